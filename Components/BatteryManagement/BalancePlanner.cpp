@@ -0,0 +1,129 @@
+/**
+ ******************************************************************************
+ * File Name          : BalancePlanner.cpp
+ * Description        : Passive cell balancing scheduler for the bq769x0
+ ******************************************************************************
+*/
+#include "BalancePlanner.hpp"
+#include "FixedPoint.hpp"
+
+/* Balance Planner ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, starts in a measurement window so the first plan uses rested voltages
+ */
+BalancePlanner::BalancePlanner()
+{
+    windowSample_ = BALANCE_ON_SAMPLES;
+    plannedMask_ = 0;
+    activeMask_ = 0;
+    relaxed_ = true;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        dutyQ15_[i] = 0;
+}
+
+/**
+ * @brief Advances the schedule by one BMS sample
+ * @param cellVoltage_mV Latest cell voltages
+ * @param cells Cell statistics for the same sample
+ * @param balancingAllowed False stops balancing immediately and drops the plan
+ * @return Cell mask to bleed until the next sample, bit n is cell n
+ */
+uint8_t BalancePlanner::Update(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], const CellStats& cells, bool balancingAllowed)
+{
+    // The first sample of a measurement window still has the bled cells pulled down
+    relaxed_ = (activeMask_ == 0);
+
+    if (!balancingAllowed) {
+        windowSample_ = BALANCE_ON_SAMPLES;
+        plannedMask_ = 0;
+        activeMask_ = 0;
+        UpdateDuty();
+        return activeMask_;
+    }
+
+    // Plan on the last sample of the measurement window, the cells have had the whole window to relax
+    if (windowSample_ == BALANCE_ON_SAMPLES + BALANCE_MEASURE_SAMPLES - 1) {
+        plannedMask_ = SelectCells(cellVoltage_mV, cells.min_mV, plannedMask_);
+        windowSample_ = 0;
+    }
+    else {
+        windowSample_++;
+    }
+
+    activeMask_ = IsMeasurementWindow() ? 0 : plannedMask_;
+    UpdateDuty();
+    return activeMask_;
+}
+
+/**
+ * @brief Picks the cells to bleed, never two on adjacent channels
+ *        Maximum weight independent set over the channel chain, O(n) dynamic program.
+ * @param cellVoltage_mV Rested cell voltages
+ * @param minCell_mV Lowest of the rested cells
+ * @param previousMask The last plan, cells in it use the lower stop threshold (hysteresis)
+ * @return Cell mask, bit n is cell n
+ */
+uint8_t BalancePlanner::SelectCells(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], uint16_t minCell_mV, uint8_t previousMask)
+{
+    // best[i + 1] is the heaviest valid selection among cells 0..i, best[0] is the empty selection
+    uint32_t best[BATTERY_NUM_CELLS + 1];
+    bool taken[BATTERY_NUM_CELLS];
+    best[0] = 0;
+
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        const uint16_t excess_mV = cellVoltage_mV[i] - minCell_mV;
+        const uint16_t threshold_mV = (previousMask & (1 << i)) ? BALANCE_STOP_DELTA_MV : BALANCE_START_DELTA_MV;
+        const bool candidate = (excess_mV > threshold_mV) && (cellVoltage_mV[i] >= BALANCE_MIN_CELL_MV);
+
+        // Taking cell i excludes cell i-1 only if they sit on neighbouring channels
+        const bool conflict = (i > 0) && (BMS_CELL_CHANNEL[i] == BMS_CELL_CHANNEL[i - 1] + 1);
+        const uint32_t weight = candidate ? ((uint32_t)excess_mV * excess_mV) : 0;
+        const uint32_t takeWeight = weight + (conflict ? best[i - 1] : best[i]);
+
+        taken[i] = candidate && (takeWeight > best[i]);
+        best[i + 1] = taken[i] ? takeWeight : best[i];
+    }
+
+    // Walk back through the decisions
+    uint8_t mask = 0;
+    int8_t i = BATTERY_NUM_CELLS - 1;
+    while (i >= 0) {
+        if (taken[i]) {
+            mask |= (1 << i);
+            const bool conflict = (i > 0) && (BMS_CELL_CHANNEL[i] == BMS_CELL_CHANNEL[i - 1] + 1);
+            i -= conflict ? 2 : 1;
+        }
+        else {
+            i--;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Maps a cell mask onto the CELLBAL1 register bits
+ * @param cellMask Bit n is cell n
+ * @return CELLBAL1 value
+ */
+uint8_t BalancePlanner::ToCellBalRegister(uint8_t cellMask)
+{
+    uint8_t reg = 0;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        if (cellMask & (1 << i))
+            reg |= (1 << BMS_CELL_CHANNEL[i]);
+    }
+    return reg;
+}
+
+/**
+ * @brief Updates the per cell balancing duty average
+ */
+void BalancePlanner::UpdateDuty()
+{
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        int32_t duty = dutyQ15_[i];
+        FixedPoint::LowPass(duty, (activeMask_ & (1 << i)) ? Q15_ONE : 0, BALANCE_DUTY_FILTER_SHIFT);
+        dutyQ15_[i] = (uint16_t)duty;
+    }
+}
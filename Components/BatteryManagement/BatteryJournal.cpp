@@ -0,0 +1,105 @@
+/**
+ ******************************************************************************
+ * File Name          : BatteryJournal.cpp
+ * Description        : Battery state transition journal and dwell histograms
+ ******************************************************************************
+*/
+#include "BatteryJournal.hpp"
+
+/* Battery Journal ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, empty journal and histograms
+ */
+BatteryJournal::BatteryJournal() : sequence_(0)
+{
+    Clear(0);
+}
+
+/**
+ * @brief Starts timing the substate the state machine starts in
+ * @param now_us Current time
+ */
+void BatteryJournal::Start(uint64_t now_us)
+{
+    enteredAt_us_ = now_us;
+}
+
+/**
+ * @brief Records a transition and the dwell in the substate being left
+ * @param now_us Current time
+ * @param event The event that triggered the transition
+ * @param faultMask Limits tripped on the triggering sample
+ * @param fromState State being left
+ * @param fromSubstate Substate being left
+ * @param toState State being entered, same as fromState for a substate transition
+ * @param toSubstate Substate being entered
+ */
+void BatteryJournal::Record(uint64_t now_us, BatteryEvent event, uint32_t faultMask,
+    BatteryState fromState, BatterySubstate fromSubstate, BatteryState toState, BatterySubstate toSubstate)
+{
+    if (fromSubstate < BSS_COUNT) {
+        uint16_t& bin = dwell_[fromSubstate][DwellBin(now_us - enteredAt_us_)];
+        bin = (bin < UINT16_MAX) ? bin + 1 : UINT16_MAX;
+    }
+    enteredAt_us_ = now_us;
+
+    BatteryJournalEntry& entry = entries_[head_];
+    entry.timestamp_us = now_us;
+    entry.faultMask = faultMask;
+    entry.sequence = sequence_++;
+    entry.event = (uint8_t)event;
+    entry.fromState = (uint8_t)fromState;
+    entry.fromSubstate = (uint8_t)fromSubstate;
+    entry.toState = (uint8_t)toState;
+    entry.toSubstate = (uint8_t)toSubstate;
+
+    head_ = (head_ + 1 < BATTERY_JOURNAL_LENGTH) ? head_ + 1 : 0;
+    count_ = (count_ < BATTERY_JOURNAL_LENGTH) ? count_ + 1 : BATTERY_JOURNAL_LENGTH;
+}
+
+/**
+ * @brief Drops every entry and histogram count, the sequence keeps running
+ * @param now_us Current time, the current substate's dwell restarts here
+ */
+void BatteryJournal::Clear(uint64_t now_us)
+{
+    head_ = 0;
+    count_ = 0;
+    for (uint8_t s = 0; s < BSS_COUNT; s++) {
+        for (uint8_t b = 0; b < BATTERY_DWELL_BINS; b++)
+            dwell_[s][b] = 0;
+    }
+    enteredAt_us_ = now_us;
+}
+
+/**
+ * @brief Reads back an entry
+ * @param age 0 is the newest entry, GetCount() - 1 the oldest
+ * @param entry Filled with the entry
+ * @return False if there is no entry that old
+ */
+bool BatteryJournal::GetEntry(uint8_t age, BatteryJournalEntry& entry) const
+{
+    if (age >= count_)
+        return false;
+
+    const uint8_t index = (head_ > age) ? head_ - 1 - age : head_ + BATTERY_JOURNAL_LENGTH - 1 - age;
+    entry = entries_[index];
+    return true;
+}
+
+/**
+ * @brief Histogram bin for a dwell time, floor(log2(seconds)) + 1 with everything under a second in bin 0
+ * @param dwell_us Dwell time
+ * @return Bin index, clamped to the last bin
+ */
+uint8_t BatteryJournal::DwellBin(uint64_t dwell_us)
+{
+    uint32_t seconds = (dwell_us >= (uint64_t)UINT32_MAX * 1000000) ? UINT32_MAX : (uint32_t)(dwell_us / 1000000);
+    uint8_t bin = 0;
+    while (seconds != 0 && bin < BATTERY_DWELL_BINS - 1) {
+        seconds >>= 1;
+        bin++;
+    }
+    return bin;
+}
@@ -0,0 +1,75 @@
+/**
+ ******************************************************************************
+ * File Name          : CellStats.cpp
+ * Description        : Per sample cell voltage statistics
+ ******************************************************************************
+*/
+#include "CellStats.hpp"
+#include <cstring>
+
+/* Cell Stats ------------------------------------------------------------------*/
+/**
+ * @brief Computes every statistic in one pass over the cells
+ *        Cells are read two at a time as one 32-bit word, each pair is ordered first
+ *        so it costs 3 compares per 2 cells instead of 4. The cell count is a
+ *        compile time constant, so the loop fully unrolls.
+ * @param cellVoltage_mV Cell voltages, need not be word aligned
+ * @return The statistics
+ */
+CellStats CellStats::Compute(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS])
+{
+    static_assert(BATTERY_NUM_CELLS >= 1 && BATTERY_NUM_CELLS <= UINT8_MAX, "Cell count out of range");
+
+    CellStats stats;
+    uint16_t minCell = UINT16_MAX;
+    uint16_t maxCell = 0;
+    uint8_t minIndex = 0;
+    uint8_t maxIndex = 0;
+    uint32_t sum = 0;
+
+    uint8_t i = 0;
+    for (; i + 1 < BATTERY_NUM_CELLS; i += 2) {
+        // The array may only be halfword aligned and the M0+ can't do unaligned loads, memcpy compiles to the right access
+        uint32_t pair;
+        memcpy(&pair, &cellVoltage_mV[i], sizeof(pair));
+        const uint16_t a = (uint16_t)pair;            // Little endian, cell i is the low half
+        const uint16_t b = (uint16_t)(pair >> 16);
+        sum += (uint32_t)a + b;
+
+        // Order the pair, then the low one can only be a new min and the high one a new max
+        const bool aLow = a <= b;
+        const uint16_t lo = aLow ? a : b;
+        const uint16_t hi = aLow ? b : a;
+        if (lo < minCell) {
+            minCell = lo;
+            minIndex = aLow ? i : i + 1;
+        }
+        if (hi > maxCell) {
+            maxCell = hi;
+            maxIndex = aLow ? i + 1 : i;
+        }
+    }
+
+    // Odd cell count leaves one
+    if (i < BATTERY_NUM_CELLS) {
+        const uint16_t a = cellVoltage_mV[i];
+        sum += a;
+        if (a < minCell) {
+            minCell = a;
+            minIndex = i;
+        }
+        if (a > maxCell) {
+            maxCell = a;
+            maxIndex = i;
+        }
+    }
+
+    stats.min_mV = minCell;
+    stats.max_mV = maxCell;
+    stats.minIndex = minIndex;
+    stats.maxIndex = maxIndex;
+    stats.sum_mV = sum;
+    stats.mean_mV = (uint16_t)(sum / BATTERY_NUM_CELLS);    // Constant divisor, a shift for the 4S pack
+    stats.spread_mV = maxCell - minCell;
+    return stats;
+}
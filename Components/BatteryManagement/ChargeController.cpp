@@ -0,0 +1,172 @@
+/**
+ ******************************************************************************
+ * File Name          : ChargeController.cpp
+ * Description        : CC/CV charge profile for the LTC4015
+ ******************************************************************************
+*/
+#include "ChargeController.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+// Indexed by ChargeZone, the hot zone has no upper limit
+static constexpr ChargeZoneEntry ZONE_TABLE[CHARGE_ZONE_COUNT] = {
+    // Upper       Current                             Cell voltage
+    { 0,           0,                                  0 },                            // CHARGE_ZONE_COLD
+    { 100,         CHARGE_CURRENT_NOMINAL_MA / 2,      CHARGE_CELL_VOLTAGE_MV },        // CHARGE_ZONE_COOL
+    { 450,         CHARGE_CURRENT_NOMINAL_MA,          CHARGE_CELL_VOLTAGE_MV },        // CHARGE_ZONE_STANDARD
+    { 600,         CHARGE_CURRENT_NOMINAL_MA / 2,      CHARGE_CELL_VOLTAGE_MV - 100 },    // CHARGE_ZONE_WARM
+    { INT16_MAX,   0,                                  0 },                            // CHARGE_ZONE_HOT
+};
+
+/* Charge Controller ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, starts suspended in the standard zone
+ */
+ChargeController::ChargeController()
+{
+    zone_ = CHARGE_ZONE_STANDARD;
+    terminated_ = false;
+    constantVoltage_ = false;
+    terminatedSocQ15_ = 0;
+    imbalanceDerate_ = false;
+    cvCeiling_mV_ = CHARGE_CELL_VOLTAGE_MV;
+    setpoint_ = Quantize(Milliamps(0), Millivolts(CHARGE_CELL_VOLTAGE_MV));
+}
+
+/**
+ * @brief Recomputes the setpoint from a new BMS sample
+ * @param bms The BMS sample
+ * @param cells Cell statistics for the same sample
+ * @param current Offset corrected pack current, positive is charging
+ * @param socQ15 State of charge
+ * @param chargingAllowed False suspends the charger (any state other than charging)
+ * @return True if a register code changed and the setpoint has to be written
+ */
+bool ChargeController::Update(const BMSData& bms, const CellStats& cells, Milliamps current, uint16_t socQ15, bool chargingAllowed)
+{
+    const ChargeZone previousZone = zone_;
+    UpdateZone(bms.temperature_dC);
+    if (!chargingAllowed || zone_ != previousZone)
+        cvCeiling_mV_ = ZONE_TABLE[zone_].cellVoltage_mV;
+
+    // Terminate once the CV phase has tapered off, restart once the pack has sagged
+    constantVoltage_ = !setpoint_.suspend && (cells.mean_mV + CHARGE_CV_BAND_MV >= setpoint_.cellVoltage_mV);
+    if (!chargingAllowed) {
+        terminated_ = false;
+    }
+    else if (!terminated_ && constantVoltage_ && current < CHARGE_TERMINATE_CURRENT) {
+        terminated_ = true;
+        terminatedSocQ15_ = socQ15;
+    }
+    else if (terminated_ && socQ15 + CHARGE_RESTART_SOC_DROP_Q15 < terminatedSocQ15_) {
+        terminated_ = false;
+    }
+
+    const ChargeZoneEntry& zone = ZONE_TABLE[zone_];
+    uint16_t target_mA = zone.current_mA;
+    uint16_t target_mV = zone.cellVoltage_mV;
+
+    if (!chargingAllowed || terminated_) {
+        target_mA = 0;
+    }
+    else if (cells.min_mV < CHARGE_PRECHARGE_CELL_MV) {
+        target_mA = (target_mA < CHARGE_CURRENT_PRECHARGE_MA) ? target_mA : CHARGE_CURRENT_PRECHARGE_MA;
+    }
+    else {
+        if (cells.spread_mV > CHARGE_IMBALANCE_DERATE_MV)
+            imbalanceDerate_ = true;
+        else if (cells.spread_mV < CHARGE_IMBALANCE_RELEASE_MV)
+            imbalanceDerate_ = false;
+
+        if (imbalanceDerate_)
+            target_mA /= 2;
+    }
+
+    // The charger regulates the pack, the highest cell ends up (max - average) above the per cell target
+    const uint16_t topCellExcess_mV = cells.max_mV - cells.mean_mV;
+    target_mV = (target_mV > topCellExcess_mV) ? target_mV - topCellExcess_mV : 0;
+    target_mV = (target_mV < cvCeiling_mV_) ? target_mV : cvCeiling_mV_;
+    cvCeiling_mV_ = target_mV;
+
+    const ChargeSetpoint next = Quantize(Milliamps(target_mA), Millivolts(target_mV));
+    const bool changed = (next.iChargeTarget != setpoint_.iChargeTarget)
+        || (next.vChargeSetting != setpoint_.vChargeSetting)
+        || (next.suspend != setpoint_.suspend);
+
+    setpoint_ = next;
+    return changed;
+}
+
+/**
+ * @brief Finds the zone for a temperature with no hysteresis
+ * @param temperature_dC Pack temperature
+ * @return The zone
+ */
+ChargeZone ChargeController::ZoneFromTemperature(int16_t temperature_dC)
+{
+    uint8_t zone = 0;
+    while (zone < CHARGE_ZONE_HOT && temperature_dC >= ZONE_TABLE[zone].upperLimit_dC)
+        zone++;
+    return (ChargeZone)zone;
+}
+
+/**
+ * @brief Rounds a setpoint down to the LTC4015 register codes
+ * @param current Charge current, anything below one LSB suspends the charger
+ * @param cellVoltage Per cell CV target, clamped to the register range
+ * @return The quantized setpoint
+ */
+ChargeSetpoint ChargeController::Quantize(Milliamps current, Millivolts cellVoltage)
+{
+    ChargeSetpoint setpoint;
+
+    // I = (code + 1) * LSB, round down so we never exceed the target
+    const uint32_t current_mA = (current.Value() > 0) ? (uint32_t)current.Value() : 0;
+    if (current_mA < CHARGER_ICHARGE_LSB_MA) {
+        setpoint.iChargeTarget = 0;
+        setpoint.current_mA = 0;
+        setpoint.suspend = true;
+    }
+    else {
+        uint32_t code = current_mA / CHARGER_ICHARGE_LSB_MA - 1;
+        code = (code > CHARGER_ICHARGE_TARGET_MAX) ? CHARGER_ICHARGE_TARGET_MAX : code;
+        setpoint.iChargeTarget = (uint8_t)code;
+        setpoint.current_mA = (uint16_t)((code + 1) * CHARGER_ICHARGE_LSB_MA);
+        setpoint.suspend = false;
+    }
+
+    // V = (base + code * step) / 2 in 0.5mV units, also rounded down
+    const uint32_t target_halfMv = (cellVoltage.Value() > 0) ? (uint32_t)cellVoltage.Value() * 2 : 0;
+    uint32_t code = (target_halfMv > CHARGER_VCHARGE_BASE_HALF_MV) ? (target_halfMv - CHARGER_VCHARGE_BASE_HALF_MV) / CHARGER_VCHARGE_STEP_HALF_MV : 0;
+    code = (code > CHARGER_VCHARGE_SETTING_MAX) ? CHARGER_VCHARGE_SETTING_MAX : code;
+    setpoint.vChargeSetting = (uint8_t)code;
+    setpoint.cellVoltage_mV = (uint16_t)((CHARGER_VCHARGE_BASE_HALF_MV + code * CHARGER_VCHARGE_STEP_HALF_MV) / 2);
+
+    return setpoint;
+}
+
+/**
+ * @brief Moves to the zone for the temperature, limits tighten immediately but only
+ *        ease once the temperature is back past the boundary by the hysteresis
+ * @param temperature_dC Pack temperature
+ */
+void ChargeController::UpdateZone(int16_t temperature_dC)
+{
+    const ChargeZone raw = ZoneFromTemperature(temperature_dC);
+    if (raw == zone_)
+        return;
+
+    const uint8_t rawDistance = (raw > CHARGE_ZONE_STANDARD) ? raw - CHARGE_ZONE_STANDARD : CHARGE_ZONE_STANDARD - raw;
+    const uint8_t zoneDistance = (zone_ > CHARGE_ZONE_STANDARD) ? zone_ - CHARGE_ZONE_STANDARD : CHARGE_ZONE_STANDARD - zone_;
+
+    if (rawDistance >= zoneDistance) {
+        zone_ = raw;
+        return;
+    }
+
+    // Easing, check against the boundary we'd cross with the hysteresis applied
+    const ChargeZone eased = (raw > zone_)
+        ? ZoneFromTemperature(temperature_dC - CHARGE_ZONE_HYSTERESIS_DC)
+        : ZoneFromTemperature(temperature_dC + CHARGE_ZONE_HYSTERESIS_DC);
+    if (eased != zone_)
+        zone_ = eased;
+}
@@ -0,0 +1,161 @@
+/**
+ ******************************************************************************
+ * File Name          : CoulombCounter.cpp
+ * Description        : Fixed-point coulomb counting state of charge engine
+ ******************************************************************************
+*/
+#include "CoulombCounter.hpp"
+#include "FixedPoint.hpp"
+#include "OCVCurve.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+// Pack temperature (0.1C) to usable capacity factor (Q15)
+static constexpr uint8_t CAPACITY_TABLE_SIZE = 7;
+static constexpr int32_t CAPACITY_TABLE_DC[CAPACITY_TABLE_SIZE] = {
+    -200, -100, 0, 100, 250, 450, 600
+};
+static constexpr int32_t CAPACITY_TABLE_FACTOR_Q15[CAPACITY_TABLE_SIZE] = {
+    19661, 24576, 27853, 30474, 32768, 32768, 31785
+};
+
+/* Coulomb Counter ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, the counter is seeded from the OCV on the first Update()
+ */
+CoulombCounter::CoulombCounter() :
+    nominalCapacityQ4_((int32_t)((uint32_t)BATTERY_NOMINAL_CAPACITY_MAH * BMS_CC_COUNTS_PER_MAH) << CC_CHARGE_FRAC_BITS)
+{
+    chargeQ4_ = 0;
+    offsetQ12_ = 0;
+    lastCorrectedQ4_ = 0;
+    restSamples_ = 0;
+    ocvCalibrated_ = false;
+    initialized_ = false;
+    socQ15_ = 0;
+    UpdateCapacity(250);
+}
+
+/**
+ * @brief Integrates one CC sample, call once per CC_READY
+ * @param ccReading Raw CC register value, positive is charging
+ * @param cellVoltage Average cell voltage, used for OCV recalibration
+ * @param temperature_dC Pack temperature in 0.1C
+ * @param zeroCurrentExpected True if both FETs are open, the reading is then pure offset
+ */
+void CoulombCounter::Update(int16_t ccReading, Millivolts cellVoltage, int16_t temperature_dC, bool zeroCurrentExpected)
+{
+    // Seed from the OCV so we don't start at 0%, this is only a rough estimate until we've rested
+    if (!initialized_) {
+        UpdateCapacity(temperature_dC);
+        CalibrateFromOCV(cellVoltage);
+        initialized_ = true;
+    }
+
+    // With the FETs open any reading is offset, learn it and don't integrate
+    if (zeroCurrentExpected) {
+        const int32_t sample = FixedPoint::Clamp<int32_t>(ccReading, -CC_OFFSET_MAX_COUNTS, CC_OFFSET_MAX_COUNTS);
+        FixedPoint::LowPass(offsetQ12_, sample << CC_OFFSET_FRAC_BITS, CC_OFFSET_FILTER_SHIFT);
+        lastCorrectedQ4_ = 0;
+    }
+    else {
+        lastCorrectedQ4_ = ((int32_t)ccReading << CC_CHARGE_FRAC_BITS) - (offsetQ12_ >> (CC_OFFSET_FRAC_BITS - CC_CHARGE_FRAC_BITS));
+        chargeQ4_ = FixedPoint::Clamp<int32_t>(chargeQ4_ + lastCorrectedQ4_, 0, nominalCapacityQ4_);
+    }
+
+    // Re-anchor to the OCV curve once per rest period, after the cells have relaxed
+    const int32_t restThresholdQ4 = CC_REST_THRESHOLD_COUNTS << CC_CHARGE_FRAC_BITS;
+    if (lastCorrectedQ4_ > -restThresholdQ4 && lastCorrectedQ4_ < restThresholdQ4) {
+        if (restSamples_ < CC_REST_SAMPLES_FOR_OCV) {
+            if (++restSamples_ == CC_REST_SAMPLES_FOR_OCV) {
+                CalibrateFromOCV(cellVoltage);
+                ocvCalibrated_ = true;
+            }
+        }
+    }
+    else {
+        restSamples_ = 0;
+    }
+
+    // Temperature changes slowly, only redo the capacity (and its reciprocal) when it moves
+    const int16_t tempDelta = temperature_dC - capacityTemperature_dC_;
+    if (tempDelta >= CC_TEMP_RECOMPUTE_DC || tempDelta <= -CC_TEMP_RECOMPUTE_DC)
+        UpdateCapacity(temperature_dC);
+
+    UpdateStateOfCharge();
+}
+
+/**
+ * @brief Sets the stored charge from a rested cell voltage
+ * @param cellVoltage Rested (open circuit) average cell voltage
+ */
+void CoulombCounter::CalibrateFromOCV(Millivolts cellVoltage)
+{
+    // The OCV curve is against the full nominal capacity, the temperature derating only affects usable charge
+    chargeQ4_ = (int32_t)(((int64_t)nominalCapacityQ4_ * OCVCurve::ToStateOfChargeQ15(cellVoltage)) >> 15);
+    UpdateStateOfCharge();
+}
+
+/**
+ * @brief Recomputes the temperature derated capacity and its reciprocal
+ * @param temperature_dC Pack temperature in 0.1C
+ */
+void CoulombCounter::UpdateCapacity(int16_t temperature_dC)
+{
+    capacityTemperature_dC_ = temperature_dC;
+    usableCapacityQ4_ = FixedPoint::MulQ15(nominalCapacityQ4_, CapacityFactorQ15(temperature_dC));
+    unavailableChargeQ4_ = nominalCapacityQ4_ - usableCapacityQ4_;
+    usableCapacityRecip_ = (1ULL << 47) / (uint64_t)usableCapacityQ4_;
+}
+
+/**
+ * @brief Recomputes the Q15 state of charge from the stored charge
+ */
+void CoulombCounter::UpdateStateOfCharge()
+{
+    const int32_t availableQ4 = chargeQ4_ - unavailableChargeQ4_;
+    if (availableQ4 <= 0) {
+        socQ15_ = 0;
+        return;
+    }
+
+    const uint32_t soc = (uint32_t)(((uint64_t)availableQ4 * usableCapacityRecip_) >> 32);
+    socQ15_ = (soc > Q15_ONE) ? Q15_ONE : (uint16_t)soc;
+}
+
+/**
+ * @brief Offset corrected current of the last sample
+ * @return Current, positive is charging
+ */
+Milliamps CoulombCounter::GetCurrent() const
+{
+    return Milliamps((int32_t)(((int64_t)lastCorrectedQ4_ * BMS_CC_LSB_UA) / (1000 << CC_CHARGE_FRAC_BITS)));
+}
+
+/**
+ * @brief Charge that can still be drawn at the present temperature
+ * @return Remaining capacity in mAh
+ */
+int32_t CoulombCounter::GetRemainingCapacityMah() const
+{
+    const int32_t availableQ4 = chargeQ4_ - unavailableChargeQ4_;
+    return (availableQ4 <= 0) ? 0 : (availableQ4 / (int32_t)(BMS_CC_COUNTS_PER_MAH << CC_CHARGE_FRAC_BITS));
+}
+
+/**
+ * @brief Capacity at the present temperature
+ * @return Usable capacity in mAh
+ */
+uint16_t CoulombCounter::GetUsableCapacityMah() const
+{
+    return (uint16_t)(usableCapacityQ4_ / (int32_t)(BMS_CC_COUNTS_PER_MAH << CC_CHARGE_FRAC_BITS));
+}
+
+/**
+ * @brief Looks up the fraction of nominal capacity usable at a temperature
+ * @param temperature_dC Pack temperature in 0.1C
+ * @return Capacity factor in Q15
+ */
+uint16_t CoulombCounter::CapacityFactorQ15(int16_t temperature_dC)
+{
+    return (uint16_t)FixedPoint::Interpolate(CAPACITY_TABLE_DC, CAPACITY_TABLE_FACTOR_Q15, CAPACITY_TABLE_SIZE, temperature_dC);
+}
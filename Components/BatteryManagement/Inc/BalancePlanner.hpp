@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * File Name          : BalancePlanner.hpp
+ * Description        : Passive cell balancing scheduler for the bq769x0
+ *                      CELLBAL registers.
+ *
+ *    Balancing runs in fixed periods: a balancing window with the planned cells
+ *    bleeding, then a measurement window with balancing off so the cells relax and
+ *    the next plan is made from clean voltages. The plan is the heaviest set of
+ *    cells with no two on adjacent channels (the bq769x0 rule), weighted by the
+ *    square of each cell's excess so the cells furthest out are always served.
+ ******************************************************************************
+*/
+#ifndef BR_BALANCE_PLANNER_HPP_
+#define BR_BALANCE_PLANNER_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "CellStats.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint8_t BALANCE_ON_SAMPLES = 16;            // Balancing window, 4s at 250ms
+constexpr uint8_t BALANCE_MEASURE_SAMPLES = 4;        // Measurement window (balancing paused), 1s at 250ms
+constexpr uint16_t BALANCE_START_DELTA_MV = 15;        // Start bleeding a cell this far above the lowest
+constexpr uint16_t BALANCE_STOP_DELTA_MV = 5;        // Keep bleeding until it's within this of the lowest
+constexpr uint16_t BALANCE_MIN_CELL_MV = 3700;        // Don't bleed cells below this
+constexpr uint8_t BALANCE_DUTY_FILTER_SHIFT = 6;    // Duty average, ~64 samples
+
+/* Class ------------------------------------------------------------------*/
+class BalancePlanner
+{
+public:
+    BalancePlanner();
+
+    uint8_t Update(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], const CellStats& cells, bool balancingAllowed);
+
+    uint8_t GetCellMask() const { return activeMask_; }
+    uint8_t GetCellBalRegister() const { return ToCellBalRegister(activeMask_); }
+    bool IsMeasurementWindow() const { return windowSample_ >= BALANCE_ON_SAMPLES; }
+    bool IsRelaxedSample() const { return relaxed_; }    // Nothing bled since the sample before, its spread is real
+    uint16_t GetDutyQ15(uint8_t cell) const { return dutyQ15_[cell]; }
+    uint8_t GetDutyPercent(uint8_t cell) const { return (uint8_t)(((uint32_t)dutyQ15_[cell] * 100 + (1 << 14)) >> 15); }
+
+    static uint8_t SelectCells(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], uint16_t minCell_mV, uint8_t previousMask);
+    static uint8_t ToCellBalRegister(uint8_t cellMask);
+
+protected:
+    void UpdateDuty();
+
+    uint8_t windowSample_;    // Position in the balance/measure period
+    uint8_t plannedMask_;    // Cells to bleed in the next balancing window, bit n is cell n
+    uint8_t activeMask_;    // Cells bleeding right now
+    bool relaxed_;          // The last sample was taken with nothing bleeding since the one before
+    uint16_t dutyQ15_[BATTERY_NUM_CELLS];
+};
+
+#endif // BR_BALANCE_PLANNER_HPP_
@@ -0,0 +1,53 @@
+/**
+ ******************************************************************************
+ * File Name          : BatteryConfig.hpp
+ * Description        : Pack and sense-chain parameters shared by the battery
+ *                      estimation, protection and charging logic.
+ *
+ *    Kept free of RTOS/HAL includes so the battery algorithms can be built on host.
+ ******************************************************************************
+*/
+#ifndef BR_BATTERY_CONFIG_HPP_
+#define BR_BATTERY_CONFIG_HPP_
+#include <cstdint>
+
+/* Pack ------------------------------------------------------------------*/
+constexpr uint8_t BATTERY_NUM_CELLS = 4;                    // Series cells on the bq76920 (4S pack)
+constexpr uint16_t BATTERY_NOMINAL_CAPACITY_MAH = 3000;    // Rated pack capacity at 25C
+constexpr uint16_t BATTERY_CELL_EMPTY_MV = 3000;            // Cell voltage considered 0% (OCV)
+constexpr uint16_t BATTERY_CELL_FULL_MV = 4200;            // Cell voltage considered 100% (OCV)
+
+/* bq769x0 Cell Channels ------------------------------------------------------------------*/
+// CELLBAL1 bit used by each cell, a 4S pack on the bq76920 leaves VC4 shorted so cell 4 sits on channel 5
+constexpr uint8_t BMS_CELL_CHANNEL[BATTERY_NUM_CELLS] = { 0, 1, 2, 4 };
+
+/* bq769x0 FETs ------------------------------------------------------------------*/
+constexpr uint8_t BMS_FET_CHG = 0x01;                        // SYS_CTRL2 CHG_ON
+constexpr uint8_t BMS_FET_DSG = 0x02;                        // SYS_CTRL2 DSG_ON
+
+/* bq769x0 Coulomb Counter ------------------------------------------------------------------*/
+constexpr uint32_t BMS_CC_LSB_NV = 8440;                    // CC register LSB, 8.44uV
+constexpr uint32_t BMS_SENSE_RESISTOR_UOHM = 1000;            // Pack current sense resistor, 1mOhm
+constexpr uint32_t BMS_CC_LSB_UA = BMS_CC_LSB_NV * 1000 / BMS_SENSE_RESISTOR_UOHM;    // Current per CC LSB in uA
+constexpr uint16_t BMS_CC_SAMPLE_PERIOD_MS = 250;            // CC_READY period in continuous conversion mode
+
+// Number of CC counts (one reading held for one sample period) in one mAh, 1mAh = 3.6e9 uA*ms
+constexpr uint32_t BMS_CC_COUNTS_PER_MAH = (uint32_t)(3600000000ULL / ((uint64_t)BMS_CC_LSB_UA * BMS_CC_SAMPLE_PERIOD_MS));
+
+/* bq769x0 TS Input ------------------------------------------------------------------*/
+constexpr uint32_t BMS_TS_ADC_LSB_UV = 382;                // TS ADC LSB, 382uV
+constexpr uint32_t BMS_TS_PULLUP_UV = 3300000;            // Internal pull-up supply, 3.3V
+constexpr uint32_t BMS_TS_PULLUP_OHM = 10000;                // Internal pull-up, 10k
+constexpr uint32_t BMS_THERMISTOR_R25_OHM = 10000;        // 103AT NTC
+constexpr uint32_t BMS_THERMISTOR_BETA = 3435;
+
+/* LTC4015 Charger ------------------------------------------------------------------*/
+constexpr uint32_t CHARGER_SENSE_RESISTOR_UOHM = 4000;        // RSNSB, battery current sense resistor, 4mOhm
+constexpr uint32_t CHARGER_ICHARGE_LSB_MA = 1000000 / CHARGER_SENSE_RESISTOR_UOHM;    // ICHARGE_TARGET LSB, 1mV / RSNSB
+constexpr uint8_t CHARGER_ICHARGE_TARGET_MAX = 31;            // 5-bit register, I = (code + 1) * LSB
+// Li-ion VCHARGE_SETTING, V/cell = code / 80 + 3.8125V, kept in 0.5mV units so it's exact
+constexpr uint16_t CHARGER_VCHARGE_BASE_HALF_MV = 7625;
+constexpr uint16_t CHARGER_VCHARGE_STEP_HALF_MV = 25;
+constexpr uint8_t CHARGER_VCHARGE_SETTING_MAX = 31;            // 4.2V/cell
+
+#endif // BR_BATTERY_CONFIG_HPP_
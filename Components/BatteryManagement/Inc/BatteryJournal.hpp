@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * File Name          : BatteryJournal.hpp
+ * Description        : Fixed size binary journal of battery state transitions
+ *                      and per-substate dwell time histograms.
+ *
+ *    Every transition is one fixed size entry in a ring that keeps the newest
+ *    BATTERY_JOURNAL_LENGTH. Entries carry a running sequence number so a
+ *    reader can tell what was overwritten between two dumps. The dwell time
+ *    spent in the substate being left goes into a log2 histogram, bin 0 is
+ *    under a second and bin n is [2^(n-1), 2^n) seconds, the last bin holds
+ *    everything longer. Nothing is allocated and nothing is formatted here,
+ *    printing and sending are up to the owner.
+ ******************************************************************************
+*/
+#ifndef BR_BATTERY_JOURNAL_HPP_
+#define BR_BATTERY_JOURNAL_HPP_
+#include <cstdint>
+#include "BatteryState.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint8_t BATTERY_JOURNAL_LENGTH = 32;            // Transitions kept, 24 bytes each
+constexpr uint8_t BATTERY_DWELL_BINS = 16;                // Last bin starts at 2^14s, ~4.5 hours
+
+/* Structs ------------------------------------------------------------------*/
+struct BatteryJournalEntry {
+    uint64_t timestamp_us;        // Clock::Micros() when the transition was taken
+    uint32_t faultMask;            // Limits tripped on the sample that triggered it, bit per ProtectionLimit
+    uint16_t sequence;            // Running count of transitions, wraps
+    uint8_t event;                // BatteryEvent that triggered it
+    uint8_t fromState;            // BatteryState
+    uint8_t fromSubstate;        // BatterySubstate
+    uint8_t toState;
+    uint8_t toSubstate;
+};
+
+/* Class ------------------------------------------------------------------*/
+class BatteryJournal
+{
+public:
+    BatteryJournal();
+
+    void Start(uint64_t now_us);
+    void Record(uint64_t now_us, BatteryEvent event, uint32_t faultMask,
+        BatteryState fromState, BatterySubstate fromSubstate, BatteryState toState, BatterySubstate toSubstate);
+    void Clear(uint64_t now_us);
+
+    uint8_t GetCount() const { return count_; }
+    uint16_t GetSequence() const { return sequence_; }
+    bool GetEntry(uint8_t age, BatteryJournalEntry& entry) const;    // Age 0 is the newest
+    uint16_t GetDwellCount(BatterySubstate substate, uint8_t bin) const { return dwell_[substate][bin]; }
+    uint64_t GetCurrentDwell_us(uint64_t now_us) const { return now_us - enteredAt_us_; }
+
+    static uint8_t DwellBin(uint64_t dwell_us);
+
+protected:
+    BatteryJournalEntry entries_[BATTERY_JOURNAL_LENGTH];
+    uint8_t head_;                // Next slot to write
+    uint8_t count_;
+    uint16_t sequence_;
+
+    uint16_t dwell_[BSS_COUNT][BATTERY_DWELL_BINS];    // Saturating counts
+    uint64_t enteredAt_us_;        // When the current substate was entered
+};
+
+#endif // BR_BATTERY_JOURNAL_HPP_
@@ -0,0 +1,61 @@
+/**
+ ******************************************************************************
+ * File Name          : BatteryState.hpp
+ * Description        : Battery state and event IDs, shared by BatterySM and the
+ *                      battery algorithms that decide transitions.
+ ******************************************************************************
+*/
+#ifndef BR_BATTERY_STATE_HPP_
+#define BR_BATTERY_STATE_HPP_
+
+enum BatteryState
+{
+    BS_IDLE = 0,
+    BS_CHARGING,
+    BS_DISCHARGING,
+	BS_FAULT,
+    BS_NONE         // Invalid state, must be last
+};
+
+// Bit for a state in per-state enable masks
+constexpr unsigned StateBit(BatteryState state) { return 1U << state; }
+
+// Phases within a state, every state has at least one
+enum BatterySubstate
+{
+    BSS_IDLE = 0,
+    BSS_PRECHARGE,              // Charging, a cell is too low for full current
+    BSS_CONSTANT_CURRENT,       // Charging
+    BSS_CONSTANT_VOLTAGE,       // Charging, current tapering
+    BSS_TOP_OFF,                // Charging, terminated and waiting for the pack to sag
+    BSS_BALANCING,              // Charging, terminated and bleeding the high cells
+    BSS_DISCHARGE,              // Discharging
+    BSS_DISCHARGE_RESERVE,      // Discharging, state of charge below the reserve
+    BSS_FAULT,
+    BSS_COUNT
+};
+
+// Everything that can move the state machine, BatterySM's transition table has a column per event
+enum BatteryEvent
+{
+    BE_PROTECTION_FAULT = 0,    // A limit tripped that needs both FETs open
+    BE_CHARGE_INHIBIT,          // A limit tripped that only stops charging
+    BE_START_CHARGE,
+    BE_START_DISCHARGE,
+    BE_STOP,                    // Back to idle
+    BE_CLEAR_FAULT,
+
+    // Raised by BatterySM from the estimators, handled by substates
+    BE_PRECHARGE_DONE,          // Every cell is above the precharge threshold
+    BE_CV_REACHED,              // The charge controller is in constant voltage
+    BE_CHARGE_TERMINATED,       // The charge controller terminated on the CV taper
+    BE_RECHARGE,                // The charge controller restarted after termination
+    BE_IMBALANCED,              // Cell spread above the balancing start threshold
+    BE_BALANCED,                // Cell spread below the balancing stop threshold
+    BE_RESERVE,                 // State of charge fell below the reserve
+
+    BE_COUNT,
+    BE_NONE = BE_COUNT          // No event, must be last
+};
+
+#endif // BR_BATTERY_STATE_HPP_
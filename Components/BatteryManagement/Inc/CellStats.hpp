@@ -0,0 +1,26 @@
+/**
+ ******************************************************************************
+ * File Name          : CellStats.hpp
+ * Description        : Per sample cell voltage statistics, computed once and
+ *                      shared by every consumer of the cell voltages.
+ ******************************************************************************
+*/
+#ifndef BR_CELL_STATS_HPP_
+#define BR_CELL_STATS_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+
+/* Structs ------------------------------------------------------------------*/
+struct CellStats {
+    uint16_t min_mV;
+    uint16_t max_mV;
+    uint8_t minIndex;        // Lowest index on ties
+    uint8_t maxIndex;        // Any of the tied cells
+    uint16_t mean_mV;        // Rounded down
+    uint16_t spread_mV;        // max - min
+    uint32_t sum_mV;        // Pack voltage as the sum of the cells
+
+    static CellStats Compute(const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS]);
+};
+
+#endif // BR_CELL_STATS_HPP_
@@ -0,0 +1,93 @@
+/**
+ ******************************************************************************
+ * File Name          : ChargeController.hpp
+ * Description        : CC/CV charge profile for the LTC4015.
+ *
+ *    Each BMS sample the controller picks a JEITA-style temperature zone (with
+ *    hysteresis on the way back towards the standard zone), then adjusts the
+ *    zone's current and voltage for the pack: precharge for deeply discharged
+ *    cells, a lower CV target so the highest cell doesn't overshoot when the
+ *    cells are imbalanced, less current while balancing catches up, and a
+ *    termination latch once the CV phase has tapered. The CV target only
+ *    ratchets down within a zone so cell voltage noise can't toggle it between
+ *    codes. The result is quantized to the LTC4015 ICHARGE_TARGET /
+ *    VCHARGE_SETTING codes and only reported as changed when a code changes, so
+ *    the charger task only writes registers when it has to.
+ ******************************************************************************
+*/
+#ifndef BR_CHARGE_CONTROLLER_HPP_
+#define BR_CHARGE_CONTROLLER_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "Data.h"
+#include "CellStats.hpp"
+#include "Units.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+enum ChargeZone : uint8_t {
+    CHARGE_ZONE_COLD = 0,    // Below 0C, no charging
+    CHARGE_ZONE_COOL,        // 0C - 10C, reduced current
+    CHARGE_ZONE_STANDARD,    // 10C - 45C
+    CHARGE_ZONE_WARM,        // 45C - 60C, reduced current and voltage
+    CHARGE_ZONE_HOT,        // Above 60C, no charging
+    CHARGE_ZONE_COUNT
+};
+
+constexpr uint16_t CHARGE_CURRENT_NOMINAL_MA = 1500;        // 0.5C
+constexpr uint16_t CHARGE_CURRENT_PRECHARGE_MA = 300;        // 0.1C, rounds down to the lowest code
+constexpr uint16_t CHARGE_CELL_VOLTAGE_MV = 4200;
+constexpr int16_t CHARGE_ZONE_HYSTERESIS_DC = 20;            // 2C back past a boundary before easing the limits
+constexpr uint16_t CHARGE_PRECHARGE_CELL_MV = 3000;            // Precharge while any cell is below this
+constexpr uint16_t CHARGE_IMBALANCE_DERATE_MV = 50;            // Halve the current above this spread
+constexpr uint16_t CHARGE_IMBALANCE_RELEASE_MV = 30;        // Back to full current below this spread
+constexpr uint16_t CHARGE_CV_BAND_MV = 25;                    // Average cell this close to the CV target counts as CV
+constexpr uint16_t CHARGE_RESTART_SOC_DROP_Q15 = 1638;        // Restart once SoC falls 5% below where we terminated
+constexpr Milliamps CHARGE_TERMINATE_CURRENT(BATTERY_NOMINAL_CAPACITY_MAH / 20);    // C/20 taper
+
+/* Structs ------------------------------------------------------------------*/
+struct ChargeZoneEntry {
+    int16_t upperLimit_dC;        // Zone applies below this temperature
+    uint16_t current_mA;
+    uint16_t cellVoltage_mV;
+};
+
+/**
+ * @brief LTC4015 setpoint, the codes are what gets written
+ */
+struct ChargeSetpoint {
+    uint16_t current_mA;        // Quantized, 0 means the charger is suspended
+    uint16_t cellVoltage_mV;    // Quantized
+    uint8_t iChargeTarget;        // ICHARGE_TARGET register
+    uint8_t vChargeSetting;        // VCHARGE_SETTING register
+    bool suspend;                // CONFIG_BITS suspend_charger
+};
+
+/* Class ------------------------------------------------------------------*/
+class ChargeController
+{
+public:
+    ChargeController();
+
+    bool Update(const BMSData& bms, const CellStats& cells, Milliamps current, uint16_t socQ15, bool chargingAllowed);
+
+    const ChargeSetpoint& GetSetpoint() const { return setpoint_; }
+    ChargeZone GetZone() const { return zone_; }
+    bool IsTerminated() const { return terminated_; }
+    bool IsConstantVoltage() const { return constantVoltage_; }    // Pack within CHARGE_CV_BAND_MV of the CV target on the last sample
+
+    static ChargeZone ZoneFromTemperature(int16_t temperature_dC);
+    static ChargeSetpoint Quantize(Milliamps current, Millivolts cellVoltage);
+
+protected:
+    void UpdateZone(int16_t temperature_dC);
+
+    ChargeZone zone_;
+    bool terminated_;
+    bool constantVoltage_;
+    uint16_t terminatedSocQ15_;
+    bool imbalanceDerate_;
+    uint16_t cvCeiling_mV_;        // Lowest CV target since charging started or the zone changed
+    ChargeSetpoint setpoint_;
+};
+
+#endif // BR_CHARGE_CONTROLLER_HPP_
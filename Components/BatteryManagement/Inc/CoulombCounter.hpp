@@ -0,0 +1,72 @@
+/**
+ ******************************************************************************
+ * File Name          : CoulombCounter.hpp
+ * Description        : Fixed-point state of charge from bq769x0 coulomb counter
+ *                      readings.
+ *
+ *    Charge is integrated in raw CC counts (Q4) so nothing is rounded per sample.
+ *    The CC offset is learned while the FETs are open, the charge is re-anchored to
+ *    the OCV curve after a long rest, and usable capacity is derated with temperature.
+ ******************************************************************************
+*/
+#ifndef BR_COULOMB_COUNTER_HPP_
+#define BR_COULOMB_COUNTER_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "Units.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint8_t CC_CHARGE_FRAC_BITS = 4;            // Fractional bits of the charge accumulator
+constexpr uint8_t CC_OFFSET_FRAC_BITS = 12;            // Fractional bits of the offset filter state
+constexpr uint8_t CC_OFFSET_FILTER_SHIFT = 6;        // Offset filter time constant, 2^6 samples = 16s
+constexpr int32_t CC_OFFSET_MAX_COUNTS = 16;            // Largest offset we accept learning (~135mA), anything more is a real current
+constexpr int32_t CC_REST_THRESHOLD_COUNTS = 3;        // |current| below this is considered rest (~25mA)
+constexpr uint16_t CC_REST_SAMPLES_FOR_OCV = 4800;    // 20 minutes of rest before the OCV is trusted
+constexpr int16_t CC_TEMP_RECOMPUTE_DC = 10;        // Recompute usable capacity after a 1C change
+
+/* Class ------------------------------------------------------------------*/
+class CoulombCounter
+{
+public:
+    CoulombCounter();
+
+    void Update(int16_t ccReading, Millivolts cellVoltage, int16_t temperature_dC, bool zeroCurrentExpected);
+    void CalibrateFromOCV(Millivolts cellVoltage);
+
+    uint16_t GetStateOfChargeQ15() const { return socQ15_; }
+    uint8_t GetStateOfChargePercent() const { return (uint8_t)(((uint32_t)socQ15_ * 100 + (1 << 14)) >> 15); }
+    Milliamps GetCurrent() const;
+    int32_t GetRemainingCapacityMah() const;
+    uint16_t GetUsableCapacityMah() const;
+    int32_t GetOffsetCountsQ12() const { return offsetQ12_; }
+    bool IsOCVCalibrated() const { return ocvCalibrated_; }
+
+    static uint16_t CapacityFactorQ15(int16_t temperature_dC);
+
+protected:
+    void UpdateCapacity(int16_t temperature_dC);
+    void UpdateStateOfCharge();
+
+    // Charge in CC counts (Q4) referenced to an empty pack at 25C
+    int32_t chargeQ4_;
+    const int32_t nominalCapacityQ4_;
+
+    // Temperature derated capacity, the capacity lost to temperature is taken off the bottom
+    int32_t usableCapacityQ4_;
+    int32_t unavailableChargeQ4_;
+    uint64_t usableCapacityRecip_;    // 2^47 / usableCapacityQ4_, so SoC needs a multiply instead of a divide
+    int16_t capacityTemperature_dC_;
+
+    // Drift compensation
+    int32_t offsetQ12_;
+    int32_t lastCorrectedQ4_;
+
+    // OCV recalibration
+    uint16_t restSamples_;
+    bool ocvCalibrated_;
+    bool initialized_;
+
+    uint16_t socQ15_;
+};
+
+#endif // BR_COULOMB_COUNTER_HPP_
@@ -0,0 +1,18 @@
+/**
+ ******************************************************************************
+ * File Name          : OCVCurve.hpp
+ * Description        : Rested cell open circuit voltage vs state of charge curve
+ ******************************************************************************
+*/
+#ifndef BR_OCV_CURVE_HPP_
+#define BR_OCV_CURVE_HPP_
+#include <cstdint>
+#include "Units.hpp"
+
+namespace OCVCurve
+{
+    uint16_t ToStateOfChargeQ15(Millivolts cellVoltage);
+    Microvolts ToVoltage(uint16_t socQ15, int32_t* slope_uVPerSocQ15 = nullptr);
+}
+
+#endif // BR_OCV_CURVE_HPP_
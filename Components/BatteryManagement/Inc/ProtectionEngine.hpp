@@ -0,0 +1,101 @@
+/**
+ ******************************************************************************
+ * File Name          : ProtectionEngine.hpp
+ * Description        : Table-driven battery limit checker.
+ *
+ *    Every sample the engine copies the inputs into a small array of values (the
+ *    cell reduction is shared through CellStats), then walks the whole limit
+ *    table. Each limit has a threshold, a debounce count, the states it is
+ *    enabled in and the event it raises; BatterySM's transition table decides
+ *    where that event goes. All limits are evaluated in every state and the enable mask is
+ *    applied afterwards, so the cost is the same no matter which state we're in.
+ *
+ *    Charger and fuel gauge samples only refresh their inputs, the debounce clock
+ *    is the BMS sample.
+ ******************************************************************************
+*/
+#ifndef BR_PROTECTION_ENGINE_HPP_
+#define BR_PROTECTION_ENGINE_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "BatteryState.hpp"
+#include "CellStats.hpp"
+#include "Units.hpp"
+#include "Data.h"
+
+/* Macros/Enums ------------------------------------------------------------*/
+// Values a limit can be checked against
+enum ProtectionSource : uint8_t {
+    PROT_SRC_MAX_CELL_MV = 0,
+    PROT_SRC_MIN_CELL_MV,
+    PROT_SRC_CELL_SPREAD_MV,
+    PROT_SRC_CURRENT_MA,        // Positive is charging
+    PROT_SRC_TEMPERATURE_DC,    // BMS thermistor
+    PROT_SRC_GAUGE_TEMPERATURE_DC,    // Fuel gauge thermistor
+    PROT_SRC_CHARGER_INPUT_MV,
+    PROT_SRC_BMS_SYS_STAT,
+    PROT_SRC_COUNT
+};
+
+enum ProtectionCompare : uint8_t {
+    PROT_ABOVE = 0,        // Violated if value > threshold
+    PROT_BELOW,            // Violated if value < threshold
+    PROT_ANY_BITS        // Violated if value & threshold
+};
+
+// Limit IDs, also the bit position in the fault-cause mask
+enum ProtectionLimit : uint8_t {
+    PROT_CELL_OVERVOLTAGE = 0,
+    PROT_CELL_UNDERVOLTAGE,
+    PROT_CELL_IMBALANCE,
+    PROT_CHARGE_OVERCURRENT,
+    PROT_DISCHARGE_OVERCURRENT,
+    PROT_CHARGE_OVERTEMP,
+    PROT_CHARGE_UNDERTEMP,
+    PROT_PACK_OVERTEMP,
+    PROT_GAUGE_OVERTEMP,
+    PROT_CHARGER_INPUT_OVERVOLTAGE,
+    PROT_BMS_HARDWARE_FAULT,
+    PROT_LIMIT_COUNT
+};
+
+constexpr uint8_t BMS_SYS_STAT_FAULT_BITS = 0x2F;    // DEVICE_XREADY | UV | OV | SCD | OCD
+
+/* Structs ------------------------------------------------------------------*/
+struct ProtectionLimitEntry {
+    ProtectionSource source;
+    ProtectionCompare compare;
+    int32_t threshold;
+    uint8_t debounceSamples;    // Consecutive violating samples before the limit trips
+    uint8_t stateMask;            // StateBit() of every state the limit is enabled in
+    BatteryEvent action;        // Event raised when tripped
+};
+
+struct ProtectionResult {
+    BatteryEvent event;            // BE_NONE if nothing tripped
+    uint32_t faultMask;            // Bit per ProtectionLimit that tripped this sample
+};
+
+/* Class ------------------------------------------------------------------*/
+class ProtectionEngine
+{
+public:
+    ProtectionEngine();
+
+    ProtectionResult Evaluate(const BMSData& bms, const CellStats& cells, Milliamps current, BatteryState state);
+    void UpdateCharger(const ChargerData& charger);
+    void UpdateFuelGauge(const FuelGaugeData& fuelGauge);
+
+    uint32_t GetLatchedFaults() const { return latchedFaults_; }
+    void LatchFaults(uint32_t faultMask) { latchedFaults_ |= faultMask; }    // Faults found outside Evaluate()
+    void ClearLatchedFaults();
+
+    static const ProtectionLimitEntry* GetLimitTable();
+
+protected:
+    int32_t values_[PROT_SRC_COUNT];
+    uint8_t debounce_[PROT_LIMIT_COUNT];
+    uint32_t latchedFaults_;    // Every limit that tripped since the last clear
+};
+
+#endif // BR_PROTECTION_ENGINE_HPP_
@@ -0,0 +1,73 @@
+/**
+ ******************************************************************************
+ * File Name          : ResistanceEstimator.hpp
+ * Description        : Online per-cell DC internal resistance and resistance
+ *                      based state of health.
+ *
+ *    Runs at the BMS sample rate on a five sample history. A current step is
+ *    accepted when the current was steady for two samples before it and two
+ *    samples after it; the sample the step landed in is skipped because the CC
+ *    only saw part of it. The resistance is dV/dI between the last sample before
+ *    and the first sample after, so it includes ~250-500ms of polarization (the
+ *    usual DCIR definition). Only steps in a mild temperature window are used so
+ *    the estimate tracks ageing rather than temperature.
+ ******************************************************************************
+*/
+#ifndef BR_RESISTANCE_ESTIMATOR_HPP_
+#define BR_RESISTANCE_ESTIMATOR_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "Units.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr Milliamps IR_STEP_MIN(500);                // Smallest current step we measure across
+constexpr Milliamps IR_STEADY_BAND(100);            // Current change allowed within the steady samples
+constexpr int16_t IR_MIN_TEMPERATURE_DC = 150;        // Only use steps between 15C and 35C
+constexpr int16_t IR_MAX_TEMPERATURE_DC = 350;
+constexpr Microohms IR_MIN_PLAUSIBLE = Units::FromMilliohms(1);        // Anything outside 1-500mOhm is a bad measurement
+constexpr Microohms IR_MAX_PLAUSIBLE = Units::FromMilliohms(500);
+constexpr uint8_t IR_FILTER_SHIFT = 3;                // Low pass over accepted steps, 1/8 weight each
+constexpr Microohms IR_NEW_CELL = Units::FromMilliohms(25);            // Beginning of life DCIR
+constexpr Microohms IR_END_OF_LIFE = Units::FromMilliohms(50);        // Resistance at which SoH is 0 (doubled)
+constexpr uint8_t IR_HISTORY_LENGTH = 5;
+
+/* Structs ------------------------------------------------------------------*/
+/**
+ * @brief Learned resistance, saved to and restored from persistent storage
+ */
+struct ResistanceRecord {
+    uint32_t cellResistance_uOhm[BATTERY_NUM_CELLS];    // 0 if never measured
+    uint16_t stepCount;        // Accepted steps, saturating
+};
+
+/* Class ------------------------------------------------------------------*/
+class ResistanceEstimator
+{
+public:
+    ResistanceEstimator();
+
+    bool Update(Milliamps current, const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], int16_t temperature_dC);
+
+    void Restore(const ResistanceRecord& record);
+    void GetRecord(ResistanceRecord& record) const;
+
+    Microohms GetCellResistance(uint8_t cell) const { return cellResistance_[cell]; }
+    Microohms GetMaxCellResistance() const;
+    uint16_t GetStateOfHealthQ15() const { return sohQ15_; }
+    uint16_t GetStepCount() const { return stepCount_; }
+
+protected:
+    void UpdateStateOfHealth();
+
+    // Sample history, index 0 is the oldest
+    Milliamps currentHistory_[IR_HISTORY_LENGTH];
+    uint16_t voltageHistory_mV_[IR_HISTORY_LENGTH][BATTERY_NUM_CELLS];
+    bool temperatureOk_[IR_HISTORY_LENGTH];
+    uint8_t historyCount_;
+
+    Microohms cellResistance_[BATTERY_NUM_CELLS];    // 0 if never measured
+    uint16_t stepCount_;
+    uint16_t sohQ15_;
+};
+
+#endif // BR_RESISTANCE_ESTIMATOR_HPP_
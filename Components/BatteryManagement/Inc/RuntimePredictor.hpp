@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * File Name          : RuntimePredictor.hpp
+ * Description        : Runtime to cutoff under the present and peak load.
+ *
+ *    The weakest cell reaches cutoff when its OCV minus the sag under load hits
+ *    the cutoff voltage. The SoC at which that happens comes from the OCV curve,
+ *    and the runtime is the charge between there and the present SoC divided by
+ *    the load. The load filters update every sample; the two runtimes each cost
+ *    an OCV lookup and a divide, so they're recomputed alternately once a second,
+ *    or both on every sample when the caller asks (close to cutoff).
+ ******************************************************************************
+*/
+#ifndef BR_RUNTIME_PREDICTOR_HPP_
+#define BR_RUNTIME_PREDICTOR_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "Units.hpp"
+#include "CellStats.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr Millivolts RUNTIME_CUTOFF_CELL_VOLTAGE(3000);            // Weakest cell voltage under load that ends the run
+constexpr Microohms RUNTIME_DEFAULT_RESISTANCE = Units::FromMilliohms(25);    // Used until the resistance estimator has a value
+constexpr Microohms RUNTIME_POLARIZATION = Units::FromMilliohms(15);        // Steady state RC sag on top of the DC resistance
+constexpr Milliamps RUNTIME_PEAK_LOAD_FLOOR(2000);                // Expected flight peak, the peak runtime never assumes less
+constexpr Milliamps RUNTIME_MIN_LOAD(10);                        // Below this the runtime is unlimited
+constexpr uint8_t RUNTIME_LOAD_FILTER_SHIFT = 4;                // ~4s load average
+constexpr uint8_t RUNTIME_PEAK_DECAY_SHIFT = 10;                // Peak load decays with a ~4 minute time constant
+constexpr uint8_t RUNTIME_UPDATE_SAMPLES = 4;                    // Each runtime is recomputed once per this many samples
+constexpr uint32_t RUNTIME_UNLIMITED_S = UINT32_MAX;
+
+/* Class ------------------------------------------------------------------*/
+class RuntimePredictor
+{
+public:
+    RuntimePredictor();
+
+    void Update(Milliamps current, const CellStats& cells, uint16_t socQ15,
+        uint16_t capacity_mAh, Microohms cellResistance, bool everySample);
+
+    uint32_t GetRuntimeSeconds() const { return runtime_s_; }
+    uint32_t GetPeakRuntimeSeconds() const { return peakRuntime_s_; }
+    Milliamps GetLoad() const { return Milliamps(loadQ4_ >> 4); }
+    Milliamps GetPeakLoad() const { return (peakLoad_ > RUNTIME_PEAK_LOAD_FLOOR) ? peakLoad_ : RUNTIME_PEAK_LOAD_FLOOR; }
+
+    static uint32_t TimeToCutoff(Milliamps load, uint16_t socQ15, uint16_t capacity_mAh, Microohms resistance, Millivolts weakCellOffset);
+
+protected:
+    int32_t loadQ4_;            // Filtered discharge current, positive is discharging
+    Milliamps peakLoad_;        // Decaying peak of the discharge current
+    uint8_t sample_;
+    uint32_t runtime_s_;
+    uint32_t peakRuntime_s_;
+};
+
+#endif // BR_RUNTIME_PREDICTOR_HPP_
@@ -0,0 +1,83 @@
+/**
+ ******************************************************************************
+ * File Name          : SocEstimator.hpp
+ * Description        : Fixed-point extended Kalman filter state of charge
+ *                      estimator over a 1RC equivalent circuit cell model.
+ *
+ *    State is [SoC, V_rc]. The covariance is kept in Q15 SoC LSBs and 128uV
+ *    voltage units so every term fits in 32 bits and all scaling is shifts.
+ *    Each step is a fixed sequence of operations (one table walk, two 64-bit
+ *    divisions), memory is just the members below.
+ ******************************************************************************
+*/
+#ifndef BR_SOC_ESTIMATOR_HPP_
+#define BR_SOC_ESTIMATOR_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+#include "Units.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+// Cell model, all per cell
+constexpr int32_t EKF_R0_MOHM = 25;                // Ohmic resistance, uV per mA
+constexpr int32_t EKF_RC_DECAY_Q16 = 64991;        // exp(-dt / R1C1) with R1 = 15mOhm, C1 = 2000F (tau 30s), dt 250ms
+constexpr int32_t EKF_RC_GAIN_Q16 = 8159;        // R1 * (1 - decay), uV per mA in Q16
+
+// SoC change per mA per sample in Q40, dt / (capacity * 3.6e6) * 2^40
+constexpr int32_t EKF_SOC_PER_MA_Q40 = (int32_t)(((uint64_t)BMS_CC_SAMPLE_PERIOD_MS << 40) / ((uint64_t)BATTERY_NOMINAL_CAPACITY_MAH * 3600000));
+
+constexpr uint8_t EKF_VOLTAGE_UNIT_SHIFT = 7;    // Covariance voltage unit, 2^7 uV = 128uV
+constexpr int32_t EKF_SOC_Q30_ONE = (1 << 30);
+
+// Noise, SoC in Q15 LSB^2 and voltage in (128uV)^2
+constexpr int32_t EKF_PROCESS_NOISE_SOC = 1;            // Current sensor error per step
+constexpr int32_t EKF_PROCESS_NOISE_VRC = 16;        // ~0.5mV model error per step
+constexpr int32_t EKF_MEASUREMENT_NOISE = 1600;        // ~5mV cell voltage/model error
+constexpr int32_t EKF_INITIAL_VAR_SOC = 10737418;    // (10% SoC)^2
+constexpr int32_t EKF_INITIAL_VAR_VRC = 6104;        // (10mV)^2
+
+// State of health, capacity is re-estimated every time the SoC moves this much
+constexpr int32_t EKF_SOH_WINDOW_SOC_Q30 = EKF_SOC_Q30_ONE / 5;    // 20% SoC
+constexpr uint8_t EKF_SOH_FILTER_SHIFT = 2;            // Low pass over capacity estimates
+
+/* Class ------------------------------------------------------------------*/
+class SocEstimator
+{
+public:
+    SocEstimator();
+
+    void Reset(Millivolts cellVoltage);
+    void Update(Milliamps current, Millivolts cellVoltage);
+
+    uint16_t GetStateOfChargeQ15() const { return (uint16_t)(socQ30_ >> 15); }
+    uint8_t GetStateOfChargePercent() const { return (uint8_t)(((int64_t)socQ30_ * 100 + (1 << 29)) >> 30); }
+    Microvolts GetRCVoltage() const { return Microvolts(vrc_uV_); }
+    Microvolts GetLastInnovation() const { return Microvolts(lastInnovation_uV_); }
+    uint16_t GetSocStdDevQ15() const;
+    uint16_t GetStateOfHealthQ15() const { return sohQ15_; }
+    uint16_t GetCapacityEstimateMah() const { return capacityEstimate_mAh_; }
+
+protected:
+    void Predict(Milliamps current);
+    void Correct(Milliamps current, Millivolts cellVoltage);
+    void UpdateStateOfHealth(Milliamps current);
+
+    // State
+    int32_t socQ30_;
+    int32_t vrc_uV_;
+
+    // Covariance, symmetric so only three terms
+    int32_t p11_;
+    int32_t p12_;
+    int32_t p22_;
+
+    int32_t lastInnovation_uV_;
+    bool initialized_;
+
+    // State of health
+    int32_t sohAnchorSocQ30_;
+    int32_t sohCharge_mASamples_;
+    uint16_t capacityEstimate_mAh_;
+    uint16_t sohQ15_;
+};
+
+#endif // BR_SOC_ESTIMATOR_HPP_
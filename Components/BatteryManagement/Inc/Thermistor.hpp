@@ -0,0 +1,145 @@
+/**
+ ******************************************************************************
+ * File Name          : Thermistor.hpp
+ * Description        : bq769x0 TS input to temperature through a compile time
+ *                      generated lookup table.
+ *
+ *    The table is built by the compiler from the thermistor beta, R25 and the
+ *    bq769x0 divider (internal 10k pull-up, 382uV ADC LSB), with one entry every
+ *    2^SHIFT ADC codes. A reading is one shift to find the segment and one
+ *    multiply to interpolate, no logarithms and no floats at runtime.
+ *
+ *    SHIFT trades flash for accuracy: each step up halves the table and roughly
+ *    quadruples the interpolation error. The error against the exact beta
+ *    equation over the operating range is checked by a static_assert, so a
+ *    table that's too coarse doesn't build.
+ ******************************************************************************
+*/
+#ifndef BR_THERMISTOR_HPP_
+#define BR_THERMISTOR_HPP_
+#include <cstdint>
+#include "BatteryConfig.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint8_t THERMISTOR_TABLE_SHIFT = 7;                // One entry every 128 codes (~49mV), 69 entries, 0.05C worst case
+constexpr int16_t THERMISTOR_MIN_DC = -400;                    // Table is clamped to -40C to 125C
+constexpr int16_t THERMISTOR_MAX_DC = 1250;
+constexpr int16_t THERMISTOR_CHECK_MIN_DC = -200;            // Accuracy is guaranteed over -20C to 80C
+constexpr int16_t THERMISTOR_CHECK_MAX_DC = 800;
+constexpr int32_t THERMISTOR_MAX_ERROR_CENTI_C = 10;        // 0.1C
+
+// Codes at or above the pull-up voltage mean the thermistor is open
+constexpr uint16_t THERMISTOR_OPEN_CODE = (uint16_t)((uint64_t)BMS_TS_PULLUP_UV / BMS_TS_ADC_LSB_UV);
+
+/* Compile Time Math ---------------------------------------------------------*/
+namespace ThermistorMath
+{
+    /**
+     * @brief Natural log, only ever evaluated by the compiler
+     */
+    constexpr double Log(double x)
+    {
+        constexpr double LN2 = 0.69314718055994530942;
+
+        // x = m * 2^e with m in [1, 2)
+        int32_t e = 0;
+        while (x >= 2.0) { x /= 2.0; e++; }
+        while (x < 1.0) { x *= 2.0; e--; }
+
+        // ln(m) = 2 * atanh((m - 1) / (m + 1)), |y| <= 1/3 so the series converges quickly
+        const double y = (x - 1.0) / (x + 1.0);
+        const double y2 = y * y;
+        double term = y;
+        double sum = 0.0;
+        for (int32_t n = 1; n < 40; n += 2) {
+            sum += term / n;
+            term *= y2;
+        }
+        return 2.0 * sum + e * LN2;
+    }
+
+    /**
+     * @brief Exact beta equation temperature for a TS ADC code
+     * @return Temperature in 0.01C, clamped to the table range
+     */
+    constexpr int32_t ExactCentiCelsius(uint16_t code)
+    {
+        constexpr double KELVIN_25C = 298.15;
+        if (code == 0)
+            return THERMISTOR_MAX_DC * 10;
+        if (code >= THERMISTOR_OPEN_CODE)
+            return THERMISTOR_MIN_DC * 10;
+
+        const double v_uV = (double)code * BMS_TS_ADC_LSB_UV;
+        const double r_ohm = (double)BMS_TS_PULLUP_OHM * v_uV / ((double)BMS_TS_PULLUP_UV - v_uV);
+        const double kelvin = 1.0 / (1.0 / KELVIN_25C + Log(r_ohm / BMS_THERMISTOR_R25_OHM) / BMS_THERMISTOR_BETA);
+        const double centi = (kelvin - 273.15) * 100.0;
+
+        if (centi > THERMISTOR_MAX_DC * 10)
+            return THERMISTOR_MAX_DC * 10;
+        if (centi < THERMISTOR_MIN_DC * 10)
+            return THERMISTOR_MIN_DC * 10;
+        return (int32_t)(centi + ((centi < 0) ? -0.5 : 0.5));
+    }
+}
+
+/* Table ------------------------------------------------------------------*/
+/**
+ * @brief Temperature at every 2^SHIFT codes from 0 up to and past the open code
+ */
+template<uint8_t SHIFT>
+struct ThermistorTable
+{
+    static constexpr uint16_t COUNT = (THERMISTOR_OPEN_CODE >> SHIFT) + 2;
+
+    int16_t centiCelsius[COUNT];    // 0.01C so the interpolation keeps a digit below the output
+
+    constexpr ThermistorTable() : centiCelsius()
+    {
+        for (uint16_t i = 0; i < COUNT; i++) {
+            const uint32_t code = (uint32_t)i << SHIFT;
+            centiCelsius[i] = (int16_t)ThermistorMath::ExactCentiCelsius((code > UINT16_MAX) ? UINT16_MAX : (uint16_t)code);
+        }
+    }
+
+    /**
+     * @brief Interpolated temperature for a TS ADC code
+     * @return Temperature in 0.01C
+     */
+    constexpr int32_t ToCentiCelsius(uint16_t code) const
+    {
+        if (code >= THERMISTOR_OPEN_CODE)
+            return THERMISTOR_MIN_DC * 10;
+
+        const uint16_t i = code >> SHIFT;
+        const int32_t frac = code & ((1 << SHIFT) - 1);
+        const int32_t lo = centiCelsius[i];
+        const int32_t hi = centiCelsius[i + 1];
+        return lo + (((hi - lo) * frac) >> SHIFT);
+    }
+
+    /**
+     * @brief Largest interpolation error against the exact equation over the checked range
+     * @return Error in 0.01C
+     */
+    constexpr int32_t MaxErrorCentiCelsius() const
+    {
+        int32_t worst = 0;
+        for (uint16_t code = 1; code < THERMISTOR_OPEN_CODE; code++) {
+            const int32_t exact = ThermistorMath::ExactCentiCelsius(code);
+            if (exact < THERMISTOR_CHECK_MIN_DC * 10 || exact > THERMISTOR_CHECK_MAX_DC * 10)
+                continue;
+            const int32_t error = ToCentiCelsius(code) - exact;
+            worst = (error > worst) ? error : ((-error > worst) ? -error : worst);
+        }
+        return worst;
+    }
+};
+
+/* Functions ------------------------------------------------------------------*/
+namespace Thermistor
+{
+    int16_t ToDeciCelsius(uint16_t tsAdcCode);
+}
+
+#endif // BR_THERMISTOR_HPP_
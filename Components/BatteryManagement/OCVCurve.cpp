@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * File Name          : OCVCurve.cpp
+ * Description        : Rested cell open circuit voltage vs state of charge curve
+ ******************************************************************************
+*/
+#include "OCVCurve.hpp"
+#include "FixedPoint.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+// Rested cell OCV (mV) to state of charge (Q15), typical NMC 18650 at 25C
+static constexpr uint8_t OCV_TABLE_SIZE = 11;
+static constexpr int32_t OCV_TABLE_MV[OCV_TABLE_SIZE] = {
+    3000, 3450, 3600, 3680, 3740, 3800, 3870, 3950, 4030, 4100, 4200
+};
+static constexpr int32_t OCV_TABLE_SOC_Q15[OCV_TABLE_SIZE] = {
+    0, 1638, 4915, 8192, 13107, 16384, 19661, 22938, 26214, 29491, 32768
+};
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Looks up the state of charge for a rested cell voltage
+ * @param cellVoltage Open circuit cell voltage
+ * @return State of charge in Q15
+ */
+uint16_t OCVCurve::ToStateOfChargeQ15(Millivolts cellVoltage)
+{
+    return (uint16_t)FixedPoint::Interpolate(OCV_TABLE_MV, OCV_TABLE_SOC_Q15, OCV_TABLE_SIZE, cellVoltage.Value());
+}
+
+/**
+ * @brief Looks up the open circuit voltage for a state of charge, with the local slope
+ * @param socQ15 State of charge in Q15, clamped to [0, 1]
+ * @param slope_uVPerSocQ15 Optional output, dOCV/dSoC of the segment in uV per Q15 LSB, in Q15
+ * @return Open circuit cell voltage
+ */
+Microvolts OCVCurve::ToVoltage(uint16_t socQ15, int32_t* slope_uVPerSocQ15)
+{
+    const int32_t soc = (socQ15 > Q15_ONE) ? Q15_ONE : socQ15;
+
+    uint8_t i = 1;
+    while (i < OCV_TABLE_SIZE - 1 && soc > OCV_TABLE_SOC_Q15[i])
+        i++;
+
+    // Slope of the segment in uV per Q15 LSB, itself kept in Q15 so the flat middle of the curve isn't truncated away
+    const int32_t slope = (int32_t)((((int64_t)(OCV_TABLE_MV[i] - OCV_TABLE_MV[i - 1]) * 1000) << 15) / (OCV_TABLE_SOC_Q15[i] - OCV_TABLE_SOC_Q15[i - 1]));
+    if (slope_uVPerSocQ15 != nullptr)
+        *slope_uVPerSocQ15 = slope;
+
+    return Microvolts(OCV_TABLE_MV[i - 1] * 1000 + (int32_t)(((int64_t)slope * (soc - OCV_TABLE_SOC_Q15[i - 1])) >> 15));
+}
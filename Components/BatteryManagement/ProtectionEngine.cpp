@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * File Name          : ProtectionEngine.cpp
+ * Description        : Table-driven battery limit checker
+ ******************************************************************************
+*/
+#include "ProtectionEngine.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+static constexpr uint8_t ALL_ACTIVE_STATES = StateBit(BS_IDLE) | StateBit(BS_CHARGING) | StateBit(BS_DISCHARGING);
+
+// Indexed by ProtectionLimit, debounce counts are in 250ms BMS samples
+static constexpr ProtectionLimitEntry LIMIT_TABLE[PROT_LIMIT_COUNT] = {
+    // Source                           Compare         Threshold   Debounce    States                                          Action
+    { PROT_SRC_MAX_CELL_MV,             PROT_ABOVE,     4250,       2,          ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_CELL_OVERVOLTAGE
+    { PROT_SRC_MIN_CELL_MV,             PROT_BELOW,     2800,       4,          StateBit(BS_IDLE) | StateBit(BS_DISCHARGING),   BE_PROTECTION_FAULT },    // PROT_CELL_UNDERVOLTAGE
+    { PROT_SRC_CELL_SPREAD_MV,          PROT_ABOVE,     300,        40,         ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_CELL_IMBALANCE
+    { PROT_SRC_CURRENT_MA,              PROT_ABOVE,     3000,       4,          ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_CHARGE_OVERCURRENT
+    { PROT_SRC_CURRENT_MA,              PROT_BELOW,     -10000,     2,          ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_DISCHARGE_OVERCURRENT
+    { PROT_SRC_TEMPERATURE_DC,          PROT_ABOVE,     450,        8,          StateBit(BS_CHARGING),                          BE_CHARGE_INHIBIT },      // PROT_CHARGE_OVERTEMP
+    { PROT_SRC_TEMPERATURE_DC,          PROT_BELOW,     0,          8,          StateBit(BS_CHARGING),                          BE_CHARGE_INHIBIT },      // PROT_CHARGE_UNDERTEMP
+    { PROT_SRC_TEMPERATURE_DC,          PROT_ABOVE,     600,        8,          ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_PACK_OVERTEMP
+    { PROT_SRC_GAUGE_TEMPERATURE_DC,    PROT_ABOVE,     600,        8,          ALL_ACTIVE_STATES,                              BE_PROTECTION_FAULT },    // PROT_GAUGE_OVERTEMP
+    { PROT_SRC_CHARGER_INPUT_MV,        PROT_ABOVE,     30000,      2,          StateBit(BS_CHARGING),                          BE_CHARGE_INHIBIT },      // PROT_CHARGER_INPUT_OVERVOLTAGE
+    { PROT_SRC_BMS_SYS_STAT,            PROT_ANY_BITS,  BMS_SYS_STAT_FAULT_BITS, 1, ALL_ACTIVE_STATES,                          BE_PROTECTION_FAULT },    // PROT_BMS_HARDWARE_FAULT
+};
+
+// How strongly a tripped limit's action wins over others, indexed by BatteryEvent
+static constexpr uint8_t ACTION_SEVERITY[BE_COUNT] = { 2, 1 };    // Only the protection events are raised here
+
+/* Protection Engine ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, inputs that haven't been sampled yet sit at values that trip nothing
+ */
+ProtectionEngine::ProtectionEngine()
+{
+    for (uint8_t i = 0; i < PROT_SRC_COUNT; i++)
+        values_[i] = 0;
+    values_[PROT_SRC_GAUGE_TEMPERATURE_DC] = 250;
+
+    for (uint8_t i = 0; i < PROT_LIMIT_COUNT; i++)
+        debounce_[i] = 0;
+
+    latchedFaults_ = 0;
+}
+
+/**
+ * @brief Checks every limit against a new BMS sample
+ * @param bms The BMS sample
+ * @param cells Cell statistics for the same sample
+ * @param current Offset corrected pack current, positive is charging
+ * @param state The state we're in
+ * @return The event to raise and the limits that tripped
+ */
+ProtectionResult ProtectionEngine::Evaluate(const BMSData& bms, const CellStats& cells, Milliamps current, BatteryState state)
+{
+    values_[PROT_SRC_MAX_CELL_MV] = cells.max_mV;
+    values_[PROT_SRC_MIN_CELL_MV] = cells.min_mV;
+    values_[PROT_SRC_CELL_SPREAD_MV] = cells.spread_mV;
+    values_[PROT_SRC_CURRENT_MA] = current.Value();
+    values_[PROT_SRC_TEMPERATURE_DC] = bms.temperature_dC;
+    values_[PROT_SRC_BMS_SYS_STAT] = bms.sysStat;
+
+    // Walk the whole table, the state only gates the result
+    const uint8_t stateBit = (uint8_t)StateBit(state);
+    ProtectionResult result = { BE_NONE, 0 };
+    uint8_t severity = 0;
+
+    for (uint8_t i = 0; i < PROT_LIMIT_COUNT; i++) {
+        const ProtectionLimitEntry& limit = LIMIT_TABLE[i];
+        const int32_t value = values_[limit.source];
+
+        bool violated;
+        switch (limit.compare) {
+        case PROT_ABOVE:
+            violated = value > limit.threshold;
+            break;
+        case PROT_BELOW:
+            violated = value < limit.threshold;
+            break;
+        default:
+            violated = (value & limit.threshold) != 0;
+            break;
+        }
+
+        debounce_[i] = violated ? ((debounce_[i] < UINT8_MAX) ? debounce_[i] + 1 : UINT8_MAX) : 0;
+
+        if ((limit.stateMask & stateBit) && debounce_[i] >= limit.debounceSamples) {
+            result.faultMask |= (1UL << i);
+            if (ACTION_SEVERITY[limit.action] > severity) {
+                severity = ACTION_SEVERITY[limit.action];
+                result.event = limit.action;
+            }
+        }
+    }
+
+    latchedFaults_ |= result.faultMask;
+    return result;
+}
+
+/**
+ * @brief Refreshes the charger inputs, checked on the next BMS sample
+ * @param charger The charger sample
+ */
+void ProtectionEngine::UpdateCharger(const ChargerData& charger)
+{
+    values_[PROT_SRC_CHARGER_INPUT_MV] = charger.inputVoltage_mV;
+}
+
+/**
+ * @brief Refreshes the fuel gauge inputs, checked on the next BMS sample
+ * @param fuelGauge The fuel gauge sample
+ */
+void ProtectionEngine::UpdateFuelGauge(const FuelGaugeData& fuelGauge)
+{
+    values_[PROT_SRC_GAUGE_TEMPERATURE_DC] = fuelGauge.temperature_dC;
+}
+
+/**
+ * @brief Clears the latched fault mask and all debounce counters
+ */
+void ProtectionEngine::ClearLatchedFaults()
+{
+    latchedFaults_ = 0;
+    for (uint8_t i = 0; i < PROT_LIMIT_COUNT; i++)
+        debounce_[i] = 0;
+}
+
+/**
+ * @brief Access to the limit table, for printing and tuning tools
+ * @return The table, PROT_LIMIT_COUNT entries indexed by ProtectionLimit
+ */
+const ProtectionLimitEntry* ProtectionEngine::GetLimitTable()
+{
+    return LIMIT_TABLE;
+}
@@ -0,0 +1,140 @@
+/**
+ ******************************************************************************
+ * File Name          : ResistanceEstimator.cpp
+ * Description        : Online per-cell DC internal resistance and resistance
+ *                      based state of health.
+ ******************************************************************************
+*/
+#include "ResistanceEstimator.hpp"
+#include "FixedPoint.hpp"
+
+/* Resistance Estimator ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, starts with no measurements and full health
+ */
+ResistanceEstimator::ResistanceEstimator()
+{
+    historyCount_ = 0;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        cellResistance_[i] = Microohms(0);
+    stepCount_ = 0;
+    sohQ15_ = Q15_ONE;
+}
+
+/**
+ * @brief Adds one BMS sample and measures across a current step if one just completed
+ * @param current Offset corrected pack current, positive is charging
+ * @param cellVoltage_mV Cell voltages from the same sample
+ * @param temperature_dC Pack temperature
+ * @return True if a step was measured on this sample
+ */
+bool ResistanceEstimator::Update(Milliamps current, const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS], int16_t temperature_dC)
+{
+    for (uint8_t h = 0; h < IR_HISTORY_LENGTH - 1; h++) {
+        currentHistory_[h] = currentHistory_[h + 1];
+        temperatureOk_[h] = temperatureOk_[h + 1];
+        for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+            voltageHistory_mV_[h][i] = voltageHistory_mV_[h + 1][i];
+    }
+
+    currentHistory_[IR_HISTORY_LENGTH - 1] = current;
+    temperatureOk_[IR_HISTORY_LENGTH - 1] = (temperature_dC >= IR_MIN_TEMPERATURE_DC) && (temperature_dC <= IR_MAX_TEMPERATURE_DC);
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        voltageHistory_mV_[IR_HISTORY_LENGTH - 1][i] = cellVoltage_mV[i];
+
+    if (historyCount_ < IR_HISTORY_LENGTH) {
+        historyCount_++;
+        return false;
+    }
+
+    // [0] [1] steady before, [2] the step, [3] [4] steady after
+    const Milliamps* I = currentHistory_;
+    const Milliamps step = I[3] - I[1];
+
+    if ((I[1] - I[0]).Abs() > IR_STEADY_BAND || (I[4] - I[3]).Abs() > IR_STEADY_BAND)
+        return false;
+    if (step.Abs() < IR_STEP_MIN)
+        return false;
+    if (!temperatureOk_[1] || !temperatureOk_[3])
+        return false;
+
+    // The divide only runs on an accepted step, a handful of times per flight
+    Microohms resistance[BATTERY_NUM_CELLS];
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        const Millivolts delta((int32_t)voltageHistory_mV_[3][i] - voltageHistory_mV_[1][i]);
+        resistance[i] = Units::Resistance(delta, step);
+
+        // A cell that moved the wrong way or too far means the step wasn't clean, drop the whole step
+        if (resistance[i] < IR_MIN_PLAUSIBLE || resistance[i] > IR_MAX_PLAUSIBLE)
+            return false;
+    }
+
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        if (cellResistance_[i] == Microohms(0))
+            cellResistance_[i] = resistance[i];
+        else
+            cellResistance_[i] += Microohms((resistance[i] - cellResistance_[i]).Value() >> IR_FILTER_SHIFT);
+    }
+
+    if (stepCount_ < UINT16_MAX)
+        stepCount_++;
+
+    // Don't measure the same step twice
+    historyCount_ = 0;
+
+    UpdateStateOfHealth();
+    return true;
+}
+
+/**
+ * @brief Restores learned resistance from persistent storage
+ * @param record The saved record
+ */
+void ResistanceEstimator::Restore(const ResistanceRecord& record)
+{
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        const Microohms r((int32_t)FixedPoint::Clamp<uint32_t>(record.cellResistance_uOhm[i], 0, INT32_MAX));
+        cellResistance_[i] = (r >= IR_MIN_PLAUSIBLE && r <= IR_MAX_PLAUSIBLE) ? r : Microohms(0);
+    }
+    stepCount_ = record.stepCount;
+    UpdateStateOfHealth();
+}
+
+/**
+ * @brief Fills a record for persistent storage
+ * @param record The record to fill
+ */
+void ResistanceEstimator::GetRecord(ResistanceRecord& record) const
+{
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        record.cellResistance_uOhm[i] = (uint32_t)cellResistance_[i].Value();
+    record.stepCount = stepCount_;
+}
+
+/**
+ * @brief The worst cell, which is what limits the pack
+ * @return Highest cell resistance, 0 if nothing has been measured
+ */
+Microohms ResistanceEstimator::GetMaxCellResistance() const
+{
+    Microohms maxResistance(0);
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        maxResistance = (cellResistance_[i] > maxResistance) ? cellResistance_[i] : maxResistance;
+    return maxResistance;
+}
+
+/**
+ * @brief SoH falls linearly from 100% at the new cell resistance to 0% at end of life
+ */
+void ResistanceEstimator::UpdateStateOfHealth()
+{
+    const Microohms resistance = GetMaxCellResistance();
+    if (resistance == Microohms(0)) {
+        sohQ15_ = Q15_ONE;
+        return;
+    }
+
+    const int32_t span = (IR_END_OF_LIFE - IR_NEW_CELL).Value();
+    const int32_t remaining = FixedPoint::Clamp<int32_t>((IR_END_OF_LIFE - resistance).Value(), 0, span);
+    sohQ15_ = (uint16_t)(((int64_t)remaining << 15) / span);
+}
@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * File Name          : RuntimePredictor.cpp
+ * Description        : Runtime to cutoff under the present and peak load
+ ******************************************************************************
+*/
+#include "RuntimePredictor.hpp"
+#include "OCVCurve.hpp"
+#include "FixedPoint.hpp"
+
+/* Runtime Predictor ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, no load seen yet
+ */
+RuntimePredictor::RuntimePredictor()
+{
+    loadQ4_ = 0;
+    peakLoad_ = Milliamps(0);
+    sample_ = 0;
+    runtime_s_ = RUNTIME_UNLIMITED_S;
+    peakRuntime_s_ = RUNTIME_UNLIMITED_S;
+}
+
+/**
+ * @brief Adds one BMS sample
+ * @param current Offset corrected pack current, positive is charging
+ * @param cells Cell statistics under the present load
+ * @param socQ15 State of charge
+ * @param capacity_mAh Present usable capacity
+ * @param cellResistance Highest cell DC resistance, 0 if not measured yet
+ * @param everySample True recomputes both runtimes on this sample instead of alternating
+ */
+void RuntimePredictor::Update(Milliamps current, const CellStats& cells, uint16_t socQ15,
+    uint16_t capacity_mAh, Microohms cellResistance, bool everySample)
+{
+    // Track discharge only, charging counts as no load
+    const Milliamps load = (current < Milliamps(0)) ? -current : Milliamps(0);
+    FixedPoint::LowPass(loadQ4_, load.Value() << 4, RUNTIME_LOAD_FILTER_SHIFT);
+    peakLoad_ -= Milliamps(peakLoad_.Value() >> RUNTIME_PEAK_DECAY_SHIFT);
+    peakLoad_ = (load > peakLoad_) ? load : peakLoad_;
+
+    // Spread the two lookups over the update period
+    sample_ = (sample_ + 1 < RUNTIME_UPDATE_SAMPLES) ? sample_ + 1 : 0;
+    if (!everySample && sample_ != 0 && sample_ != RUNTIME_UPDATE_SAMPLES / 2)
+        return;
+
+    // The weakest cell hits cutoff first, it sits (average - min) below the average
+    const Millivolts weakCellOffset((int32_t)cells.mean_mV - cells.min_mV);
+
+    const Microohms resistance = ((cellResistance != Microohms(0)) ? cellResistance : RUNTIME_DEFAULT_RESISTANCE) + RUNTIME_POLARIZATION;
+
+    if (everySample || sample_ == 0)
+        runtime_s_ = TimeToCutoff(GetLoad(), socQ15, capacity_mAh, resistance, weakCellOffset);
+    if (everySample || sample_ != 0)
+        peakRuntime_s_ = TimeToCutoff(GetPeakLoad(), socQ15, capacity_mAh, resistance, weakCellOffset);
+}
+
+/**
+ * @brief Time until the weakest cell reaches cutoff at a constant load
+ * @param load Discharge current, positive
+ * @param socQ15 Present state of charge
+ * @param capacity_mAh Usable capacity
+ * @param resistance Cell resistance seen by a sustained load
+ * @param weakCellOffset How far the weakest cell sits below the average
+ * @return Seconds to cutoff, 0 if already there, RUNTIME_UNLIMITED_S with no load
+ */
+uint32_t RuntimePredictor::TimeToCutoff(Milliamps load, uint16_t socQ15, uint16_t capacity_mAh, Microohms resistance, Millivolts weakCellOffset)
+{
+    if (load < RUNTIME_MIN_LOAD)
+        return RUNTIME_UNLIMITED_S;
+
+    // Average cell OCV at which the weakest cell, sagging under the load, reaches cutoff
+    const Millivolts cutoffOcv = RUNTIME_CUTOFF_CELL_VOLTAGE + Units::VoltageDrop(load, resistance) + weakCellOffset;
+    const uint16_t cutoffSocQ15 = OCVCurve::ToStateOfChargeQ15(cutoffOcv);
+
+    if (socQ15 <= cutoffSocQ15)
+        return 0;
+
+    // (dSoC * capacity) is mAh in Q15, 3600s per hour
+    const uint64_t usable_mAhQ15 = (uint64_t)(socQ15 - cutoffSocQ15) * capacity_mAh;
+    return (uint32_t)((usable_mAhQ15 * 3600 / (uint32_t)load.Value()) >> 15);
+}
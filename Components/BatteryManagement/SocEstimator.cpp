@@ -0,0 +1,149 @@
+/**
+ ******************************************************************************
+ * File Name          : SocEstimator.cpp
+ * Description        : Fixed-point extended Kalman filter state of charge estimator
+ ******************************************************************************
+*/
+#include "SocEstimator.hpp"
+#include "FixedPoint.hpp"
+#include "OCVCurve.hpp"
+
+/* SoC Estimator ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, the filter is seeded from the cell voltage on the first Update()
+ */
+SocEstimator::SocEstimator()
+{
+    socQ30_ = 0;
+    vrc_uV_ = 0;
+    p11_ = EKF_INITIAL_VAR_SOC;
+    p12_ = 0;
+    p22_ = EKF_INITIAL_VAR_VRC;
+    lastInnovation_uV_ = 0;
+    initialized_ = false;
+
+    sohAnchorSocQ30_ = 0;
+    sohCharge_mASamples_ = 0;
+    capacityEstimate_mAh_ = BATTERY_NOMINAL_CAPACITY_MAH;
+    sohQ15_ = Q15_ONE;
+}
+
+/**
+ * @brief Re-seeds the filter from a cell voltage assumed to be near rest
+ * @param cellVoltage Average cell voltage
+ */
+void SocEstimator::Reset(Millivolts cellVoltage)
+{
+    socQ30_ = (int32_t)OCVCurve::ToStateOfChargeQ15(cellVoltage) << 15;
+    vrc_uV_ = 0;
+    p11_ = EKF_INITIAL_VAR_SOC;
+    p12_ = 0;
+    p22_ = EKF_INITIAL_VAR_VRC;
+
+    sohAnchorSocQ30_ = socQ30_;
+    sohCharge_mASamples_ = 0;
+    initialized_ = true;
+}
+
+/**
+ * @brief Runs one predict/correct step, call once per BMS sample
+ * @param current Offset corrected pack current, positive is charging
+ * @param cellVoltage Average cell voltage
+ */
+void SocEstimator::Update(Milliamps current, Millivolts cellVoltage)
+{
+    if (!initialized_)
+        Reset(cellVoltage);
+
+    Predict(current);
+    Correct(current, cellVoltage);
+    UpdateStateOfHealth(current);
+}
+
+/**
+ * @brief Time update, x = F x + B u and P = F P F' + Q with F = diag(1, decay)
+ * @param current Pack current, positive is charging
+ */
+void SocEstimator::Predict(Milliamps current)
+{
+    const int32_t current_mA = current.Value();
+    socQ30_ = FixedPoint::Clamp<int32_t>(socQ30_ + (int32_t)(((int64_t)current_mA * EKF_SOC_PER_MA_Q40) >> 10), 0, EKF_SOC_Q30_ONE);
+    vrc_uV_ = (int32_t)(((int64_t)vrc_uV_ * EKF_RC_DECAY_Q16 + (int64_t)current_mA * EKF_RC_GAIN_Q16) >> 16);
+
+    p11_ += EKF_PROCESS_NOISE_SOC;
+    p12_ = (int32_t)(((int64_t)p12_ * EKF_RC_DECAY_Q16) >> 16);
+    p22_ = (int32_t)(((int64_t)p22_ * EKF_RC_DECAY_Q16 * EKF_RC_DECAY_Q16) >> 32) + EKF_PROCESS_NOISE_VRC;
+}
+
+/**
+ * @brief Measurement update against the terminal voltage V = OCV(SoC) + V_rc + R0 * I
+ * @param current Pack current, positive is charging
+ * @param cellVoltage Measured average cell voltage
+ */
+void SocEstimator::Correct(Milliamps current, Millivolts cellVoltage)
+{
+    // Linearize the OCV curve around the current SoC, H = [dOCV/dSoC, 1]
+    int32_t slope;
+    const Microvolts ocv = OCVCurve::ToVoltage(GetStateOfChargeQ15(), &slope);
+    const int32_t h1Q16 = slope >> (EKF_VOLTAGE_UNIT_SHIFT + 15 - 16);    // 128uV units per Q15 LSB, in Q16
+
+    const int32_t predicted_uV = ocv.Value() + vrc_uV_ + EKF_R0_MOHM * current.Value();
+    lastInnovation_uV_ = Units::ToMicrovolts(cellVoltage).Value() - predicted_uV;
+    const int32_t innovation = lastInnovation_uV_ >> EKF_VOLTAGE_UNIT_SHIFT;
+
+    // N = P H', S = H P H' + R, K = N / S
+    const int32_t n1 = (int32_t)(((int64_t)p11_ * h1Q16) >> 16) + p12_;
+    const int32_t n2 = (int32_t)(((int64_t)p12_ * h1Q16) >> 16) + p22_;
+    const int64_t s = (((int64_t)n1 * h1Q16) >> 16) + n2 + EKF_MEASUREMENT_NOISE;
+    const int32_t k1Q16 = (int32_t)(((int64_t)n1 << 16) / s);
+    const int32_t k2Q16 = (int32_t)(((int64_t)n2 << 16) / s);
+
+    // x += K * innovation, SoC gain is in Q15 LSBs per 128uV
+    socQ30_ = FixedPoint::Clamp<int32_t>(socQ30_ + (int32_t)(((int64_t)k1Q16 * innovation) >> 1), 0, EKF_SOC_Q30_ONE);
+    vrc_uV_ += (int32_t)(((int64_t)k2Q16 * innovation) >> (16 - EKF_VOLTAGE_UNIT_SHIFT));
+
+    // P -= K H P, written as K * N so the diagonal can only shrink by what the gain explains
+    p11_ -= (int32_t)(((int64_t)k1Q16 * n1) >> 16);
+    p12_ -= (int32_t)(((int64_t)k1Q16 * n2) >> 16);
+    p22_ -= (int32_t)(((int64_t)k2Q16 * n2) >> 16);
+    p11_ = (p11_ < 1) ? 1 : p11_;
+    p22_ = (p22_ < 1) ? 1 : p22_;
+}
+
+/**
+ * @brief Compares charge moved against estimated SoC moved to track usable capacity
+ * @param current Pack current, positive is charging
+ */
+void SocEstimator::UpdateStateOfHealth(Milliamps current)
+{
+    sohCharge_mASamples_ += current.Value();
+
+    const int32_t socDelta = socQ30_ - sohAnchorSocQ30_;
+    if (socDelta < EKF_SOH_WINDOW_SOC_Q30 && socDelta > -EKF_SOH_WINDOW_SOC_Q30)
+        return;
+
+    // capacity = charge / dSoC, runs once per 20% of SoC so the division is fine here
+    const int64_t capacity_mAh = (((int64_t)sohCharge_mASamples_ * BMS_CC_SAMPLE_PERIOD_MS) << 30) / ((int64_t)3600000 * socDelta);
+
+    // Reject windows that were dominated by filter convergence rather than real charge
+    if (capacity_mAh > BATTERY_NOMINAL_CAPACITY_MAH / 2 && capacity_mAh < BATTERY_NOMINAL_CAPACITY_MAH * 3 / 2) {
+        int32_t filtered = capacityEstimate_mAh_;
+        FixedPoint::LowPass(filtered, (int32_t)capacity_mAh, EKF_SOH_FILTER_SHIFT);
+        capacityEstimate_mAh_ = (uint16_t)filtered;
+
+        const uint32_t soh = ((uint32_t)capacityEstimate_mAh_ << 15) / BATTERY_NOMINAL_CAPACITY_MAH;
+        sohQ15_ = (soh > Q15_ONE) ? Q15_ONE : (uint16_t)soh;
+    }
+
+    sohAnchorSocQ30_ = socQ30_;
+    sohCharge_mASamples_ = 0;
+}
+
+/**
+ * @brief Standard deviation of the SoC estimate
+ * @return 1 sigma in Q15
+ */
+uint16_t SocEstimator::GetSocStdDevQ15() const
+{
+    return (uint16_t)FixedPoint::Sqrt((uint32_t)p11_);
+}
@@ -0,0 +1,25 @@
+/**
+ ******************************************************************************
+ * File Name          : Thermistor.cpp
+ * Description        : bq769x0 TS input to temperature
+ ******************************************************************************
+*/
+#include "Thermistor.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+static constexpr ThermistorTable<THERMISTOR_TABLE_SHIFT> TABLE;
+
+static_assert(TABLE.MaxErrorCentiCelsius() <= THERMISTOR_MAX_ERROR_CENTI_C,
+    "Thermistor table too coarse for the required accuracy, lower THERMISTOR_TABLE_SHIFT");
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Converts a TS ADC reading to temperature
+ * @param tsAdcCode 14-bit TS register value
+ * @return Temperature in 0.1C, THERMISTOR_MIN_DC if the thermistor is open
+ */
+int16_t Thermistor::ToDeciCelsius(uint16_t tsAdcCode)
+{
+    const int32_t centi = TABLE.ToCentiCelsius(tsAdcCode);
+    return (int16_t)((centi + ((centi < 0) ? -5 : 5)) / 10);
+}
@@ -63,7 +63,23 @@ void PMBProtocolTask::HandleProtobufCommandMessage(EmbeddedProto::ReadBufferFixe
     switch (msg.get_pmb_command().get_command_enum())
     {
     case Proto::DmbCommand::Command::RSC_ANY_TO_ABORT:
-        FlightTask::Inst().SendCommand(Command(CONTROL_ACTION, (uint16_t)RSC_ANY_TO_ABORT));
+        // CONTROL_ACTION carries a BatteryRemoteCommand, the raw RSC value would be read as one
+        FlightTask::Inst().SendBatteryRemoteCommand(BATTERY_ABORT_COMMAND);
+        break;
+    case Proto::DmbCommand::Command::PMB_BATTERY_FORCE_SAFE:
+        FlightTask::Inst().SendBatteryRemoteCommand(BRC_FORCE_SAFE);
+        break;
+    case Proto::DmbCommand::Command::PMB_BATTERY_CHARGE:
+        FlightTask::Inst().SendBatteryRemoteCommand(BRC_CHARGE);
+        break;
+    case Proto::DmbCommand::Command::PMB_BATTERY_DISCHARGE:
+        FlightTask::Inst().SendBatteryRemoteCommand(BRC_DISCHARGE);
+        break;
+    case Proto::DmbCommand::Command::PMB_BATTERY_IDLE:
+        FlightTask::Inst().SendBatteryRemoteCommand(BRC_IDLE);
+        break;
+    case Proto::DmbCommand::Command::PMB_BATTERY_CLEAR_FAULT:
+        FlightTask::Inst().SendBatteryRemoteCommand(BRC_CLEAR_FAULT);
         break;
     default:
         break;
@@ -126,6 +142,22 @@ void PMBProtocolTask::HandleProtobufControlMesssage(EmbeddedProto::ReadBufferFix
             paramMs = (paramMs > 0xFFFF) ? 0xFFFE : paramMs;
             TelemetryTask::Inst().SendCommand(Command(TELEMETRY_CHANGE_PERIOD, paramMs));
         }
+        else if(msg.get_sys_ctrl().get_sys_cmd() == Proto::SystemControl::Command::SYS_BATTERY_JOURNAL_DUMP)
+        {
+            FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_TRANSMIT_BATTERY_JOURNAL));
+        }
+        else if(msg.get_sys_ctrl().get_sys_cmd() == Proto::SystemControl::Command::SYS_POWER_SELECT_INTERNAL)
+        {
+            FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_POWER_INTERNAL));
+        }
+        else if(msg.get_sys_ctrl().get_sys_cmd() == Proto::SystemControl::Command::SYS_POWER_SELECT_UMBILICAL)
+        {
+            FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_POWER_UMBILICAL));
+        }
+        else if(msg.get_sys_ctrl().get_sys_cmd() == Proto::SystemControl::Command::SYS_POWER_PATH_STATUS)
+        {
+            FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_TRANSMIT_POWER_PATH));
+        }
     }
 }
 
@@ -7,7 +7,7 @@
 #ifndef SOAR_COMMS_UARTTASK_HPP_
 #define SOAR_COMMS_UARTTASK_HPP_
 /* Includes ------------------------------------------------------------------*/
-#include "Task.hpp"
+#include "StaticTask.hpp"
 #include "SystemDefines.hpp"
 #include "UARTDriver.hpp"
 
@@ -23,28 +23,21 @@ enum UART_TASK_COMMANDS {
 
 
 /* Class ------------------------------------------------------------------*/
-class UARTTask : public Task
+class UARTTask : public StaticTask<UARTTask, UART_TASK_RTOS_PRIORITY, UART_TASK_STACK_DEPTH_WORDS, UART_TASK_QUEUE_DEPTH_OBJS>
 {
-public:
-    static UARTTask& Inst() {
-        static UARTTask inst;
-        return inst;
-    }
+    friend StaticTask;
 
+public:
     void InitTask();
 
 protected:
-    static void RunTask(void* pvParams) { UARTTask::Inst().Run(pvParams); } // Static Task Interface, passes control to the instance Run();
-
     void Run(void* pvParams);    // Main run code
 
     void ConfigureUART();
     void HandleCommand(Command& cm);
 
 private:
-    UARTTask() : Task(UART_TASK_QUEUE_DEPTH_OBJS) {}    // Private constructor
-    UARTTask(const UARTTask&);                        // Prevent copy-construction
-    UARTTask& operator=(const UARTTask&);            // Prevent assignment
+    UARTTask() : StaticTask("UARTTask") {}    // Private constructor
 };
 
 
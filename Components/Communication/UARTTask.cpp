@@ -23,20 +23,8 @@ void UARTTask::ConfigureUART()
 */
 void UARTTask::InitTask()
 {
-    // Make sure the task is not already initialized
-    SOAR_ASSERT(rtTaskHandle == nullptr, "Cannot initialize UART task twice");
-    
     // Start the task
-    BaseType_t rtValue =
-        xTaskCreate((TaskFunction_t)UARTTask::RunTask,
-            (const char*)"UARTTask",
-            (uint16_t)UART_TASK_STACK_DEPTH_WORDS,
-            (void*)this,
-            (UBaseType_t)UART_TASK_RTOS_PRIORITY,
-            (TaskHandle_t*)&rtTaskHandle);
-
-    //Ensure creation succeded
-    SOAR_ASSERT(rtValue == pdPASS, "UARTTask::InitTask() - xTaskCreate() failed");
+    StaticTask::InitTask();
 
     // Configure DMA
      
@@ -48,16 +36,8 @@ void UARTTask::InitTask()
 */
 void UARTTask::Run(void * pvParams)
 {
-    //UART Task loop
-    while(1) {
-        Command cm;
-
-        //Wait forever for a command
-        qEvtQueue->ReceiveWait(cm);
-        
-        //Process the command
-        HandleCommand(cm);
-    }
+    //UART Task loop, waits forever for each command
+    RunBlocking();
 }
 
 /**
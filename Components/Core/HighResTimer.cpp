@@ -0,0 +1,332 @@
+/**
+ ******************************************************************************
+ * File Name          : HighResTimer.cpp
+ * Description        : Microsecond one shot and periodic timers on a TIM2
+ *                      compare channel.
+ ******************************************************************************
+*/
+#include "HighResTimer.hpp"
+#include "SystemDefines.hpp"
+#include "timers.h"
+#include "RuntimeStats.hpp"
+
+static_assert(RUNTIME_STATS_TIMER_HZ == 1000000, "HighResTimer deadlines are in TIM2 counts, which must be 1 us");
+
+/* Variables -----------------------------------------------------------------*/
+static HighResTimerEntry* volatile head = nullptr;     // Armed entries, earliest deadline first
+static HighResJitter jitter[HRT_CONTEXT_COUNT] = {};   // ISR context written by the interrupt, deferred by the timer daemon
+
+static const char* const CONTEXT_NAMES[HRT_CONTEXT_COUNT] = { "ISR", "Deferred" };
+static const char* const BUCKET_NAMES[HIGH_RES_JITTER_BUCKETS] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128+" };
+
+/* Helpers ------------------------------------------------------------------*/
+/**
+ * @brief Masks interrupts from task or interrupt context
+ * @return PRIMASK to restore
+ */
+static uint32_t Mask()
+{
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void Unmask(uint32_t primask)
+{
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Links an entry in deadline order, after any with the same deadline, interrupts masked
+ */
+static void Insert(HighResTimerEntry& entry)
+{
+    HighResTimerEntry* volatile* link = &head;
+    while (*link != nullptr && (int32_t)((*link)->deadline - entry.deadline) <= 0)
+        link = &(*link)->next;
+    entry.next = *link;
+    *link = &entry;
+}
+
+/**
+ * @brief Unlinks an entry, interrupts masked
+ */
+static void Remove(HighResTimerEntry& entry)
+{
+    HighResTimerEntry* volatile* link = &head;
+    while (*link != nullptr && *link != &entry)
+        link = &(*link)->next;
+    if (*link != nullptr)
+        *link = entry.next;
+    entry.next = nullptr;
+}
+
+/**
+ * @brief Points the compare at the head deadline, or turns the interrupt off if nothing is armed, interrupts masked
+ */
+static void Program()
+{
+    if (head == nullptr) {
+        TIM2->DIER &= ~TIM_DIER_CC1IE;
+        return;
+    }
+
+    TIM2->CCR1 = head->deadline;
+    TIM2->SR = ~TIM_SR_CC1IF;
+    TIM2->DIER |= TIM_DIER_CC1IE;
+
+    // Already passed before the compare was written, a match would be a whole counter wrap away
+    if ((int32_t)(head->deadline - TIM2->CNT) <= 0)
+        TIM2->EGR = TIM_EGR_CC1G;
+}
+
+/**
+ * @brief Adds one lateness sample
+ */
+static void Record(HighResJitter& j, uint32_t late_us)
+{
+    uint8_t bucket = 0;
+    for (uint32_t v = late_us; v != 0 && bucket < HIGH_RES_JITTER_BUCKETS - 1; v >>= 1)
+        bucket++;
+
+    j.count++;
+    j.total_us += late_us;
+    j.min_us = (late_us < j.min_us) ? late_us : j.min_us;
+    j.max_us = (late_us > j.max_us) ? late_us : j.max_us;
+    j.histogram[bucket]++;
+}
+
+/**
+ * @brief Runs a deferred callback in the timer daemon
+ * @param pvParameter1 The entry
+ * @param ulParameter2 Deadline it was due at
+ */
+static void RunDeferred(void* pvParameter1, uint32_t ulParameter2)
+{
+    const HighResTimerEntry* entry = (const HighResTimerEntry*)pvParameter1;
+    Record(jitter[HRT_CONTEXT_DEFERRED], TIM2->CNT - ulParameter2);
+    entry->callback(entry->arg);
+}
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Sets channel 1 up as a plain compare and enables the interrupt, call before the scheduler starts
+ */
+void HighResTimer::Init()
+{
+    RCC->APBENR1 |= RCC_APBENR1_TIM2EN;
+    (void)RCC->APBENR1;    // Clock enable takes effect before the first register write
+
+    TIM2->CCMR1 &= ~(TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE | TIM_CCMR1_CC1S);    // Frozen output compare, CCR1 written straight through
+    TIM2->DIER &= ~TIM_DIER_CC1IE;
+    TIM2->SR = ~TIM_SR_CC1IF;
+
+    NVIC_SetPriority(TIM2_IRQn, HIGH_RES_TIMER_IRQ_PRIORITY);
+    NVIC_EnableIRQ(TIM2_IRQn);
+    ResetJitter();
+}
+
+/**
+ * @brief Sets up an entry before its first Arm
+ * @param callback Called on expiry, in the given context
+ * @param arg Passed to the callback
+ */
+void HighResTimer::InitEntry(HighResTimerEntry& entry, void (*callback)(void* arg), void* arg, HighResContext context)
+{
+    entry = {};
+    entry.callback = callback;
+    entry.arg = arg;
+    entry.context = context;
+}
+
+/**
+ * @brief Arms an entry, rearming it if it's already armed, from a task or an interrupt
+ * @param delay_us Time from now until the callback
+ * @param period_us Rearmed by this much on every expiry, keeping the phase, 0 for one shot
+ * @return false if TIM2 isn't running yet, the run time stats start it with the scheduler
+ */
+bool HighResTimer::Arm(HighResTimerEntry& entry, uint32_t delay_us, uint32_t period_us)
+{
+    SOAR_ASSERT(delay_us <= HIGH_RES_TIMER_MAX_DELAY_US && period_us <= HIGH_RES_TIMER_MAX_DELAY_US, "HighResTimer delay out of range");
+    if ((TIM2->CR1 & TIM_CR1_CEN) == 0)
+        return false;
+
+    const uint32_t primask = Mask();
+    if (entry.armed)
+        Remove(entry);
+
+    entry.deadline = TIM2->CNT + delay_us;
+    entry.period_us = period_us;
+    entry.armed = true;
+    Insert(entry);
+    if (head == &entry)
+        Program();
+    Unmask(primask);
+    return true;
+}
+
+/**
+ * @brief Disarms an entry, from a task or an interrupt
+ * @return true if it was armed
+ */
+bool HighResTimer::Cancel(HighResTimerEntry& entry)
+{
+    const uint32_t primask = Mask();
+    const bool wasArmed = entry.armed;
+    if (wasArmed) {
+        const bool wasHead = (head == &entry);
+        Remove(entry);
+        entry.armed = false;
+        if (wasHead)
+            Program();
+    }
+    Unmask(primask);
+    return wasArmed;
+}
+
+/**
+ * @brief Whether any entry is armed
+ */
+bool HighResTimer::IsPending()
+{
+    return head != nullptr;
+}
+
+/**
+ * @brief Microsecond counter the deadlines are on
+ */
+uint32_t HighResTimer::Now()
+{
+    return TIM2->CNT;
+}
+
+/**
+ * @brief TIM2 compare interrupt, runs or hands over every entry that's due and moves the compare on
+ */
+void HighResTimer::OnCompareIrq()
+{
+    BaseType_t woken = pdFALSE;
+    TIM2->SR = ~TIM_SR_CC1IF;
+
+    while (1) {
+        // Pop the head if it's due, with the list locked against an Arm from a higher priority interrupt
+        uint32_t primask = Mask();
+        HighResTimerEntry* entry = head;
+        const uint32_t now = TIM2->CNT;
+        if (entry == nullptr || (int32_t)(entry->deadline - now) > 0) {
+            Program();
+            Unmask(primask);
+            break;
+        }
+
+        head = entry->next;
+        entry->next = nullptr;
+        const uint32_t deadline = entry->deadline;
+        HighResJitter& j = jitter[entry->context];
+        if (entry->period_us != 0) {
+            // Keeps the phase, whole periods that have already gone by are dropped
+            entry->deadline += entry->period_us;
+            if ((int32_t)(entry->deadline - now) <= 0) {
+                const uint32_t behind = (now - entry->deadline) / entry->period_us + 1;
+                entry->deadline += behind * entry->period_us;
+                j.skipped += behind;
+            }
+            Insert(*entry);
+        }
+        else {
+            entry->armed = false;
+        }
+        Unmask(primask);
+
+        if (entry->context == HRT_CONTEXT_ISR) {
+            Record(j, TIM2->CNT - deadline);
+            entry->callback(entry->arg);
+        }
+        else if (xTimerPendFunctionCallFromISR(RunDeferred, entry, deadline, &woken) != pdPASS) {
+            j.deferFailed++;
+        }
+    }
+
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Consistent copy of one context's jitter
+ */
+HighResJitter HighResTimer::GetJitter(HighResContext context)
+{
+    const uint32_t primask = Mask();
+    const HighResJitter copy = jitter[context];
+    Unmask(primask);
+    return copy;
+}
+
+/**
+ * @brief Clears the jitter of both contexts
+ */
+void HighResTimer::ResetJitter()
+{
+    const uint32_t primask = Mask();
+    for (HighResJitter& j : jitter) {
+        j = {};
+        j.min_us = UINT32_MAX;
+    }
+    Unmask(primask);
+}
+
+/**
+ * @brief Prints the lateness of every callback since the last reset on the debug console
+ */
+void HighResTimer::PrintJitter()
+{
+    SOAR_PRINT("\n\t-- High Res Timer Jitter (us late) --\n");
+    for (uint8_t c = 0; c < HRT_CONTEXT_COUNT; c++) {
+        const HighResJitter j = GetJitter((HighResContext)c);
+        if (j.count == 0) {
+            SOAR_PRINT("%-9s no callbacks, %lu skipped, %lu not deferred\n", CONTEXT_NAMES[c], (unsigned long)j.skipped, (unsigned long)j.deferFailed);
+            continue;
+        }
+
+        SOAR_PRINT("%-9s %lu callbacks, min %lu, mean %lu, max %lu, %lu skipped, %lu not deferred\n", CONTEXT_NAMES[c],
+            (unsigned long)j.count, (unsigned long)j.min_us, (unsigned long)(j.total_us / j.count), (unsigned long)j.max_us,
+            (unsigned long)j.skipped, (unsigned long)j.deferFailed);
+        for (uint8_t b = 0; b < HIGH_RES_JITTER_BUCKETS; b++) {
+            if (j.histogram[b] != 0)
+                SOAR_PRINT("  %7s : %lu\n", BUCKET_NAMES[b], (unsigned long)j.histogram[b]);
+        }
+    }
+    SOAR_PRINT("\n");
+}
+
+/**
+ * @brief Measures the jitter under a test load, a periodic entry in each context, then prints it
+ *        Blocks the calling task for HIGH_RES_JITTER_TEST_MS.
+ */
+void HighResTimer::RunJitterTest()
+{
+    static HighResTimerEntry isrTest;
+    static HighResTimerEntry deferredTest;
+    static volatile uint32_t isrCalls;
+    static volatile uint32_t deferredCalls;
+
+    isrCalls = 0;
+    deferredCalls = 0;
+    InitEntry(isrTest, [](void*) { isrCalls = isrCalls + 1; }, nullptr, HRT_CONTEXT_ISR);
+    InitEntry(deferredTest, [](void*) { deferredCalls = deferredCalls + 1; }, nullptr, HRT_CONTEXT_DEFERRED);
+
+    ResetJitter();
+    if (!Arm(isrTest, HIGH_RES_JITTER_TEST_ISR_US, HIGH_RES_JITTER_TEST_ISR_US) ||
+        !Arm(deferredTest, HIGH_RES_JITTER_TEST_DEFERRED_US, HIGH_RES_JITTER_TEST_DEFERRED_US)) {
+        SOAR_PRINT("HighResTimer, TIM2 not running\n");
+        return;
+    }
+
+    osDelay(HIGH_RES_JITTER_TEST_MS);
+    Cancel(isrTest);
+    Cancel(deferredTest);
+    osDelay(1);    // Lets the daemon run anything already handed over
+
+    SOAR_PRINT("%lu us ISR period, %lu us deferred period, for %lu ms, %lu / %lu calls\n", (unsigned long)HIGH_RES_JITTER_TEST_ISR_US,
+        (unsigned long)HIGH_RES_JITTER_TEST_DEFERRED_US, (unsigned long)HIGH_RES_JITTER_TEST_MS, (unsigned long)isrCalls, (unsigned long)deferredCalls);
+    PrintJitter();
+}
@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * File Name          : Clock.hpp
+ * Description        : Microsecond time since boot.
+ *
+ *    Built from the RTOS tick count and the SysTick down counter, so it needs
+ *    no extra timer. Reads are a few loads and one divide, fine for event
+ *    timestamps but not meant for tight loops. If the SysTick has reloaded
+ *    and its interrupt hasn't run yet (interrupts masked) the result can be
+ *    up to one tick behind.
+ *
+ *    The 32-bit tick count wraps after 49.7 days at 1 kHz, so it's extended
+ *    with the kernel's own tick overflow count (the one it keeps for
+ *    timeouts). The result is monotonic for the life of the board, and
+ *    nothing has to read it at least once per wrap. Reading the pair takes
+ *    a critical section, so call it from tasks only, not from interrupts.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_CLOCK_H
+#define AVIONICS_INCLUDE_SOAR_CORE_CLOCK_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+
+#ifndef COMPUTER_ENVIRONMENT
+#include "stm32g0xx.h"
+#include "cmsis_os.h"
+#endif
+
+/* Functions -----------------------------------------------------------------*/
+namespace Clock
+{
+#ifndef COMPUTER_ENVIRONMENT
+    constexpr uint32_t US_PER_TICK = 1000000 / configTICK_RATE_HZ;
+
+    /**
+     * @brief Microseconds since the scheduler started
+     */
+    inline uint64_t Micros()
+    {
+        // The tick count, its overflow count and the counter have to come from the same tick, read again if the tick moved
+        TimeOut_t tick;
+        uint32_t counter;
+        do {
+            vTaskSetTimeOutState(&tick);
+            counter = SysTick->VAL;
+        } while (tick.xTimeOnEntering != xTaskGetTickCount());
+
+        const uint64_t ticks = ((uint64_t)(uint32_t)tick.xOverflowCount << 32) | tick.xTimeOnEntering;
+        const uint32_t reload = SysTick->LOAD + 1;
+        const uint32_t elapsed = reload - 1 - counter;    // Counts down from LOAD
+        return ticks * US_PER_TICK + (elapsed * US_PER_TICK) / reload;
+    }
+#else
+    // Host builds run on simulated time, moved forward by whatever is driving the code (the trace replay)
+    inline uint64_t& HostMicros()
+    {
+        static uint64_t micros = 0;
+        return micros;
+    }
+
+    inline uint64_t Micros() { return HostMicros(); }
+    inline void SetMicros(uint64_t micros) { HostMicros() = micros; }
+#endif
+}
+
+#endif // AVIONICS_INCLUDE_SOAR_CORE_CLOCK_H
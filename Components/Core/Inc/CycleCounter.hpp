@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * File Name          : CycleCounter.hpp
+ * Description        : Cycle measurement for short code sections.
+ *
+ *    The Cortex-M0+ has no DWT cycle counter, so this reads the SysTick down
+ *    counter instead. A measurement is only valid if it is shorter than one
+ *    SysTick period (1ms) and interrupts are masked for its duration, use
+ *    Measure() which takes care of both.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_CYCLE_COUNTER_H
+#define AVIONICS_INCLUDE_SOAR_CORE_CYCLE_COUNTER_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+
+#ifndef COMPUTER_ENVIRONMENT
+#include "stm32g0xx.h"
+#include "cmsis_os.h"
+#else
+#include <chrono>
+#endif
+
+/* Structs -------------------------------------------------------------------*/
+struct CycleStats {
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint16_t count;
+
+    uint32_t Average() const { return (count == 0) ? 0 : (total / count); }
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace CycleCounter
+{
+#ifndef COMPUTER_ENVIRONMENT
+    inline uint32_t Now() { return SysTick->VAL; }
+
+    /**
+     * @brief Cycles between two Now() readings, handles a single SysTick reload
+     */
+    inline uint32_t Elapsed(uint32_t start, uint32_t end)
+    {
+        return (start >= end) ? (start - end) : (start + (SysTick->LOAD + 1) - end);
+    }
+#else
+    // Host builds count nanoseconds instead, the numbers are only useful relative to each other
+    inline uint32_t Now()
+    {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline uint32_t Elapsed(uint32_t start, uint32_t end) { return end - start; }
+#endif
+
+    /**
+     * @brief Runs fn iterations times with interrupts masked around each call and collects cycle stats
+     * @param fn Callable to measure, each call must complete well within 1ms
+     * @param iterations Number of calls to measure
+     * @return Min/max/total cycles over all calls
+     */
+    template<typename Fn>
+    CycleStats Measure(Fn fn, uint16_t iterations)
+    {
+        CycleStats stats = { UINT32_MAX, 0, 0, 0 };
+        for (uint16_t i = 0; i < iterations; i++) {
+#ifndef COMPUTER_ENVIRONMENT
+            taskENTER_CRITICAL();
+#endif
+            const uint32_t start = Now();
+            fn(i);
+            const uint32_t end = Now();
+#ifndef COMPUTER_ENVIRONMENT
+            taskEXIT_CRITICAL();
+#endif
+            const uint32_t cycles = Elapsed(start, end);
+            stats.min = (cycles < stats.min) ? cycles : stats.min;
+            stats.max = (cycles > stats.max) ? cycles : stats.max;
+            stats.total += cycles;
+            stats.count++;
+        }
+        return stats;
+    }
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_CYCLE_COUNTER_H */
@@ -0,0 +1,105 @@
+/**
+ ******************************************************************************
+ * File Name          : FixedPoint.hpp
+ * Description        : Integer Q-format helpers for math on the FPU-less M0+.
+ *
+ *    Everything in here is integer-only so results are bit-exact between the
+ *    target and a host build. Signed right shifts are assumed to be arithmetic
+ *    (true for GCC on both ARM and x86).
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_FIXED_POINT_H
+#define AVIONICS_INCLUDE_SOAR_CORE_FIXED_POINT_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+
+/* Macros --------------------------------------------------------------------*/
+constexpr uint16_t Q15_ONE = 0x8000;    // 1.0 in unsigned Q1.15, used for ratios in [0, 1]
+
+/* Functions -----------------------------------------------------------------*/
+namespace FixedPoint
+{
+    /**
+     * @brief Clamps a value to [lo, hi]
+     */
+    template<typename T>
+    constexpr T Clamp(T value, T lo, T hi)
+    {
+        return (value < lo) ? lo : ((value > hi) ? hi : value);
+    }
+
+    /**
+     * @brief Saturates a 32-bit value into a signed 16-bit value
+     */
+    constexpr int16_t SaturateToInt16(int32_t value)
+    {
+        return (int16_t)Clamp<int32_t>(value, INT16_MIN, INT16_MAX);
+    }
+
+    /**
+     * @brief Multiplies a value by an unsigned Q1.15 ratio, rounding to nearest
+     */
+    constexpr int32_t MulQ15(int32_t value, uint16_t ratioQ15)
+    {
+        return (int32_t)(((int64_t)value * ratioQ15 + (1 << 14)) >> 15);
+    }
+
+    /**
+     * @brief Integer square root, floor(sqrt(value)), fixed 16 iterations
+     */
+    inline uint32_t Sqrt(uint32_t value)
+    {
+        uint32_t result = 0;
+        uint32_t bit = 1UL << 30;
+        while (bit != 0) {
+            if (value >= result + bit) {
+                value -= result + bit;
+                result = (result >> 1) + bit;
+            }
+            else {
+                result >>= 1;
+            }
+            bit >>= 2;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Single-pole IIR low pass, state += (input - state) / 2^shift
+     * @param state Filter state, updated in place
+     * @param input New sample in the same Q-format as state
+     * @param shift Filter strength, the time constant is ~2^shift samples
+     */
+    inline void LowPass(int32_t& state, int32_t input, uint8_t shift)
+    {
+        state += (input - state) >> shift;
+    }
+
+    /**
+     * @brief Piecewise linear interpolation over a breakpoint table
+     *        Inputs outside the table are clamped to the end points.
+     *        Costs a division, so keep it off per-sample paths.
+     * @param xs Breakpoints, strictly increasing
+     * @param ys Output at each breakpoint
+     * @param count Number of breakpoints, must be >= 2
+     * @param x Input to interpolate at
+     * @return Interpolated output
+     */
+    inline int32_t Interpolate(const int32_t* xs, const int32_t* ys, uint8_t count, int32_t x)
+    {
+        if (x <= xs[0])
+            return ys[0];
+        if (x >= xs[count - 1])
+            return ys[count - 1];
+
+        uint8_t i = 1;
+        while (x > xs[i])
+            i++;
+
+        const int32_t dx = xs[i] - xs[i - 1];
+        const int32_t dy = ys[i] - ys[i - 1];
+        return ys[i - 1] + (int32_t)(((int64_t)dy * (x - xs[i - 1])) / dx);
+    }
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_FIXED_POINT_H */
@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * File Name          : HighResTimer.hpp
+ * Description        : Microsecond one shot and periodic timers on a TIM2
+ *                      compare channel.
+ *
+ *    For delays the 1 ms tick can't resolve, e.g. sampling 300 us after a
+ *    FET switch or a balancing duty cycle. TIM2 already runs free at 1 us for
+ *    the run time stats, channel 1 compares against it, nothing else is
+ *    started. Armed entries are kept in a list sorted by deadline and CCR1
+ *    holds the head, so the interrupt only fires when something is due.
+ *
+ *    Each entry says where its callback runs:
+ *      HRT_CONTEXT_ISR       - In the TIM2 interrupt, a few us late, must be
+ *                              short and only use FromISR calls
+ *      HRT_CONTEXT_DEFERRED  - Handed to the RTOS timer daemon with
+ *                              xTimerPendFunctionCallFromISR, later by however
+ *                              long the daemon takes to run, any RTOS call
+ *                              allowed. A callback already handed over still
+ *                              runs if the entry is cancelled in the meantime.
+ *
+ *    Arm and Cancel are safe from tasks and interrupts, the list is walked
+ *    with interrupts masked, a few entries long. How late every callback
+ *    started is kept as a jitter histogram per context, "hrt" on the debug
+ *    console runs a test load and prints it.
+ *
+ *    TIM2 stops in STOP1, tickless idle only uses WFI while an entry is armed.
+ *    The interrupt runs at HIGH_RES_TIMER_IRQ_PRIORITY, under the ALERT path.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_HIGH_RES_TIMER_H
+#define AVIONICS_INCLUDE_SOAR_CORE_HIGH_RES_TIMER_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include "cmsis_os.h"
+
+/* Macros --------------------------------------------------------------------*/
+constexpr uint32_t HIGH_RES_TIMER_IRQ_PRIORITY = 1;         // Below the ALERT fast path, which must be the only priority 0
+constexpr uint32_t HIGH_RES_TIMER_MAX_DELAY_US = 0x7FFFFFFF;    // Deadlines are compared as signed differences
+constexpr uint8_t HIGH_RES_JITTER_BUCKETS = 9;              // 0, 1, 2-3, 4-7 ... 64-127, 128+ us late
+constexpr uint32_t HIGH_RES_JITTER_TEST_MS = 2000;          // How long "hrt" runs its test load
+constexpr uint32_t HIGH_RES_JITTER_TEST_ISR_US = 250;       // Test periods
+constexpr uint32_t HIGH_RES_JITTER_TEST_DEFERRED_US = 1000;
+
+/* Enums -----------------------------------------------------------------*/
+enum HighResContext : uint8_t
+{
+    HRT_CONTEXT_ISR = 0,
+    HRT_CONTEXT_DEFERRED,
+    HRT_CONTEXT_COUNT
+};
+
+/* Structs -------------------------------------------------------------------*/
+/**
+ * @brief A high resolution timeout, owned by the caller, must stay in place while armed
+ */
+struct HighResTimerEntry {
+    HighResTimerEntry* next;
+    uint32_t deadline;              // TIM2 count it's due at
+    uint32_t period_us;             // Rearmed by this much on expiry, 0 for one shot
+    void (*callback)(void* arg);
+    void* arg;
+    HighResContext context;
+    bool armed;
+};
+
+struct HighResJitter {
+    uint32_t count;                 // Callbacks started
+    uint32_t min_us;                // Lateness, deadline to callback start
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t histogram[HIGH_RES_JITTER_BUCKETS];
+    uint32_t skipped;               // Periods dropped by a periodic entry that fell a whole period behind
+    uint32_t deferFailed;           // Timer daemon queue full, callback not run
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace HighResTimer
+{
+    void Init();                    // Before the scheduler starts, TIM2 itself is started with the run time stats
+
+    void InitEntry(HighResTimerEntry& entry, void (*callback)(void* arg), void* arg, HighResContext context);
+    bool Arm(HighResTimerEntry& entry, uint32_t delay_us, uint32_t period_us = 0);
+    bool Cancel(HighResTimerEntry& entry);
+    bool IsPending();               // Anything armed, TIM2 has to keep running
+    uint32_t Now();                 // us, wraps every ~71 minutes
+
+    void OnCompareIrq();            // TIM2 interrupt
+
+    HighResJitter GetJitter(HighResContext context);
+    void ResetJitter();
+    void PrintJitter();
+    void RunJitterTest();           // Blocks the calling task for HIGH_RES_JITTER_TEST_MS
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_HIGH_RES_TIMER_H */
@@ -0,0 +1,91 @@
+/**
+ ******************************************************************************
+ * File Name          : LowPower.hpp
+ * Description        : Tickless idle, STOP1 when the idle period is long enough.
+ *
+ *    FreeRTOS calls SuppressTicksAndSleep from the idle task
+ *    (configUSE_TICKLESS_IDLE 2). Idle periods shorter than
+ *    LOW_POWER_STOP_MIN_TICKS only WFI with the tick running. Longer ones
+ *    stop the SysTick and enter STOP1 until an LPTIM1 compare at the expected
+ *    wake tick, or any interrupt that comes first. LPTIM1 runs free on the
+ *    LSI, which is calibrated against the HSI once at Init. On wake the kernel
+ *    tick, the HAL tick and the run time counter are moved on by the time
+ *    spent stopped, and the SysTick is restarted in phase, so Clock::Micros()
+ *    keeps counting through it.
+ *
+ *    Wake sources in STOP1:
+ *      - LPTIM1 compare, the next task timeout
+ *      - GPIO EXTI lines, the bq769x0 ALERT on PB5 (unmasked by
+ *        FastProtection::Init)
+ *      - USART1/USART2 receive, both run on HSI16 with UESM set so the first
+ *        byte is received, not just detected
+ *    STOP1 is passed over (WFI instead) while a UART is still shifting out or
+ *    an I2C bus is busy, while a HighResTimer entry is armed, and while
+ *    anything holds InhibitStop(). It's also passed over while either I2C
+ *    has SMBus alert enabled (ALERTEN): SMBA, PA1 for I2C1, only reaches the
+ *    I2C peripheral, and that can't wake STOP1. An alert that has to wake the
+ *    part goes on a GPIO EXTI line, as the bq769x0 ALERT does.
+ *
+ *    Waking costs about 10 us from STOP1 on HSI16 plus ~20 us of tick
+ *    bookkeeping with interrupts masked, before the interrupt that woke the
+ *    part runs. The bq769x0 CC_READY wakes it every 250 ms regardless.
+ *
+ *    "lowpower" on the debug console prints the time spent in run, WFI and
+ *    STOP1 since the last reset. "lpmode run|sleep|stop" pins the deepest
+ *    state and resets the counters, to compare supply current between states.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_LOW_POWER_H
+#define AVIONICS_INCLUDE_SOAR_CORE_LOW_POWER_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include "cmsis_os.h"
+
+/* Macros --------------------------------------------------------------------*/
+constexpr uint32_t LOW_POWER_STOP_MIN_TICKS = 5;            // Shorter idles only WFI, STOP1 entry and the LPTIM compare write take ~150 us
+constexpr uint32_t LOW_POWER_LPTIM_PRESCALER = 16;          // LSI / 16, ~2 kHz, 0.5 ms resolution
+constexpr uint16_t LOW_POWER_MAX_SLEEP_COUNTS = 0xF000;     // ~30 s, leaves room on the 16 bit counter for the wake bookkeeping
+constexpr uint32_t LOW_POWER_CALIBRATION_TICKS = 50;        // SysTick periods the LSI is measured over at Init
+constexpr uint32_t LOW_POWER_MIN_RESTART_CYCLES = 64;       // Shortest first SysTick period after a wake
+
+/* Enums -----------------------------------------------------------------*/
+enum LowPowerMode : uint8_t
+{
+    LP_MODE_RUN = 0,        // Idle task spins, for a baseline current measurement
+    LP_MODE_SLEEP,          // WFI only, the tick keeps running
+    LP_MODE_STOP,           // STOP1 when the idle is long enough, the default
+};
+
+/* Structs -------------------------------------------------------------------*/
+struct LowPowerStats {
+    uint64_t since_us;          // Clock::Micros() at the last reset
+    uint64_t sleep_us;          // In WFI with the tick running
+    uint64_t stop_us;           // In STOP1
+    uint32_t sleepEntries;
+    uint32_t stopEntries;
+    uint32_t earlyWakes;        // STOP1 left by an interrupt before the compare
+    uint32_t stopDeclined;      // Long enough for STOP1, but inhibited or a peripheral was busy
+    uint32_t aborted;           // A tick or a ready task got in while setting up
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace LowPower
+{
+    void Init();                                    // Before the scheduler starts
+    void SuppressTicksAndSleep(TickType_t expectedIdleTicks);    // portSUPPRESS_TICKS_AND_SLEEP, idle task
+
+    void SetMode(LowPowerMode mode);
+    LowPowerMode GetMode();
+
+    void InhibitStop();                             // Nested, for peripherals that run across a task block
+    void ReleaseStop();
+
+    uint32_t GetLsiHz();
+    LowPowerStats GetStats();
+    void ResetStats();
+    void PrintStats();
+
+    const char* ModeToString(LowPowerMode mode);
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_LOW_POWER_H */
@@ -31,6 +31,7 @@ public:
     //Constructors
     Queue(void);
     Queue(uint16_t depth);
+    Queue(uint16_t depth, uint8_t* storage, StaticQueue_t* queueBuffer);
 
     //Functions
     bool Send(Command& command);
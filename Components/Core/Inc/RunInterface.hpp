@@ -12,5 +12,8 @@ void run_interface();
 
 void cpp_USART1_IRQHandler();
 void cpp_USART2_IRQHandler();
+void cpp_EXTI4_15_IRQHandler();
+void cpp_TIM2_IRQHandler();
+bool cpp_NMI_Handler();
 
 #endif /* C__IFACE_HPP_ */
@@ -0,0 +1,167 @@
+/**
+ ******************************************************************************
+ * File Name          : StateTable.hpp
+ * Description        : Compile time state machine tables.
+ *
+ *    A machine is two constexpr tables: one row per state with its entry and
+ *    exit actions, and a dense [state][event] grid saying where each event
+ *    goes and which guard has to pass first. Every cell repeats its own state
+ *    and event so IsComplete() can static_assert that nothing was left out or
+ *    put in the wrong place. Dispatch is two array lookups, no virtual calls
+ *    and nothing on the heap; guards and actions are small enums the owner
+ *    handles in a switch.
+ *
+ *    States can be split into substates. Substates only list the transitions
+ *    they handle themselves, anything else is inherited from the parent's row
+ *    in the dense table. The compiler expands the sparse list into a dense
+ *    index so the substate lookup is O(1) as well, and checks that substate
+ *    transitions never leave their parent (that's the parent's job).
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_STATE_TABLE_H
+#define AVIONICS_INCLUDE_SOAR_CORE_STATE_TABLE_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+
+/* Structs -------------------------------------------------------------------*/
+/**
+ * @brief Entry and exit actions of one state
+ */
+template<typename State, typename Action>
+struct StateTableEntry {
+    State state;        // Must match the row
+    Action onEnter;
+    Action onExit;
+};
+
+/**
+ * @brief What one event does in one state
+ */
+template<typename State, typename Event, typename Guard>
+struct StateTableTransition {
+    State state;        // Must match the row
+    Event event;        // Must match the column
+    Guard guard;        // Must pass for the transition to be taken
+    State next;         // Same as state to handle the event without a transition
+};
+
+/**
+ * @brief A substate, its parent and its entry and exit actions
+ */
+template<typename Substate, typename State, typename Action>
+struct StateTableSubstate {
+    Substate substate;  // Must match the row
+    State parent;
+    Action onEnter;     // Runs after the parent's
+    Action onExit;      // Runs before the parent's
+    uint8_t flags;      // Owner defined, what to run while in this substate
+};
+
+/**
+ * @brief Dense [substate][event] index into a sparse substate transition list, built by the compiler
+ */
+template<size_t SUBSTATES, size_t EVENTS>
+struct StateTableIndex {
+    static constexpr uint8_t INHERIT = 0xFF;    // No row, the parent handles the event
+
+    uint8_t row[SUBSTATES][EVENTS];
+    uint32_t handled[SUBSTATES];    // Bit per event with a row, so owners only check for events that can do something
+
+    template<typename Transition, size_t N>
+    constexpr StateTableIndex(const Transition (&transitions)[N]) : row(), handled()
+    {
+        static_assert(N < INHERIT, "Too many substate transitions for a uint8_t index");
+        static_assert(EVENTS <= 32, "Too many events for the handled mask");
+
+        for (size_t s = 0; s < SUBSTATES; s++) {
+            for (size_t e = 0; e < EVENTS; e++)
+                row[s][e] = INHERIT;
+        }
+        for (size_t i = 0; i < N; i++) {
+            row[transitions[i].state][transitions[i].event] = (uint8_t)i;
+            handled[transitions[i].state] |= 1UL << transitions[i].event;
+        }
+    }
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace StateTable
+{
+    /**
+     * @brief Checks every state has its row, in enum order
+     */
+    template<typename State, typename Action, size_t STATES>
+    constexpr bool IsComplete(const StateTableEntry<State, Action> (&states)[STATES])
+    {
+        for (size_t s = 0; s < STATES; s++) {
+            if ((size_t)states[s].state != s)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks every state/event pair has its cell, in enum order, and only leads to real states
+     */
+    template<typename State, typename Event, typename Guard, size_t STATES, size_t EVENTS>
+    constexpr bool IsComplete(const StateTableTransition<State, Event, Guard> (&transitions)[STATES][EVENTS])
+    {
+        for (size_t s = 0; s < STATES; s++) {
+            for (size_t e = 0; e < EVENTS; e++) {
+                const StateTableTransition<State, Event, Guard>& t = transitions[s][e];
+                if ((size_t)t.state != s || (size_t)t.event != e || (size_t)t.next >= STATES)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks every substate has its row, in enum order, under a real parent
+     */
+    template<typename Substate, typename State, typename Action, size_t SUBSTATES>
+    constexpr bool IsComplete(const StateTableSubstate<Substate, State, Action> (&substates)[SUBSTATES], size_t states)
+    {
+        for (size_t s = 0; s < SUBSTATES; s++) {
+            if ((size_t)substates[s].substate != s || (size_t)substates[s].parent >= states)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks a sparse substate transition list has no duplicate cells and never leaves a parent
+     */
+    template<typename Substate, typename State, typename Action, size_t SUBSTATES, typename Transition, size_t N>
+    constexpr bool IsNested(const StateTableSubstate<Substate, State, Action> (&substates)[SUBSTATES], const Transition (&transitions)[N])
+    {
+        for (size_t i = 0; i < N; i++) {
+            const Transition& t = transitions[i];
+            if ((size_t)t.state >= SUBSTATES || (size_t)t.next >= SUBSTATES)
+                return false;
+            if (substates[t.state].parent != substates[t.next].parent)
+                return false;
+            for (size_t j = 0; j < i; j++) {
+                if (transitions[j].state == t.state && transitions[j].event == t.event)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks each state's initial substate belongs to it
+     */
+    template<typename Substate, typename State, typename Action, size_t SUBSTATES, size_t STATES>
+    constexpr bool IsInitialValid(const StateTableSubstate<Substate, State, Action> (&substates)[SUBSTATES], const Substate (&initial)[STATES])
+    {
+        for (size_t s = 0; s < STATES; s++) {
+            if ((size_t)initial[s] >= SUBSTATES || (size_t)substates[initial[s]].parent != s)
+                return false;
+        }
+        return true;
+    }
+}
+
+#endif // AVIONICS_INCLUDE_SOAR_CORE_STATE_TABLE_H
@@ -0,0 +1,180 @@
+/**
+ ******************************************************************************
+ * File Name          : StaticTask.hpp
+ * Description        : CRTP base for tasks with statically allocated stack,
+ *                      TCB and event queue.
+ *
+ *    Provides what every task used to write out by hand: the Inst()
+ *    singleton, the RunTask trampoline, InitTask and the copy protection.
+ *    The stack, TCB and queue storage are members, and since the instance is
+ *    a function static they end up in .bss, nothing comes from the heap.
+ *
+ *    A task derives from StaticTask<Self, priority, stack words, queue depth>,
+ *    befriends its base, passes its name to the base constructor and
+ *    implements Run(void*) and HandleCommand(Command&). Run can do its setup
+ *    and then hand over to one of the loop skeletons:
+ *      RunBlocking  - Asynchronous, waits on the queue and handles each command
+ *                     as it arrives
+ *      RunPeriodic  - Synchronous-Blocking, drains the queue and calls
+ *                     OnPeriod() every GetPeriodMs(), commands wait for the
+ *                     next period
+ *      RunHybrid    - Synchronous-Non-Blocking, handles commands as they
+ *                     arrive and still calls OnPeriod() every GetPeriodMs(),
+ *                     waiting on the queue for whatever is left of the period
+ *    GetPeriodMs() and OnPeriod() are only needed by the loops that use them.
+ *
+ *    InitTask registers the task with the watchdog supervisor, with the
+ *    deadline from GetWatchdogDeadlineMs(), which a task can hide with its
+ *    own. The loops check in on every pass, RunBlocking wakes at least every
+ *    WATCHDOG_CHECKIN_PERIOD_MS to do so while its queue is empty. A task
+ *    with its own loop calls Watchdog::CheckIn(watchdogId_) the same way.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H
+#define AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H
+/* Includes ------------------------------------------------------------------*/
+#include "Task.hpp"
+#include "SystemDefines.hpp"
+#include "Watchdog.hpp"
+
+/* Class -----------------------------------------------------------------*/
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+class StaticTask : public Task
+{
+    static_assert(StackWords >= configMINIMAL_STACK_SIZE, "Task stack is below the RTOS minimum");
+    static_assert(QueueDepth > 0, "Task needs an event queue");
+
+public:
+    static Derived& Inst() {
+        static Derived inst;
+        return inst;
+    }
+
+    void InitTask();
+
+protected:
+    explicit StaticTask(const char* name);
+
+    static void RunTask(void* pvParams) { Derived::Inst().Run(pvParams); } // Static Task Interface, passes control to the instance Run();
+
+    // Run loop skeletons, never return
+    void RunBlocking();
+    void RunPeriodic();
+    void RunHybrid();
+
+    Derived& Self() { return static_cast<Derived&>(*this); }
+    uint32_t GetWatchdogDeadlineMs() const { return WATCHDOG_DEFAULT_DEADLINE_MS; }
+
+    const char* const kName_;    // RTOS task name
+    WatchdogId watchdogId_;      // Check-in slot, assigned by InitTask
+
+private:
+    StaticTask(const StaticTask&);                        // Prevent copy-construction
+    StaticTask& operator=(const StaticTask&);            // Prevent assignment
+
+    // Static storage, declared before queue_ so it exists when the queue is created
+    StackType_t stack_[StackWords];
+    StaticTask_t tcb_;
+    uint8_t queueStorage_[QueueDepth * sizeof(Command)];
+    StaticQueue_t queueBuffer_;
+    Queue queue_;
+};
+
+/* Implementation ------------------------------------------------------------*/
+/**
+ * @brief Constructor, creates the event queue in the member storage
+ * @param name RTOS task name, must outlive the task
+ */
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+StaticTask<Derived, Priority, StackWords, QueueDepth>::StaticTask(const char* name)
+    : Task(&queue_), kName_(name), watchdogId_(0), queue_(QueueDepth, queueStorage_, &queueBuffer_)
+{
+}
+
+/**
+ * @brief Creates the RTOS task on the member stack and TCB
+ */
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+void StaticTask<Derived, Priority, StackWords, QueueDepth>::InitTask()
+{
+    // Make sure the task is not already initialized
+    SOAR_ASSERT(rtTaskHandle == nullptr, "Cannot initialize %s twice", kName_);
+
+    watchdogId_ = Watchdog::Register(kName_, Self().GetWatchdogDeadlineMs());
+
+    rtTaskHandle = xTaskCreateStatic((TaskFunction_t)StaticTask::RunTask,
+        kName_,
+        (uint32_t)StackWords,
+        (void*)this,
+        Priority,
+        stack_,
+        &tcb_);
+
+    SOAR_ASSERT(rtTaskHandle != nullptr, "%s::InitTask() - xTaskCreateStatic() failed", kName_);
+}
+
+/**
+ * @brief Asynchronous loop, waits for a command and handles it, checking in with the watchdog while idle
+ */
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+void StaticTask<Derived, Priority, StackWords, QueueDepth>::RunBlocking()
+{
+    while (1) {
+        Watchdog::CheckIn(watchdogId_);
+
+        Command cm;
+        if (qEvtQueue->Receive(cm, WATCHDOG_CHECKIN_PERIOD_MS))
+            Self().HandleCommand(cm);
+    }
+}
+
+/**
+ * @brief Synchronous-Blocking loop, handles everything queued then runs the period, on a fixed rate
+ */
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+void StaticTask<Derived, Priority, StackWords, QueueDepth>::RunPeriodic()
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    while (1) {
+        Watchdog::CheckIn(watchdogId_);
+
+        //Process all commands in queue this cycle
+        Command cm;
+        while (qEvtQueue->Receive(cm))
+            Self().HandleCommand(cm);
+
+        vTaskDelayUntil(&lastWake, MS_TO_TICKS(Self().GetPeriodMs()));
+        Self().OnPeriod();
+    }
+}
+
+/**
+ * @brief Synchronous-Non-Blocking loop, handles commands as they arrive and runs the period in between
+ */
+template <class Derived, UBaseType_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+void StaticTask<Derived, Priority, StackWords, QueueDepth>::RunHybrid()
+{
+    TickType_t nextPeriod = xTaskGetTickCount() + MS_TO_TICKS(Self().GetPeriodMs());
+    while (1) {
+        Watchdog::CheckIn(watchdogId_);
+
+        const TickType_t now = xTaskGetTickCount();
+        const int32_t remaining = (int32_t)(nextPeriod - now);
+
+        if (remaining <= 0) {
+            Self().OnPeriod();
+            nextPeriod += MS_TO_TICKS(Self().GetPeriodMs());
+
+            // Fell more than a period behind, skip the missed ones rather than run them back to back
+            if ((int32_t)(nextPeriod - now) <= 0)
+                nextPeriod = now + MS_TO_TICKS(Self().GetPeriodMs());
+            continue;
+        }
+
+        Command cm;
+        if (qEvtQueue->Receive(cm, TICKS_TO_MS(remaining)))
+            Self().HandleCommand(cm);
+    }
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H */
@@ -21,6 +21,7 @@ public:
     //Constructors
     Task(void);
     Task(uint16_t depth);
+    explicit Task(Queue* queue);
 
     void InitTask();
 
@@ -1,7 +1,7 @@
 /**
  ******************************************************************************
  * File Name          : Timer.hpp
- * Description        : Wrapper for FreeRTOS Timers
+ * Description        : Timer facade over the TimerWheel
  ******************************************************************************
 */
 #ifndef AVIONICS_INCLUDE_SOAR_CORE_TIMER_H
@@ -9,11 +9,9 @@
 /* Includes ------------------------------------------------------------------*/
 #include "cmsis_os.h"
 #include "Utils.hpp"
-#include "FreeRTOS.h"
+#include "TimerWheel.hpp"
 
 /* Macros --------------------------------------------------------------------*/
-constexpr uint32_t DEFAULT_TIMER_COMMAND_WAIT_PERIOD = MS_TO_TICKS(15); // Default time to block a task if a command cannot be issued to the timer
-
 #define DEFAULT_TIMER_PERIOD (MS_TO_TICKS(1000)) // 1s
 
 // Enumeration representing the 4 timer states
@@ -30,13 +28,14 @@ enum TimerState {
 /**
  * @brief Timer class
  *
- * Wrapper for FreeRTOS Timers
+ * Facade over a TimerWheel entry, nothing is allocated or queued to start, stop or change a timer.
+ * Callbacks run in the TimerWheel task and must be short.
 */
 class Timer
 {
 public:
     Timer(); // Default Constructor (Polling Timer)
-    Timer(void (*TimerCallbackFunction_t)( TimerHandle_t xTimer )); // Constructor for Callback Enabled Timer
+    Timer(void (*TimerCallbackFunction_t)( Timer* timer )); // Constructor for Callback Enabled Timer
     ~Timer();
     bool ChangePeriodMs(const uint32_t period_ms); // Resets timers and initializes period to specified parameters
     bool ChangePeriodMsAndStart(const uint32_t period_ms); // Restarting timer with the specified parameter
@@ -44,7 +43,7 @@ public:
     bool Stop();
     bool ResetTimer();
     bool ResetTimerAndStart();
-    void SetAutoReload(bool setReloadOn);  //True for Autoreload and False for One-shot
+    void SetAutoReload(bool setReloadOn);  //True for Autoreload and False for One-shot, a counting timer changes at once
 
     const uint32_t GetOriginalPeriodMs(){return timerPeriod;};
     const bool GetIfAutoReload(); // Returns true if timer is Autoreload and False if it is One-shot
@@ -52,13 +51,18 @@ public:
     const uint32_t GetPeriodMs(); // Returns period in ms
     const uint32_t GetRemainingTimeMs(); // Returns time left till timer will expire
 
-    static void DefaultCallback( TimerHandle_t xTimer );
+    static void DefaultCallback( Timer* timer );
 
 protected:
     const uint32_t GetRTOSTimeRemaining();
+    void Arm(const uint32_t time_ms);
+
+    static void WheelCallback(void* arg); // Wheel entry callback, updates the state and calls the user callback
 
     TimerState timerState; // Enum that holds current timer state
-    TimerHandle_t rtTimerHandle;
+    TimerWheelEntry entry;
+    void (*callback)(Timer* timer);
+    bool autoReload = false;
     uint32_t timerPeriod = DEFAULT_TIMER_PERIOD;
     uint32_t remainingTimeBetweenPauses; // Calculates time left on timer when it is paused
 
@@ -0,0 +1,102 @@
+/**
+ ******************************************************************************
+ * File Name          : TimerWheel.hpp
+ * Description        : Hierarchical timer wheel, many lightweight timeouts
+ *                      expired from a single task.
+ *
+ *    A FreeRTOS software timer per timeout costs a timer object from the heap
+ *    and a command through the timer service queue for every start, stop and
+ *    period change. The wheel instead keeps caller owned entries in
+ *    TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots, each slot a doubly
+ *    linked list, so arming and cancelling is an unlink and a link with the
+ *    scheduler suspended, O(1), nothing queued or allocated and no interrupt
+ *    masked.
+ *
+ *    Level 0 holds the entries due within the next TIMER_WHEEL_SLOTS ticks,
+ *    one slot per tick. Each level above covers TIMER_WHEEL_SLOTS times the
+ *    span of the one below, and a slot is moved down a level (cascaded) when
+ *    the level below wraps round to it. With 4 levels of 32 that's 2^20 ticks,
+ *    about 17 minutes at 1 kHz, longer timeouts go round the top level again.
+ *
+ *    Entries expire in the TimerWheel task, callbacks run there one at a time
+ *    with no lock held, so they may arm or cancel entries, their own
+ *    included, but must be short. The task sleeps until the next slot that
+ *    holds anything, found from a per level occupancy bitmap, and is woken by
+ *    a task notification when an entry is armed ahead of that.
+ *
+ *    Arm/SetPeriod/Cancel/Remaining are for tasks, not interrupts.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_TIMER_WHEEL_H
+#define AVIONICS_INCLUDE_SOAR_CORE_TIMER_WHEEL_H
+/* Includes ------------------------------------------------------------------*/
+#include "StaticTask.hpp"
+#include "SystemDefines.hpp"
+
+/* Macros --------------------------------------------------------------------*/
+constexpr uint8_t TIMER_WHEEL_SLOT_BITS = 5;                                // 32 slots per level, one occupancy word
+constexpr uint8_t TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_SLOT_BITS;
+constexpr uint8_t TIMER_WHEEL_LEVELS = 4;                                   // 2^20 ticks before an entry has to go round again
+constexpr uint32_t TIMER_WHEEL_MAX_DELAY_TICKS = (1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+/* Structs -------------------------------------------------------------------*/
+/**
+ * @brief A timeout, owned by the caller, must stay in place while armed
+ */
+struct TimerWheelEntry {
+    TimerWheelEntry* next;
+    TimerWheelEntry* prev;
+    TickType_t expiry;              // Tick it's due on
+    TickType_t period;              // Rearmed by this much on expiry, 0 for one shot
+    void (*callback)(void* arg);    // Runs in the TimerWheel task
+    void* arg;
+    uint8_t level;                  // Where it's linked, for the occupancy bitmap on unlink
+    uint8_t slot;
+    bool armed;
+};
+
+struct TimerWheelStats {
+    uint16_t armed;                 // Entries in the wheel now
+    uint16_t peakArmed;
+    uint32_t expired;               // Callbacks run
+    uint32_t cascaded;              // Entries moved down a level
+    uint32_t maxLate_ticks;         // Longest an entry waited past its expiry to be run
+};
+
+/* Class -----------------------------------------------------------------*/
+class TimerWheel : public StaticTask<TimerWheel, TIMER_WHEEL_TASK_RTOS_PRIORITY, TIMER_WHEEL_TASK_STACK_DEPTH_WORDS, TIMER_WHEEL_TASK_QUEUE_DEPTH_OBJS>
+{
+    friend StaticTask;
+
+public:
+    static void Init(TimerWheelEntry& entry, void (*callback)(void* arg), void* arg);
+
+    void Arm(TimerWheelEntry& entry, TickType_t delay_ticks, TickType_t period_ticks = 0);
+    void SetPeriod(TimerWheelEntry& entry, TickType_t period_ticks);
+    bool Cancel(TimerWheelEntry& entry);
+    TickType_t Remaining(const TimerWheelEntry& entry) const;
+
+    TimerWheelStats GetStats();
+    void PrintStats();
+
+protected:
+    void Run(void* pvParams); // Main run code
+
+private:
+    TimerWheel();        // Private constructor
+
+    void Link(TimerWheelEntry& entry, TickType_t earliest);
+    void Unlink(TimerWheelEntry& entry);
+    void Advance(TickType_t target);
+    void Cascade(uint8_t level);
+    void Expire(uint8_t slot);
+    TickType_t TicksToNextEvent() const;
+
+    TimerWheelEntry* slots_[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint32_t occupied_[TIMER_WHEEL_LEVELS];    // Bit per non-empty slot
+    TickType_t now_;                           // Wheel time, every slot up to it has been processed
+    volatile TickType_t wakeAt_;               // When the task next looks at the wheel
+    TimerWheelStats stats_;
+};
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_TIMER_WHEEL_H */
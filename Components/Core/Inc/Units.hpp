@@ -0,0 +1,177 @@
+/**
+ ******************************************************************************
+ * File Name          : Units.hpp
+ * Description        : Typed integer physical units and Q16.16 scalars.
+ *
+ *    Each unit is a distinct type around an int32_t, so millivolts can't be
+ *    passed where milliamps are expected and a mixed-unit product has to go
+ *    through a named conversion. Arithmetic saturates instead of wrapping.
+ *    Conversions are constexpr and overflow checked: an overflow in a constant
+ *    expression fails to compile, at runtime the result saturates.
+ *
+ *    Nothing here touches float, so none of it pulls in the soft-float library
+ *    on the M0+.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_UNITS_H
+#define AVIONICS_INCLUDE_SOAR_CORE_UNITS_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+
+/* Overflow Checking ---------------------------------------------------------*/
+namespace Units
+{
+    /**
+     * @brief Reached only when a conversion overflows. Deliberately not constexpr, so
+     *        evaluating it in a constant expression is a compile error.
+     */
+    inline void ConversionOverflow() {}
+
+    /**
+     * @brief Narrows a 64-bit intermediate to int32_t, saturating on overflow
+     */
+    constexpr int32_t Saturate(int64_t value)
+    {
+        return (value > INT32_MAX) ? (ConversionOverflow(), INT32_MAX)
+            : ((value < INT32_MIN) ? (ConversionOverflow(), INT32_MIN) : (int32_t)value);
+    }
+}
+
+/* Quantity ------------------------------------------------------------------*/
+/**
+ * @brief An integer quantity in one unit, the tag only exists to make units distinct types
+ */
+template<typename Tag>
+class Quantity
+{
+public:
+    constexpr Quantity() : value_(0) {}
+    constexpr explicit Quantity(int32_t value) : value_(value) {}
+
+    constexpr int32_t Value() const { return value_; }
+
+    constexpr Quantity operator+(Quantity rhs) const { return Quantity(Units::Saturate((int64_t)value_ + rhs.value_)); }
+    constexpr Quantity operator-(Quantity rhs) const { return Quantity(Units::Saturate((int64_t)value_ - rhs.value_)); }
+    constexpr Quantity operator-() const { return Quantity(Units::Saturate(-(int64_t)value_)); }
+    constexpr Quantity operator*(int32_t factor) const { return Quantity(Units::Saturate((int64_t)value_ * factor)); }
+    Quantity& operator+=(Quantity rhs) { return *this = *this + rhs; }
+    Quantity& operator-=(Quantity rhs) { return *this = *this - rhs; }
+
+    constexpr bool operator==(Quantity rhs) const { return value_ == rhs.value_; }
+    constexpr bool operator!=(Quantity rhs) const { return value_ != rhs.value_; }
+    constexpr bool operator<(Quantity rhs) const { return value_ < rhs.value_; }
+    constexpr bool operator>(Quantity rhs) const { return value_ > rhs.value_; }
+    constexpr bool operator<=(Quantity rhs) const { return value_ <= rhs.value_; }
+    constexpr bool operator>=(Quantity rhs) const { return value_ >= rhs.value_; }
+
+    constexpr Quantity Abs() const { return (value_ < 0) ? -*this : *this; }
+
+protected:
+    int32_t value_;
+};
+
+struct MillivoltTag {};
+struct MicrovoltTag {};
+struct MilliampTag {};
+struct MicroohmTag {};
+struct DeciKelvinTag {};
+
+using Millivolts = Quantity<MillivoltTag>;
+using Microvolts = Quantity<MicrovoltTag>;
+using Milliamps = Quantity<MilliampTag>;
+using Microohms = Quantity<MicroohmTag>;
+using DeciKelvin = Quantity<DeciKelvinTag>;
+
+/* Q16.16 Scalar -------------------------------------------------------------*/
+/**
+ * @brief Signed Q16.16 scalar for gains and conversion factors
+ */
+class Q16
+{
+public:
+    static constexpr uint8_t FRAC_BITS = 16;
+    static constexpr int64_t ONE_RAW = (int64_t)1 << FRAC_BITS;    // Scaled by multiplying, shifting a negative left is undefined
+
+    constexpr Q16() : raw_(0) {}
+
+    static constexpr Q16 FromRaw(int32_t raw) { return Q16(raw); }
+    static constexpr Q16 FromInt(int32_t value) { return Q16(Units::Saturate((int64_t)value * ONE_RAW)); }
+
+    /**
+     * @brief num / den rounded to nearest, meant for constants so the divide happens at compile time
+     */
+    static constexpr Q16 FromRatio(int64_t num, int64_t den)
+    {
+        return Q16(Units::Saturate(((num * ONE_RAW) + ((((num < 0) != (den < 0)) ? -den : den) / 2)) / den));
+    }
+
+    constexpr int32_t Raw() const { return raw_; }
+
+    /**
+     * @brief Scales an integer, rounding to nearest and saturating
+     */
+    constexpr int32_t Apply(int32_t value) const
+    {
+        return Units::Saturate(((int64_t)value * raw_ + (1 << (FRAC_BITS - 1))) >> FRAC_BITS);
+    }
+
+    constexpr Q16 operator*(Q16 rhs) const { return Q16(Apply(rhs.raw_)); }
+    constexpr Q16 operator+(Q16 rhs) const { return Q16(Units::Saturate((int64_t)raw_ + rhs.raw_)); }
+    constexpr Q16 operator-(Q16 rhs) const { return Q16(Units::Saturate((int64_t)raw_ - rhs.raw_)); }
+    constexpr bool operator<(Q16 rhs) const { return raw_ < rhs.raw_; }
+    constexpr bool operator>(Q16 rhs) const { return raw_ > rhs.raw_; }
+
+protected:
+    constexpr explicit Q16(int32_t raw) : raw_(raw) {}
+
+    int32_t raw_;
+};
+
+/* Conversions ---------------------------------------------------------------*/
+namespace Units
+{
+    // Unit scaling
+    constexpr Millivolts FromVolts(int32_t volts) { return Millivolts(Saturate((int64_t)volts * 1000)); }
+    constexpr Microvolts ToMicrovolts(Millivolts mV) { return Microvolts(Saturate((int64_t)mV.Value() * 1000)); }
+    constexpr Millivolts ToMillivolts(Microvolts uV) { return Millivolts(uV.Value() / 1000); }
+    constexpr Milliamps FromAmps(int32_t amps) { return Milliamps(Saturate((int64_t)amps * 1000)); }
+    constexpr Microohms FromMilliohms(int32_t mOhm) { return Microohms(Saturate((int64_t)mOhm * 1000)); }
+
+    // Temperature, the sensors and thresholds are in 0.1C
+    constexpr int32_t ZERO_CELSIUS_DK = 2732;
+    constexpr DeciKelvin FromDeciCelsius(int32_t dC) { return DeciKelvin(Saturate((int64_t)dC + ZERO_CELSIUS_DK)); }
+    constexpr int32_t ToDeciCelsius(DeciKelvin dK) { return dK.Value() - ZERO_CELSIUS_DK; }
+
+    /**
+     * @brief Ohm's law, I * R, rounded to the nearest millivolt
+     */
+    constexpr Millivolts VoltageDrop(Milliamps current, Microohms resistance)
+    {
+        return Millivolts(Saturate(((int64_t)current.Value() * resistance.Value() + 500000) / 1000000));
+    }
+
+    /**
+     * @brief Ohm's law, dV / dI. Costs a divide.
+     * @return The resistance, 0 if the current is 0
+     */
+    constexpr Microohms Resistance(Millivolts voltage, Milliamps current)
+    {
+        return (current.Value() == 0) ? Microohms(0) : Microohms(Saturate((int64_t)voltage.Value() * 1000000 / current.Value()));
+    }
+
+    // Angle and motion factors, these replace the float macros that used to live in Utils.hpp
+    constexpr Q16 MICRORAD_PER_MILLIDEG = Q16::FromRatio(314159265, 18000000);    // PI/180 urad/mdeg
+    constexpr Q16 MILLIDEG_PER_MICRORAD = Q16::FromRatio(18000000, 314159265);    // 180/PI mdeg/urad
+    constexpr Q16 MMPS2_PER_MILLIG = Q16::FromRatio(980665, 100000);            // mm/s^2 per milli-g
+    constexpr Q16 GRAMS_PER_LB = Q16::FromRatio(45359237, 100000);                // Grams per pound
+
+    constexpr int32_t MilliDegToMicroRad(int32_t millideg) { return MICRORAD_PER_MILLIDEG.Apply(millideg); }
+    constexpr int32_t MicroRadToMilliDeg(int32_t microrad) { return MILLIDEG_PER_MICRORAD.Apply(microrad); }
+    constexpr int32_t MilliDpsToMicroRadps(int32_t millidps) { return MICRORAD_PER_MILLIDEG.Apply(millidps); }
+    constexpr int32_t MilliGToMmps2(int32_t millig) { return MMPS2_PER_MILLIG.Apply(millig); }
+    constexpr int32_t LbsToGrams(int32_t lbs) { return GRAMS_PER_LB.Apply(lbs); }
+
+    static_assert(Q16::FromInt(-3).Raw() == -3 * 65536 && Q16::FromRatio(-1, 2).Raw() == -32768, "Q16 constants must work for negative values");
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_UNITS_H */
@@ -0,0 +1,83 @@
+/**
+ ******************************************************************************
+ * File Name          : Watchdog.hpp
+ * Description        : Per task deadline supervision in front of the IWDG.
+ *
+ *    Every StaticTask registers at InitTask with a deadline and checks in
+ *    from its run loop. A check-in is one increment of the task's own
+ *    counter: each counter has a single writer, so nothing is locked or
+ *    masked (the M0+ has no exclusive access instructions, a shared bitmask
+ *    would need a critical section to set a bit). WatchdogTask compares the
+ *    counters every WATCHDOG_SUPERVISE_PERIOD_MS, a task is alive while its
+ *    counter moved within its deadline. The IWDG is only refreshed while
+ *    every supervised task is alive.
+ *
+ *    The first task to miss its deadline is written to a record in .noinit
+ *    RAM, which survives the IWDG reset, and the IWDG is left to run out.
+ *    At boot the record is read back with the RCC reset flags, "System Reset
+ *    Reason" shows the task. An IWDG reset without a record means the
+ *    supervisor itself stopped, or something kept it from running.
+ *
+ *    The IWDG keeps counting in STOP1, the supervisor period bounds how long
+ *    tickless idle can stay stopped. It's frozen while the core is halted by
+ *    a debugger.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_WATCHDOG_H
+#define AVIONICS_INCLUDE_SOAR_CORE_WATCHDOG_H
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include "cmsis_os.h"
+
+/* Macros --------------------------------------------------------------------*/
+constexpr uint8_t WATCHDOG_MAX_CLIENTS = 8;                 // Supervised tasks
+constexpr uint32_t WATCHDOG_SUPERVISE_PERIOD_MS = 100;      // Check-in counters compared, IWDG refreshed
+constexpr uint32_t WATCHDOG_CHECKIN_PERIOD_MS = 500;        // Longest a task waiting on its queue goes without checking in
+constexpr uint32_t WATCHDOG_DEFAULT_DEADLINE_MS = 2000;     // Missed check-ins before a task is declared stuck
+constexpr uint32_t WATCHDOG_IWDG_TIMEOUT_MS = 1000;         // From the last refresh to the reset, LSI / 32 so 1 count per ms
+constexpr uint32_t WATCHDOG_RECORD_MAGIC = 0x57444F47;      // "WDOG", the retained record is valid
+
+typedef uint8_t WatchdogId;
+
+/* Structs -------------------------------------------------------------------*/
+struct WatchdogResetRecord {
+    uint32_t magic;
+    char name[configMAX_TASK_NAME_LEN];     // First task to miss its deadline
+    uint32_t overdue_ms;                    // Since its last check-in
+    uint32_t uptime_ms;                     // When the miss was seen
+    uint32_t resetCount;                    // Watchdog resets in a row, cleared by any other reset
+    uint32_t check;                         // ~magic ^ the other words
+};
+
+struct WatchdogStatus {
+    uint8_t clientCount;
+    uint8_t aliveMask;                      // Bit per client, set while within its deadline
+    uint32_t worstMargin_ms;                // Smallest deadline minus age seen over all clients
+    const char* resetCause;
+    bool hasRecord;                         // Last reset was a supervised deadline miss
+    WatchdogResetRecord record;
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace Watchdog
+{
+    extern volatile uint32_t checkIns[WATCHDOG_MAX_CLIENTS];
+
+    void CheckResetCause();                                         // First thing in run_main
+    WatchdogId Register(const char* name, uint32_t deadline_ms);    // Before the scheduler starts
+    void SetDeadline(WatchdogId id, uint32_t deadline_ms);          // From the task itself, e.g. when its period changes
+
+    /**
+     * @brief Tells the supervisor the task is still running, safe from the owning task only
+     */
+    inline void CheckIn(WatchdogId id) { checkIns[id] = checkIns[id] + 1; }
+
+    void Start();
+    bool Supervise();                       // WatchdogTask, refreshes the IWDG if every client is alive
+
+    const char* GetResetCause();
+    WatchdogStatus GetStatus();
+    void PrintStatus();
+}
+
+#endif /* AVIONICS_INCLUDE_SOAR_CORE_WATCHDOG_H */
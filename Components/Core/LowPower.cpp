@@ -0,0 +1,405 @@
+/**
+ ******************************************************************************
+ * File Name          : LowPower.cpp
+ * Description        : Tickless idle, STOP1 when the idle period is long enough.
+ ******************************************************************************
+*/
+#include "LowPower.hpp"
+#include "SystemDefines.hpp"
+#include "Clock.hpp"
+#include "RuntimeStats.hpp"
+#include "HighResTimer.hpp"
+
+/* Variables -----------------------------------------------------------------*/
+static volatile LowPowerMode mode = LP_MODE_STOP;
+static volatile uint8_t stopInhibit = 0;
+static bool ready = false;                  // LPTIM1 running and the LSI calibrated
+static uint32_t lsiHz = 32000;
+static TickType_t maxStopTicks = 0;
+
+// Written by the idle task with interrupts masked, copied out in a critical section
+static LowPowerStats stats = {};
+
+/* Helpers ------------------------------------------------------------------*/
+/**
+ * @brief LPTIM1 counter, it runs off the LSI so two equal reads in a row are needed for a valid one
+ */
+static uint16_t ReadCounter()
+{
+    uint16_t first;
+    uint16_t second;
+    do {
+        first = (uint16_t)LPTIM1->CNT;
+        second = (uint16_t)LPTIM1->CNT;
+    } while (first != second);
+    return second;
+}
+
+static uint32_t CountsToUs(uint32_t counts)
+{
+    return (uint32_t)(((uint64_t)counts * LOW_POWER_LPTIM_PRESCALER * 1000000) / lsiHz);
+}
+
+static uint32_t UsToCounts(uint64_t us)
+{
+    return (uint32_t)((us * lsiHz) / ((uint64_t)LOW_POWER_LPTIM_PRESCALER * 1000000));
+}
+
+/**
+ * @brief Starts LPTIM1 free running over the full 16 bits
+ * @param prescalerBits CFGR PRESC field
+ */
+static void StartLptim(uint32_t prescalerBits)
+{
+    LPTIM1->CR = 0;
+    LPTIM1->CFGR = prescalerBits;
+    LPTIM1->IER = LPTIM_IER_CMPMIE;         // Only writable while disabled
+    LPTIM1->CR = LPTIM_CR_ENABLE;
+    LPTIM1->ARR = 0xFFFF;
+    while ((LPTIM1->ISR & LPTIM_ISR_ARROK) == 0) {}
+    LPTIM1->ICR = LPTIM_ICR_ARROKCF;
+    LPTIM1->CR |= LPTIM_CR_CNTSTRT;
+}
+
+/**
+ * @brief Measures the LSI against SysTick periods, which run on the HSI whether or not interrupts are enabled
+ * @return LSI frequency in Hz
+ */
+static uint32_t CalibrateLsi()
+{
+    StartLptim(0);    // Undivided, 32 counts per ms
+
+    (void)SysTick->CTRL;    // Reading clears COUNTFLAG, start on a fresh period
+    while ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) == 0) {}
+    const uint16_t start = ReadCounter();
+    for (uint32_t i = 0; i < LOW_POWER_CALIBRATION_TICKS; i++)
+        while ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) == 0) {}
+    const uint16_t counts = ReadCounter() - start;
+
+    const uint64_t cycles = (uint64_t)LOW_POWER_CALIBRATION_TICKS * (SysTick->LOAD + 1);
+    return (uint32_t)(((uint64_t)counts * SystemCoreClock) / cycles);
+}
+
+/**
+ * @brief Moves a UART's kernel clock to HSI16 and lets it wake the core from STOP1
+ *        The source can only change with the UART disabled, so an enabled one finishes its byte, is disabled and enabled again.
+ *        Its configuration and interrupt enables are kept, a receive already started carries on.
+ * @param selMask USARTxSEL field in CCIPR
+ * @param selHsi16 HSI16 value of that field
+ */
+static void SelectUartHsi16(USART_TypeDef* uart, uint32_t selMask, uint32_t selHsi16)
+{
+    const uint32_t enabled = uart->CR1 & USART_CR1_UE;
+    if (enabled) {
+        while ((uart->ISR & USART_ISR_TC) == 0) {}
+        uart->CR1 &= ~USART_CR1_UE;
+    }
+
+    RCC->CCIPR = (RCC->CCIPR & ~selMask) | selHsi16;
+    uart->CR1 |= USART_CR1_UESM | enabled;
+}
+
+/**
+ * @brief Whether stopping the clocks now would cut off a transfer or miss an interrupt
+ */
+static bool PeripheralsBusy()
+{
+    // TIM2 stops in STOP1, an armed high resolution timer would come in late by the whole sleep
+    if (HighResTimer::IsPending())
+        return true;
+
+    // A byte still in a UART shift register, the polled transmit only waits for TXE
+    if ((USART1->CR1 & USART_CR1_UE) && !(USART1->ISR & USART_ISR_TC))
+        return true;
+    if ((USART2->CR1 & USART_CR1_UE) && !(USART2->ISR & USART_ISR_TC))
+        return true;
+
+    // SMBALERT only reaches the I2C peripheral, which is stopped in STOP1 and isn't on an unmasked EXTI line
+    if ((I2C1->CR1 & I2C_CR1_ALERTEN) || (I2C2->CR1 & I2C_CR1_ALERTEN))
+        return true;
+
+    // SMBus transfers in flight
+    return ((I2C1->ISR & I2C_ISR_BUSY) != 0) || ((I2C2->ISR & I2C_ISR_BUSY) != 0);
+}
+
+/**
+ * @brief WFI until the next interrupt, usually the tick
+ */
+static void Sleep()
+{
+    __disable_irq();
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        __enable_irq();
+        return;
+    }
+
+    const uint32_t start = RuntimeStats::Counter();
+    __DSB();
+    __WFI();
+    const uint32_t slept = RuntimeStats::Counter() - start;
+    __enable_irq();
+
+    stats.sleep_us += slept;
+    stats.sleepEntries++;
+}
+
+/**
+ * @brief STOP1 until the LPTIM1 compare at the expected wake tick, or an earlier interrupt
+ * @param expectedIdleTicks Ticks until the kernel next has something to do
+ */
+static void Stop(TickType_t expectedIdleTicks)
+{
+    if (expectedIdleTicks > maxStopTicks)
+        expectedIdleTicks = maxStopTicks;
+
+    // The LPTIM count, SysTick phase and tick count from the same instant
+    __disable_irq();
+    const TickType_t tickAtStart = xTaskGetTickCount();
+    const uint16_t start = ReadCounter();
+    const uint32_t runStart = RuntimeStats::Counter();
+    const uint32_t reload = SysTick->LOAD + 1;
+    const uint32_t toNextTick = SysTick->VAL;
+    const bool tickPending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+    __enable_irq();
+
+    if (tickPending) {
+        stats.aborted++;
+        return;
+    }
+
+    // Wake on the boundary of the expected wake tick. The compare write takes a few LSI clocks to land, wait for it with interrupts enabled
+    const uint64_t sleep_us = (uint64_t)(expectedIdleTicks - 1) * Clock::US_PER_TICK + ((uint64_t)toNextTick * Clock::US_PER_TICK) / reload;
+    LPTIM1->ICR = LPTIM_ICR_CMPOKCF;
+    LPTIM1->CMP = (uint16_t)(start + UsToCounts(sleep_us));
+    while ((LPTIM1->ISR & LPTIM_ISR_CMPOK) == 0) {}
+
+    __disable_irq();
+
+    // A tick while waiting would put the SysTick phase out, anything else means there's work to do
+    if (xTaskGetTickCount() != tickAtStart || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0 || eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        __enable_irq();
+        stats.aborted++;
+        return;
+    }
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    // The compare interrupt is only enabled to wake the WFI, it's cleared again before interrupts are unmasked
+    LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+    NVIC_ClearPendingIRQ(TIM6_DAC_LPTIM1_IRQn);
+    NVIC_EnableIRQ(TIM6_DAC_LPTIM1_IRQn);
+
+    PWR->CR1 = (PWR->CR1 & ~PWR_CR1_LPMS) | PWR_CR1_LPMS_0;    // STOP1
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    __ISB();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    // Back on HSI16, the same clock as before, nothing to restore
+    const bool byCompare = (LPTIM1->ISR & LPTIM_ISR_CMPM) != 0;
+    NVIC_DisableIRQ(TIM6_DAC_LPTIM1_IRQn);
+    LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+    NVIC_ClearPendingIRQ(TIM6_DAC_LPTIM1_IRQn);
+
+    const uint32_t slept_us = CountsToUs((uint16_t)(ReadCounter() - start));
+    const uint32_t ran_us = RuntimeStats::Counter() - runStart;    // TIM2 only counted while the bus clock was running
+    const uint32_t stopped_us = (slept_us > ran_us) ? (slept_us - ran_us) : 0;
+
+    // Whole ticks from the tick boundary before start, the rest is the phase to restart SysTick at
+    const uint64_t sinceTick_us = ((uint64_t)(reload - toNextTick) * Clock::US_PER_TICK) / reload + slept_us;
+    TickType_t ticks = (TickType_t)(sinceTick_us / Clock::US_PER_TICK);
+    uint32_t nextTick = (uint32_t)(((Clock::US_PER_TICK - sinceTick_us % Clock::US_PER_TICK) * reload) / Clock::US_PER_TICK);
+
+    // The wake tick itself comes from the SysTick, vTaskStepTick doesn't unblock anything
+    if (ticks >= expectedIdleTicks) {
+        ticks = expectedIdleTicks - 1;
+        nextTick = LOW_POWER_MIN_RESTART_CYCLES;
+    }
+    nextTick = (nextTick < LOW_POWER_MIN_RESTART_CYCLES) ? LOW_POWER_MIN_RESTART_CYCLES : nextTick;
+
+    SysTick->LOAD = nextTick - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = reload - 1;    // Takes effect from the next reload
+
+    if (ticks > 0) {
+        vTaskStepTick(ticks);
+        uwTick += ticks;    // HAL timeouts
+    }
+    RuntimeStats::Advance(stopped_us);
+
+    stats.stop_us += stopped_us;
+    stats.stopEntries++;
+    stats.earlyWakes += byCompare ? 0 : 1;
+
+    __enable_irq();
+}
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Starts LPTIM1 on the calibrated LSI and sets up the STOP1 wake sources, call before the scheduler starts
+ */
+void LowPower::Init()
+{
+    RCC->CSR |= RCC_CSR_LSION;
+    while ((RCC->CSR & RCC_CSR_LSIRDY) == 0) {}
+
+    RCC->CCIPR = (RCC->CCIPR & ~RCC_CCIPR_LPTIM1SEL) | RCC_CCIPR_LPTIM1SEL_0;    // LSI
+    RCC->APBENR1 |= RCC_APBENR1_LPTIM1EN;
+    (void)RCC->APBENR1;    // Clock enable takes effect before the first register write
+
+    lsiHz = CalibrateLsi();
+    StartLptim(LPTIM_CFGR_PRESC_2);    // /16
+    maxStopTicks = CountsToUs(LOW_POWER_MAX_SLEEP_COUNTS) / Clock::US_PER_TICK;
+
+    // UARTs keep receiving in STOP1 on HSI16, the same frequency as PCLK so the baud rate doesn't change
+    SelectUartHsi16(USART1, RCC_CCIPR_USART1SEL, RCC_CCIPR_USART1SEL_1);
+    SelectUartHsi16(USART2, RCC_CCIPR_USART2SEL, RCC_CCIPR_USART2SEL_1);
+
+    // Direct wake lines, LPTIM1 and the two UARTs
+    EXTI->IMR1 |= EXTI_IMR1_IM29 | EXTI_IMR1_IM25 | EXTI_IMR1_IM26;
+
+    ready = true;
+}
+
+/**
+ * @brief Called by the idle task with the scheduler suspended when nothing is due for a while
+ * @param expectedIdleTicks Ticks until the next task timeout
+ */
+void LowPower::SuppressTicksAndSleep(TickType_t expectedIdleTicks)
+{
+    if (mode == LP_MODE_RUN)
+        return;
+
+    if (mode == LP_MODE_SLEEP || !ready || expectedIdleTicks < LOW_POWER_STOP_MIN_TICKS) {
+        Sleep();
+        return;
+    }
+
+    if (stopInhibit > 0 || PeripheralsBusy()) {
+        stats.stopDeclined++;
+        Sleep();
+        return;
+    }
+
+    Stop(expectedIdleTicks);
+}
+
+/**
+ * @brief Sets the deepest state the idle task may use, and starts a new measurement
+ */
+void LowPower::SetMode(LowPowerMode newMode)
+{
+    mode = newMode;
+    ResetStats();
+}
+
+/**
+ * @brief Deepest state the idle task may use
+ */
+LowPowerMode LowPower::GetMode()
+{
+    return mode;
+}
+
+/**
+ * @brief Keeps the part out of STOP1 until the matching ReleaseStop(), WFI is still allowed
+ */
+void LowPower::InhibitStop()
+{
+    taskENTER_CRITICAL();
+    stopInhibit++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Releases one InhibitStop()
+ */
+void LowPower::ReleaseStop()
+{
+    taskENTER_CRITICAL();
+    SOAR_ASSERT(stopInhibit > 0, "LowPower::ReleaseStop() without InhibitStop()");
+    stopInhibit--;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Calibrated LSI frequency
+ */
+uint32_t LowPower::GetLsiHz()
+{
+    return lsiHz;
+}
+
+/**
+ * @brief Consistent copy of the counters
+ */
+LowPowerStats LowPower::GetStats()
+{
+    taskENTER_CRITICAL();
+    const LowPowerStats copy = stats;
+    taskEXIT_CRITICAL();
+    return copy;
+}
+
+/**
+ * @brief Zeroes the counters and starts measuring from now
+ */
+void LowPower::ResetStats()
+{
+    const uint64_t now = Clock::Micros();
+    taskENTER_CRITICAL();
+    stats = {};
+    stats.since_us = now;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Prints the time spent in each state since the last reset on the debug console
+ */
+void LowPower::PrintStats()
+{
+    const LowPowerStats s = GetStats();
+    const uint64_t total_us = Clock::Micros() - s.since_us;
+    const uint64_t lowPower_us = s.sleep_us + s.stop_us;
+    const uint64_t run_us = (total_us > lowPower_us) ? (total_us - lowPower_us) : 0;
+    const uint64_t divisor = (total_us == 0) ? 1 : total_us;    // Straight after a reset
+
+    SOAR_PRINT("\n\t-- Low Power (%s, LSI %lu Hz) --\n", ModeToString(GetMode()), (unsigned long)lsiHz);
+    SOAR_PRINT("Measured  : %lu ms\n", (unsigned long)(total_us / 1000));
+    SOAR_PRINT("Run       : %lu ms, %lu permille\n", (unsigned long)(run_us / 1000), (unsigned long)((run_us * 1000) / divisor));
+    SOAR_PRINT("Sleep     : %lu ms, %lu permille, %lu entries\n", (unsigned long)(s.sleep_us / 1000),
+        (unsigned long)((s.sleep_us * 1000) / divisor), (unsigned long)s.sleepEntries);
+    SOAR_PRINT("Stop1     : %lu ms, %lu permille, %lu entries, %lu woken early\n", (unsigned long)(s.stop_us / 1000),
+        (unsigned long)((s.stop_us * 1000) / divisor), (unsigned long)s.stopEntries, (unsigned long)s.earlyWakes);
+    SOAR_PRINT("Stop1 passed over %lu, aborted %lu\n\n", (unsigned long)s.stopDeclined, (unsigned long)s.aborted);
+    if ((I2C1->CR1 & I2C_CR1_ALERTEN) || (I2C2->CR1 & I2C_CR1_ALERTEN))
+        SOAR_PRINT("Stop1 held off, SMBus alert is enabled on%s%s and can't wake it\n\n",
+            (I2C1->CR1 & I2C_CR1_ALERTEN) ? " I2C1" : "", (I2C2->CR1 & I2C_CR1_ALERTEN) ? " I2C2" : "");
+}
+
+/**
+ * @brief Returns a string for a mode
+ */
+const char* LowPower::ModeToString(LowPowerMode lpMode)
+{
+    switch (lpMode) {
+    case LP_MODE_RUN:
+        return "run";
+    case LP_MODE_SLEEP:
+        return "sleep";
+    case LP_MODE_STOP:
+        return "stop";
+    default:
+        return "";
+    }
+}
+
+/* FreeRTOS Hooks ------------------------------------------------------------------*/
+extern "C" {
+    void LowPower_SuppressTicksAndSleep(uint32_t expectedIdleTicks)
+    {
+        LowPower::SuppressTicksAndSleep((TickType_t)expectedIdleTicks);
+    }
+}
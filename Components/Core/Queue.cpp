@@ -31,6 +31,18 @@ Queue::Queue(uint16_t depth)
     queueDepth = depth;
 }
 
+/**
+ * @brief Constructor with caller provided storage, nothing comes from the heap
+ * @param depth Queue depth
+ * @param storage At least depth * sizeof(Command) bytes
+ * @param queueBuffer Queue control block
+*/
+Queue::Queue(uint16_t depth, uint8_t* storage, StaticQueue_t* queueBuffer)
+{
+    rtQueueHandle = xQueueCreateStatic(depth, sizeof(Command), storage, queueBuffer);
+    queueDepth = depth;
+}
+
 /**
  * @brief Sends a command object to the queue, safe to call from ISR
  * @param command Command object reference to send
@@ -7,6 +7,11 @@
 
 #include "main_avionics.hpp"
 #include "UARTDriver.hpp"
+#include "FastProtection.hpp"
+#include "RuntimeStats.hpp"
+#include "HighResTimer.hpp"
+#include "SystemStorage.hpp"
+#include "main.h"
 
 extern "C" {
     void run_interface()
@@ -16,12 +21,38 @@ extern "C" {
 
     void cpp_USART1_IRQHandler()
     {
+        RuntimeStats::IsrEnter();
         Driver::uart1.HandleIRQ_UART();
+        RuntimeStats::IsrExit();
     }
 
     void cpp_USART2_IRQHandler()
     {
+        RuntimeStats::IsrEnter();
         Driver::uart2.HandleIRQ_UART();
+        RuntimeStats::IsrExit();
+    }
+
+    void cpp_EXTI4_15_IRQHandler()
+    {
+        // Straight to the protection path, no HAL callback dispatch on the way
+        if (__HAL_GPIO_EXTI_GET_RISING_IT(BMS_ALERT_Pin)) {
+            __HAL_GPIO_EXTI_CLEAR_RISING_IT(BMS_ALERT_Pin);
+            FastProtection::OnAlert();    // Not bracketed, the power select write comes first
+        }
+    }
+
+    void cpp_TIM2_IRQHandler()
+    {
+        RuntimeStats::IsrEnter();
+        HighResTimer::OnCompareIrq();
+        RuntimeStats::IsrExit();
+    }
+
+    bool cpp_NMI_Handler()
+    {
+        // A torn storage record is the only NMI that's recoverable, the read that hit it fails instead
+        return SystemStorage::OnEccNmi();
     }
 }
 
@@ -27,3 +27,13 @@ Task::Task(uint16_t depth)
         qEvtQueue = new Queue(depth);
     rtTaskHandle = nullptr;
 }
+
+/**
+ * @brief Constructor with an event queue owned elsewhere, used by StaticTask
+ * @param queue Event queue, may not be constructed yet but must be before the task runs
+*/
+Task::Task(Queue* queue)
+{
+    qEvtQueue = queue;
+    rtTaskHandle = nullptr;
+}
@@ -1,7 +1,7 @@
 /**
  ******************************************************************************
  * File Name          : Timer.cpp
- * Description        : FreeRTOS Timer Wrapper
+ * Description        : Timer facade over the TimerWheel
  ******************************************************************************
 */
 #include "SystemDefines.hpp"
@@ -11,54 +11,69 @@
  * @brief Default constructor makes a timer that can only be polled for state
  * Default behaviour : ->Autoreload is set to false (One shot Timer)
  *                        ->Timer Period is 1000ms
- *                        ->The Callback function simply changes state to COMPLETE and has no other functionality
+ *                        ->Expiry simply changes state to COMPLETE and has no other functionality
 */
 Timer::Timer()
 {
-    // We make a timer named "Timer" with a callback function that does nothing, Autoreload false, and the default period of 1s.
-    // The timer ID is specified as (void *)this to provide a unique ID for each timer object - however this is not necessary for polling timers.
-    // The timer is created in the dormant state.
-    rtTimerHandle = xTimerCreate("Timer", timerPeriod, pdFALSE, (void *)this, DefaultCallback);
-    SOAR_ASSERT(rtTimerHandle, "Error Occurred, Timer not created");
+    // The wheel entry is dormant until the timer is started
+    TimerWheel::Init(entry, WheelCallback, (void *)this);
+    callback = nullptr;
     timerState = UNINITIALIZED;
+    remainingTimeBetweenPauses = 0;
 }
 
 /**
  * Constructor for callback enabled timer
- * ! User has to add "Timer::DefaultCallback(rtTimerHandle);" in the callback function for accurate functioning of Timer States
+ * The state is already updated when the callback runs, calling Timer::DefaultCallback() from it is no longer needed
  * Default behaviour : ->Autoreload is set to false (One shot Timer)
  *                        ->Timer Period is 1000ms
- *                        ->The Callback function will be provided by the user while making sure to follow instruction above
+ *                        ->The Callback function will be provided by the user, it runs in the TimerWheel task
 */
-Timer::Timer(void (*TimerDefaultCallback_t)( TimerHandle_t xTimer ))
+Timer::Timer(void (*TimerDefaultCallback_t)( Timer* timer ))
 {
-    rtTimerHandle = xTimerCreate("Timer", timerPeriod, pdFALSE, (void *)this, TimerDefaultCallback_t);
-    SOAR_ASSERT(rtTimerHandle, "Error Occurred, Timer not created");
+    TimerWheel::Init(entry, WheelCallback, (void *)this);
+    callback = TimerDefaultCallback_t;
     timerState = UNINITIALIZED;
+    remainingTimeBetweenPauses = 0;
 }
 
 /**
- * @brief Default de-constructor makes a timer that can only be polled for state
- * @return Prints a success message if the timer is successfully deleted and a warning message if it was not deleted
+ * @brief Destructor, takes the timer out of the wheel so it can't expire on a dead object
 */
 Timer::~Timer()
 {
-    if (xTimerDelete(rtTimerHandle, DEFAULT_TIMER_COMMAND_WAIT_PERIOD*2) == pdPASS) {
-        SOAR_PRINT("Timer has been deleted \n\n");
-    }
-    else {
-        SOAR_PRINT("WARNING, FAILED TO DELETE TIMER! \n\n");
-    }
+    TimerWheel::Inst().Cancel(entry);
 }
 
 /**
- * @brief Callback function for timers.
- * ! MUST be used for ALL timers. Has to be called manually by the user for callback enabled timers. Visit constructor for instructions.
+ * @brief Default state update on expiry, kept for callbacks written for the FreeRTOS timer wrapper
  * @return Sets timer state to COMPLETE when the timer has expired
 */
-void Timer::DefaultCallback(TimerHandle_t xTimer){
-    Timer* ptrTimer = (Timer*)pvTimerGetTimerID(xTimer);
-    ptrTimer->timerState = COMPLETE;
+void Timer::DefaultCallback(Timer* timer){
+    timer->timerState = COMPLETE;
+}
+
+/**
+ * @brief Wheel entry callback, runs in the TimerWheel task
+ *        One shot timers go to COMPLETE, auto-reload timers keep COUNTING as the wheel has rearmed them.
+*/
+void Timer::WheelCallback(void* arg)
+{
+    Timer* ptrTimer = (Timer*)arg;
+    if (!ptrTimer->autoReload)
+        DefaultCallback(ptrTimer);
+
+    if (ptrTimer->callback != nullptr)
+        ptrTimer->callback(ptrTimer);
+}
+
+/**
+ * @brief Arms the wheel entry, repeating every period if auto-reload is set
+ * @param time_ms Time until the first expiry
+ */
+void Timer::Arm(const uint32_t time_ms)
+{
+    TimerWheel::Inst().Arm(entry, MS_TO_TICKS(time_ms), autoReload ? MS_TO_TICKS(timerPeriod) : 0);
 }
 
 /**
@@ -67,14 +82,10 @@ void Timer::DefaultCallback(TimerHandle_t xTimer){
  */
 bool Timer::ChangePeriodMs(const uint32_t period_ms)
 {
-    if (xTimerChangePeriod(rtTimerHandle, MS_TO_TICKS(period_ms), DEFAULT_TIMER_COMMAND_WAIT_PERIOD) == pdTRUE) {
-        if (xTimerStop(rtTimerHandle, DEFAULT_TIMER_COMMAND_WAIT_PERIOD) == pdPASS) {
-            timerPeriod = period_ms;
-            timerState = UNINITIALIZED;
-            return true;
-        }
-    }
-    return false;
+    TimerWheel::Inst().Cancel(entry);
+    timerPeriod = period_ms;
+    timerState = UNINITIALIZED;
+    return true;
 }
 
 /**
@@ -83,12 +94,10 @@ bool Timer::ChangePeriodMs(const uint32_t period_ms)
  */
 bool Timer::ChangePeriodMsAndStart(const uint32_t period_ms)
 {
-    if (xTimerChangePeriod(rtTimerHandle, MS_TO_TICKS(period_ms), DEFAULT_TIMER_COMMAND_WAIT_PERIOD) == pdTRUE) {
-        timerPeriod = period_ms;
-        timerState = COUNTING;
-        return true;
-    }
-    return false;
+    timerPeriod = period_ms;
+    Arm(timerPeriod);
+    timerState = COUNTING;
+    return true;
 }
 
 /**
@@ -101,17 +110,15 @@ bool Timer::Start()
     if ((timerState == COMPLETE) || (timerState == COUNTING)) {
         return false;
     }
-    // Changes timer period to time left when it was previously stopped
+    // Resumes with the time left when it was previously stopped
     else if (timerState == PAUSED) {
-        xTimerChangePeriod(rtTimerHandle, MS_TO_TICKS(remainingTimeBetweenPauses), DEFAULT_TIMER_COMMAND_WAIT_PERIOD);
+        Arm(remainingTimeBetweenPauses);
         timerState = COUNTING;
         return true;
     }
-    if (xTimerStart(rtTimerHandle, DEFAULT_TIMER_COMMAND_WAIT_PERIOD) == pdPASS) {
-        timerState = COUNTING;
-        return true;
-    }
-    return false;
+    Arm(timerPeriod);
+    timerState = COUNTING;
+    return true;
 }
 
 /**
@@ -126,11 +133,9 @@ bool Timer::Stop()
     }
     // Calculates the time left on the timer before it is paused
     remainingTimeBetweenPauses = GetRTOSTimeRemaining();
-    if (xTimerStop(rtTimerHandle, DEFAULT_TIMER_COMMAND_WAIT_PERIOD) == pdPASS) {
-        timerState = PAUSED;
-        return true;
-    }
-    return false;
+    TimerWheel::Inst().Cancel(entry);
+    timerState = PAUSED;
+    return true;
 }
 
 /**
@@ -166,19 +171,12 @@ bool Timer::ResetTimerAndStart()
 
 /**
  * @param Sets timer to auto-reload if parameter is set to true, Sets timer to one shot if parameter is set to false
+ *        Takes effect at once, as with the FreeRTOS timer, a counting timer keeps its expiry and repeats or stops after it
 */
 void Timer::SetAutoReload(bool setReloadOn)
 {
-    if (setReloadOn == true){
-        vTimerSetReloadMode(rtTimerHandle, pdTRUE);
-        //Testing purposes
-        SOAR_PRINT("Set to Auto Reload\n\n");
-    }
-    if (setReloadOn == false){
-        vTimerSetReloadMode(rtTimerHandle, pdFALSE);
-        //Testing purposes
-        SOAR_PRINT("Set to One Shot\n\n");
-    }
+    autoReload = setReloadOn;
+    TimerWheel::Inst().SetPeriod(entry, autoReload ? MS_TO_TICKS(timerPeriod) : 0);
 }
 
 /**
@@ -186,12 +184,7 @@ void Timer::SetAutoReload(bool setReloadOn)
 */
 const bool Timer::GetIfAutoReload()
 {
-    if ((uxTimerGetReloadMode(rtTimerHandle)) == (( UBaseType_t ) pdTRUE)) {
-        return true;
-    }
-    else {
-        return false;
-    }
+    return autoReload;
 }
 
 /**
@@ -208,7 +201,7 @@ const TimerState Timer::GetState()
 */
 const uint32_t Timer::GetPeriodMs()
 {
-    return (TICKS_TO_MS(xTimerGetPeriod(rtTimerHandle)));
+    return timerPeriod;
 }
 
 /**
@@ -237,5 +230,5 @@ const uint32_t Timer::GetRemainingTimeMs()
  */
 const uint32_t Timer::GetRTOSTimeRemaining()
 {
-    return (TICKS_TO_MS(xTimerGetExpiryTime(rtTimerHandle) - xTaskGetTickCount()));;
+    return TICKS_TO_MS(TimerWheel::Inst().Remaining(entry));
 }
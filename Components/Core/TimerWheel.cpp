@@ -0,0 +1,332 @@
+/**
+ ******************************************************************************
+ * File Name          : TimerWheel.cpp
+ * Description        : Hierarchical timer wheel, many lightweight timeouts
+ *                      expired from a single task.
+ ******************************************************************************
+*/
+#include "TimerWheel.hpp"
+#include <cstring>
+
+/* Helpers ------------------------------------------------------------------*/
+constexpr uint32_t SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+
+static uint8_t SlotIndex(TickType_t tick, uint8_t level)
+{
+    return (uint8_t)((tick >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+}
+
+/**
+ * @brief Distance in slots from start to the first occupied slot at or after it, wrapping
+ * @return 0 to TIMER_WHEEL_SLOTS - 1, or TIMER_WHEEL_SLOTS if none is occupied
+ */
+static uint8_t NextOccupied(uint32_t occupied, uint8_t start)
+{
+    if (occupied == 0)
+        return TIMER_WHEEL_SLOTS;
+    const uint32_t rotated = (start == 0) ? occupied : ((occupied >> start) | (occupied << (TIMER_WHEEL_SLOTS - start)));
+    return (uint8_t)__builtin_ctz(rotated);
+}
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Constructor for TimerWheel
+ */
+TimerWheel::TimerWheel() : StaticTask("TimerWheel")
+{
+    memset(slots_, 0, sizeof(slots_));
+    memset(occupied_, 0, sizeof(occupied_));
+    now_ = xTaskGetTickCount();    // 0 on the target, the wheel is made before the scheduler starts
+    wakeAt_ = now_;
+    stats_ = {};
+}
+
+/**
+ * @brief Sets up an entry before its first Arm
+ * @param callback Called in the TimerWheel task on expiry
+ * @param arg Passed to the callback
+ */
+void TimerWheel::Init(TimerWheelEntry& entry, void (*callback)(void* arg), void* arg)
+{
+    entry = {};
+    entry.callback = callback;
+    entry.arg = arg;
+}
+
+/**
+ * @brief Instance Run loop for the TimerWheel, expires entries and sleeps until the next occupied slot
+ * @param pvParams RTOS Passed void parameters, contains a pointer to the object instance, should not be used
+ */
+void TimerWheel::Run(void* pvParams)
+{
+    while (1) {
+        Watchdog::CheckIn(watchdogId_);
+        Advance(xTaskGetTickCount());
+
+        // An Arm ahead of wakeAt_ after this notifies, the notification is kept if it lands before the take
+        vTaskSuspendAll();
+        TickType_t eventAt = now_ + TicksToNextEvent();
+        const TickType_t checkInAt = xTaskGetTickCount() + MS_TO_TICKS(WATCHDOG_CHECKIN_PERIOD_MS);
+        eventAt = ((int32_t)(eventAt - checkInAt) < 0) ? eventAt : checkInAt;
+        wakeAt_ = eventAt;
+        xTaskResumeAll();
+
+        const int32_t wait = (int32_t)(eventAt - xTaskGetTickCount());
+        ulTaskNotifyTake(pdTRUE, (wait > 0) ? (TickType_t)wait : 0);
+    }
+}
+
+/**
+ * @brief Arms an entry, rearming it if it's already armed, O(1)
+ * @param delay_ticks Ticks from now until the callback, 0 for the next time the wheel runs
+ * @param period_ticks Rearmed by this much on every expiry, 0 for one shot
+ */
+void TimerWheel::Arm(TimerWheelEntry& entry, TickType_t delay_ticks, TickType_t period_ticks)
+{
+    vTaskSuspendAll();
+    if (entry.armed)
+        Unlink(entry);
+    else
+        stats_.armed++;
+
+    entry.expiry = xTaskGetTickCount() + delay_ticks;
+    entry.period = period_ticks;
+    entry.armed = true;
+    Link(entry, now_ + 1);
+
+    stats_.peakArmed = (stats_.armed > stats_.peakArmed) ? stats_.armed : stats_.peakArmed;
+    const bool wake = (int32_t)(entry.expiry - wakeAt_) < 0;
+    xTaskResumeAll();
+
+    if (wake && rtTaskHandle != nullptr)
+        xTaskNotifyGive(rtTaskHandle);
+}
+
+/**
+ * @brief Changes the period of an entry without moving its next expiry, O(1)
+ * @param period_ticks Rearmed by this much from its next expiry on, 0 for that expiry to be the last
+ */
+void TimerWheel::SetPeriod(TimerWheelEntry& entry, TickType_t period_ticks)
+{
+    vTaskSuspendAll();
+    entry.period = period_ticks;
+    xTaskResumeAll();
+}
+
+/**
+ * @brief Disarms an entry, O(1)
+ * @return true if it was armed
+ */
+bool TimerWheel::Cancel(TimerWheelEntry& entry)
+{
+    vTaskSuspendAll();
+    const bool wasArmed = entry.armed;
+    if (wasArmed) {
+        Unlink(entry);
+        entry.armed = false;
+        stats_.armed--;
+    }
+    xTaskResumeAll();
+    return wasArmed;
+}
+
+/**
+ * @brief Ticks until an entry expires
+ * @return 0 if it isn't armed or is due
+ */
+TickType_t TimerWheel::Remaining(const TimerWheelEntry& entry) const
+{
+    if (!entry.armed)
+        return 0;
+    const int32_t remaining = (int32_t)(entry.expiry - xTaskGetTickCount());
+    return (remaining > 0) ? (TickType_t)remaining : 0;
+}
+
+/**
+ * @brief Links an entry into the slot for its expiry relative to the wheel time, scheduler suspended
+ * @param earliest First slot it may go in, the current one only while it's still to be expired
+ */
+void TimerWheel::Link(TimerWheelEntry& entry, TickType_t earliest)
+{
+    // Already due goes in the earliest slot, too far out goes in the last one and comes round again
+    TickType_t at = ((int32_t)(entry.expiry - earliest) > 0) ? entry.expiry : earliest;
+    if (at - now_ > TIMER_WHEEL_MAX_DELAY_TICKS)
+        at = now_ + TIMER_WHEEL_MAX_DELAY_TICKS;
+
+    const TickType_t delta = at - now_;
+    uint8_t level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+        level++;
+
+    const uint8_t slot = SlotIndex(at, level);
+    entry.level = level;
+    entry.slot = slot;
+    entry.prev = nullptr;
+    entry.next = slots_[level][slot];
+    if (entry.next != nullptr)
+        entry.next->prev = &entry;
+    slots_[level][slot] = &entry;
+    occupied_[level] |= (1UL << slot);
+}
+
+/**
+ * @brief Unlinks an entry from its slot, scheduler suspended
+ */
+void TimerWheel::Unlink(TimerWheelEntry& entry)
+{
+    if (entry.prev != nullptr)
+        entry.prev->next = entry.next;
+    else
+        slots_[entry.level][entry.slot] = entry.next;
+    if (entry.next != nullptr)
+        entry.next->prev = entry.prev;
+
+    if (slots_[entry.level][entry.slot] == nullptr)
+        occupied_[entry.level] &= ~(1UL << entry.slot);
+    entry.next = nullptr;
+    entry.prev = nullptr;
+}
+
+/**
+ * @brief Moves the wheel time up to target, cascading and expiring slots on the way
+ *        Steps straight to the next occupied level 0 slot or level 0 wrap, empty ticks cost nothing.
+ */
+void TimerWheel::Advance(TickType_t target)
+{
+    while ((int32_t)(target - now_) > 0) {
+        vTaskSuspendAll();
+        const uint8_t current = (uint8_t)(now_ & SLOT_MASK);
+        TickType_t step = TIMER_WHEEL_SLOTS - current;
+        const uint8_t next = NextOccupied(occupied_[0], (uint8_t)((current + 1) & SLOT_MASK));
+        if (next < TIMER_WHEEL_SLOTS && (TickType_t)(next + 1) < step)
+            step = next + 1;
+        if (target - now_ < step)
+            step = target - now_;
+
+        now_ += step;
+        if ((now_ & SLOT_MASK) == 0)
+            Cascade(1);
+        const uint8_t slot = (uint8_t)(now_ & SLOT_MASK);
+        const bool due = (occupied_[0] & (1UL << slot)) != 0;
+        xTaskResumeAll();
+
+        if (due)
+            Expire(slot);
+    }
+}
+
+/**
+ * @brief Moves the current slot of a level down now the level below has wrapped, then the level above if this one has, scheduler suspended
+ */
+void TimerWheel::Cascade(uint8_t level)
+{
+    const uint8_t slot = SlotIndex(now_, level);
+    TimerWheelEntry* entry = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~(1UL << slot);
+
+    while (entry != nullptr) {
+        TimerWheelEntry* next = entry->next;
+        Link(*entry, now_);    // The current level 0 slot is expired next
+        stats_.cascaded++;
+        entry = next;
+    }
+
+    if (slot == 0 && level + 1 < TIMER_WHEEL_LEVELS)
+        Cascade(level + 1);
+}
+
+/**
+ * @brief Runs the callbacks of every entry in a level 0 slot, one at a time with the scheduler running
+ */
+void TimerWheel::Expire(uint8_t slot)
+{
+    while (1) {
+        vTaskSuspendAll();
+        TimerWheelEntry* entry = slots_[0][slot];
+        if (entry == nullptr) {
+            xTaskResumeAll();
+            return;
+        }
+        Unlink(*entry);
+
+        // Came round again after being clamped to the wheel span, not due yet
+        if ((int32_t)(entry->expiry - now_) > 0) {
+            Link(*entry, now_ + 1);
+            xTaskResumeAll();
+            continue;
+        }
+
+        const TickType_t late = xTaskGetTickCount() - entry->expiry;
+        stats_.maxLate_ticks = (late > stats_.maxLate_ticks) ? late : stats_.maxLate_ticks;
+        stats_.expired++;
+
+        void (*callback)(void*) = entry->callback;
+        void* arg = entry->arg;
+        if (entry->period != 0) {
+            // Keeps the phase, unless it has fallen a whole period behind
+            entry->expiry += entry->period;
+            if ((int32_t)(entry->expiry - now_) <= 0)
+                entry->expiry = now_ + entry->period;
+            Link(*entry, now_ + 1);
+        }
+        else {
+            entry->armed = false;
+            stats_.armed--;
+        }
+        xTaskResumeAll();
+
+        if (callback != nullptr)
+            callback(arg);
+    }
+}
+
+/**
+ * @brief Ticks from the wheel time to the next slot that needs processing, a level 0 expiry or a cascade
+ * @return TIMER_WHEEL_MAX_DELAY_TICKS if the wheel is empty
+ */
+TickType_t TimerWheel::TicksToNextEvent() const
+{
+    TickType_t best = TIMER_WHEEL_MAX_DELAY_TICKS;
+
+    const uint8_t next = NextOccupied(occupied_[0], (uint8_t)((now_ + 1) & SLOT_MASK));
+    if (next < TIMER_WHEEL_SLOTS)
+        best = next + 1;
+
+    // A higher level slot needs cascading once the level below wraps round to it
+    for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        const uint8_t shift = TIMER_WHEEL_SLOT_BITS * level;
+        const uint8_t current = SlotIndex(now_, level);
+        const uint8_t ahead = NextOccupied(occupied_[level], (uint8_t)((current + 1) & SLOT_MASK));
+        if (ahead == TIMER_WHEEL_SLOTS)
+            continue;
+
+        const TickType_t cascadeAt = ((now_ >> shift) + ahead + 1) << shift;
+        if (cascadeAt - now_ < best)
+            best = cascadeAt - now_;
+    }
+    return best;
+}
+
+/**
+ * @brief Consistent copy of the counters
+ */
+TimerWheelStats TimerWheel::GetStats()
+{
+    vTaskSuspendAll();
+    const TimerWheelStats copy = stats_;
+    xTaskResumeAll();
+    return copy;
+}
+
+/**
+ * @brief Prints the wheel counters on the debug console
+ */
+void TimerWheel::PrintStats()
+{
+    const TimerWheelStats s = GetStats();
+    SOAR_PRINT("\n\t-- Timer Wheel --\n");
+    SOAR_PRINT("Armed %u (peak %u), expired %lu, cascaded %lu\n", s.armed, s.peakArmed,
+        (unsigned long)s.expired, (unsigned long)s.cascaded);
+    SOAR_PRINT("Worst expiry lateness: %lu ms\n\n", (unsigned long)TICKS_TO_MS(s.maxLate_ticks));
+}
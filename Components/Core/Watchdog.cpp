@@ -0,0 +1,236 @@
+/**
+ ******************************************************************************
+ * File Name          : Watchdog.cpp
+ * Description        : Per task deadline supervision in front of the IWDG.
+ ******************************************************************************
+*/
+#include "Watchdog.hpp"
+#include <cstring>
+#include "SystemDefines.hpp"
+
+/* Structs -------------------------------------------------------------------*/
+struct WatchdogClient {
+    const char* name;
+    volatile uint32_t deadline_ticks;       // 0 for not supervised
+    uint32_t lastCount;                     // Check-in counter at the last change
+    TickType_t lastSeen;                    // Tick the counter last moved
+};
+
+/* Variables -----------------------------------------------------------------*/
+volatile uint32_t Watchdog::checkIns[WATCHDOG_MAX_CLIENTS] = {};
+
+static WatchdogClient clients[WATCHDOG_MAX_CLIENTS] = {};
+static uint8_t clientCount = 0;
+
+// Supervisor state, only written by Supervise(), copied out in a critical section
+static uint8_t aliveMask = 0;
+static uint32_t worstMargin_ms = UINT32_MAX;
+static bool missRecorded = false;
+
+// Not zeroed by the startup code, survives the IWDG reset
+static WatchdogResetRecord retained __attribute__((section(".noinit")));
+
+static uint32_t resetFlags = 0;             // RCC_CSR at boot
+static bool hasRecord = false;
+static WatchdogResetRecord lastRecord = {};
+
+/* Helpers ------------------------------------------------------------------*/
+static uint32_t RecordCheck(const WatchdogResetRecord& record)
+{
+    uint32_t nameWords[configMAX_TASK_NAME_LEN / sizeof(uint32_t)];
+    memcpy(nameWords, record.name, sizeof(nameWords));
+
+    uint32_t check = ~record.magic ^ record.overdue_ms ^ record.uptime_ms ^ record.resetCount;
+    for (uint32_t word : nameWords)
+        check ^= word;
+    return check;
+}
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Latches the reset flags and the retained record of the last reset, clears both for the next one
+ */
+void Watchdog::CheckResetCause()
+{
+    resetFlags = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    const bool recordValid = (retained.magic == WATCHDOG_RECORD_MAGIC) && (retained.check == RecordCheck(retained));
+    hasRecord = recordValid && (resetFlags & RCC_CSR_IWDGRSTF);
+    if (hasRecord)
+        lastRecord = retained;
+
+    // Keep only the count, so consecutive watchdog resets can be told apart from a one off
+    retained = {};
+    retained.resetCount = hasRecord ? lastRecord.resetCount : 0;
+}
+
+/**
+ * @brief Adds a task to the supervision, call before the scheduler starts
+ * @param name Task name, must outlive the task
+ * @param deadline_ms Longest time between check-ins, 0 to register without supervising
+ * @return Id to check in with
+ */
+WatchdogId Watchdog::Register(const char* name, uint32_t deadline_ms)
+{
+    SOAR_ASSERT(clientCount < WATCHDOG_MAX_CLIENTS, "Watchdog, too many clients for %s", name);
+
+    WatchdogClient& client = clients[clientCount];
+    client.name = name;
+    client.deadline_ticks = MS_TO_TICKS(deadline_ms);
+    client.lastCount = checkIns[clientCount];
+    client.lastSeen = 0;
+    return clientCount++;
+}
+
+/**
+ * @brief Changes a deadline, a single word store so safe while the supervisor runs
+ */
+void Watchdog::SetDeadline(WatchdogId id, uint32_t deadline_ms)
+{
+    clients[id].deadline_ticks = MS_TO_TICKS(deadline_ms);
+}
+
+/**
+ * @brief Starts the IWDG, from then on Supervise() has to be called within WATCHDOG_IWDG_TIMEOUT_MS
+ */
+void Watchdog::Start()
+{
+    // Stop the IWDG while a debugger has the core halted
+    RCC->APBENR1 |= RCC_APBENR1_DBGEN;
+    (void)RCC->APBENR1;    // Clock enable takes effect before the first register write
+    DBG->APBFZ1 |= DBG_APB_FZ1_DBG_IWDG_STOP;
+
+    IWDG->KR = 0xCCCC;                          // Start, also turns the LSI on
+    IWDG->KR = 0x5555;                          // Unlock PR and RLR
+    IWDG->PR = IWDG_PR_PR_0 | IWDG_PR_PR_1;     // LSI / 32
+    IWDG->RLR = WATCHDOG_IWDG_TIMEOUT_MS;
+    while (IWDG->SR != 0) {}
+    IWDG->KR = 0xAAAA;
+}
+
+/**
+ * @brief Compares every client's check-ins against its deadline, refreshes the IWDG if all are alive
+ *        On the first miss the task is written to the retained record and the IWDG is left to reset.
+ * @return true if the IWDG was refreshed
+ */
+bool Watchdog::Supervise()
+{
+    const TickType_t now = xTaskGetTickCount();
+    uint8_t alive = 0;
+    int8_t missed = -1;
+    uint32_t margin_ms = UINT32_MAX;
+
+    for (uint8_t i = 0; i < clientCount; i++) {
+        WatchdogClient& client = clients[i];
+        const uint32_t count = checkIns[i];
+        if (count != client.lastCount) {
+            client.lastCount = count;
+            client.lastSeen = now;
+        }
+
+        const uint32_t deadline = client.deadline_ticks;
+        const uint32_t age = now - client.lastSeen;
+        if (deadline == 0 || age <= deadline) {
+            alive |= (1 << i);
+            if (deadline != 0 && TICKS_TO_MS(deadline - age) < margin_ms)
+                margin_ms = TICKS_TO_MS(deadline - age);
+        }
+        else if (missed < 0) {
+            missed = i;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    aliveMask = alive;
+    worstMargin_ms = (margin_ms < worstMargin_ms) ? margin_ms : worstMargin_ms;
+    taskEXIT_CRITICAL();
+
+    if (missed < 0) {
+        IWDG->KR = 0xAAAA;
+        return true;
+    }
+
+    if (!missRecorded) {
+        missRecorded = true;
+        const WatchdogClient& client = clients[missed];
+        strncpy(retained.name, client.name, sizeof(retained.name) - 1);
+        retained.name[sizeof(retained.name) - 1] = '\0';
+        retained.overdue_ms = TICKS_TO_MS(now - client.lastSeen);
+        retained.uptime_ms = TICKS_TO_MS(now);
+        retained.resetCount++;
+        retained.magic = WATCHDOG_RECORD_MAGIC;
+        retained.check = RecordCheck(retained);
+
+        SOAR_PRINT("Watchdog, %s missed its deadline by %lu ms, resetting\n", client.name,
+            (unsigned long)(retained.overdue_ms - TICKS_TO_MS(client.deadline_ticks)));
+    }
+    return false;
+}
+
+/**
+ * @brief Cause of the last reset, from the flags latched by CheckResetCause()
+ */
+const char* Watchdog::GetResetCause()
+{
+    // The NRST pin flag is set by every internal reset as well, so it's checked last
+    if (resetFlags & RCC_CSR_IWDGRSTF)
+        return hasRecord ? "Watchdog, task deadline missed" : "Watchdog, supervisor stalled";
+    if (resetFlags & RCC_CSR_WWDGRSTF)
+        return "Window watchdog";
+    if (resetFlags & RCC_CSR_LPWRRSTF)
+        return "Low power";
+    if (resetFlags & RCC_CSR_SFTRSTF)
+        return "Software";
+    if (resetFlags & RCC_CSR_OBLRSTF)
+        return "Option byte load";
+    if (resetFlags & RCC_CSR_PWRRSTF)
+        return "Power on / brownout";
+    if (resetFlags & RCC_CSR_PINRSTF)
+        return "Reset pin";
+    return "Unknown";
+}
+
+/**
+ * @brief Consistent copy of the supervision state and the last reset, safe from any task
+ */
+WatchdogStatus Watchdog::GetStatus()
+{
+    WatchdogStatus status = {};
+    status.clientCount = clientCount;
+    status.resetCause = GetResetCause();
+    status.hasRecord = hasRecord;
+    status.record = lastRecord;
+
+    taskENTER_CRITICAL();
+    status.aliveMask = aliveMask;
+    status.worstMargin_ms = worstMargin_ms;
+    taskEXIT_CRITICAL();
+    return status;
+}
+
+/**
+ * @brief Prints the supervised tasks and the last reset on the debug console
+ */
+void Watchdog::PrintStatus()
+{
+    const WatchdogStatus s = GetStatus();
+    const TickType_t now = xTaskGetTickCount();
+
+    SOAR_PRINT("\n\t-- Watchdog (IWDG %lu ms) --\n", (unsigned long)WATCHDOG_IWDG_TIMEOUT_MS);
+    SOAR_PRINT("Last reset: %s\n", s.resetCause);
+    if (s.hasRecord)
+        SOAR_PRINT("  %s, %lu ms since its check-in at %lu ms uptime, %lu in a row\n", s.record.name,
+            (unsigned long)s.record.overdue_ms, (unsigned long)s.record.uptime_ms, (unsigned long)s.record.resetCount);
+
+    SOAR_PRINT("Task             Deadline   Last check-in\n");
+    for (uint8_t i = 0; i < s.clientCount; i++) {
+        if (clients[i].deadline_ticks == 0) {
+            SOAR_PRINT("%-16s        -\n", clients[i].name);
+            continue;
+        }
+        SOAR_PRINT("%-16s %5lu ms   %5lu ms ago%s\n", clients[i].name, (unsigned long)TICKS_TO_MS(clients[i].deadline_ticks),
+            (unsigned long)TICKS_TO_MS(now - clients[i].lastSeen), (s.aliveMask & (1 << i)) ? "" : "  MISSED");
+    }
+    SOAR_PRINT("Closest to a deadline: %lu ms to spare\n\n", (unsigned long)s.worstMargin_ms);
+}
@@ -9,68 +9,350 @@
 #include "CommandMessage.hpp"
 #include "WriteBufferFixedSize.h"
 #include "GPIO.hpp"
+#include "Clock.hpp"
+#include "FastProtection.hpp"
+
+/* Tables ------------------------------------------------------------------*/
+// Indexed by BatteryState
+static constexpr BatteryStateEntry STATE_TABLE[BS_NONE] = {
+    // State            OnEnter                 OnExit
+    { BS_IDLE,          BA_FETS_OFF,            BA_NONE },
+    { BS_CHARGING,      BA_CHARGE_FET_ON,       BA_FETS_OFF },
+    { BS_DISCHARGING,   BA_DISCHARGE_FET_ON,    BA_FETS_OFF },
+    { BS_FAULT,         BA_FETS_OFF,            BA_CLEAR_FAULTS },
+};
+
+// Indexed by [BatteryState][BatteryEvent], next == state handles the event in place
+static constexpr BatteryTransition TRANSITION_TABLE[BS_NONE][BE_COUNT] = {
+    {   // State            Event                   Guard                   Next
+        { BS_IDLE,          BE_PROTECTION_FAULT,    BG_NONE,                BS_FAULT },
+        { BS_IDLE,          BE_CHARGE_INHIBIT,      BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_START_CHARGE,        BG_NO_ACTIVE_FAULTS,    BS_CHARGING },
+        { BS_IDLE,          BE_START_DISCHARGE,     BG_NO_ACTIVE_FAULTS,    BS_DISCHARGING },
+        { BS_IDLE,          BE_STOP,                BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_CLEAR_FAULT,         BG_NONE,                BS_IDLE },
+        // Substate events, the substates that care have their own rows
+        { BS_IDLE,          BE_PRECHARGE_DONE,      BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_CV_REACHED,          BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_CHARGE_TERMINATED,   BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_RECHARGE,            BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_IMBALANCED,          BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_BALANCED,            BG_NONE,                BS_IDLE },
+        { BS_IDLE,          BE_RESERVE,             BG_NONE,                BS_IDLE },
+    },
+    {
+        { BS_CHARGING,      BE_PROTECTION_FAULT,    BG_NONE,                BS_FAULT },
+        { BS_CHARGING,      BE_CHARGE_INHIBIT,      BG_NONE,                BS_IDLE },
+        { BS_CHARGING,      BE_START_CHARGE,        BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_START_DISCHARGE,     BG_NO_ACTIVE_FAULTS,    BS_DISCHARGING },
+        { BS_CHARGING,      BE_STOP,                BG_NONE,                BS_IDLE },
+        { BS_CHARGING,      BE_CLEAR_FAULT,         BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_PRECHARGE_DONE,      BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_CV_REACHED,          BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_CHARGE_TERMINATED,   BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_RECHARGE,            BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_IMBALANCED,          BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_BALANCED,            BG_NONE,                BS_CHARGING },
+        { BS_CHARGING,      BE_RESERVE,             BG_NONE,                BS_CHARGING },
+    },
+    {
+        { BS_DISCHARGING,   BE_PROTECTION_FAULT,    BG_NONE,                BS_FAULT },
+        { BS_DISCHARGING,   BE_CHARGE_INHIBIT,      BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_START_CHARGE,        BG_NO_ACTIVE_FAULTS,    BS_CHARGING },
+        { BS_DISCHARGING,   BE_START_DISCHARGE,     BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_STOP,                BG_NONE,                BS_IDLE },
+        { BS_DISCHARGING,   BE_CLEAR_FAULT,         BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_PRECHARGE_DONE,      BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_CV_REACHED,          BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_CHARGE_TERMINATED,   BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_RECHARGE,            BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_IMBALANCED,          BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_BALANCED,            BG_NONE,                BS_DISCHARGING },
+        { BS_DISCHARGING,   BE_RESERVE,             BG_NONE,                BS_DISCHARGING },
+    },
+    {   // Only a clear with the limits back in range leaves Fault
+        { BS_FAULT,         BE_PROTECTION_FAULT,    BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_CHARGE_INHIBIT,      BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_START_CHARGE,        BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_START_DISCHARGE,     BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_STOP,                BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_CLEAR_FAULT,         BG_NO_ACTIVE_FAULTS,    BS_IDLE },
+        { BS_FAULT,         BE_PRECHARGE_DONE,      BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_CV_REACHED,          BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_CHARGE_TERMINATED,   BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_RECHARGE,            BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_IMBALANCED,          BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_BALANCED,            BG_NONE,                BS_FAULT },
+        { BS_FAULT,         BE_RESERVE,             BG_NONE,                BS_FAULT },
+    },
+};
+
+static_assert(StateTable::IsComplete(STATE_TABLE), "STATE_TABLE must have one row per BatteryState, in order");
+static_assert(StateTable::IsComplete(TRANSITION_TABLE), "TRANSITION_TABLE must handle every BatteryState/BatteryEvent pair, in order");
+
+// Indexed by BatterySubstate
+static constexpr BatterySubstateEntry SUBSTATE_TABLE[BSS_COUNT] = {
+    // Substate                 Parent              OnEnter     OnExit      Work
+    { BSS_IDLE,                 BS_IDLE,            BA_NONE,    BA_NONE,    BW_RUNTIME },
+    { BSS_PRECHARGE,            BS_CHARGING,        BA_NONE,    BA_NONE,    BW_CHARGE },
+    { BSS_CONSTANT_CURRENT,     BS_CHARGING,        BA_NONE,    BA_NONE,    BW_CHARGE },
+    { BSS_CONSTANT_VOLTAGE,     BS_CHARGING,        BA_NONE,    BA_NONE,    BW_CHARGE | BW_BALANCE },
+    { BSS_TOP_OFF,              BS_CHARGING,        BA_NONE,    BA_NONE,    BW_CHARGE },
+    { BSS_BALANCING,            BS_CHARGING,        BA_NONE,    BA_NONE,    BW_CHARGE | BW_BALANCE },
+    { BSS_DISCHARGE,            BS_DISCHARGING,     BA_NONE,    BA_NONE,    BW_RUNTIME },
+    { BSS_DISCHARGE_RESERVE,    BS_DISCHARGING,     BA_NONE,    BA_NONE,    BW_RUNTIME | BW_RUNTIME_EVERY_SAMPLE },
+    { BSS_FAULT,                BS_FAULT,           BA_NONE,    BA_NONE,    0 },
+};
+
+// Substate entered with its parent, indexed by BatteryState
+static constexpr BatterySubstate INITIAL_SUBSTATE[BS_NONE] = { BSS_IDLE, BSS_PRECHARGE, BSS_DISCHARGE, BSS_FAULT };
+
+// Only what the substates handle themselves, every other event goes to the parent's row above
+static constexpr BatterySubstateTransition SUBSTATE_TRANSITION_TABLE[] = {
+    // Substate                 Event                   Guard       Next
+    { BSS_PRECHARGE,            BE_PRECHARGE_DONE,      BG_NONE,    BSS_CONSTANT_CURRENT },
+    { BSS_CONSTANT_CURRENT,     BE_CV_REACHED,          BG_NONE,    BSS_CONSTANT_VOLTAGE },
+    { BSS_CONSTANT_VOLTAGE,     BE_CHARGE_TERMINATED,   BG_NONE,    BSS_TOP_OFF },
+    { BSS_TOP_OFF,              BE_RECHARGE,            BG_NONE,    BSS_CONSTANT_CURRENT },
+    { BSS_TOP_OFF,              BE_IMBALANCED,          BG_NONE,    BSS_BALANCING },
+    { BSS_BALANCING,            BE_RECHARGE,            BG_NONE,    BSS_CONSTANT_CURRENT },
+    { BSS_BALANCING,            BE_BALANCED,            BG_NONE,    BSS_TOP_OFF },
+    { BSS_DISCHARGE,            BE_RESERVE,             BG_NONE,    BSS_DISCHARGE_RESERVE },
+};
+
+static constexpr StateTableIndex<BSS_COUNT, BE_COUNT> SUBSTATE_INDEX(SUBSTATE_TRANSITION_TABLE);
+
+// Indexed by BatteryRemoteCommand, what an operator may ask for and from where
+static constexpr BatteryRemoteEntry REMOTE_TABLE[BRC_COUNT] = {
+    // Command          Event                   Target          Allowed from
+    { BRC_CHARGE,       BE_START_CHARGE,        BS_CHARGING,    StateBit(BS_IDLE) | StateBit(BS_DISCHARGING) },
+    { BRC_DISCHARGE,    BE_START_DISCHARGE,     BS_DISCHARGING, StateBit(BS_IDLE) | StateBit(BS_CHARGING) },
+    { BRC_IDLE,         BE_STOP,                BS_IDLE,        StateBit(BS_CHARGING) | StateBit(BS_DISCHARGING) },
+    { BRC_CLEAR_FAULT,  BE_CLEAR_FAULT,         BS_IDLE,        StateBit(BS_FAULT) },
+    { BRC_FORCE_SAFE,   BE_PROTECTION_FAULT,    BS_FAULT,       StateBit(BS_IDLE) | StateBit(BS_CHARGING) | StateBit(BS_DISCHARGING) },
+};
 
-/* Battery State Machine ------------------------------------------------------------------*/
 /**
- * @brief Default constructor for Battery SM, initializes all states
+ * @brief Every allowed command has to be a transition to its target in TRANSITION_TABLE, so the two can't drift apart
  */
-BatterySM::BatterySM(BatteryState startingState, bool enterStartingState)
+static constexpr bool IsRemoteTableValid()
 {
-    // Setup the internal array of states. Setup in order of enum.
-    stateArray[BS_IDLE] = new Idle();
-    stateArray[BS_CHARGING] = new Charging();
-    stateArray[BS_DISCHARGING] = new Discharging();
-    stateArray[BS_FAULT] = new Fault();
-
-    // Verify all states are initialized AND state IDs are consistent
-    for (uint8_t i = 0; i < BS_NONE; i++) {
-        SOAR_ASSERT(stateArray[i] != nullptr);
-        SOAR_ASSERT(stateArray[i]->GetStateID() == i);
+    for (uint8_t c = 0; c < BRC_COUNT; c++) {
+        if (REMOTE_TABLE[c].command != c)
+            return false;
+        for (uint8_t s = 0; s < BS_NONE; s++) {
+            if ((REMOTE_TABLE[c].allowedStates & StateBit((BatteryState)s)) && TRANSITION_TABLE[s][REMOTE_TABLE[c].event].next != REMOTE_TABLE[c].target)
+                return false;
+        }
     }
+    return true;
+}
+
+static_assert(IsRemoteTableValid(), "REMOTE_TABLE must have one row per BatteryRemoteCommand, in order, and agree with TRANSITION_TABLE");
+static_assert(REMOTE_TABLE[BATTERY_ABORT_COMMAND].target == BS_FAULT
+    && (REMOTE_TABLE[BATTERY_ABORT_COMMAND].allowedStates | StateBit(BS_FAULT)) == StateBit(BS_NONE) - 1,
+    "An abort must reach Fault from every state");
+
+static_assert(StateTable::IsComplete(SUBSTATE_TABLE, BS_NONE), "SUBSTATE_TABLE must have one row per BatterySubstate, in order");
+static_assert(StateTable::IsNested(SUBSTATE_TABLE, SUBSTATE_TRANSITION_TABLE), "Substate transitions must stay within their parent and be unique");
+static_assert(StateTable::IsInitialValid(SUBSTATE_TABLE, INITIAL_SUBSTATE), "Each state's initial substate must belong to it");
 
-    bs_currentState = stateArray[startingState];
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Logs one step of a transition with the time, so the entry/exit order can be checked
+ */
+static void LogTransitionStep(const char* step, const char* name)
+{
+    SOAR_PRINT("[%lu ms]   %s %s\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()), step, name);
+}
+
+/* Battery State Machine ------------------------------------------------------------------*/
+/**
+ * @brief Constructor for Battery SM, all storage is in the object and the tables are in flash
+ * @param startingState State to start in
+ * @param enterStartingState True runs the starting state's entry action
+ */
+BatterySM::BatterySM(BatteryState startingState, bool enterStartingState)
+{
+    SOAR_ASSERT(startingState < BS_NONE, "Invalid starting state");
+
+    state_ = startingState;
+    substate_ = INITIAL_SUBSTATE[startingState];
+    fetRegister_ = 0;    // FETs stay open until a state's entry action closes them
+    lastFaultMask_ = 0;
+    packVoltage_mV_ = 0;
+    minCellVoltage_mV_ = 0;
+    lastSample_us_ = 0;
+    lastRemote_us_ = 0;
+    hasRemote_ = false;
+    PublishChargeSetpoint();    // Make sure the charger starts from our setpoint
+    journal_.Start(Clock::Micros());
 
     // If we need to run OnEnter for the starting state, do so
     if (enterStartingState) {
-        bs_currentState->OnEnter();
+        RunAction(STATE_TABLE[state_].onEnter);
+        RunAction(SUBSTATE_TABLE[substate_].onEnter);
     }
 
-    SOAR_PRINT("Battery State Machine Started in [ %s ] state\n", BaseBatteryState::StateToString(bs_currentState->GetStateID()));
+    SOAR_PRINT("Battery State Machine Started in [ %s.%s ] state\n", StateToString(state_), SubstateToString(substate_));
+}
+
+/**
+ * @brief Looks the event up in the transition tables and takes the transition if its guard passes
+ *        The substate gets the first look; with no row, or a failed guard, the event goes to the parent.
+ * @param event The event to handle
+ * @return The state after the event
+ */
+BatteryState BatterySM::Dispatch(BatteryEvent event)
+{
+    if (event >= BE_COUNT)
+        return state_;
+
+    const uint8_t row = SUBSTATE_INDEX.row[substate_][event];
+    if (row != SUBSTATE_INDEX.INHERIT && CheckGuard(SUBSTATE_TRANSITION_TABLE[row].guard)) {
+        TransitionSubstate(SUBSTATE_TRANSITION_TABLE[row].next, event);
+        return state_;
+    }
+
+    const BatteryTransition& transition = TRANSITION_TABLE[state_][event];
+    if (transition.next == state_ || !CheckGuard(transition.guard))
+        return state_;
+
+    return TransitionState(transition.next, event);
 }
 
 /**
  * @brief Handles state transitions
  * @param nextState The next state to transition to
+ * @param event The event that triggered the transition, for the journal
  * @return The state after the transition
  */
-BatteryState BatterySM::TransitionState(BatteryState nextState)
+BatteryState BatterySM::TransitionState(BatteryState nextState, BatteryEvent event)
 {
     // Check if we're already in the next state (TransitionState does not allow entry into the existing state)
-    if (nextState == bs_currentState->GetStateID())
-        return bs_currentState->GetStateID();
+    if (nextState == state_)
+        return state_;
 
     // Check the next state is valid
     if (nextState >= BS_NONE)
-        return bs_currentState->GetStateID();
+        return state_;
+
+    const BatterySubstate nextSubstate = INITIAL_SUBSTATE[nextState];
+    journal_.Record(Clock::Micros(), event, lastFaultMask_, state_, substate_, nextState, nextSubstate);
+    SOAR_PRINT("[%lu ms] BATTERY STATE TRANSITION [ %s.%s ] --> [ %s.%s ]\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()),
+        StateToString(state_), SubstateToString(substate_), StateToString(nextState), SubstateToString(nextSubstate));
+
+    // Innermost exits first, outermost entries first
+    LogTransitionStep("exit substate", SubstateToString(substate_));
+    RunAction(SUBSTATE_TABLE[substate_].onExit);
+    LogTransitionStep("exit state", StateToString(state_));
+    RunAction(STATE_TABLE[state_].onExit);
 
-    BatteryState previousState = bs_currentState->GetStateID();
+    state_ = nextState;
+    substate_ = nextSubstate;
 
-    // Exit the current state
-    bs_currentState->OnExit();
+    LogTransitionStep("enter state", StateToString(state_));
+    RunAction(STATE_TABLE[state_].onEnter);
+    LogTransitionStep("enter substate", SubstateToString(substate_));
+    RunAction(SUBSTATE_TABLE[substate_].onEnter);
+
+    // Return the state after the transition
+    return state_;
+}
 
-    // Set the next state
-    bs_currentState = stateArray[nextState];
+/**
+ * @brief Moves between substates of the current state, the parent is neither exited nor entered
+ * @param nextSubstate The substate to move to, always a sibling (checked when the table is built)
+ * @param event The event that triggered the transition, for the journal
+ */
+void BatterySM::TransitionSubstate(BatterySubstate nextSubstate, BatteryEvent event)
+{
+    if (nextSubstate == substate_)
+        return;
 
-    // Assert the next state is initalized
-    SOAR_ASSERT(bs_currentState != nullptr, "bs_currentState is nullptr in TransitionState");
+    journal_.Record(Clock::Micros(), event, lastFaultMask_, state_, substate_, state_, nextSubstate);
 
-    // Enter the current state
-    bs_currentState->OnEnter();
+    SOAR_PRINT("[%lu ms] BATTERY SUBSTATE TRANSITION [ %s.%s ] --> [ %s.%s ]\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()),
+        StateToString(state_), SubstateToString(substate_), StateToString(state_), SubstateToString(nextSubstate));
 
-    SOAR_PRINT("BATTERY STATE TRANSITION [ %s ] --> [ %s ]\n", BaseBatteryState::StateToString(previousState), BaseBatteryState::StateToString(bs_currentState->GetStateID()));
+    LogTransitionStep("exit substate", SubstateToString(substate_));
+    RunAction(SUBSTATE_TABLE[substate_].onExit);
+    substate_ = nextSubstate;
+    LogTransitionStep("enter substate", SubstateToString(substate_));
+    RunAction(SUBSTATE_TABLE[substate_].onEnter);
+}
 
-    // Return the state after the transition
-    return bs_currentState->GetStateID();
+/**
+ * @brief Raises the estimator driven events, only those the current substate has a row for are checked
+ *        At most one is raised per sample so each substate sees at least one sample.
+ * @param cells Cell statistics for the sample
+ */
+void BatterySM::RaiseSubstateEvents(const CellStats& cells)
+{
+    const uint32_t handled = SUBSTATE_INDEX.handled[substate_];
+    if (handled == 0)
+        return;
+
+    auto wants = [handled](BatteryEvent event) { return (handled & (1UL << event)) != 0; };
+
+    // Bleeding pulls the high cells down, the spread only counts on a sample with nothing bled before it
+    const bool relaxed = balancePlanner_.IsRelaxedSample();
+
+    if (wants(BE_PRECHARGE_DONE) && cells.min_mV >= CHARGE_PRECHARGE_CELL_MV)
+        Dispatch(BE_PRECHARGE_DONE);
+    else if (wants(BE_CV_REACHED) && chargeController_.IsConstantVoltage())
+        Dispatch(BE_CV_REACHED);
+    else if (wants(BE_CHARGE_TERMINATED) && chargeController_.IsTerminated())
+        Dispatch(BE_CHARGE_TERMINATED);
+    else if (wants(BE_RECHARGE) && !chargeController_.IsTerminated())
+        Dispatch(BE_RECHARGE);
+    else if (wants(BE_IMBALANCED) && relaxed && cells.spread_mV > BALANCE_START_DELTA_MV)
+        Dispatch(BE_IMBALANCED);
+    else if (wants(BE_BALANCED) && relaxed && cells.spread_mV <= BALANCE_STOP_DELTA_MV)
+        Dispatch(BE_BALANCED);
+    else if (wants(BE_RESERVE) && socEstimator_.GetStateOfChargeQ15() < BATTERY_RESERVE_SOC_Q15)
+        Dispatch(BE_RESERVE);
+}
+
+/**
+ * @brief Evaluates a transition guard
+ * @param guard The guard
+ * @return True if the transition may be taken
+ */
+bool BatterySM::CheckGuard(BatteryGuard guard) const
+{
+    switch (guard) {
+    case BG_NONE:
+        return true;
+    case BG_NO_ACTIVE_FAULTS:
+        return lastFaultMask_ == 0;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Runs an entry or exit action
+ * @param action The action
+ */
+void BatterySM::RunAction(BatteryAction action)
+{
+    switch (action) {
+    case BA_FETS_OFF:
+        fetRegister_ = 0;
+        break;
+    case BA_CHARGE_FET_ON:
+        fetRegister_ = BMS_FET_CHG;
+        break;
+    case BA_DISCHARGE_FET_ON:
+        fetRegister_ = BMS_FET_DSG;
+        break;
+    case BA_CLEAR_FAULTS:
+        protection_.ClearLatchedFaults();
+        break;
+    default:
+        break;
+    }
 }
 
 /**
@@ -79,346 +361,405 @@ BatteryState BatterySM::TransitionState(BatteryState nextState)
  */
 void BatterySM::HandleCommand(Command& cm)
 {
-    SOAR_ASSERT(bs_currentState != nullptr, "Command received before state machine initialized");
-
     switch (cm.GetCommand()) {
     case DATA_COMMAND: {
-        BatteryState nextState = bs_currentState->GetStateID(); // Default: no state change
-
         switch (cm.GetTaskCommand()) {
         case BMS_UPDATE: {
             BMSData bms;
             cm.CopyDataFromCommand((uint8_t*)&bms, sizeof(BMSData));
-            nextState = bs_currentState->HandleBMSData(bms); // Returns new state
+
+            // A trip whose notify didn't fit in the queue, handle it before anything can close the FETs
+            FastProtection::CheckSample(bms.sysStat);
+            if (FastProtection::IsLatched())
+                HandleAlert();
+
+            // Reduce the cells once, every consumer below shares the result
+            const CellStats cells = CellStats::Compute(bms.cellVoltage_mV);
+            UpdateEstimators(bms, cells);
+            packVoltage_mV_ = bms.packVoltage_mV;
+            minCellVoltage_mV_ = cells.min_mV;
+            lastSample_us_ = Clock::Micros();
+
+            // Protection runs identically in every state, the transition table decides what its event does
+            const ProtectionResult protection = protection_.Evaluate(bms, cells, coulombCounter_.GetCurrent(), state_);
+            lastFaultMask_ = protection.faultMask;
+
+            // A tripped limit takes priority over the substate's progress for this sample
+            if (protection.event != BE_NONE)
+                Dispatch(protection.event);
+            else
+                RaiseSubstateEvents(cells);
             break;
         }
         case CHARGER_UPDATE: {
             ChargerData charger;
             cm.CopyDataFromCommand((uint8_t*)&charger, sizeof(ChargerData));
-            nextState = bs_currentState->HandleChargerData(charger); // Returns new state
+            protection_.UpdateCharger(charger);
             break;
         }
         case FUEL_GAUGE_UPDATE: {
             FuelGaugeData fuel_gauge;
             cm.CopyDataFromCommand((uint8_t*)&fuel_gauge, sizeof(FuelGaugeData));
-            nextState = bs_currentState->HandleFuelGaugeData(fuel_gauge); // Returns new state
+            protection_.UpdateFuelGauge(fuel_gauge);
+            break;
+        }
+        case BMS_ALERT: {
+            HandleAlert();
             break;
         }
         default:
             SOAR_PRINT("BatterySM - Unknown DATA_COMMAND TaskCommand: %d\n", cm.GetTaskCommand());
             break;
         }
+        break;
     }
-    }
-}
-
-/**
- * @brief Gets the current battery state as a proto enum
- * @return Current battery state
- */
-Proto::BatteryState BatterySM::GetBatteryStateAsProto()
-{
-    switch (bs_currentState->GetStateID()) {
-    case BS_IDLE:
-        return Proto::BatteryState::BS_IDLE;
-    case BS_CHARGING:
-        return Proto::BatteryState::BS_CHARGING;
-    case BS_DISCHARGING:
-        return Proto::BatteryState::BS_DISCHHARGING;
-    case BS_FAULT:
-        return Proto::BatteryState::BS_FAULT;
     default:
-        return Proto::BatteryState::BS_NONE;
+        break;
     }
 }
 
-/* PreLaunch State ------------------------------------------------------------------*/
-/**
- * @brief PreLaunch state constructor
- */
-Idle::Idle()
-{
-    bsStateID = BS_IDLE;
-}
-
 /**
- * @brief Entry to Idle state
- * @return The state we're entering
+ * @brief Handles an operator command, checked against REMOTE_TABLE and rate limited, then dispatched like any event
+ *        Charge and discharge are refused while a fast protection trip is latched, they would close the FETs it opened.
+ * @param command BatteryRemoteCommand, anything else is answered with BRR_UNKNOWN_COMMAND
+ * @return What happened and the state it left the machine in
  */
-BatteryState Idle::OnEnter()
+BatteryRemoteAck BatterySM::HandleRemoteCommand(uint16_t command)
 {
-	// CHG/DSG FETs OFF
+    BatteryRemoteResult result;
+    const uint64_t now_us = Clock::Micros();
 
-    return bsStateID;
-}
-
-/**
- * @brief Exit from Idle state
- * @return The state we're exiting
- */
-BatteryState Idle::OnExit()
-{
-    // We don't do anything upon exiting idle
-
-    return bsStateID;
-}
-
-/**
- * @brief Handles BMS data from Idle state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Idle::HandleBMSData(const BMSData& bms)
-{
-    // Check for faults
-	// Check voltage
-	// Check current
-	// etc...
-    return currentState;
-}
+    if (command >= BRC_COUNT) {
+        result = BRR_UNKNOWN_COMMAND;
+    }
+    else {
+        const BatteryRemoteEntry& entry = REMOTE_TABLE[command];
+        if (state_ == entry.target)
+            result = BRR_ALREADY_IN_STATE;
+        else if ((entry.allowedStates & StateBit(state_)) == 0)
+            result = BRR_NOT_ALLOWED;
+        else if ((command == BRC_CHARGE || command == BRC_DISCHARGE) && FastProtection::IsLatched())
+            result = BRR_PROTECTION_LATCHED;
+        else if (command != BRC_FORCE_SAFE && hasRemote_ && now_us - lastRemote_us_ < (uint64_t)BATTERY_REMOTE_MIN_INTERVAL_MS * 1000)
+            result = BRR_RATE_LIMITED;
+        else if (Dispatch(entry.event) != entry.target)
+            result = BRR_GUARD_FAILED;
+        else
+            result = BRR_ACCEPTED;
+
+        if (result == BRR_ACCEPTED) {
+            lastRemote_us_ = now_us;
+            hasRemote_ = true;
+        }
+    }
 
-/**
- * @brief Handles charger data from Idle state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Idle::HandleChargerData(const ChargerData& charger)
-{
-    // Check stuff
-	// etc...
-    return currentState;
-}
+    BatteryRemoteAck ack;
+    ack.command = (uint8_t)command;
+    ack.result = (uint8_t)result;
+    ack.state = (uint8_t)state_;
+    ack.substate = (uint8_t)substate_;
+    ack.sequence = journal_.GetSequence();
 
-/**
- * @brief Handles fuel gauge data from Idle state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Idle::HandleFuelGaugeData(const FuelGaugeData& fuel_gauge)
-{
-    // Check stuff
-	// etc...
-    return currentState;
+    SOAR_PRINT("[%lu ms] BATTERY REMOTE %s: %s, now [ %s.%s ]\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()),
+        RemoteCommandToString(command), RemoteResultToString(result), StateToString(state_), SubstateToString(substate_));
+    return ack;
 }
 
-/* Charging State ------------------------------------------------------------------*/
 /**
- * @brief Charging state constructor
+ * @brief The ALERT interrupt already switched to umbilical power, catch the state machine up
+ *        The SYS_STAT bits behind it show up on the next sample, until they're gone Fault can't be cleared.
  */
-Charging::Charging()
+void BatterySM::HandleAlert()
 {
-    bsStateID = BS_CHARGING;
+    lastFaultMask_ |= 1UL << PROT_BMS_HARDWARE_FAULT;
+    protection_.LatchFaults(1UL << PROT_BMS_HARDWARE_FAULT);
+    Dispatch(BE_PROTECTION_FAULT);
+    FastProtection::Acknowledge();
 }
 
 /**
- * @brief Entry to Charging state
- * @return The state we're entering
+ * @brief FET bits for SYS_CTRL2, both open while a fast protection trip is waiting to be handled
  */
-BatteryState Charging::OnEnter()
+uint8_t BatterySM::GetFetRegister() const
 {
-	// CHG FET On
-	// DSG FET Off
-
-    return bsStateID;
+    return FastProtection::IsLatched() ? 0 : fetRegister_;
 }
 
 /**
- * @brief Exit from Charging state
- * @return The state we're exiting
+ * @brief Runs the estimators on a new BMS sample, the substate's work flags gate the optional ones
+ * @param bms The BMS sample
+ * @param cells Cell statistics for the sample
  */
-BatteryState Charging::OnExit()
+void BatterySM::UpdateEstimators(const BMSData& bms, const CellStats& cells)
 {
-    // CHG FET Off
+    const uint8_t work = SUBSTATE_TABLE[substate_].flags;
 
-    return bsStateID;
-}
-
-/**
- * @brief Handles BMS data from Charging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Charging::HandleBMSData(const BMSData& bms)
-{
-    // Check for faults
-	// Check voltage
-	// Check current
-	// etc...
-    return currentState;
-}
+    // With both FETs open (Idle and Fault) the CC reading is pure offset
+    coulombCounter_.Update(bms.ccReading, Millivolts(cells.mean_mV), bms.temperature_dC, fetRegister_ == 0);
+    const Milliamps current = coulombCounter_.GetCurrent();
 
-/**
- * @brief Handles charger data from Charging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Charging::HandleChargerData(const ChargerData& charger)
-{
-    // Check stuff
-	// etc...
-    return currentState;
-}
+    // The EKF takes the offset corrected current so both estimators see the same input
+    socEstimator_.Update(current, Millivolts(cells.mean_mV));
 
-/**
- * @brief Handles fuel gauge data from Charging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
- */
-BatteryState Charging::HandleFuelGaugeData(const FuelGaugeData& fuel_gauge)
-{
-    // Check stuff
-	// etc...
-    return currentState;
-}
+    // Internal resistance from load switches and charge start/stop
+    resistanceEstimator_.Update(current, bms.cellVoltage_mV, bms.temperature_dC);
 
-/* Discharging State ------------------------------------------------------------------*/
-/**
- * @brief Discharging state constructor
- */
-Discharging::Discharging()
-{
-    bsStateID = BS_DISCHARGING;
-}
+    // Nothing to predict while charging or faulted, close to cutoff both runtimes refresh every sample
+    if (work & BW_RUNTIME) {
+        runtimePredictor_.Update(current, cells, socEstimator_.GetStateOfChargeQ15(),
+            socEstimator_.GetCapacityEstimateMah(), resistanceEstimator_.GetMaxCellResistance(), (work & BW_RUNTIME_EVERY_SAMPLE) != 0);
+    }
 
-/**
- * @brief Entry to Discharging state
- * @return The state we're entering
- */
-BatteryState Discharging::OnEnter()
-{
-	// CHG FET Off
-	// DSG FET On
+    // Passive balancing only runs near the top of charge
+    balancePlanner_.Update(bms.cellVoltage_mV, cells, (work & BW_BALANCE) != 0);
 
-    return bsStateID;
+    // Charger is suspended outside of charging, only flag a write when a register changes
+    if (chargeController_.Update(bms, cells, current, socEstimator_.GetStateOfChargeQ15(), (work & BW_CHARGE) != 0))
+        PublishChargeSetpoint();
 }
 
 /**
- * @brief Exit from Disharging state
- * @return The state we're exiting
+ * @brief Hands the controller's setpoint over to TakeChargeSetpoint, the copy and flag change together
  */
-BatteryState Discharging::OnExit()
+void BatterySM::PublishChargeSetpoint()
 {
-    // CHG FET Off
-	// DSG FET Off
-
-    return bsStateID;
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    chargeSetpoint_ = chargeController_.GetSetpoint();
+    chargeSetpointPending_ = true;
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
 }
 
 /**
- * @brief Handles BMS data from Discharging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Gets the charge setpoint if it changed since the last call, safe from a task other than the FlightTask
+ * @param setpoint Filled with the setpoint to write
+ * @return True if the setpoint changed and should be written to the LTC4015
  */
-BatteryState Discharging::HandleBMSData(const BMSData& bms)
+bool BatterySM::TakeChargeSetpoint(ChargeSetpoint& setpoint)
 {
-    // Check for faults
-	// Check voltage
-	// Check current
-	// etc...
-    return currentState;
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    const bool pending = chargeSetpointPending_;
+    if (pending) {
+        setpoint = chargeSetpoint_;
+        chargeSetpointPending_ = false;
+    }
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
+    return pending;
 }
 
 /**
- * @brief Handles charger data from Discharging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Fills a telemetry snapshot of the battery
+ * @param status Snapshot to fill
  */
-BatteryState Discharging::HandleChargerData(const ChargerData& charger)
+void BatterySM::GetStatus(BatteryStatus& status) const
 {
-    // Check stuff
-	// etc...
-    return currentState;
+    status.state = (uint8_t)state_;
+    status.stateOfCharge_pct = socEstimator_.GetStateOfChargePercent();
+    status.coulombSoc_pct = coulombCounter_.GetStateOfChargePercent();
+
+    // Health is whichever of capacity fade and resistance growth is further along
+    const uint16_t capacitySohQ15 = socEstimator_.GetStateOfHealthQ15();
+    const uint16_t resistanceSohQ15 = resistanceEstimator_.GetStateOfHealthQ15();
+    const uint16_t sohQ15 = (capacitySohQ15 < resistanceSohQ15) ? capacitySohQ15 : resistanceSohQ15;
+    status.stateOfHealth_pct = (uint8_t)(((uint32_t)sohQ15 * 100 + (1 << 14)) >> 15);
+    status.maxCellResistance_uOhm = (uint32_t)resistanceEstimator_.GetMaxCellResistance().Value();
+
+    status.current_mA = coulombCounter_.GetCurrent().Value();
+    status.runtime_s = runtimePredictor_.GetRuntimeSeconds();
+    status.peakRuntime_s = runtimePredictor_.GetPeakRuntimeSeconds();
+    status.faultMask = protection_.GetLatchedFaults();
+    status.balanceMask = balancePlanner_.GetCellMask();
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        status.balanceDuty_pct[i] = balancePlanner_.GetDutyPercent(i);
 }
 
 /**
- * @brief Handles fuel gauge data from Discharging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Prints the journal, oldest entry first, and the dwell histogram of every substate that has one
  */
-BatteryState Discharging::HandleFuelGaugeData(const FuelGaugeData& fuel_gauge)
+void BatterySM::PrintJournal() const
 {
-    // Check stuff
-	// etc...
-    return currentState;
-}
+    SOAR_PRINT("Battery transitions, %u of %u kept\n", journal_.GetCount(), journal_.GetSequence());
+    for (uint8_t age = journal_.GetCount(); age > 0; age--) {
+        BatteryJournalEntry e;
+        journal_.GetEntry(age - 1, e);
+        SOAR_PRINT("  #%u %lu.%06lu s %s: %s.%s --> %s.%s faults 0x%08lx\n", e.sequence,
+            (unsigned long)(e.timestamp_us / 1000000), (unsigned long)(e.timestamp_us % 1000000), EventToString((BatteryEvent)e.event),
+            StateToString((BatteryState)e.fromState), SubstateToString((BatterySubstate)e.fromSubstate),
+            StateToString((BatteryState)e.toState), SubstateToString((BatterySubstate)e.toSubstate), (unsigned long)e.faultMask);
+    }
 
-/* Fault State ------------------------------------------------------------------*/
-/**
- * @brief Fault state constructor
- */
-Fault::Fault()
-{
-    bsStateID = BS_FAULT;
+    SOAR_PRINT("Dwell histograms, bin 0 is <1s, bin n is <2^n s\n");
+    for (uint8_t s = 0; s < BSS_COUNT; s++) {
+        uint32_t total = 0;
+        for (uint8_t b = 0; b < BATTERY_DWELL_BINS; b++)
+            total += journal_.GetDwellCount((BatterySubstate)s, b);
+        if (total == 0)
+            continue;
+
+        SOAR_PRINT("  %-10s", SubstateToString((BatterySubstate)s));
+        for (uint8_t b = 0; b < BATTERY_DWELL_BINS; b++)
+            SOAR_PRINT(" %u", journal_.GetDwellCount((BatterySubstate)s, b));
+        SOAR_PRINT("\n");
+    }
+    SOAR_PRINT("  In %s for %lu s\n", SubstateToString(substate_), (unsigned long)(journal_.GetCurrentDwell_us(Clock::Micros()) / 1000000));
 }
 
 /**
- * @brief Entry to Fault state
- * @return The state we're entering
+ * @brief Gets the current battery state as a proto enum
+ * @return Current battery state
  */
-BatteryState Fault::OnEnter()
+Proto::BatteryState BatterySM::GetBatteryStateAsProto()
 {
-	// CHG FET Off
-	// DSG FET Off
-	// read who threw error
-	// handle fault
-
-    return bsStateID;
+    switch (state_) {
+    case BS_IDLE:
+        return Proto::BatteryState::BS_IDLE;
+    case BS_CHARGING:
+        return Proto::BatteryState::BS_CHARGING;
+    case BS_DISCHARGING:
+        return Proto::BatteryState::BS_DISCHHARGING;
+    case BS_FAULT:
+        return Proto::BatteryState::BS_FAULT;
+    default:
+        return Proto::BatteryState::BS_NONE;
+    }
 }
 
 /**
- * @brief Exit from Fault state
- * @return The state we're exiting
+ * @brief Returns a string for the substate
  */
-BatteryState Fault::OnExit()
+const char* BatterySM::SubstateToString(BatterySubstate substateId)
 {
-	// clear error bits maybe?
-	// or do nothing
-    return bsStateID;
+    switch(substateId) {
+    case BSS_IDLE:
+        return "Idle";
+    case BSS_PRECHARGE:
+        return "Precharge";
+    case BSS_CONSTANT_CURRENT:
+        return "CC";
+    case BSS_CONSTANT_VOLTAGE:
+        return "CV";
+    case BSS_TOP_OFF:
+        return "TopOff";
+    case BSS_BALANCING:
+        return "Balancing";
+    case BSS_DISCHARGE:
+        return "Discharge";
+    case BSS_DISCHARGE_RESERVE:
+        return "Reserve";
+    case BSS_FAULT:
+        return "Fault";
+    default:
+        return "WARNING: Invalid";
+    }
 }
 
 /**
- * @brief Handles BMS data from Fault state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Returns a string for the state
  */
-BatteryState Fault::HandleBMSData(const BMSData& bms)
+const char* BatterySM::StateToString(BatteryState stateId)
 {
-    // Check for faults
-	// Check voltage
-	// Check current
-	// etc...
-    return currentState;
+    switch(stateId) {
+    case BS_IDLE:
+        return "Idle";
+    case BS_CHARGING:
+        return "Charging";
+    case BS_DISCHARGING:
+        return "Discharging";
+    case BS_FAULT:
+        return "Fault";
+    case BS_NONE:
+        return "None";
+    default:
+        return "WARNING: Invalid";
+    }
 }
 
 /**
- * @brief Handles charger data from Discharging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Returns a string for the event
  */
-BatteryState Fault::HandleChargerData(const ChargerData& charger)
+const char* BatterySM::EventToString(BatteryEvent eventId)
 {
-    // Check stuff
-	// etc...
-    return currentState;
+    switch(eventId) {
+    case BE_PROTECTION_FAULT:
+        return "ProtectionFault";
+    case BE_CHARGE_INHIBIT:
+        return "ChargeInhibit";
+    case BE_START_CHARGE:
+        return "StartCharge";
+    case BE_START_DISCHARGE:
+        return "StartDischarge";
+    case BE_STOP:
+        return "Stop";
+    case BE_CLEAR_FAULT:
+        return "ClearFault";
+    case BE_PRECHARGE_DONE:
+        return "PrechargeDone";
+    case BE_CV_REACHED:
+        return "CvReached";
+    case BE_CHARGE_TERMINATED:
+        return "ChargeTerminated";
+    case BE_RECHARGE:
+        return "Recharge";
+    case BE_IMBALANCED:
+        return "Imbalanced";
+    case BE_BALANCED:
+        return "Balanced";
+    case BE_RESERVE:
+        return "Reserve";
+    default:
+        return "WARNING: Invalid";
+    }
 }
 
 /**
- * @brief Handles fuel gauge data from Discharging state
- * @return The rocket state to transition to or stay in. The current rocket state if no transition
+ * @brief Returns a string for an operator command
  */
-BatteryState Fault::HandleFuelGaugeData(const FuelGaugeData& fuel_gauge)
+const char* BatterySM::RemoteCommandToString(uint16_t command)
 {
-    // Check stuff
-	// etc...
-    return currentState;
+    switch (command) {
+    case BRC_CHARGE:
+        return "Charge";
+    case BRC_DISCHARGE:
+        return "Discharge";
+    case BRC_IDLE:
+        return "Idle";
+    case BRC_CLEAR_FAULT:
+        return "ClearFault";
+    case BRC_FORCE_SAFE:
+        return "ForceSafe";
+    default:
+        return "Unknown";
+    }
 }
 
 /**
- * @brief Returns a string for the state
+ * @brief Returns a string for an operator command result
  */
-const char* BaseBatteryState::StateToString(BatteryState stateId)
+const char* BatterySM::RemoteResultToString(BatteryRemoteResult result)
 {
-    switch(stateId) {
-    case BS_IDLE:
-        return "Idle";
-    case BS_CHARGING:
-        return "Charging";
-    case BS_DISCHARGING:
-        return "Discharging";
-    case BS_FAULT:
-        return "Fault";
-    case BS_NONE:
-        return "None";
+    switch (result) {
+    case BRR_ACCEPTED:
+        return "Accepted";
+    case BRR_ALREADY_IN_STATE:
+        return "AlreadyInState";
+    case BRR_NOT_ALLOWED:
+        return "NotAllowed";
+    case BRR_GUARD_FAILED:
+        return "GuardFailed";
+    case BRR_RATE_LIMITED:
+        return "RateLimited";
+    case BRR_UNKNOWN_COMMAND:
+        return "UnknownCommand";
+    case BRR_PROTECTION_LATCHED:
+        return "ProtectionLatched";
     default:
-        return "WARNING: Invalid";
+        return "";
     }
 }
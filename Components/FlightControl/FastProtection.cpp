@@ -0,0 +1,183 @@
+/**
+ ******************************************************************************
+ * File Name          : FastProtection.cpp
+ * Description        : Interrupt driven protection path for the bq769x0 ALERT pin
+ ******************************************************************************
+*/
+#include "FastProtection.hpp"
+#include "SystemDefines.hpp"
+#include "GPIO.hpp"
+#include "CycleCounter.hpp"
+#include "ProtectionEngine.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+#ifndef COMPUTER_ENVIRONMENT
+constexpr uint32_t ALERT_EXTI_LINE = 5;         // BMS_ALERT is PB5
+constexpr uint32_t ALERT_EXTI_PORT = 1;         // EXTICR port code for GPIOB
+static_assert(BMS_ALERT_Pin == (1U << ALERT_EXTI_LINE), "ALERT_EXTI_LINE must match BMS_ALERT_Pin");
+static_assert(ALERT_EXTI_LINE >= 4 && ALERT_EXTI_LINE <= 15, "BMS_ALERT must be on an EXTI4_15 line, that's the handler wired to OnAlert");
+#endif
+
+/* Variables ------------------------------------------------------------------*/
+// Written from the ALERT interrupt, only read whole with interrupts masked
+static FastProtection::NotifyCallback notify = nullptr;
+static volatile bool latched = false;
+static volatile bool synced = false;            // A CC_READY edge has set the grid
+static volatile uint32_t lastSampleTick = 0;
+static volatile uint32_t tripTick = 0;
+static FastProtectionStats stats = {};
+
+// Task side, BMS sample checks
+static uint8_t lastFaultBits = 0;
+static uint16_t tripsAtLastSample = 0;
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Sets who is told about a trip, then arms the ALERT rising edge interrupt
+ *        MX_GPIO_Init leaves BMS_ALERT a plain input, so no edge is taken before there's someone to tell.
+ * @param notifyCallback Called from the ISR after the pack is safe, normally queues BMS_ALERT for BatterySM
+ */
+void FastProtection::Init(NotifyCallback notifyCallback)
+{
+    notify = notifyCallback;
+
+#ifndef COMPUTER_ENVIRONMENT
+    const uint32_t line = 1UL << ALERT_EXTI_LINE;
+    const uint32_t shift = (ALERT_EXTI_LINE % 4) * 8;
+    EXTI->EXTICR[ALERT_EXTI_LINE / 4] = (EXTI->EXTICR[ALERT_EXTI_LINE / 4] & ~(0xFFUL << shift)) | (ALERT_EXTI_PORT << shift);
+    EXTI->RTSR1 |= line;
+    EXTI->FTSR1 &= ~line;
+    EXTI->RPR1 = line;      // Write one to clear, drops an edge from before now
+    EXTI->IMR1 |= line;     // Also what lets ALERT wake STOP1
+
+    NVIC_SetPriority(EXTI4_15_IRQn, FAST_PROTECTION_IRQ_PRIORITY);
+    NVIC_EnableIRQ(EXTI4_15_IRQn);
+#endif
+}
+
+/**
+ * @brief ALERT rising edge, makes the pack safe first and works out the rest after
+ *        Runs in interrupt context, nothing in here may block.
+ */
+void FastProtection::OnAlert()
+{
+    const uint32_t start = CycleCounter::Now();
+    const uint32_t now = xTaskGetTickCountFromISR();
+
+    // CC_READY lands on the 250 ms grid, even if some were missed, and only once per period. Until the first one there's no grid to go by
+    const uint32_t period = MS_TO_TICKS(FAST_PROTECTION_SAMPLE_PERIOD_MS);
+    const uint32_t window = MS_TO_TICKS(FAST_PROTECTION_SAMPLE_WINDOW_MS);
+    const uint32_t sinceSample = now - lastSampleTick;
+    const uint32_t phase = sinceSample % period;
+    if (!synced) {
+        synced = true;
+        lastSampleTick = now;
+        stats.sampleEdges++;
+        stats.unsyncedEdges++;
+        return;
+    }
+    if ((phase <= window || phase >= period - window) && sinceSample > window) {
+        lastSampleTick = now;
+        stats.sampleEdges++;
+        return;
+    }
+
+    GPIO::PowerSelect::ForceUmbilicalPower();
+    const uint32_t cycles = CycleCounter::Elapsed(start, CycleCounter::Now());
+
+    latched = true;
+    tripTick = now;
+    stats.trips++;
+    stats.lastResponseCycles = cycles;
+    stats.maxResponseCycles = (cycles > stats.maxResponseCycles) ? cycles : stats.maxResponseCycles;
+
+    if (notify != nullptr && !notify())
+        stats.missedNotifies++;
+}
+
+/**
+ * @brief Whether a trip is waiting for BatterySM
+ */
+bool FastProtection::IsLatched()
+{
+    return latched;
+}
+
+/**
+ * @brief Checks a BMS sample for a fault the interrupt didn't trip on, it came in on an edge taken for CC_READY
+ *        Only counts and logs, the protection engine acts on the same SYS_STAT bits.
+ * @param sysStat SYS_STAT of the sample
+ */
+void FastProtection::CheckSample(uint8_t sysStat)
+{
+    const uint8_t faultBits = sysStat & BMS_SYS_STAT_FAULT_BITS;
+    const uint8_t newBits = faultBits & ~lastFaultBits;
+    lastFaultBits = faultBits;
+
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    const bool tripped = latched || stats.trips != tripsAtLastSample;
+    tripsAtLastSample = stats.trips;
+    if (newBits != 0 && !tripped)
+        stats.slowPathFaults++;
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
+
+    if (newBits != 0 && !tripped) {
+        SOAR_PRINT("[%lu ms] FAST PROTECTION missed SYS_STAT 0x%02X, the ALERT edge was taken for a sample\n",
+            (unsigned long)TICKS_TO_MS(xTaskGetTickCount()), newBits);
+    }
+}
+
+/**
+ * @brief Called by BatterySM once it's in Fault, the FET register is its own again from here
+ */
+void FastProtection::Acknowledge()
+{
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    if (latched) {
+        const uint32_t handled_ms = TICKS_TO_MS(xTaskGetTickCount() - tripTick);
+        stats.lastHandled_ms = handled_ms;
+        stats.maxHandled_ms = (handled_ms > stats.maxHandled_ms) ? handled_ms : stats.maxHandled_ms;
+        latched = false;
+    }
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
+}
+
+/**
+ * @brief Consistent copy of the counters
+ */
+FastProtectionStats FastProtection::GetStats()
+{
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    const FastProtectionStats copy = stats;
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
+    return copy;
+}
+
+/**
+ * @brief Prints the counters and response times on the debug console
+ */
+void FastProtection::PrintStats()
+{
+    const FastProtectionStats s = GetStats();
+
+    SOAR_PRINT("\n\t-- Fast Protection --\n");
+    SOAR_PRINT("ALERT edges     : %lu samples (%u before the grid), %u trips, %u late notifies\n",
+        (unsigned long)s.sampleEdges, s.unsyncedEdges, s.trips, s.missedNotifies);
+    SOAR_PRINT("Slow path faults: %u, SYS_STAT faults with no trip, the edge was taken for a sample\n", s.slowPathFaults);
+    SOAR_PRINT("Response cycles : last %lu, worst %lu (after the fixed entry cost)\n",
+        (unsigned long)s.lastResponseCycles, (unsigned long)s.maxResponseCycles);
+    SOAR_PRINT("Handled (ms)    : last %lu, worst %lu\n", (unsigned long)s.lastHandled_ms, (unsigned long)s.maxHandled_ms);
+    SOAR_PRINT("Latched         : %s\n\n", IsLatched() ? "yes" : "no");
+}
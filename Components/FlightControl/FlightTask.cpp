@@ -5,18 +5,23 @@
  ******************************************************************************
 */
 #include "FlightTask.hpp"
+#include <cstring>
 #include "GPIO.hpp"
 #include "SystemDefines.hpp"
 #include "PMBProtocolTask.hpp"
 #include "BatterySM.hpp"
+#include "SystemStorage.hpp"
+#include "FastProtection.hpp"
+#include "PowerPath.hpp"
 
 /**
  * @brief Constructor for FlightTask
  */
-FlightTask::FlightTask() : Task(FLIGHT_TASK_QUEUE_DEPTH_OBJS)
+FlightTask::FlightTask() : StaticTask("FlightTask")
 {
-    rsm_ = nullptr;
+    bsm_ = nullptr;
     firstStateSent_ = 0;
+    savedResistanceSteps_ = 0;
 }
 
 /**
@@ -24,18 +29,13 @@ FlightTask::FlightTask() : Task(FLIGHT_TASK_QUEUE_DEPTH_OBJS)
  */
 void FlightTask::InitTask()
 {
-    // Make sure the task is not already initialized
-    SOAR_ASSERT(rtTaskHandle == nullptr, "Cannot initialize flight task twice");
-    
-    BaseType_t rtValue =
-        xTaskCreate((TaskFunction_t)FlightTask::RunTask,
-            (const char*)"FlightTask",
-            (uint16_t)FLIGHT_TASK_STACK_DEPTH_WORDS,
-            (void*)this,
-            (UBaseType_t)FLIGHT_TASK_RTOS_PRIORITY,
-            (TaskHandle_t*)&rtTaskHandle);
-
-    SOAR_ASSERT(rtValue == pdPASS, "FlightTask::InitTask() - xTaskCreate() failed");
+    // The queue exists from construction, so trips can be queued before the task first runs
+    FastProtection::Init(&FlightTask::NotifyAlert);
+
+    // Nothing reads the rail until the charger task provides VSYS, switch unverified (with a warning) rather than refuse every request
+    PowerPath::Inst().AllowUnverified(true);
+
+    StaticTask::InitTask();
 }
 
 /**
@@ -48,51 +48,28 @@ void FlightTask::Run(void * pvParams)
     SystemState sysState;
     bool stateReadSuccess = SystemStorage::Inst().Read(sysState);
 
-    if (stateReadSuccess == true) {
-        // Succeded to read state, initialize the rocket state machine
+    // Failed to read state, start in default state
+    BatteryState startingState = BS_IDLE;
 
-        // Make sure we start in a valid state, if the state is invalid then ABORT
-        if(sysState.rocketState >= RS_NONE || sysState.rocketState < RS_PRELAUNCH)
+    if (stateReadSuccess == true) {
+        // Succeded to read state, make sure we start in a valid state, if the state is invalid then IDLE (both FETs off)
+        if(sysState.batteryState < BS_NONE && sysState.batteryState >= BS_IDLE)
         {
-            sysState.rocketState = RS_ABORT;
+            startingState = sysState.batteryState;
         }
-
-        rsm_ = new RocketSM(sysState.rocketState, true);
     }
-    else {
-        // Failed to read state, start in default state
-        rsm_ = new RocketSM(RS_ABORT, true);
-    }
-
-    while (1) {
-        // There's effectively 3 types of tasks... 'Async' and 'Synchronous-Blocking' and 'Synchronous-Non-Blocking'
-        // Asynchronous tasks don't require a fixed-delay and can simply delay using xQueueReceive, it will immedietly run the next task
-        // cycle as soon as it gets an event.
-
-        // Synchronous-Non-Blocking tasks require a fixed-delay and will require something like an RTOS timer that tracks the time till the next run cycle,
-        // and will delay using xQueueReceive for the set time, but if it gets interrupted by an event will handle the event then restart a xQueueReceive with
-        // the time remaining in the timer
-
-        // Synchronous-Blocking tasks are simpler to implement, they do NOT require instant handling of queue events, and will simply delay using osDelay() and
-        // poll the event queue once every cycle.
 
-        // This task below with the display would be a 'Synchronous-Non-Blocking' we want to handle queue events instantly, but keep a fixed delay
-        // Could consider a universal queue that directs and handles commands to specific tasks, and a task that handles the queue events and then calls the
-        // Mappings between X command and P subscribers (tasks that are expecting it).
-
-        // Since FlightTask is so critical to managing the system, it may make sense to make this a Async task that handles commands as they come in, and have these display commands be routed over to the DisplayTask
-        // or maybe HID (Human Interface Device) task that handles both updating buzzer frequencies and LED states.
-
-
-        //Process commands in blocking mode
-        Command cm;
-        bool res = qEvtQueue->ReceiveWait(cm);
-        if(res)
-            HandleCommand(cm);
-
-        //osDelay(FLIGHT_PHASE_DISPLAY_FREQ);
+    // The state machine lives as long as the task, keep it out of the heap
+    static BatterySM bsm(startingState, true);
+    bsm_ = &bsm;
 
+    if (stateReadSuccess == true) {
+        bsm_->RestoreResistance(sysState.resistance);
+        savedResistanceSteps_ = bsm_->GetResistanceEstimator().GetStepCount();
     }
+
+    // Commands are handled as they come in, see StaticTask for the periodic and hybrid loops
+    RunBlocking();
 }
 
 /**
@@ -101,16 +78,84 @@ void FlightTask::Run(void * pvParams)
  */
 void FlightTask::HandleCommand(Command& cm)
 {
-    // If this is a request command, we handle it in the task (rocket state command must always be control actions)
+    // If this is a request command, we handle it in the task (battery state command must always be control actions)
     if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_TRANSMIT_STATE)
         SendRocketState();
-    else
-        rsm_->HandleCommand(cm);
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_TRANSMIT_BATTERY_STATUS)
+        SendBatteryStatus();
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_PRINT_BATTERY_JOURNAL)
+        bsm_->PrintJournal();
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_TRANSMIT_BATTERY_JOURNAL)
+        SendBatteryJournal();
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_POWER_INTERNAL) {
+        // Blocks for at most the verify window, BMS samples queue up meanwhile
+        PowerPath::Inst().SelectInternal(*bsm_);
+        SendPowerPathStatus();
+    }
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_POWER_UMBILICAL) {
+        PowerPath::Inst().SelectUmbilical();
+        SendPowerPathStatus();
+    }
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_TRANSMIT_POWER_PATH)
+        SendPowerPathStatus();
+    else if (cm.GetCommand() == REQUEST_COMMAND && cm.GetTaskCommand() == FT_REQUEST_PRINT_POWER_PATH)
+        PowerPath::Inst().PrintStats();
+    else if (cm.GetCommand() == CONTROL_ACTION) {
+        // Every operator command comes through here, whoever sent it
+        const BatteryState previousState = bsm_->GetState();
+        const BatteryRemoteAck ack = bsm_->HandleRemoteCommand(cm.GetTaskCommand());
+        SendBatteryRemoteAck(ack);
+
+        if (bsm_->GetState() != previousState)
+            SaveSystemState();
+    }
+    else {
+        const BatteryState previousState = bsm_->GetState();
+        bsm_->HandleCommand(cm);
+
+        // Storage coalesces these, a burst of transitions is still one flash write
+        if (bsm_->GetState() != previousState || bsm_->GetResistanceEstimator().GetStepCount() != savedResistanceSteps_)
+            SaveSystemState();
+    }
 
 	// Make sure the command is reset
     cm.Reset();
 }
 
+/**
+ * @brief Queues an operator command for the state machine, behind any queued samples so it's checked against the latest state
+ * @param command The command
+ */
+void FlightTask::SendBatteryRemoteCommand(BatteryRemoteCommand command)
+{
+    Command cm(CONTROL_ACTION, (uint16_t)command);
+    qEvtQueue->Send(cm);
+}
+
+/**
+ * @brief Queues a fast protection trip for the state machine, called from the ALERT interrupt
+ * @return False if the queue was full, BatterySM then picks the trip up on the next BMS sample
+ */
+bool FlightTask::NotifyAlert()
+{
+    Command cm(DATA_COMMAND, (uint16_t)BMS_ALERT);
+    return Inst().GetEventQueue()->SendFromISR(cm);
+}
+
+/**
+ * @brief Queues the battery state and learned resistance to be saved to flash
+ */
+void FlightTask::SaveSystemState()
+{
+    SystemState sysState;
+    memset(&sysState, 0, sizeof(sysState));
+    sysState.batteryState = bsm_->GetState();
+    bsm_->GetResistanceEstimator().GetRecord(sysState.resistance);
+    savedResistanceSteps_ = sysState.resistance.stepCount;
+
+    SystemStorage::Inst().Write(sysState);
+}
+
 /**
  * @brief Sends rocket state commands to the RCU
  */
@@ -133,7 +178,7 @@ void FlightTask::SendRocketState()
     else {
         stateMsg.set_sys_state(Proto::SystemState::State::SYS_NORMAL_OPERATION);
     }
-    stateMsg.set_rocket_state(rsm_->GetRocketStateAsProto());
+    stateMsg.set_battery_state(bsm_->GetBatteryStateAsProto());
     msg.set_sys_state(stateMsg);
 
     EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
@@ -142,3 +187,139 @@ void FlightTask::SendRocketState()
     // Send the control message
     DMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_CONTROL);
 }
+
+/**
+ * @brief Sends the battery telemetry snapshot to the RCU
+ */
+void FlightTask::SendBatteryStatus()
+{
+    BatteryStatus status;
+    bsm_->GetStatus(status);
+
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::BatteryStatus batteryMsg;
+    batteryMsg.set_state_of_charge(status.stateOfCharge_pct);
+    batteryMsg.set_coulomb_soc(status.coulombSoc_pct);
+    batteryMsg.set_state_of_health(status.stateOfHealth_pct);
+    batteryMsg.set_max_cell_resistance_uohm(status.maxCellResistance_uOhm);
+    batteryMsg.set_current_ma(status.current_mA);
+    batteryMsg.set_runtime_s(status.runtime_s);
+    batteryMsg.set_peak_runtime_s(status.peakRuntime_s);
+    batteryMsg.set_fault_mask(status.faultMask);
+    batteryMsg.set_balance_mask(status.balanceMask);
+    batteryMsg.set_storage_failures(SystemStorage::Inst().GetStats().failures);
+
+    // Per cell duties are packed one byte per cell, cell 1 in the low byte
+    uint32_t packedDuty = 0;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS && i < 4; i++)
+        packedDuty |= (uint32_t)status.balanceDuty_pct[i] << (8 * i);
+    batteryMsg.set_balance_duty(packedDuty);
+    teleMsg.set_batteryStatus(batteryMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
+
+/**
+ * @brief Sends the battery transition journal, oldest entry first, then one dwell histogram per substate
+ */
+void FlightTask::SendBatteryJournal()
+{
+    const BatteryJournal& journal = bsm_->GetJournal();
+
+    for (uint8_t age = journal.GetCount(); age > 0; age--) {
+        BatteryJournalEntry entry;
+        journal.GetEntry(age - 1, entry);
+
+        Proto::TelemetryMessage teleMsg;
+        teleMsg.set_source(Proto::Node::NODE_PMB);
+        teleMsg.set_target(Proto::Node::NODE_RCU);
+        Proto::BatteryTransition transitionMsg;
+        transitionMsg.set_sequence(entry.sequence);
+        transitionMsg.set_timestamp_us(entry.timestamp_us);
+        transitionMsg.set_event(entry.event);
+        transitionMsg.set_from_state(entry.fromState);
+        transitionMsg.set_from_substate(entry.fromSubstate);
+        transitionMsg.set_to_state(entry.toState);
+        transitionMsg.set_to_substate(entry.toSubstate);
+        transitionMsg.set_fault_mask(entry.faultMask);
+        teleMsg.set_batteryTransition(transitionMsg);
+
+        EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+        teleMsg.serialize(writeBuffer);
+        PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+    }
+
+    for (uint8_t s = 0; s < BSS_COUNT; s++) {
+        Proto::TelemetryMessage teleMsg;
+        teleMsg.set_source(Proto::Node::NODE_PMB);
+        teleMsg.set_target(Proto::Node::NODE_RCU);
+        Proto::BatteryDwell dwellMsg;
+        dwellMsg.set_substate(s);
+        for (uint8_t b = 0; b < BATTERY_DWELL_BINS; b++)
+            dwellMsg.add_bins(journal.GetDwellCount((BatterySubstate)s, b));
+        teleMsg.set_batteryDwell(dwellMsg);
+
+        EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+        teleMsg.serialize(writeBuffer);
+        PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+    }
+}
+
+/**
+ * @brief Sends the power source, the last switch outcome and the switchover timing to the RCU
+ */
+void FlightTask::SendPowerPathStatus()
+{
+    const PowerPath& powerPath = PowerPath::Inst();
+    const PowerPathStats& stats = powerPath.GetStats();
+
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::PowerPathStatus powerMsg;
+    powerMsg.set_internal(powerPath.IsInternal());
+    powerMsg.set_last_result(stats.lastResult);
+    powerMsg.set_attempts(stats.attempts);
+    powerMsg.set_switches(stats.switches);
+    powerMsg.set_rollbacks(stats.rollbacks);
+    powerMsg.set_refusals(stats.refusals);
+    powerMsg.set_unverified(stats.unverified);
+    powerMsg.set_last_switchover_us(stats.lastSwitchover_us);
+    powerMsg.set_max_switchover_us(stats.maxSwitchover_us);
+    powerMsg.set_last_dip_mv(stats.lastDip_mV);
+    powerMsg.set_max_dip_mv(stats.maxDip_mV);
+    teleMsg.set_powerPath(powerMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
+
+/**
+ * @brief Acknowledges an operator command with the state it left the battery in
+ * @param ack The acknowledgement from BatterySM
+ */
+void FlightTask::SendBatteryRemoteAck(const BatteryRemoteAck& ack)
+{
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::BatteryCommandAck ackMsg;
+    ackMsg.set_command(ack.command);
+    ackMsg.set_result(ack.result);
+    ackMsg.set_state(ack.state);
+    ackMsg.set_substate(ack.substate);
+    ackMsg.set_sequence(ack.sequence);
+    teleMsg.set_batteryCommandAck(ackMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
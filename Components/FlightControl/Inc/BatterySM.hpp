@@ -9,40 +9,101 @@
 
 #include "Command.hpp"
 #include "CoreProto.h"
+#include "Data.h"
+#include "CoulombCounter.hpp"
+#include "SocEstimator.hpp"
+#include "BalancePlanner.hpp"
+#include "ResistanceEstimator.hpp"
+#include "ChargeController.hpp"
+#include "RuntimePredictor.hpp"
+#include "BatteryState.hpp"
+#include "ProtectionEngine.hpp"
+#include "CellStats.hpp"
+#include "StateTable.hpp"
+#include "BatteryJournal.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+// Checked before a transition is taken, a failed guard leaves the event unhandled
+enum BatteryGuard : uint8_t
+{
+    BG_NONE = 0,                // Always passes
+    BG_NO_ACTIVE_FAULTS,        // Nothing tripped on the last BMS sample
+};
 
-enum BatteryState
+// Run on entry to and exit from a state
+enum BatteryAction : uint8_t
 {
-    BS_IDLE = 0,
-    BS_CHARGING,
-    BS_DISCHARGING,
-	BS_FAULT,
-    BS_NONE         // Invalid state, must be last
+    BA_NONE = 0,
+    BA_FETS_OFF,
+    BA_CHARGE_FET_ON,           // CHG on, DSG off
+    BA_DISCHARGE_FET_ON,        // DSG on, CHG off
+    BA_CLEAR_FAULTS,            // Clears the latched protection faults
 };
 
-/**
- * @brief Base class for Battery State Machine
- */
-class BaseBatteryState
+// Per sample work a substate enables, anything not listed is skipped or held off
+enum BatteryWork : uint8_t
 {
-public:
-    virtual BatteryState HandleCommand(Command& cm) = 0; //Handle a command based on the current state
-    virtual BatteryState OnEnter() = 0;  //Returns the state we're entering
-    virtual BatteryState OnExit() = 0;   //Returns the state we're exiting
-    virtual BatteryState HandleBMSData(const BMSData& bms) = 0;
-    virtual BatteryState HandleChargerData(const ChargerData& charger) = 0;
-    virtual BatteryState HandleFuelGaugeData(const FuelGaugeData& fuel_gauge) = 0;
+    BW_CHARGE = 0x01,                   // Charge controller may enable the charger
+    BW_BALANCE = 0x02,                  // Balance planner may bleed cells
+    BW_RUNTIME = 0x04,                  // Runtime prediction runs
+    BW_RUNTIME_EVERY_SAMPLE = 0x08,     // Both runtimes are recomputed on every sample
+};
 
-    virtual BatteryState GetStateID() { return bsStateID; }
+// Operator commands, a CONTROL_ACTION with one of these as the task command
+enum BatteryRemoteCommand : uint8_t
+{
+    BRC_CHARGE = 0,
+    BRC_DISCHARGE,
+    BRC_IDLE,
+    BRC_CLEAR_FAULT,
+    BRC_FORCE_SAFE,             // Fault from anywhere, FETs open until a clear
+    BRC_COUNT
+};
 
-    static const char* StateToString(BatteryState stateId);
+constexpr BatteryRemoteCommand BATTERY_ABORT_COMMAND = BRC_FORCE_SAFE;    // What an RCU abort (RSC_ANY_TO_ABORT) is carried out as
 
-protected:
-    BatteryState bsStateID = BS_NONE;    //The name of the state we're in
+enum BatteryRemoteResult : uint8_t
+{
+    BRR_ACCEPTED = 0,           // Transition taken
+    BRR_ALREADY_IN_STATE,       // Nothing to do
+    BRR_NOT_ALLOWED,            // Not from the current state
+    BRR_GUARD_FAILED,           // Allowed, but the transition's guard refused it (active faults)
+    BRR_RATE_LIMITED,           // Too soon after the last accepted command
+    BRR_UNKNOWN_COMMAND,
+    BRR_PROTECTION_LATCHED,     // A fast protection trip hasn't been handled yet, the FETs stay open
+};
 
+constexpr uint16_t BATTERY_RESERVE_SOC_Q15 = 6554;    // 20%, discharging below this is the reserve
+constexpr uint32_t BATTERY_REMOTE_MIN_INTERVAL_MS = 1000;    // Between accepted operator commands, force safe is exempt
+
+/* Structs ------------------------------------------------------------------*/
+// One row of the operator command matrix
+struct BatteryRemoteEntry {
+    BatteryRemoteCommand command;
+    BatteryEvent event;         // Dispatched through the transition table like any other event
+    BatteryState target;        // State the command asks for
+    uint8_t allowedStates;      // StateBit() of every state it may be sent in, besides the target
+};
+
+// Sent back for every operator command
+struct BatteryRemoteAck {
+    uint8_t command;            // BatteryRemoteCommand
+    uint8_t result;             // BatteryRemoteResult
+    uint8_t state;              // BatteryState after the command
+    uint8_t substate;           // BatterySubstate after the command
+    uint16_t sequence;          // Journal sequence after the command
 };
 
+typedef StateTableEntry<BatteryState, BatteryAction> BatteryStateEntry;
+typedef StateTableTransition<BatteryState, BatteryEvent, BatteryGuard> BatteryTransition;
+typedef StateTableSubstate<BatterySubstate, BatteryState, BatteryAction> BatterySubstateEntry;
+typedef StateTableTransition<BatterySubstate, BatteryEvent, BatteryGuard> BatterySubstateTransition;
+
 /**
  * @brief Battery State Machine
+ *        States, substates, events, guards and entry/exit actions are constexpr tables in BatterySM.cpp,
+ *        dispatch is a table lookup and a switch over the guard and actions. The substate sees an event
+ *        first, anything it has no row for is handled by its parent state.
  */
 class BatterySM
 {
@@ -50,82 +111,73 @@ public:
     BatterySM(BatteryState startingState, bool enterStartingState);
 
     void HandleCommand(Command& cm);
+    BatteryRemoteAck HandleRemoteCommand(uint16_t command);
+    BatteryState Dispatch(BatteryEvent event);
 
+    BatteryState GetState() const { return state_; }
+    BatterySubstate GetSubstate() const { return substate_; }
     Proto::BatteryState GetBatteryStateAsProto();
+    const CoulombCounter& GetCoulombCounter() const { return coulombCounter_; }
+    const SocEstimator& GetSocEstimator() const { return socEstimator_; }
+    const ResistanceEstimator& GetResistanceEstimator() const { return resistanceEstimator_; }
+    void RestoreResistance(const ResistanceRecord& record) { resistanceEstimator_.Restore(record); }
+    const RuntimePredictor& GetRuntimePredictor() const { return runtimePredictor_; }
+    uint8_t GetCellBalRegister() const { return balancePlanner_.GetCellBalRegister(); }    // Written to CELLBAL1 by the BMS task each sample
+    uint8_t GetFetRegister() const;    // BMS_FET_* bits, written to SYS_CTRL2 by the BMS task each sample
+    bool TakeChargeSetpoint(ChargeSetpoint& setpoint);    // For the charger task, true if the LTC4015 needs rewriting. Safe from another task, nothing polls it until the LTC4015 driver lands
+    void GetStatus(BatteryStatus& status) const;
+    uint32_t GetLastFaultMask() const { return lastFaultMask_; }
+    Millivolts GetPackVoltage() const { return Millivolts(packVoltage_mV_); }          // Last BMS sample
+    Millivolts GetMinCellVoltage() const { return Millivolts(minCellVoltage_mV_); }
+    uint64_t GetLastSampleTime_us() const { return lastSample_us_; }    // 0 before the first sample
+    const BatteryJournal& GetJournal() const { return journal_; }
+    void PrintJournal() const;
+
+    static const char* StateToString(BatteryState stateId);
+    static const char* SubstateToString(BatterySubstate substateId);
+    static const char* EventToString(BatteryEvent eventId);
+    static const char* RemoteCommandToString(uint16_t command);
+    static const char* RemoteResultToString(BatteryRemoteResult result);
 
 protected:
-    BatteryState TransitionState(BatteryState nextState);
+    BatteryState TransitionState(BatteryState nextState, BatteryEvent event);
+    void TransitionSubstate(BatterySubstate nextSubstate, BatteryEvent event);
+    void RaiseSubstateEvents(const CellStats& cells);
+    bool CheckGuard(BatteryGuard guard) const;
+    void RunAction(BatteryAction action);
+    void UpdateEstimators(const BMSData& bms, const CellStats& cells);
+    void PublishChargeSetpoint();
+    void HandleAlert();
 
     // Variables
-    BaseBatteryState* stateArray[BS_NONE];
-    BaseBatteryState* bs_currentState;
+    BatteryState state_;
+    BatterySubstate substate_;
+    uint8_t fetRegister_;
+
+    // Estimators, fed from every sample regardless of state
+    CoulombCounter coulombCounter_;
+    SocEstimator socEstimator_;
+    BalancePlanner balancePlanner_;
+    ResistanceEstimator resistanceEstimator_;
+    RuntimePredictor runtimePredictor_;
+
+    // LTC4015 charge profile
+    ChargeController chargeController_;
+    ChargeSetpoint chargeSetpoint_;    // Published copy for TakeChargeSetpoint, with the flag only touched in a critical section
+    bool chargeSetpointPending_;
+
+    // Limit checking, runs on every BMS sample and raises events into the transition table
+    ProtectionEngine protection_;
+    uint32_t lastFaultMask_;    // Limits that tripped on the last BMS sample
+    uint16_t packVoltage_mV_;
+    uint16_t minCellVoltage_mV_;
+    uint64_t lastSample_us_;
+
+    // Every transition taken and how long each substate lasted
+    BatteryJournal journal_;
+
+    uint64_t lastRemote_us_;    // Last accepted operator command, for the rate limit
+    bool hasRemote_;
 };
 
-/**
- * @brief Idle state, waiting for commands to proceeding sequences
- */
-class Idle : public BaseBatteryState
-{
-public:
-    Idle();
-
-    // Base class
-    BatteryState HandleCommand(Command& cm) override;
-    BatteryState OnEnter() override;
-    BatteryState OnExit() override;
-    BatteryState HandleBMSData(const BMSData& bms) override;
-    BatteryState HandleChargerData(const ChargerData& charger) override;
-    BatteryState HandleFuelGaugeData(const FuelGaugeData& fuel_gauge) override;
-};
-
-/**
- * @brief Charging state
- */
-class Charging : public BaseBatteryState
-{
-public:
-    Charging();
-
-    BatteryState HandleCommand(Command& cm) override;
-    BatteryState OnEnter() override;
-    BatteryState OnExit() override;
-    BatteryState HandleBMSData(const BMSData& bms) override;
-    BatteryState HandleChargerData(const ChargerData& charger) override;
-    BatteryState HandleFuelGaugeData(const FuelGaugeData& fuel_gauge) override;
-};
-
-/**
- * @brief Charging state
- */
-class Discharging : public BaseBatteryState
-{
-public:
-    Discharging();
-
-    BatteryState HandleCommand(Command& cm) override;
-    BatteryState OnEnter() override;
-    BatteryState OnExit() override;
-    BatteryState HandleBMSData(const BMSData& bms) override;
-    BatteryState HandleChargerData(const ChargerData& charger) override;
-    BatteryState HandleFuelGaugeData(const FuelGaugeData& fuel_gauge) override;
-};
-
-/**
- * @brief Fault state
- */
-class Fault : public BaseBatteryState
-{
-public:
-    Fault();
-
-    BatteryState HandleCommand(Command& cm) override;
-    BatteryState OnEnter() override;
-    BatteryState OnExit() override;
-    BatteryState HandleBMSData(const BMSData& bms) override;
-    BatteryState HandleChargerData(const ChargerData& charger) override;
-    BatteryState HandleFuelGaugeData(const FuelGaugeData& fuel_gauge) override;
-
-};
-
-
 #endif // BR_AVIONICS_BATTERY_SM
@@ -0,0 +1,87 @@
+/**
+ ******************************************************************************
+ * File Name          : FastProtection.hpp
+ * Description        : Interrupt driven protection path for the bq769x0 ALERT
+ *                      pin, makes the pack safe before any task runs.
+ *
+ *    The bq769x0 raises ALERT for faults (OV, UV, SCD, OCD, XREADY) and for
+ *    every CC_READY, one every 250 ms. An edge on the CC_READY grid is a
+ *    sample and left to the BMS task, an edge off the grid can only be a
+ *    fault: the handler switches the power select to umbilical with a single
+ *    store, latches the trip and queues BMS_ALERT for BatterySM. Until
+ *    BatterySM has taken the Fault transition and acknowledged, the FET
+ *    register it hands the BMS task reads 0, so nothing closes the FETs the
+ *    bq769x0 opened itself. A notify that doesn't fit in the queue is picked
+ *    up on the next BMS sample instead.
+ *
+ *    CC_READY comes once per period, so a second edge inside the same window
+ *    is a fault too. What can't be told apart without an I2C read is a fault
+ *    on the first edge inside the window, or on any edge before the first
+ *    sample set the grid. Those are taken as samples, and the fault then
+ *    only reaches BatterySM through the SYS_STAT of the next BMS sample.
+ *    BatterySM hands every sample's SYS_STAT to CheckSample, which counts
+ *    and logs any fault bits that appear with no trip behind them, so a fault
+ *    that took the slow path leaves a trace.
+ *
+ *    BMS_ALERT is PB5, EXTI line 5 on the EXTI4_15 vector. Init arms the
+ *    rising edge and enables the vector at FAST_PROTECTION_IRQ_PRIORITY.
+ *
+ *    Estimated worst case response, ALERT edge to BATTERY_EN low, counted
+ *    from the code rather than measured on the board (16 MHz HSI, 0 wait states):
+ *      EXTI synchronisation                         2 cycles
+ *      Exception entry, stacking and vector fetch  16 cycles
+ *      EXTI4_15 handler, pending check and clear   ~12 cycles
+ *      OnAlert, tick read, grid check, BRR store  ~100 cycles (the modulo is a software divide)
+ *    ~130 cycles, about 8 us, if the interrupt is taken straight away, to be
+ *    checked against what "fastprot" reports on the board. On top of
+ *    that comes anything that holds it off:
+ *      - A running handler of the same priority, ALERT must be the only priority 0 interrupt
+ *      - The longest PRIMASK section, FreeRTOS critical sections mask everything on the M0+
+ *      - Flash program/erase stalls every fetch from flash, vector included: ~85 us per
+ *        SystemStorage double word, up to 40 ms for the bank erase every 51 records
+ *      - Waking from STOP1 in tickless idle, ~10 us, then ~20 us masked while LowPower
+ *        corrects the tick, so the grid check sees the right time
+ *    The SCD and OCD delays of the bq769x0 cover the erase case, it opens the
+ *    FETs in hardware regardless. The handler measures itself from entry to
+ *    the store with the SysTick counter, "fastprot" on the debug console
+ *    prints the last and worst, and how long BatterySM took to acknowledge.
+ ******************************************************************************
+*/
+#ifndef BR_FAST_PROTECTION_HPP_
+#define BR_FAST_PROTECTION_HPP_
+#include <cstdint>
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint32_t FAST_PROTECTION_SAMPLE_PERIOD_MS = 250;    // bq769x0 CC_READY period
+constexpr uint32_t FAST_PROTECTION_SAMPLE_WINDOW_MS = 8;      // Either side of the grid, CC timing tolerance plus one tick
+constexpr uint32_t FAST_PROTECTION_IRQ_PRIORITY = 0;          // EXTI4_15, must be the only priority 0 interrupt
+
+/* Structs ------------------------------------------------------------------*/
+struct FastProtectionStats {
+    uint32_t sampleEdges;           // ALERT edges on the CC_READY grid
+    uint16_t trips;                 // ALERT edges off the grid, each one made the pack safe
+    uint16_t missedNotifies;        // Trips BatterySM wasn't told about straight away
+    uint16_t unsyncedEdges;         // Edges taken as samples before the grid was set
+    uint16_t slowPathFaults;        // SYS_STAT faults that showed up in a sample with no trip for them
+    uint32_t lastResponseCycles;    // Handler entry to power select written
+    uint32_t maxResponseCycles;
+    uint32_t lastHandled_ms;        // Trip to BatterySM acknowledging it
+    uint32_t maxHandled_ms;
+};
+
+/* Functions -----------------------------------------------------------------*/
+namespace FastProtection
+{
+    typedef bool (*NotifyCallback)();    // Called from the ISR after a trip, false if the notify couldn't be queued
+
+    void Init(NotifyCallback notify);
+    void OnAlert();                      // ALERT rising edge, interrupt context
+
+    bool IsLatched();                    // Tripped and not yet acknowledged
+    void CheckSample(uint8_t sysStat);   // Every BMS sample, logs a fault the interrupt took for a sample
+    void Acknowledge();                  // BatterySM is in Fault
+    FastProtectionStats GetStats();
+    void PrintStats();
+}
+
+#endif // BR_FAST_PROTECTION_HPP_
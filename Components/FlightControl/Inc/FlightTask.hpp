@@ -6,7 +6,7 @@
 */
 #ifndef SOAR_FLIGHTTASK_HPP_
 #define SOAR_FLIGHTTASK_HPP_
-#include "Task.hpp"
+#include "StaticTask.hpp"
 #include "SystemDefines.hpp"
 #include "BatterySM.hpp"
 
@@ -17,36 +17,46 @@ enum FlightTaskRequests
 {
 	FT_REQUEST_NONE = 0, 
 	FT_REQUEST_TRANSMIT_STATE,	// Send the current state over the Radio
+	FT_REQUEST_TRANSMIT_BATTERY_STATUS,	// Send the battery telemetry snapshot over the Radio
+	FT_REQUEST_PRINT_BATTERY_JOURNAL,	// Print the battery transition journal on the debug console
+	FT_REQUEST_TRANSMIT_BATTERY_JOURNAL,	// Send the battery transition journal and dwell histograms over the Radio
+	FT_REQUEST_POWER_INTERNAL,	// Hand the load over to the battery, then send the power path status
+	FT_REQUEST_POWER_UMBILICAL,	// Hand the load back to the umbilical, then send the power path status
+	FT_REQUEST_TRANSMIT_POWER_PATH,	// Send the power path status over the Radio
+	FT_REQUEST_PRINT_POWER_PATH,	// Print the power path status on the debug console
 };
 
-class FlightTask : public Task
+class FlightTask : public StaticTask<FlightTask, FLIGHT_TASK_RTOS_PRIORITY, FLIGHT_TASK_STACK_DEPTH_WORDS, FLIGHT_TASK_QUEUE_DEPTH_OBJS>
 {
-public:
-    static FlightTask& Inst() {
-        static FlightTask inst;
-        return inst;
-    }
+    friend StaticTask;
 
+public:
     void InitTask();
 
-protected:
-    static void RunTask(void* pvParams) { FlightTask::Inst().Run(pvParams); } // Static Task Interface, passes control to the instance Run();
+    void SendBatteryRemoteCommand(BatteryRemoteCommand command);
 
+protected:
     void Run(void * pvParams); // Main run code
 
     void HandleCommand(Command& cm);
 
     void SendRocketState();
+    void SendBatteryStatus();
+    void SendBatteryJournal();
+    void SendPowerPathStatus();
+    void SendBatteryRemoteAck(const BatteryRemoteAck& ack);
+    void SaveSystemState();
+
+    static bool NotifyAlert();    // FastProtection trip, interrupt context
 
 private:
     // Private Functions
     FlightTask();        // Private constructor
-    FlightTask(const FlightTask&);                        // Prevent copy-construction
-    FlightTask& operator=(const FlightTask&);            // Prevent assignment
 
     // Private Variables
-    RocketSM* rsm_;
+    BatterySM* bsm_;
     uint16_t firstStateSent_;
+    uint16_t savedResistanceSteps_;    // Resistance estimator step count when the state was last saved
 };
 
 #endif    // SOAR_FLIGHTTASK_HPP_
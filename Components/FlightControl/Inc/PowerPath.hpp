@@ -0,0 +1,112 @@
+/**
+ ******************************************************************************
+ * File Name          : PowerPath.hpp
+ * Description        : Sequenced power source switching between the umbilical
+ *                      and the internal battery.
+ *
+ *    A handover is pre-checked, switched, verified and rolled back if the
+ *    rail doesn't hold. Going internal the pack has to be out of Fault with
+ *    no fast protection trip pending, sampled within the last second and
+ *    above the handover minimums. The rail is read before BATTERY_EN moves
+ *    and then every POWER_PATH_POLL_MS; the switch stands once
+ *    POWER_PATH_SETTLE_SAMPLES readings in a row are above
+ *    POWER_PATH_RAIL_MIN_VOLTAGE, and is undone if that hasn't happened within
+ *    POWER_PATH_VERIFY_WINDOW_MS. Switchover time (select written to rail
+ *    settled) and the dip (baseline minus lowest reading) are kept for each
+ *    attempt.
+ *
+ *    The rail is read through a RailSense callback, the LTC4015 VSYS reading
+ *    from the charger task. Without one nothing is switched, since a handover
+ *    that can't be verified can't be rolled back either. The exception is an
+ *    explicit unverified mode (AllowUnverified): the pre-checks still run,
+ *    then the select is written, a warning is logged and the result is
+ *    PP_UNVERIFIED. FlightTask turns that mode on until the charger task
+ *    provides a rail sense. A registered rail sense always takes precedence.
+ *    The fast protection path bypasses all of this and forces umbilical on
+ *    its own. Every select write checks the latch with interrupts masked, so
+ *    it never overwrites a trip, and a trip at any point of a handover,
+ *    the last rail read included, ends it on umbilical as PP_BATTERY_FAULT.
+ ******************************************************************************
+*/
+#ifndef BR_POWER_PATH_HPP_
+#define BR_POWER_PATH_HPP_
+#include <cstdint>
+#include "BatterySM.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr Millivolts POWER_PATH_MIN_CELL_VOLTAGE(3300);   // Lowest cell, below this the pack can't carry the load for long
+constexpr Millivolts POWER_PATH_MIN_PACK_VOLTAGE(13200);  // Whole pack, 4S at 3.3V
+constexpr uint32_t POWER_PATH_SAMPLE_MAX_AGE_US = 1000000;    // BMS sample at most this old for the pre-check
+constexpr Millivolts POWER_PATH_RAIL_MIN_VOLTAGE(11000);  // Rail has to stay above this on the new source
+constexpr uint32_t POWER_PATH_VERIFY_WINDOW_MS = 20;      // Rail has this long to settle before the switch is undone
+constexpr uint32_t POWER_PATH_POLL_MS = 1;                // Rail read period while verifying
+constexpr uint8_t POWER_PATH_SETTLE_SAMPLES = 3;          // Consecutive good readings to call it settled
+
+enum PowerPathResult : uint8_t
+{
+    PP_OK = 0,
+    PP_ALREADY_SELECTED,        // Nothing to do
+    PP_NO_RAIL_SENSE,           // Refused, no way to verify
+    PP_RAIL_READ_FAILED,        // Refused, baseline read failed
+    PP_BATTERY_FAULT,           // Refused or aborted, Fault or a fast protection trip
+    PP_BATTERY_STALE,           // Refused, no recent BMS sample
+    PP_BATTERY_LOW,             // Refused, pack or lowest cell under the handover minimum
+    PP_RAIL_LOW,                // Switched and rolled back, the rail didn't settle in the window
+    PP_UNVERIFIED,              // Switched with no rail sense, nothing checked the rail
+};
+
+/* Structs ------------------------------------------------------------------*/
+struct PowerPathStats {
+    uint16_t attempts;              // Every request that wasn't PP_ALREADY_SELECTED
+    uint16_t switches;              // Switched and settled
+    uint16_t rollbacks;             // Switched and undone
+    uint16_t refusals;              // Failed a pre-check, nothing moved
+    uint16_t unverified;            // Switched in the unverified mode, counted apart from switches
+    PowerPathResult lastResult;
+    uint32_t lastSwitchover_us;     // Select written to rail settled, last successful switch
+    uint32_t maxSwitchover_us;
+    uint16_t lastDip_mV;            // Baseline minus the lowest reading, last switch or rollback
+    uint16_t maxDip_mV;
+};
+
+/* Class ------------------------------------------------------------------*/
+class PowerPath
+{
+public:
+    typedef bool (*RailSense)(Millivolts& rail);    // Fresh rail reading, false if the read failed
+
+    static PowerPath& Inst() {
+        static PowerPath inst;
+        return inst;
+    }
+
+    void SetRailSense(RailSense railSense) { railSense_ = railSense; }
+    void AllowUnverified(bool allow) { allowUnverified_ = allow; }    // Switch without a rail sense, see above
+
+    PowerPathResult SelectInternal(const BatterySM& bsm);
+    PowerPathResult SelectUmbilical();
+
+    bool IsInternal() const;
+    const PowerPathStats& GetStats() const { return stats_; }
+    void PrintStats() const;
+
+    static const char* ResultToString(PowerPathResult result);
+
+protected:
+    PowerPathResult Switch(bool toInternal);
+    PowerPathResult Refuse(PowerPathResult result);
+    PowerPathResult Finish(PowerPathResult result);
+    PowerPathResult Tripped();
+    static bool Select(bool internal);
+
+    RailSense railSense_;
+    bool allowUnverified_;
+    PowerPathStats stats_;
+
+private:
+    PowerPath();                                    // Private constructor
+    PowerPath(const PowerPath&);                    // Prevent copy-construction
+    PowerPath& operator=(const PowerPath&);         // Prevent assignment
+};
+
+#endif // BR_POWER_PATH_HPP_
@@ -7,28 +7,23 @@
 */
 #ifndef SOAR_TELEMETRYTASK_HPP_
 #define SOAR_TELEMETRYTASK_HPP_
-#include "Task.hpp"
+#include "StaticTask.hpp"
 #include "SystemDefines.hpp"
 
 constexpr uint16_t TELEMETRY_HEARTBEAT_TIMER_PERIOD_MS = 2000; // 2s between heartbeat telemetry
 constexpr uint16_t PERIOD_BETWEEN_FLASH_LOGS_MS = 10000; // 10s between logs to flash
 
-class TelemetryTask : public Task
+class TelemetryTask : public StaticTask<TelemetryTask, TELEMETRY_TASK_RTOS_PRIORITY, TELEMETRY_TASK_STACK_DEPTH_WORDS, TELEMETRY_TASK_QUEUE_DEPTH_OBJS>
 {
-public:
-    static TelemetryTask& Inst() {
-        static TelemetryTask inst;
-        return inst;
-    }
-
-    void InitTask();
+    friend StaticTask;
 
 protected:
-    static void RunTask(void* pvParams) { TelemetryTask::Inst().Run(pvParams); } // Static Task Interface, passes control to the instance Run();
-
     void Run(void* pvParams); // Main run code
 
     void HandleCommand(Command& cm);
+    uint32_t GetPeriodMs() const { return loggingDelayMs; }
+    void OnPeriod() { RunLogSequence(); }
+    uint32_t GetWatchdogDeadlineMs() const { return loggingDelayMs + WATCHDOG_DEFAULT_DEADLINE_MS; }    // Only checks in once a period
     void RunLogSequence();
 
     void RequestSample();
@@ -36,13 +31,13 @@ protected:
     void RequestLogToFlash();
 
     void SendVentDrainStatus();
+    void SendCpuLoad();
+    void SendStackUsage();
 
 
 private:
     // Private Functions
     TelemetryTask();        // Private constructor
-    TelemetryTask(const TelemetryTask&);                        // Prevent copy-construction
-    TelemetryTask& operator=(const TelemetryTask&);            // Prevent assignment
 
     // Private Variables
     uint32_t loggingDelayMs;
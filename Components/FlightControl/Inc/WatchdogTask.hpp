@@ -0,0 +1,41 @@
+/**
+ ******************************************************************************
+ * File Name          : WatchdogTask.hpp
+ * Description        : Watchdog supervisor, refreshes the IWDG while every
+ *                      task keeps its deadline, tracks the RCU heartbeat.
+ ******************************************************************************
+*/
+#ifndef SOAR_WATCHDOGTASK_HPP_
+#define SOAR_WATCHDOGTASK_HPP_
+#include "StaticTask.hpp"
+#include "SystemDefines.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+enum WatchdogTaskCommands
+{
+    WATCHDOG_COMMAND_NONE = 0,
+    RADIOHB_REQUEST,        // HEARTBEAT_COMMAND, heartbeat received from the RCU
+    HB_STATUS_SEND,         // TASK_SPECIFIC_COMMAND, send the watchdog and heartbeat status over the Radio
+};
+
+class WatchdogTask : public StaticTask<WatchdogTask, WATCHDOG_TASK_RTOS_PRIORITY, WATCHDOG_TASK_STACK_DEPTH_WORDS, WATCHDOG_TASK_QUEUE_DEPTH_OBJS>
+{
+    friend StaticTask;
+
+protected:
+    void Run(void* pvParams); // Main run code
+
+    void HandleCommand(Command& cm);
+    uint32_t GetPeriodMs() const { return WATCHDOG_SUPERVISE_PERIOD_MS; }
+    void OnPeriod();
+    uint32_t GetWatchdogDeadlineMs() const { return 0; }    // The IWDG supervises the supervisor
+
+    void SendStatus();
+
+private:
+    WatchdogTask();        // Private constructor
+
+    TickType_t lastRadioHeartbeat_;    // 0 until the first heartbeat
+};
+
+#endif    // SOAR_WATCHDOGTASK_HPP_
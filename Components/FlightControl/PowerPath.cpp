@@ -0,0 +1,241 @@
+/**
+ ******************************************************************************
+ * File Name          : PowerPath.cpp
+ * Description        : Sequenced power source switching between the umbilical
+ *                      and the internal battery.
+ ******************************************************************************
+*/
+#include "PowerPath.hpp"
+#include <cstring>
+#include "SystemDefines.hpp"
+#include "GPIO.hpp"
+#include "Clock.hpp"
+#include "FastProtection.hpp"
+
+/* Power Path ------------------------------------------------------------------*/
+/**
+ * @brief Constructor, no rail sense until the charger task provides one
+ */
+PowerPath::PowerPath()
+{
+    railSense_ = nullptr;
+    allowUnverified_ = false;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/**
+ * @brief Hands the load over to the battery, if the pack is fit for it and the rail holds
+ * @param bsm Battery state machine, for the pre-check
+ * @return PP_OK if the switch stands, otherwise why it was refused or rolled back
+ */
+PowerPathResult PowerPath::SelectInternal(const BatterySM& bsm)
+{
+    if (IsInternal())
+        return PP_ALREADY_SELECTED;
+
+    stats_.attempts++;
+    if (bsm.GetState() == BS_FAULT || FastProtection::IsLatched())
+        return Refuse(PP_BATTERY_FAULT);
+    if (bsm.GetLastSampleTime_us() == 0 || Clock::Micros() - bsm.GetLastSampleTime_us() > POWER_PATH_SAMPLE_MAX_AGE_US)
+        return Refuse(PP_BATTERY_STALE);
+    if (bsm.GetPackVoltage() < POWER_PATH_MIN_PACK_VOLTAGE || bsm.GetMinCellVoltage() < POWER_PATH_MIN_CELL_VOLTAGE)
+        return Refuse(PP_BATTERY_LOW);
+
+    return Switch(true);
+}
+
+/**
+ * @brief Hands the load back to the umbilical, rolled back to the battery if the umbilical can't hold the rail
+ * @return PP_OK if the switch stands, otherwise why it was refused or rolled back
+ */
+PowerPathResult PowerPath::SelectUmbilical()
+{
+    if (!IsInternal())
+        return PP_ALREADY_SELECTED;
+
+    stats_.attempts++;
+    return Switch(false);
+}
+
+/**
+ * @brief Whether the battery is carrying the load
+ */
+bool PowerPath::IsInternal() const
+{
+    return GPIO::PowerSelect::IsInternal();
+}
+
+/**
+ * @brief Switches, then watches the rail until it settles or the window runs out
+ * @param toInternal Source to switch to
+ * @return PP_OK, or why it was refused, aborted or rolled back
+ */
+PowerPathResult PowerPath::Switch(bool toInternal)
+{
+    if (railSense_ == nullptr) {
+        if (!allowUnverified_)
+            return Refuse(PP_NO_RAIL_SENSE);
+
+        // Nothing can tell whether the new source holds the rail, so nothing can roll it back either
+        SOAR_PRINT("[%lu ms] POWER PATH WARNING: no rail sense, switching to %s unverified\n",
+            (unsigned long)TICKS_TO_MS(xTaskGetTickCount()), toInternal ? "INTERNAL" : "UMBILICAL");
+        if (!Select(toInternal))
+            return Refuse(PP_BATTERY_FAULT);
+        stats_.unverified++;
+        return Finish(PP_UNVERIFIED);
+    }
+
+    Millivolts baseline;
+    if (!railSense_(baseline))
+        return Refuse(PP_RAIL_READ_FAILED);
+
+    // A trip during the baseline read has already forced umbilical
+    const uint64_t start_us = Clock::Micros();
+    if (!Select(toInternal))
+        return Refuse(PP_BATTERY_FAULT);
+
+    Millivolts minRail = baseline;
+    uint8_t good = 0;
+    uint32_t settled_us = 0;
+    while (Clock::Micros() - start_us < (uint64_t)POWER_PATH_VERIFY_WINDOW_MS * 1000) {
+        if (FastProtection::IsLatched())
+            return Tripped();
+
+        Millivolts rail;
+        if (railSense_(rail)) {
+            minRail = (rail < minRail) ? rail : minRail;
+            good = (rail >= POWER_PATH_RAIL_MIN_VOLTAGE) ? good + 1 : 0;
+        }
+        else {
+            good = 0;    // A failed read proves nothing either way
+        }
+
+        if (good >= POWER_PATH_SETTLE_SAMPLES) {
+            settled_us = (uint32_t)(Clock::Micros() - start_us);
+            break;
+        }
+        osDelay(MS_TO_TICKS(POWER_PATH_POLL_MS));
+    }
+
+    stats_.lastDip_mV = (uint16_t)(baseline - minRail).Value();
+    stats_.maxDip_mV = (stats_.lastDip_mV > stats_.maxDip_mV) ? stats_.lastDip_mV : stats_.maxDip_mV;
+
+    // The last read can trip too, a rail that held doesn't make the pack fit to carry it
+    if (FastProtection::IsLatched())
+        return Tripped();
+
+    if (good < POWER_PATH_SETTLE_SAMPLES) {
+        Select(!toInternal);    // Never back onto the battery once protection has taken it away
+        stats_.rollbacks++;
+        return Finish(PP_RAIL_LOW);
+    }
+
+    stats_.switches++;
+    stats_.lastSwitchover_us = settled_us;
+    stats_.maxSwitchover_us = (settled_us > stats_.maxSwitchover_us) ? settled_us : stats_.maxSwitchover_us;
+    return Finish(PP_OK);
+}
+
+/**
+ * @brief Records a pre-check failure, nothing was switched
+ * @param result Why
+ * @return result
+ */
+PowerPathResult PowerPath::Refuse(PowerPathResult result)
+{
+    stats_.refusals++;
+    stats_.lastResult = result;
+    SOAR_PRINT("[%lu ms] POWER PATH refused: %s\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()), ResultToString(result));
+    return result;
+}
+
+/**
+ * @brief Records and logs the outcome of a switch
+ * @param result Outcome
+ * @return result
+ */
+PowerPathResult PowerPath::Finish(PowerPathResult result)
+{
+    stats_.lastResult = result;
+    SOAR_PRINT("[%lu ms] POWER PATH now %s: %s (switchover %lu us, dip %u mV)\n", (unsigned long)TICKS_TO_MS(xTaskGetTickCount()),
+        IsInternal() ? "INTERNAL" : "UMBILICAL", ResultToString(result),
+        (unsigned long)((result == PP_OK) ? stats_.lastSwitchover_us : 0), stats_.lastDip_mV);
+    return result;
+}
+
+/**
+ * @brief Ends a switch fast protection tripped during, the pack is kept off the load whichever way it was going
+ * @return PP_BATTERY_FAULT
+ */
+PowerPathResult PowerPath::Tripped()
+{
+    GPIO::PowerSelect::ForceUmbilicalPower();
+    stats_.rollbacks++;
+    return Finish(PP_BATTERY_FAULT);
+}
+
+/**
+ * @brief Drives BATTERY_EN, the latch is checked with interrupts masked so the select can't overwrite a trip the ALERT ISR just made
+ * @return False if fast protection has latched, the select is then left on umbilical
+ */
+bool PowerPath::Select(bool internal)
+{
+#ifndef COMPUTER_ENVIRONMENT
+    taskENTER_CRITICAL();
+#endif
+    const bool latched = FastProtection::IsLatched();
+    if (latched)
+        GPIO::PowerSelect::ForceUmbilicalPower();
+    else if (internal)
+        GPIO::PowerSelect::InternalPower();
+    else
+        GPIO::PowerSelect::UmbilicalPower();
+#ifndef COMPUTER_ENVIRONMENT
+    taskEXIT_CRITICAL();
+#endif
+    return !latched;
+}
+
+/**
+ * @brief Prints the counters and timing on the debug console
+ */
+void PowerPath::PrintStats() const
+{
+    SOAR_PRINT("\n\t-- Power Path --\n");
+    SOAR_PRINT("Source          : %s\n", IsInternal() ? "internal" : "umbilical");
+    SOAR_PRINT("Attempts        : %u, %u switched, %u rolled back, %u refused, %u unverified\n",
+        stats_.attempts, stats_.switches, stats_.rollbacks, stats_.refusals, stats_.unverified);
+    SOAR_PRINT("Rail sense      : %s\n", (railSense_ != nullptr) ? "yes" : (allowUnverified_ ? "none, switching unverified" : "none, refusing"));
+    SOAR_PRINT("Last result     : %s\n", ResultToString(stats_.lastResult));
+    SOAR_PRINT("Switchover (us) : last %lu, worst %lu\n", (unsigned long)stats_.lastSwitchover_us, (unsigned long)stats_.maxSwitchover_us);
+    SOAR_PRINT("Rail dip (mV)   : last %u, worst %u\n\n", stats_.lastDip_mV, stats_.maxDip_mV);
+}
+
+/**
+ * @brief Returns a string for a result
+ */
+const char* PowerPath::ResultToString(PowerPathResult result)
+{
+    switch (result) {
+    case PP_OK:
+        return "Ok";
+    case PP_ALREADY_SELECTED:
+        return "AlreadySelected";
+    case PP_NO_RAIL_SENSE:
+        return "NoRailSense";
+    case PP_RAIL_READ_FAILED:
+        return "RailReadFailed";
+    case PP_BATTERY_FAULT:
+        return "BatteryFault";
+    case PP_BATTERY_STALE:
+        return "BatteryStale";
+    case PP_BATTERY_LOW:
+        return "BatteryLow";
+    case PP_RAIL_LOW:
+        return "RailLow";
+    case PP_UNVERIFIED:
+        return "Unverified";
+    default:
+        return "";
+    }
+}
@@ -5,55 +5,32 @@
  ******************************************************************************
 */
 #include "TelemetryTask.hpp"
+#include <cstring>
 #include "GPIO.hpp"
 #include "SystemDefines.hpp"
 #include "PMBProtocolTask.hpp"
 #include "FlightTask.hpp"
+#include "RuntimeStats.hpp"
+#include "StackMonitor.hpp"
 
 /**
  * @brief Constructor for TelemetryTask
  */
-TelemetryTask::TelemetryTask() : Task(TELEMETRY_TASK_QUEUE_DEPTH_OBJS)
+TelemetryTask::TelemetryTask() : StaticTask("TelemetryTask")
 {
     loggingDelayMs = TELEMETRY_DEFAULT_LOGGING_RATE_MS;
     numNonFlashLogs_ = 0;
     numNonControlLogs_ = 0;
 }
 
-/**
- * @brief Initialize the TelemetryTask
- */
-void TelemetryTask::InitTask()
-{
-    // Make sure the task is not already initialized
-    SOAR_ASSERT(rtTaskHandle == nullptr, "Cannot initialize telemetry task twice");
-
-    BaseType_t rtValue =
-        xTaskCreate((TaskFunction_t)TelemetryTask::RunTask,
-            (const char*)"TelemetryTask",
-            (uint16_t)TELEMETRY_TASK_STACK_DEPTH_WORDS,
-            (void*)this,
-            (UBaseType_t)TELEMETRY_TASK_RTOS_PRIORITY,
-            (TaskHandle_t*)&rtTaskHandle);
-
-    SOAR_ASSERT(rtValue == pdPASS, "TelemetryTask::InitTask() - xTaskCreate() failed");
-}
-
 /**
  * @brief Instance Run loop for the Telemetry Task, runs on scheduler start as long as the task is initialized.
  * @param pvParams RTOS Passed void parameters, contains a pointer to the object instance, should not be used
  */
 void TelemetryTask::Run(void* pvParams)
 {
-    while (1) {
-        //Process all commands in queue this cycle
-        Command cm;
-        while (qEvtQueue->Receive(cm))
-            HandleCommand(cm);
-
-        osDelay(loggingDelayMs);
-        RunLogSequence();
-    }
+    // Commands wait for the next log sequence, which runs every loggingDelayMs
+    RunPeriodic();
 }
 
 /**
@@ -66,6 +43,7 @@ void TelemetryTask::HandleCommand(Command& cm)
     switch (cm.GetCommand()) {
     case TELEMETRY_CHANGE_PERIOD: {
         loggingDelayMs = (uint16_t)cm.GetTaskCommand();
+        Watchdog::SetDeadline(watchdogId_, GetWatchdogDeadlineMs());
     break;
     }
     default:
@@ -86,6 +64,9 @@ void TelemetryTask::RunLogSequence()
     // Flight State
     FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_TRANSMIT_STATE));
 
+    // Battery Status
+    FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_TRANSMIT_BATTERY_STATUS));
+
     // Heartbeat Status (limited to every 2 seconds)
     if (++numNonControlLogs_ >= (TELEMETRY_HEARTBEAT_TIMER_PERIOD_MS / loggingDelayMs)) {
         numNonControlLogs_ = 0;
@@ -95,6 +76,12 @@ void TelemetryTask::RunLogSequence()
     // GPIO
     SendVentDrainStatus();
 
+    // CPU load and stack use, once per window
+    if (RuntimeStats::Update()) {
+        SendCpuLoad();
+        SendStackUsage();
+    }
+
     // Other Sensors
     RequestSample();
     RequestTransmit();
@@ -180,3 +167,62 @@ void TelemetryTask::SendVentDrainStatus()
     // Send the control message
     DMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
 }
+
+/**
+ * @brief Sends the per task CPU load of the last window to the RCU
+ */
+void TelemetryTask::SendCpuLoad()
+{
+    const RuntimeSnapshot snapshot = RuntimeStats::GetSnapshot();
+
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::CpuLoadStatus cpuMsg;
+    cpuMsg.set_window_ms(snapshot.window_us / 1000);
+    cpuMsg.set_idle_permille(snapshot.idle_permille);
+    cpuMsg.set_isr_permille(snapshot.isr_permille);
+    cpuMsg.set_untracked_tasks(snapshot.untrackedTasks);
+    cpuMsg.set_skipped_windows(snapshot.skippedWindows);
+    for (uint8_t i = 0; i < snapshot.taskCount; i++) {
+        Proto::TaskCpuLoad taskMsg;
+        taskMsg.set_task_number(snapshot.tasks[i].taskNumber);
+        taskMsg.set_priority(snapshot.tasks[i].priority);
+        taskMsg.set_load_permille(snapshot.tasks[i].load_permille);
+        taskMsg.mutable_name().set(snapshot.tasks[i].name, strlen(snapshot.tasks[i].name));
+        cpuMsg.add_tasks(taskMsg);
+    }
+    teleMsg.set_cpuLoadStatus(cpuMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
+
+/**
+ * @brief Sends the deepest stack use seen for each task to the RCU
+ */
+void TelemetryTask::SendStackUsage()
+{
+    const StackSnapshot snapshot = StackMonitor::GetSnapshot();
+
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::StackUsageStatus stackMsg;
+    for (uint8_t i = 0; i < snapshot.taskCount; i++) {
+        Proto::TaskStackUsage taskMsg;
+        taskMsg.set_task_number(snapshot.tasks[i].taskNumber);
+        taskMsg.set_size_words(snapshot.tasks[i].size_words);
+        taskMsg.set_min_free_words(snapshot.tasks[i].minFree_words);
+        taskMsg.mutable_name().set(snapshot.tasks[i].name, strlen(snapshot.tasks[i].name));
+        stackMsg.add_tasks(taskMsg);
+    }
+    teleMsg.set_stackUsageStatus(stackMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
@@ -0,0 +1,93 @@
+/**
+ ******************************************************************************
+ * File Name          : WatchdogTask.cpp
+ * Description        : Watchdog supervisor, refreshes the IWDG while every
+ *                      task keeps its deadline, tracks the RCU heartbeat.
+ ******************************************************************************
+*/
+#include "WatchdogTask.hpp"
+#include <cstring>
+#include "SystemDefines.hpp"
+#include "PMBProtocolTask.hpp"
+#include "Watchdog.hpp"
+
+/**
+ * @brief Constructor for WatchdogTask
+ */
+WatchdogTask::WatchdogTask() : StaticTask("WatchdogTask")
+{
+    lastRadioHeartbeat_ = 0;
+}
+
+/**
+ * @brief Instance Run loop for the Watchdog Task, starts the IWDG and supervises every WATCHDOG_SUPERVISE_PERIOD_MS
+ * @param pvParams RTOS Passed void parameters, contains a pointer to the object instance, should not be used
+ */
+void WatchdogTask::Run(void* pvParams)
+{
+    Watchdog::Start();
+    RunHybrid();
+}
+
+/**
+ * @brief Compares the task check-ins and refreshes the IWDG if every task is alive
+ */
+void WatchdogTask::OnPeriod()
+{
+    Watchdog::Supervise();
+}
+
+/**
+ * @brief Handles a command from the command queue
+ * @param cm Command to handle
+ */
+void WatchdogTask::HandleCommand(Command& cm)
+{
+    switch (cm.GetCommand()) {
+    case HEARTBEAT_COMMAND: {
+        if (cm.GetTaskCommand() == RADIOHB_REQUEST)
+            lastRadioHeartbeat_ = xTaskGetTickCount();
+        break;
+    }
+    case TASK_SPECIFIC_COMMAND: {
+        if (cm.GetTaskCommand() == HB_STATUS_SEND)
+            SendStatus();
+        break;
+    }
+    default:
+        SOAR_PRINT("WatchdogTask - Received Unsupported Command {%d}\n", cm.GetCommand());
+        break;
+    }
+
+    //No matter what we happens, we must reset allocated data
+    cm.Reset();
+}
+
+/**
+ * @brief Sends the supervision state, the last reset and the RCU heartbeat age to the RCU
+ */
+void WatchdogTask::SendStatus()
+{
+    const WatchdogStatus status = Watchdog::GetStatus();
+
+    Proto::TelemetryMessage teleMsg;
+    teleMsg.set_source(Proto::Node::NODE_PMB);
+    teleMsg.set_target(Proto::Node::NODE_RCU);
+    Proto::WatchdogStatus wdMsg;
+    wdMsg.set_alive_mask(status.aliveMask);
+    wdMsg.set_client_count(status.clientCount);
+    wdMsg.set_worst_margin_ms(status.worstMargin_ms);
+    wdMsg.set_radio_hb_age_ms((lastRadioHeartbeat_ == 0) ? UINT32_MAX : TICKS_TO_MS(xTaskGetTickCount() - lastRadioHeartbeat_));
+    wdMsg.mutable_reset_cause().set(status.resetCause, strlen(status.resetCause));
+    if (status.hasRecord) {
+        wdMsg.mutable_missed_task().set(status.record.name, strlen(status.record.name));
+        wdMsg.set_missed_overdue_ms(status.record.overdue_ms);
+        wdMsg.set_watchdog_reset_count(status.record.resetCount);
+    }
+    teleMsg.set_watchdogStatus(wdMsg);
+
+    EmbeddedProto::WriteBufferFixedSize<DEFAULT_PROTOCOL_WRITE_BUFFER_SIZE> writeBuffer;
+    teleMsg.serialize(writeBuffer);
+
+    PMBProtocolTask::SendProtobufMessage(writeBuffer, Proto::MessageID::MSG_TELEMETRY);
+}
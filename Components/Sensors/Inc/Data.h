@@ -1,11 +1,70 @@
 #ifndef AVIONICS_INCLUDE_SOAR_DATA_H
 #define AVIONICS_INCLUDE_SOAR_DATA_H
 
-#include "SystemDefines.hpp"
-#include "BatterySM.hpp"
+#include <cstdint>
+#include "BatteryConfig.hpp"
 
+/* Enums ------------------------------------------------------------------*/
+// DATA_COMMAND task commands carrying sensor samples to the battery state machine
+enum BATTERY_DATA_COMMANDS {
+    BATTERY_DATA_NONE = 0,
+    BMS_UPDATE,             // Data is a BMSData
+    CHARGER_UPDATE,         // Data is a ChargerData
+    FUEL_GAUGE_UPDATE,      // Data is a FuelGaugeData
+    BMS_ALERT               // No data, ALERT tripped the fast protection path, see FastProtection.hpp
+};
+
+/* Structs ------------------------------------------------------------------*/
+/**
+ * @brief One bq769x0 sample, sent on every CC_READY
+ */
+struct BMSData {
+    uint16_t cellVoltage_mV[BATTERY_NUM_CELLS];    // Cell voltages, cell 1 is the bottom of the stack
+    uint16_t packVoltage_mV;    // BAT register
+    int16_t ccReading;          // Raw CC register, positive is charging
+    int16_t temperature_dC;     // Pack temperature in 0.1C, TS1 through Thermistor::ToDeciCelsius
+    uint8_t sysStat;            // SYS_STAT register
+};
+
+/**
+ * @brief One LTC4015 telemetry sample
+ */
+struct ChargerData {
+    uint16_t inputVoltage_mV;
+    uint16_t batteryVoltage_mV;
+    int16_t chargeCurrent_mA;
+    int16_t dieTemperature_dC;
+    uint16_t chargerState;      // CHARGER_STATE register
+    uint16_t chargeStatus;      // CHARGE_STATUS register
+};
+
+/**
+ * @brief One bq34z100 sample
+ */
+struct FuelGaugeData {
+    uint8_t stateOfCharge_pct;
+    uint16_t remainingCapacity_mAh;
+    uint16_t fullChargeCapacity_mAh;
+    uint16_t voltage_mV;
+    int16_t averageCurrent_mA;
+    int16_t temperature_dC;
+};
+
+/**
+ * @brief Battery telemetry snapshot, filled by BatterySM
+ */
 struct BatteryStatus {
-	// fill
+    uint8_t state;              // BatteryState
+    uint8_t stateOfCharge_pct;  // EKF estimate
+    uint8_t coulombSoc_pct;     // Coulomb counter estimate
+    uint8_t stateOfHealth_pct;  // Worst of capacity and resistance based health
+    uint32_t maxCellResistance_uOhm;    // Highest cell DCIR, 0 until a current step is measured
+    int32_t current_mA;         // Offset corrected, positive is charging
+    uint32_t runtime_s;         // Time to cutoff at the present load, UINT32_MAX if not discharging
+    uint32_t peakRuntime_s;     // Time to cutoff at the peak load
+    uint32_t faultMask;         // Latched ProtectionLimit bits
+    uint8_t balanceMask;        // Cells bleeding right now, bit n is cell n
+    uint8_t balanceDuty_pct[BATTERY_NUM_CELLS];    // Recent balancing duty per cell
 };
 
 
@@ -0,0 +1,383 @@
+/**
+ ******************************************************************************
+ * File Name          : Benchmarks.cpp
+ * Description        : On-target cycle benchmarks for the battery algorithms.
+ ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "Benchmarks.hpp"
+#include "SystemDefines.hpp"
+#include "CoulombCounter.hpp"
+#include "SocEstimator.hpp"
+#include "OCVCurve.hpp"
+#include "FixedPoint.hpp"
+#include "Units.hpp"
+#include "Thermistor.hpp"
+#include "ProtectionEngine.hpp"
+#include "ChargeController.hpp"
+#include "RuntimePredictor.hpp"
+#include "CellStats.hpp"
+#include "BatterySM.hpp"
+
+/* Virtual Dispatch Baseline -----------------------------------------------------------------*/
+namespace
+{
+    /**
+     * @brief The virtual state interface BatterySM used before its transition table, kept as the dispatch baseline
+     */
+    class VirtualBatteryState
+    {
+    public:
+        virtual BatteryState HandleEvent(BatteryEvent event) = 0;
+        virtual BatteryState OnEnter() = 0;
+        virtual BatteryState OnExit() = 0;
+        virtual BatteryState GetStateID() = 0;
+    };
+
+    template<BatteryState ID>
+    class VirtualState : public VirtualBatteryState
+    {
+    public:
+        BatteryState HandleEvent(BatteryEvent event) override { return (event == BE_PROTECTION_FAULT) ? BS_FAULT : ID; }
+        BatteryState OnEnter() override { return ID; }
+        BatteryState OnExit() override { return ID; }
+        BatteryState GetStateID() override { return ID; }
+    };
+
+    VirtualState<BS_IDLE> virtualIdle;
+    VirtualState<BS_CHARGING> virtualCharging;
+    VirtualState<BS_DISCHARGING> virtualDischarging;
+    VirtualState<BS_FAULT> virtualFault;
+    VirtualBatteryState* const VIRTUAL_STATES[BS_NONE] = { &virtualIdle, &virtualCharging, &virtualDischarging, &virtualFault };
+    VirtualBatteryState* virtualCurrent = &virtualIdle;
+
+    /**
+     * @brief Same shape as the old HandleCommand and TransitionState
+     */
+    BatteryState VirtualDispatch(BatteryEvent event)
+    {
+        const BatteryState next = virtualCurrent->HandleEvent(event);
+        if (next == virtualCurrent->GetStateID() || next >= BS_NONE)
+            return virtualCurrent->GetStateID();
+
+        virtualCurrent->OnExit();
+        virtualCurrent = VIRTUAL_STATES[next];
+        virtualCurrent->OnEnter();
+        return virtualCurrent->GetStateID();
+    }
+}
+
+/* Functions -----------------------------------------------------------------*/
+/**
+ * @brief Runs every benchmark and prints the results
+ */
+void Benchmarks::RunAll()
+{
+    SOAR_PRINT("\n\t-- Benchmarks (cycles: min / avg / max) --\n");
+    CoulombCounterUpdate();
+    SocEstimatorUpdate();
+    CellStatsCompute();
+    ProtectionEvaluate();
+    ChargeControllerUpdate();
+    RuntimePredictorUpdate();
+    UnitConversions();
+    ThermistorConversion();
+    StateMachineDispatch();
+    ChargeProfileSimulation(250);
+    ChargeProfileSimulation(440);
+}
+
+/**
+ * @brief Prints the result of one benchmark
+ * @param name Name of the benchmark
+ * @param stats Cycle stats collected by CycleCounter::Measure
+ */
+void Benchmarks::PrintResult(const char* name, const CycleStats& stats)
+{
+    SOAR_PRINT("%-24s: %lu / %lu / %lu\n", name, stats.min, stats.Average(), stats.max);
+}
+
+/**
+ * @brief Cycles per CoulombCounter::Update on the discharge path
+ */
+void Benchmarks::CoulombCounterUpdate()
+{
+    static CoulombCounter cc;
+    cc.Update(0, Millivolts(3800), 250, true);
+
+    // Alternate temperature so the capacity recompute path is included in the max
+    const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+        cc.Update(-118 + (int16_t)(i & 0x7), Millivolts(3700), (i & 0x3F) ? 250 : 100, false);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("CoulombCounter::Update", stats);
+}
+
+/**
+ * @brief Cycles per SocEstimator::Update over a simulated discharge, and the SoC error at the end
+ *        The simulated cell uses the same 1RC model with the filter seeded 10% high.
+ */
+void Benchmarks::SocEstimatorUpdate()
+{
+    static SocEstimator ekf;
+    static int32_t cellSocQ30;
+    static int32_t cellVrc_uV;
+
+    cellSocQ30 = (int32_t)26214 << 15;    // 80%
+    cellVrc_uV = 0;
+    ekf.Reset(Millivolts(4100));        // ~90%
+
+    const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+        // Pulsed 1.5A / 0.3A load
+        const int32_t current_mA = (i & 0x20) ? -1500 : -300;
+        cellSocQ30 += (int32_t)(((int64_t)current_mA * EKF_SOC_PER_MA_Q40) >> 10);
+        cellVrc_uV = (int32_t)(((int64_t)cellVrc_uV * EKF_RC_DECAY_Q16 + (int64_t)current_mA * EKF_RC_GAIN_Q16) >> 16);
+        const int32_t cell_uV = OCVCurve::ToVoltage((uint16_t)(cellSocQ30 >> 15)).Value() + cellVrc_uV + EKF_R0_MOHM * current_mA;
+
+        ekf.Update(Milliamps(current_mA), Millivolts(cell_uV / 1000));
+    }, BENCHMARK_ITERATIONS * 8);
+
+    PrintResult("SocEstimator::Update", stats);
+
+    const int32_t error = (int32_t)ekf.GetStateOfChargeQ15() - (cellSocQ30 >> 15);
+    SOAR_PRINT("  SoC error after %d steps: %ld Q15 (sigma %u)\n", stats.count, error, ekf.GetSocStdDevQ15());
+}
+
+/**
+ * @brief Cycles per CellStats::Compute against separate min, max and sum scans over the same cells
+ */
+void Benchmarks::CellStatsCompute()
+{
+    static volatile uint16_t sink;
+    static uint16_t cells[BATTERY_NUM_CELLS];
+
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        cells[i] = 3700 + 3 * i;
+
+    const CycleStats singleStats = CycleCounter::Measure([](uint16_t i) {
+        cells[i % BATTERY_NUM_CELLS] ^= 0x40;    // Move the min and max around
+        const CellStats stats = CellStats::Compute(cells);
+        sink = stats.min_mV + stats.max_mV + stats.mean_mV;
+    }, BENCHMARK_ITERATIONS);
+
+    const CycleStats scanStats = CycleCounter::Measure([](uint16_t i) {
+        cells[i % BATTERY_NUM_CELLS] ^= 0x40;
+        uint16_t minCell = cells[0];
+        for (uint8_t c = 1; c < BATTERY_NUM_CELLS; c++)
+            minCell = (cells[c] < minCell) ? cells[c] : minCell;
+        uint16_t maxCell = cells[0];
+        for (uint8_t c = 1; c < BATTERY_NUM_CELLS; c++)
+            maxCell = (cells[c] > maxCell) ? cells[c] : maxCell;
+        uint32_t sum = 0;
+        for (uint8_t c = 0; c < BATTERY_NUM_CELLS; c++)
+            sum += cells[c];
+        sink = minCell + maxCell + (uint16_t)(sum / BATTERY_NUM_CELLS);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("CellStats (single pass)", singleStats);
+    PrintResult("CellStats (three scans)", scanStats);
+}
+
+/**
+ * @brief Cycles per ProtectionEngine::Evaluate (with the cell stats) in each state, these should all match
+ */
+void Benchmarks::ProtectionEvaluate()
+{
+    static ProtectionEngine protection;
+    static BMSData bms;
+    static BatteryState state;
+    static const char* const NAMES[BS_NONE] = { "Protection (Idle)", "Protection (Charging)", "Protection (Discharging)", "Protection (Fault)" };
+
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        bms.cellVoltage_mV[i] = 3700 + i;
+    bms.temperature_dC = 250;
+
+    for (uint8_t s = 0; s < BS_NONE; s++) {
+        state = (BatteryState)s;
+        const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+            bms.cellVoltage_mV[i & 0x3] ^= 0x40;    // Wiggle the cells so the min/max branches vary
+            protection.Evaluate(bms, CellStats::Compute(bms.cellVoltage_mV), Milliamps(-500), state);
+        }, BENCHMARK_ITERATIONS);
+        PrintResult(NAMES[s], stats);
+    }
+}
+
+/**
+ * @brief Cycles per RuntimePredictor::Update, the max is a sample that recomputes a runtime
+ */
+void Benchmarks::RuntimePredictorUpdate()
+{
+    static RuntimePredictor runtime;
+    static const uint16_t cellVoltage_mV[BATTERY_NUM_CELLS] = { 3720, 3700, 3710, 3690 };
+    static const CellStats cells = CellStats::Compute(cellVoltage_mV);
+
+    const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+        runtime.Update(Milliamps(-800 - (int32_t)(i & 0xFF)), cells, 16384, 3000, Units::FromMilliohms(30), false);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("RuntimePredictor::Update", stats);
+    SOAR_PRINT("  50%%, 0.9A: %lu s, peak %ld mA: %lu s\n", runtime.GetRuntimeSeconds(), runtime.GetPeakLoad().Value(), runtime.GetPeakRuntimeSeconds());
+}
+
+/**
+ * @brief Typed integer unit conversions against the float expressions they replace
+ *        Same inputs and the same three conversions (I*R drop, 0.1C to 0.1K, mdps to urad/s),
+ *        the float path runs through the soft-float library on the M0+.
+ */
+void Benchmarks::UnitConversions()
+{
+    static volatile int32_t sink;
+    static volatile int32_t current_mA = 1750;
+    static volatile int32_t resistance_uOhm = 41000;
+    static volatile int16_t temperature_dC = 287;
+    static volatile int32_t rate_mdps = 123456;
+
+    const CycleStats fixedStats = CycleCounter::Measure([](uint16_t i) {
+        const Millivolts drop = Units::VoltageDrop(Milliamps(current_mA + i), Microohms(resistance_uOhm));
+        const DeciKelvin temperature = Units::FromDeciCelsius(temperature_dC);
+        sink = drop.Value() + temperature.Value() + Units::MilliDpsToMicroRadps(rate_mdps);
+    }, BENCHMARK_ITERATIONS);
+
+    const CycleStats floatStats = CycleCounter::Measure([](uint16_t i) {
+        const float drop = (float)(current_mA + i) * (float)resistance_uOhm * 1e-6f;
+        const float temperature = (float)temperature_dC + 2731.5f;
+        sink = (int32_t)(drop + 0.5f) + (int32_t)(temperature + 0.5f) + (int32_t)((float)rate_mdps * 17.453292f);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("Units (fixed)", fixedStats);
+    PrintResult("Units (float)", floatStats);
+}
+
+/**
+ * @brief Cycles per Thermistor::ToDeciCelsius across the whole input range
+ */
+void Benchmarks::ThermistorConversion()
+{
+    static volatile int16_t sink;
+
+    const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+        sink = Thermistor::ToDeciCelsius((uint16_t)(i * 37));
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("Thermistor::ToDeciCelsius", stats);
+}
+
+/**
+ * @brief Cycles per ChargeController::Update
+ */
+void Benchmarks::ChargeControllerUpdate()
+{
+    static ChargeController charger;
+    static BMSData bms;
+    static CellStats cells;
+
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+        bms.cellVoltage_mV[i] = 3900 + 20 * i;
+    cells = CellStats::Compute(bms.cellVoltage_mV);
+
+    // Sweep the temperature through every zone
+    const CycleStats stats = CycleCounter::Measure([](uint16_t i) {
+        bms.temperature_dC = (int16_t)(i * 4) - 100;
+        charger.Update(bms, cells, Milliamps(1500), 16384, true);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("ChargeController::Update", stats);
+}
+
+/**
+ * @brief Cycles to dispatch one event through the BatterySM transition table against the virtual state classes
+ *        Idle with events its substate passes up and the parent handles in place, the every-sample case;
+ *        transitions print so they aren't timed.
+ */
+void Benchmarks::StateMachineDispatch()
+{
+    static BatterySM sm(BS_IDLE, false);
+    static const BatteryEvent EVENTS[] = { BE_CHARGE_INHIBIT, BE_STOP, BE_CLEAR_FAULT };
+    static volatile BatteryState sink;
+
+    const CycleStats tableStats = CycleCounter::Measure([](uint16_t i) {
+        sink = sm.Dispatch(EVENTS[i % 3]);
+    }, BENCHMARK_ITERATIONS);
+
+    const CycleStats virtualStats = CycleCounter::Measure([](uint16_t i) {
+        sink = VirtualDispatch(EVENTS[i % 3]);
+    }, BENCHMARK_ITERATIONS);
+
+    PrintResult("Dispatch (table)", tableStats);
+    PrintResult("Dispatch (virtual)", virtualStats);
+}
+
+/**
+ * @brief Charges a simulated pack from 10% with the charge controller driving an ideal CC/CV charger
+ *        Each cell is an OCV source with a series resistance; the pack is one thermal mass
+ *        (180J/K, 0.1W/K to ambient) heated by I^2R. Prints the charge time, peak temperature,
+ *        number of register writes and end of charge cell voltages.
+ * @param ambient_dC Ambient temperature
+ */
+void Benchmarks::ChargeProfileSimulation(int16_t ambient_dC)
+{
+    constexpr int32_t SAMPLES_PER_MAH = 3600000 / BMS_CC_SAMPLE_PERIOD_MS;    // Charge is kept in mA-samples
+    constexpr uint32_t MAX_SAMPLES = 6UL * 3600 * 1000 / BMS_CC_SAMPLE_PERIOD_MS;    // Give up after 6 hours
+    static const int32_t CELL_CAPACITY_MAH[BATTERY_NUM_CELLS] = { 3000, 3000, 2850, 3000 };
+    static const int32_t CELL_RESISTANCE_MOHM[BATTERY_NUM_CELLS] = { 30, 30, 35, 45 };
+    static const int32_t CELL_START_PCT[BATTERY_NUM_CELLS] = { 10, 10, 10, 13 };
+
+    static ChargeController charger;
+    charger = ChargeController();
+
+    int32_t cellCharge[BATTERY_NUM_CELLS];
+    int32_t resistanceSum_mOhm = 0;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        cellCharge[i] = CELL_CAPACITY_MAH[i] * SAMPLES_PER_MAH / 100 * CELL_START_PCT[i];
+        resistanceSum_mOhm += CELL_RESISTANCE_MOHM[i];
+    }
+
+    const int32_t ambient_uK = (int32_t)ambient_dC * 100000;
+    int32_t temperature_uK = ambient_uK;
+    int32_t peakTemperature_uK = temperature_uK;
+    int32_t current_mA = 0;
+    uint16_t writes = 0;
+    BMSData bms = {};
+
+    uint32_t sample = 0;
+    for (; sample < MAX_SAMPLES && !charger.IsTerminated(); sample++) {
+        // Cell voltages and SoC (taken from the most charged cell, as a gauge would report the pack)
+        int32_t ocvSum_uV = 0;
+        uint16_t socQ15 = 0;
+        int32_t cellOcv_uV[BATTERY_NUM_CELLS];
+        for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+            const int32_t cellSocQ15 = FixedPoint::Clamp<int32_t>((int32_t)(((int64_t)cellCharge[i] << 15) / (CELL_CAPACITY_MAH[i] * SAMPLES_PER_MAH)), 0, Q15_ONE);
+            cellOcv_uV[i] = OCVCurve::ToVoltage((uint16_t)cellSocQ15).Value();
+            ocvSum_uV += cellOcv_uV[i];
+            socQ15 = ((uint16_t)cellSocQ15 > socQ15) ? (uint16_t)cellSocQ15 : socQ15;
+            bms.cellVoltage_mV[i] = (uint16_t)((cellOcv_uV[i] + current_mA * CELL_RESISTANCE_MOHM[i]) / 1000);
+        }
+        bms.temperature_dC = (int16_t)(temperature_uK / 100000);
+
+        if (charger.Update(bms, CellStats::Compute(bms.cellVoltage_mV), Milliamps(current_mA), socQ15, true))
+            writes++;
+
+        // Ideal charger, constant current until the pack reaches the CV target
+        const ChargeSetpoint& setpoint = charger.GetSetpoint();
+        current_mA = 0;
+        if (!setpoint.suspend) {
+            const int32_t headroom_uV = (int32_t)setpoint.cellVoltage_mV * 1000 * BATTERY_NUM_CELLS - ocvSum_uV;
+            const int32_t cvCurrent_mA = (headroom_uV > 0) ? headroom_uV / resistanceSum_mOhm : 0;
+            current_mA = (cvCurrent_mA < setpoint.current_mA) ? cvCurrent_mA : setpoint.current_mA;
+        }
+
+        for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+            cellCharge[i] += current_mA;
+
+        // I^2R heating against a fixed conductance to ambient, in uW, uJ and uK
+        const int32_t heat_uW = current_mA * current_mA / 1000 * resistanceSum_mOhm;
+        const int32_t cooling_uW = (temperature_uK - ambient_uK) / 10;
+        temperature_uK += (heat_uW - cooling_uW) / 4 / 180;
+        peakTemperature_uK = (temperature_uK > peakTemperature_uK) ? temperature_uK : peakTemperature_uK;
+    }
+
+    SOAR_PRINT("Charge sim @ %d dC: %lu min, peak %ld dC, %u writes, zone %u, %s\n", ambient_dC,
+        sample * BMS_CC_SAMPLE_PERIOD_MS / 60000, peakTemperature_uK / 100000, writes, charger.GetZone(),
+        charger.IsTerminated() ? "terminated" : "timed out");
+    SOAR_PRINT("  Cells (mV): %u %u %u %u\n", bms.cellVoltage_mV[0], bms.cellVoltage_mV[1], bms.cellVoltage_mV[2], bms.cellVoltage_mV[3]);
+}
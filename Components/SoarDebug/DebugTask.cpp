@@ -25,6 +25,15 @@
 #include "BatteryTask.hpp"
 #include "GPSTask.hpp"
 #include "FlashTask.hpp"
+#include "Benchmarks.hpp"
+#include "FastProtection.hpp"
+#include "RuntimeStats.hpp"
+#include "StackMonitor.hpp"
+#include "LowPower.hpp"
+#include "Watchdog.hpp"
+#include "TimerWheel.hpp"
+#include "HighResTimer.hpp"
+#include "SystemStorage.hpp"
 /* Macros --------------------------------------------------------------------*/
 
 /* Structs -------------------------------------------------------------------*/
@@ -52,7 +61,7 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
 /**
  * @brief Constructor, sets all member variables
  */
-DebugTask::DebugTask() : Task(TASK_DEBUG_QUEUE_DEPTH_OBJS), kUart_(UART::Debug)
+DebugTask::DebugTask() : StaticTask("DebugTask"), kUart_(UART::Debug)
 {
     memset(debugBuffer, 0, sizeof(debugBuffer));
     debugMsgIdx = 0;
@@ -64,20 +73,8 @@ DebugTask::DebugTask() : Task(TASK_DEBUG_QUEUE_DEPTH_OBJS), kUart_(UART::Debug)
  */
 void DebugTask::InitTask()
 {
-    // Make sure the task is not already initialized
-    SOAR_ASSERT(rtTaskHandle == nullptr, "Cannot initialize Debug task twice");
-
     // Start the task
-    BaseType_t rtValue =
-        xTaskCreate((TaskFunction_t)DebugTask::RunTask,
-            (const char*)"DebugTask",
-            (uint16_t)TASK_DEBUG_STACK_DEPTH_WORDS,
-            (void*)this,
-            (UBaseType_t)TASK_DEBUG_PRIORITY,
-            (TaskHandle_t*)&rtTaskHandle);
-
-    //Ensure creation succeded
-    SOAR_ASSERT(rtValue == pdPASS, "DebugTask::InitTask - xTaskCreate() failed");
+    StaticTask::InitTask();
 }
 
 // TODO: Only run thread when appropriate GPIO pin pulled HIGH (or by define)
@@ -89,19 +86,21 @@ void DebugTask::Run(void * pvParams)
     // Arm the interrupt
     ReceiveData();
 
-    while (1) {
-        Command cm;
-
-        //Wait forever for a command
-        qEvtQueue->ReceiveWait(cm);
-
-        //Process the command
-        if(cm.GetCommand() == DATA_COMMAND && cm.GetTaskCommand() == EVENT_DEBUG_RX_COMPLETE) {
-            HandleDebugMessage((const char*)debugBuffer);
-        }
+    //Wait forever for each command
+    RunBlocking();
+}
 
-        cm.Reset();
+/**
+ * @brief Handles a command from the event queue
+ * @param cm Command to handle
+ */
+void DebugTask::HandleCommand(Command& cm)
+{
+    if(cm.GetCommand() == DATA_COMMAND && cm.GetTaskCommand() == EVENT_DEBUG_RX_COMPLETE) {
+        HandleDebugMessage((const char*)debugBuffer);
     }
+
+    cm.Reset();
 }
 
 /**
@@ -111,9 +110,29 @@ void DebugTask::Run(void * pvParams)
 void DebugTask::HandleDebugMessage(const char* msg)
 {
     //-- PARAMETRIZED COMMANDS -- (Must be first)
+    if (strncmp(msg, "bsm ", 4) == 0) {
+        // Operator battery command by name, e.g. "bsm Charge", same path and checks as over the radio
+        uint8_t command = 0;
+        while (command < BRC_COUNT && strcmp(msg + 4, BatterySM::RemoteCommandToString(command)) != 0)
+            command++;
+        if (command < BRC_COUNT)
+            FlightTask::Inst().SendBatteryRemoteCommand((BatteryRemoteCommand)command);
+        else
+            SOAR_PRINT("Debug, unknown battery command: %s\n", msg + 4);
+    }
+    else if (strncmp(msg, "lpmode ", 7) == 0) {
+        // Deepest idle state, e.g. "lpmode sleep", also restarts the "lowpower" measurement
+        uint8_t lpMode = LP_MODE_RUN;
+        while (lpMode <= LP_MODE_STOP && strcmp(msg + 7, LowPower::ModeToString((LowPowerMode)lpMode)) != 0)
+            lpMode++;
+        if (lpMode <= LP_MODE_STOP)
+            LowPower::SetMode((LowPowerMode)lpMode);
+        else
+            SOAR_PRINT("Debug, unknown low power mode: %s\n", msg + 7);
+    }
 
     //-- SYSTEM / CHAR COMMANDS -- (Must be last)
-    if (strcmp(msg, "sysreset") == 0) {
+    else if (strcmp(msg, "sysreset") == 0) {
         // Reset the system
         SOAR_ASSERT(false, "System reset requested");
     }
@@ -122,7 +141,49 @@ void DebugTask::HandleDebugMessage(const char* msg)
         SOAR_PRINT("\n\t-- SOAR System Info --\n");
         SOAR_PRINT("Current System Heap Use: %d Bytes\n", xPortGetFreeHeapSize());
         SOAR_PRINT("Lowest Ever Heap Size\t: %d Bytes\n", xPortGetMinimumEverFreeHeapSize());
-        SOAR_PRINT("Debug Task Runtime  \t: %d ms\n\n", TICKS_TO_MS(xTaskGetTickCount()));
+        SOAR_PRINT("Debug Task Runtime  \t: %d ms\n", TICKS_TO_MS(xTaskGetTickCount()));
+        SystemStorage::Inst().PrintStats();
+        StackMonitor::PrintSummary();
+    }
+    else if (strcmp(msg, "stackhdr") == 0) {
+        // Recommended stack depths from the deepest use seen so far
+        StackMonitor::PrintRecommendations();
+    }
+    else if (strcmp(msg, "bench") == 0) {
+        // Run the on-target cycle benchmarks
+        Benchmarks::RunAll();
+    }
+    else if (strcmp(msg, "bsmlog") == 0) {
+        // Battery transition journal, printed by the flight task so it reads a consistent journal
+        FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_PRINT_BATTERY_JOURNAL));
+    }
+    else if (strcmp(msg, "fastprot") == 0) {
+        // ALERT fast path counters and measured response times
+        FastProtection::PrintStats();
+    }
+    else if (strcmp(msg, "top") == 0) {
+        // Per task CPU load over the last telemetry window
+        RuntimeStats::PrintTop();
+    }
+    else if (strcmp(msg, "lowpower") == 0) {
+        // Time spent in run, WFI and STOP1 since the last "lpmode"
+        LowPower::PrintStats();
+    }
+    else if (strcmp(msg, "watchdog") == 0) {
+        // Supervised tasks, their deadlines and the cause of the last reset
+        Watchdog::PrintStatus();
+    }
+    else if (strcmp(msg, "timers") == 0) {
+        // Timer wheel occupancy and expiry lateness
+        TimerWheel::Inst().PrintStats();
+    }
+    else if (strcmp(msg, "hrt") == 0) {
+        // High resolution timer lateness under a test load, blocks the debug task while it runs
+        HighResTimer::RunJitterTest();
+    }
+    else if (strcmp(msg, "powerpath") == 0) {
+        // Power source and switchover stats, printed by the flight task which does the switching
+        FlightTask::Inst().SendCommand(Command(REQUEST_COMMAND, (uint16_t)FT_REQUEST_PRINT_POWER_PATH));
     }
     else if (strcmp(msg, "blinkled") == 0) {
         // Print message
@@ -0,0 +1,36 @@
+/**
+ ******************************************************************************
+ * File Name          : Benchmarks.hpp
+ * Description        : On-target cycle benchmarks, run from the debug console
+ *                      with the 'bench' command.
+ ******************************************************************************
+*/
+#ifndef SOAR_SYSTEM_BENCHMARKS_HPP_
+#define SOAR_SYSTEM_BENCHMARKS_HPP_
+/* Includes ------------------------------------------------------------------*/
+#include "CycleCounter.hpp"
+
+/* Macros ------------------------------------------------------------------*/
+constexpr uint16_t BENCHMARK_ITERATIONS = 256;    // Number of measured calls per benchmark
+
+/* Functions ------------------------------------------------------------------*/
+namespace Benchmarks
+{
+    void RunAll();
+
+    void PrintResult(const char* name, const CycleStats& stats);
+
+    // Individual benchmarks
+    void CoulombCounterUpdate();
+    void SocEstimatorUpdate();
+    void CellStatsCompute();
+    void ProtectionEvaluate();
+    void ChargeControllerUpdate();
+    void RuntimePredictorUpdate();
+    void UnitConversions();
+    void ThermistorConversion();
+    void StateMachineDispatch();
+    void ChargeProfileSimulation(int16_t ambient_dC);
+}
+
+#endif    // SOAR_SYSTEM_BENCHMARKS_HPP_
@@ -7,7 +7,7 @@
 #ifndef SOAR_SYSTEM_DEBUG_TASK_HPP_
 #define SOAR_SYSTEM_DEBUG_TASK_HPP_
 /* Includes ------------------------------------------------------------------*/
-#include "Task.hpp"
+#include "StaticTask.hpp"
 #include "SystemDefines.hpp"
 #include "UARTDriver.hpp"
 
@@ -21,27 +21,22 @@ enum DEBUG_TASK_COMMANDS {
 constexpr uint16_t DEBUG_RX_BUFFER_SZ_BYTES = 16;
 
 /* Class ------------------------------------------------------------------*/
-class DebugTask : public Task, public UARTReceiverBase
+class DebugTask : public StaticTask<DebugTask, TASK_DEBUG_PRIORITY, TASK_DEBUG_STACK_DEPTH_WORDS, TASK_DEBUG_QUEUE_DEPTH_OBJS>, public UARTReceiverBase
 {
-public:
-    static DebugTask& Inst() {
-        static DebugTask inst;
-        return inst;
-    }
+    friend StaticTask;
 
+public:
     void InitTask();
 
     // Interrupt receive callback
     void InterruptRxData(uint8_t errors);
 
 protected:
-    static void RunTask(void* pvParams) { DebugTask::Inst().Run(pvParams); } // Static Task Interface, passes control to the instance Run();
-
     void Run(void* pvParams);    // Main run code
 
     void ConfigureUART();
     void HandleDebugMessage(const char* msg);
-    //void HandleCommand(Command& cm);
+    void HandleCommand(Command& cm);
 
     bool ReceiveData();
 
@@ -59,8 +54,6 @@ protected:
 
 private:
     DebugTask(); // Private constructor
-    DebugTask(const DebugTask&);                    // Prevent copy-construction
-    DebugTask& operator=(const DebugTask&);            // Prevent assignment
 };
 
 #endif    // SOAR_SYSTEM_DEBUG_TASK_HPP_
@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * File Name          : RuntimeStats.hpp
+ * Description        : Per task CPU load from the FreeRTOS run time counters,
+ *                      printed by the 'top' debug command and sent as telemetry.
+ *
+ *    The run time counter is TIM2, free running at 1 MHz. FreeRTOS charges
+ *    each task the counter time it was switched in for. Loads are worked out
+ *    over a window, the difference between two samples of every task's
+ *    counter, so the 32 bit counters wrapping every ~71 minutes doesn't
+ *    matter as long as a window is shorter than that. Everything is integer
+ *    permille, nothing is formatted until someone asks for 'top'.
+ *
+ *    Interrupt time is charged by FreeRTOS to whichever task was interrupted.
+ *    ISR handlers that bracket their body with IsrEnter()/IsrExit() are also
+ *    counted on their own, which gives the ISR load estimate. The kernel's
+ *    SysTick and PendSV handlers aren't bracketed, so the estimate is low by
+ *    their share, a few us per tick.
+ ******************************************************************************
+*/
+#ifndef SOAR_SYSTEM_RUNTIME_STATS_HPP_
+#define SOAR_SYSTEM_RUNTIME_STATS_HPP_
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include "cmsis_os.h"
+
+/* Macros ------------------------------------------------------------------*/
+constexpr uint32_t RUNTIME_STATS_TIMER_HZ = 1000000;        // TIM2 count rate, 1 us resolution
+constexpr uint32_t RUNTIME_STATS_WINDOW_MS = 5000;          // Load is averaged over this long, also the telemetry period
+constexpr uint8_t RUNTIME_STATS_MAX_TASKS = 12;             // Tasks in the snapshot, the rest are counted in untrackedTasks
+constexpr uint8_t RUNTIME_STATS_MAX_SYSTEM_TASKS = 24;      // Tasks read from the kernel, a window with more is skipped
+
+/* Structs -------------------------------------------------------------------*/
+struct TaskLoad {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t taskNumber;             // FreeRTOS task number, stable for the life of the task
+    uint8_t priority;               // Current priority
+    uint16_t load_permille;         // Share of the window this task was running
+};
+
+struct RuntimeSnapshot {
+    uint32_t window_us;             // Counter time covered by the snapshot, 0 until the first window closes
+    uint16_t idle_permille;         // Idle task share
+    uint16_t isr_permille;          // Bracketed ISR share, also included in the task it interrupted
+    uint8_t taskCount;
+    uint8_t untrackedTasks;         // Running tasks that didn't fit in tasks, still counted in idle_permille
+    uint32_t skippedWindows;        // Windows not sampled as there were more than RUNTIME_STATS_MAX_SYSTEM_TASKS tasks
+    TaskLoad tasks[RUNTIME_STATS_MAX_TASKS];    // Idle task included, in the order the kernel lists them
+};
+
+/* Functions ------------------------------------------------------------------*/
+namespace RuntimeStats
+{
+    void ConfigureTimer();          // portCONFIGURE_TIMER_FOR_RUN_TIME_STATS, called once by the scheduler start
+    uint32_t Counter();             // portGET_RUN_TIME_COUNTER_VALUE
+    void Advance(uint32_t us);      // After STOP1, which TIM2 doesn't count through
+
+    void IsrEnter();                // First thing in a bracketed ISR
+    void IsrExit();                 // Last thing in a bracketed ISR
+
+    bool Update();                  // Closes the window if it's due, true if a new snapshot is ready
+    RuntimeSnapshot GetSnapshot();
+    void PrintTop();
+}
+
+#endif    // SOAR_SYSTEM_RUNTIME_STATS_HPP_
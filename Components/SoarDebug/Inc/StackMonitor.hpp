@@ -0,0 +1,54 @@
+/**
+ ******************************************************************************
+ * File Name          : StackMonitor.hpp
+ * Description        : Lifetime stack high water marks for every task, with
+ *                      recommended stack depths.
+ *
+ *    Sampled with the CPU load window, from the same uxTaskGetSystemState
+ *    walk, so it costs no extra pass over the stacks. The smallest free
+ *    space ever seen is kept per task, reported in "sysinfo" and telemetry.
+ *
+ *    "stackhdr" prints a header of recommended *_STACK_DEPTH_WORDS values:
+ *    the words used so far plus STACK_MONITOR_MARGIN_PERCENT, at least
+ *    STACK_MONITOR_MIN_HEADROOM_WORDS, rounded up. It's only as good as the
+ *    code paths that have run, take it after a full bench session (charge,
+ *    discharge, faults, debug commands) and not after a quick boot.
+ ******************************************************************************
+*/
+#ifndef SOAR_SYSTEM_STACK_MONITOR_HPP_
+#define SOAR_SYSTEM_STACK_MONITOR_HPP_
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include "cmsis_os.h"
+#include "RuntimeStats.hpp"
+
+/* Macros ------------------------------------------------------------------*/
+constexpr uint8_t STACK_MONITOR_MARGIN_PERCENT = 25;          // Added on top of the deepest use seen
+constexpr uint16_t STACK_MONITOR_MIN_HEADROOM_WORDS = 32;     // Margin never below this, an interrupt frame plus a HAL call
+constexpr uint16_t STACK_MONITOR_ROUND_WORDS = 16;            // Recommendations are a multiple of this
+
+/* Structs -------------------------------------------------------------------*/
+struct TaskStackUsage {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t taskNumber;
+    uint16_t size_words;            // Configured depth, 0 if the task isn't in the budget table
+    uint16_t minFree_words;         // Lowest free space ever sampled
+};
+
+struct StackSnapshot {
+    uint8_t taskCount;
+    TaskStackUsage tasks[RUNTIME_STATS_MAX_TASKS];
+};
+
+/* Functions ------------------------------------------------------------------*/
+namespace StackMonitor
+{
+    void Record(const TaskStatus_t* status, uint8_t count);    // From RuntimeStats::Update
+    StackSnapshot GetSnapshot();
+
+    uint16_t Recommend(uint16_t size_words, uint16_t minFree_words);
+    void PrintSummary();
+    void PrintRecommendations();
+}
+
+#endif    // SOAR_SYSTEM_STACK_MONITOR_HPP_
@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * File Name          : RuntimeStats.cpp
+ * Description        : Per task CPU load from the FreeRTOS run time counters.
+ ******************************************************************************
+*/
+#include "RuntimeStats.hpp"
+#include <cstring>
+#include "SystemDefines.hpp"
+#include "StackMonitor.hpp"
+
+/* Structs -------------------------------------------------------------------*/
+struct TaskRunTime {
+    UBaseType_t taskNumber;
+    uint32_t runTime;               // Counter at the start of the window
+};
+
+/* Variables -----------------------------------------------------------------*/
+static volatile uint32_t isrDepth = 0;      // Nesting, only the outermost ISR adds its time
+static volatile uint32_t isrEntry = 0;
+static volatile uint32_t isrTotal = 0;      // Counter time spent in bracketed ISRs, wraps with the counter
+
+// Only touched by Update(), which always runs in the same task, snapshot is copied out with the scheduler suspended
+static TaskStatus_t status[RUNTIME_STATS_MAX_SYSTEM_TASKS];
+static TaskRunTime previous[RUNTIME_STATS_MAX_SYSTEM_TASKS];
+static uint8_t previousCount = 0;
+static uint32_t windowStart = 0;
+static uint32_t windowStartIsr = 0;
+static bool started = false;           // windowStart and previous hold a sample
+static uint32_t lastAttempt = 0;        // Counter at the last sample, taken or skipped
+static bool attempted = false;
+static RuntimeSnapshot snapshot = {};
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Starts TIM2 free running at RUNTIME_STATS_TIMER_HZ, the timer clock is PCLK (APB prescaler 1)
+ */
+void RuntimeStats::ConfigureTimer()
+{
+    RCC->APBENR1 |= RCC_APBENR1_TIM2EN;
+    (void)RCC->APBENR1;    // Clock enable takes effect before the first register write
+
+    TIM2->CR1 = 0;
+    TIM2->PSC = (SystemCoreClock / RUNTIME_STATS_TIMER_HZ) - 1;
+    TIM2->ARR = 0xFFFFFFFF;
+    TIM2->EGR = TIM_EGR_UG;    // Load the prescaler now rather than at the first overflow
+    TIM2->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Current run time counter
+ */
+uint32_t RuntimeStats::Counter()
+{
+    return TIM2->CNT;
+}
+
+/**
+ * @brief Moves the counter on by time TIM2 didn't see, the bus clock is off in STOP1
+ *        Call with interrupts masked.
+ * @param us Time to add
+ */
+void RuntimeStats::Advance(uint32_t us)
+{
+    TIM2->CNT += us;
+}
+
+/**
+ * @brief Marks the start of a bracketed ISR
+ */
+void RuntimeStats::IsrEnter()
+{
+    if (isrDepth++ == 0)
+        isrEntry = TIM2->CNT;
+}
+
+/**
+ * @brief Marks the end of a bracketed ISR, the outermost one adds its time
+ */
+void RuntimeStats::IsrExit()
+{
+    if (--isrDepth == 0)
+        isrTotal += TIM2->CNT - isrEntry;
+}
+
+/**
+ * @brief Closes the load window once RUNTIME_STATS_WINDOW_MS has passed and works out the new snapshot
+ *        Always call from the same task.
+ * @return true if the snapshot was updated
+ */
+bool RuntimeStats::Update()
+{
+    const uint32_t now = TIM2->CNT;
+    if (attempted && (now - lastAttempt) < RUNTIME_STATS_WINDOW_MS * (RUNTIME_STATS_TIMER_HZ / 1000))
+        return false;
+    attempted = true;
+    lastAttempt = now;
+
+    // uxTaskGetSystemState fills nothing if the array is too small, so with more tasks than it holds the
+    // window is skipped and counted, the next snapshot then covers it as well
+    uint32_t totalRunTime;
+    UBaseType_t count = 0;
+    if (uxTaskGetNumberOfTasks() <= RUNTIME_STATS_MAX_SYSTEM_TASKS)
+        count = uxTaskGetSystemState(status, RUNTIME_STATS_MAX_SYSTEM_TASKS, &totalRunTime);
+    if (count == 0) {
+        snapshot.skippedWindows++;
+        return false;
+    }
+    const uint32_t isrNow = isrTotal;
+
+    // The walk filled in the stack high water marks as well
+    StackMonitor::Record(status, (uint8_t)count);
+
+    const uint32_t window = totalRunTime - windowStart;
+    if (started && window > 0) {
+        const TaskHandle_t idle = xTaskGetIdleTaskHandle();
+        snapshot.window_us = (uint32_t)(((uint64_t)window * 1000000) / RUNTIME_STATS_TIMER_HZ);
+        snapshot.isr_permille = (uint16_t)(((uint64_t)(isrNow - windowStartIsr) * 1000) / window);
+        snapshot.idle_permille = 0;
+        snapshot.taskCount = 0;
+        snapshot.untrackedTasks = 0;
+
+        for (UBaseType_t i = 0; i < count; i++) {
+            // Tasks created during the window count from zero
+            uint32_t before = 0;
+            for (uint8_t j = 0; j < previousCount; j++) {
+                if (previous[j].taskNumber == status[i].xTaskNumber) {
+                    before = previous[j].runTime;
+                    break;
+                }
+            }
+            const uint16_t load_permille = (uint16_t)(((uint64_t)(status[i].ulRunTimeCounter - before) * 1000) / window);
+
+            if (status[i].xHandle == idle)
+                snapshot.idle_permille = load_permille;
+
+            // Past the snapshot's size the rest are only counted
+            if (snapshot.taskCount >= RUNTIME_STATS_MAX_TASKS) {
+                snapshot.untrackedTasks++;
+                continue;
+            }
+
+            TaskLoad& load = snapshot.tasks[snapshot.taskCount++];
+            strncpy(load.name, status[i].pcTaskName, sizeof(load.name) - 1);
+            load.name[sizeof(load.name) - 1] = '\0';
+            load.taskNumber = (uint8_t)status[i].xTaskNumber;
+            load.priority = (uint8_t)status[i].uxCurrentPriority;
+            load.load_permille = load_permille;
+        }
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        previous[i].taskNumber = status[i].xTaskNumber;
+        previous[i].runTime = status[i].ulRunTimeCounter;
+    }
+    previousCount = (uint8_t)count;
+    windowStart = totalRunTime;
+    windowStartIsr = isrNow;
+
+    const bool updated = started;
+    started = true;
+    return updated;
+}
+
+/**
+ * @brief Consistent copy of the latest snapshot, safe from any task, window_us is 0 until the first window has closed
+ */
+RuntimeSnapshot RuntimeStats::GetSnapshot()
+{
+    vTaskSuspendAll();
+    const RuntimeSnapshot copy = snapshot;
+    xTaskResumeAll();
+    return copy;
+}
+
+/**
+ * @brief Prints the latest snapshot on the debug console
+ */
+void RuntimeStats::PrintTop()
+{
+    const RuntimeSnapshot s = GetSnapshot();
+    if (s.window_us == 0) {
+        SOAR_PRINT("CPU load not sampled yet, the first window closes %lu ms after boot\n", (unsigned long)RUNTIME_STATS_WINDOW_MS);
+        return;
+    }
+
+    SOAR_PRINT("\n\t-- CPU over %lu ms --\n", (unsigned long)(s.window_us / 1000));
+    SOAR_PRINT("  #  Pri  Load    Task\n");
+    for (uint8_t i = 0; i < s.taskCount; i++) {
+        const TaskLoad& t = s.tasks[i];
+        SOAR_PRINT("%3u  %3u  %3u.%u%%  %s\n", t.taskNumber, t.priority,
+            t.load_permille / 10, t.load_permille % 10, t.name);
+    }
+    SOAR_PRINT("Idle %u.%u%%, ISR %u.%u%% (estimate, counted in the tasks above too)\n\n",
+        s.idle_permille / 10, s.idle_permille % 10,
+        s.isr_permille / 10, s.isr_permille % 10);
+    if (s.untrackedTasks > 0 || s.skippedWindows > 0)
+        SOAR_PRINT("%u more tasks not listed, %lu windows skipped with more than %u tasks\n\n",
+            s.untrackedTasks, (unsigned long)s.skippedWindows, RUNTIME_STATS_MAX_SYSTEM_TASKS);
+}
+
+/* FreeRTOS Hooks ------------------------------------------------------------------*/
+extern "C" {
+    void RuntimeStats_ConfigureTimer(void)
+    {
+        RuntimeStats::ConfigureTimer();
+    }
+
+    uint32_t RuntimeStats_GetCounter(void)
+    {
+        return TIM2->CNT;
+    }
+}
@@ -0,0 +1,167 @@
+/**
+ ******************************************************************************
+ * File Name          : StackMonitor.cpp
+ * Description        : Lifetime stack high water marks and recommended depths.
+ ******************************************************************************
+*/
+#include "StackMonitor.hpp"
+#include <cstring>
+#include "SystemDefines.hpp"
+#include "ProtocolTask.hpp"
+
+/* Structs -------------------------------------------------------------------*/
+struct StackBudget {
+    const char* taskName;           // As given to the RTOS
+    const char* constantName;       // What sets its depth
+    uint16_t size_words;
+    bool isConfigDefine;            // A FreeRTOSConfig.h define rather than a constexpr
+};
+
+/* Constants -----------------------------------------------------------------*/
+static const StackBudget BUDGETS[] = {
+    { "FlightTask", "FLIGHT_TASK_STACK_DEPTH_WORDS", FLIGHT_TASK_STACK_DEPTH_WORDS, false },
+    { "UARTTask", "UART_TASK_STACK_DEPTH_WORDS", UART_TASK_STACK_DEPTH_WORDS, false },
+    { "DebugTask", "TASK_DEBUG_STACK_DEPTH_WORDS", TASK_DEBUG_STACK_DEPTH_WORDS, false },
+    { "TelemetryTask", "TELEMETRY_TASK_STACK_DEPTH_WORDS", TELEMETRY_TASK_STACK_DEPTH_WORDS, false },
+    { "StorageTask", "STORAGE_TASK_STACK_DEPTH_WORDS", STORAGE_TASK_STACK_DEPTH_WORDS, false },
+    { "WatchdogTask", "WATCHDOG_TASK_STACK_DEPTH_WORDS", WATCHDOG_TASK_STACK_DEPTH_WORDS, false },
+    { "TimerWheel", "TIMER_WHEEL_TASK_STACK_DEPTH_WORDS", TIMER_WHEEL_TASK_STACK_DEPTH_WORDS, false },
+    { "ProtocolTask", "TASK_PROTOCOL_STACK_DEPTH_WORDS", TASK_PROTOCOL_STACK_DEPTH_WORDS, false },
+    { configIDLE_TASK_NAME, "configMINIMAL_STACK_SIZE", configMINIMAL_STACK_SIZE, true },
+    { configTIMER_SERVICE_TASK_NAME, "configTIMER_TASK_STACK_DEPTH", configTIMER_TASK_STACK_DEPTH, true },
+};
+constexpr uint8_t NUM_BUDGETS = sizeof(BUDGETS) / sizeof(BUDGETS[0]);
+
+/* Variables -----------------------------------------------------------------*/
+static StackSnapshot stacks = {};   // Written by Record() only, copied out with the scheduler suspended
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Budget table entry for a task
+ * @return nullptr if the task isn't in the table
+ */
+static const StackBudget* FindBudget(const char* taskName)
+{
+    for (uint8_t i = 0; i < NUM_BUDGETS; i++) {
+        if (strcmp(BUDGETS[i].taskName, taskName) == 0)
+            return &BUDGETS[i];
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Folds a uxTaskGetSystemState sample into the lifetime minimums
+ * @param status Task states, with the stack high water marks filled in
+ * @param count Number of entries
+ */
+void StackMonitor::Record(const TaskStatus_t* status, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t t = 0;
+        while (t < stacks.taskCount && stacks.tasks[t].taskNumber != status[i].xTaskNumber)
+            t++;
+
+        if (t == stacks.taskCount) {
+            if (stacks.taskCount >= RUNTIME_STATS_MAX_TASKS)
+                continue;
+
+            const StackBudget* budget = FindBudget(status[i].pcTaskName);
+            TaskStackUsage& usage = stacks.tasks[stacks.taskCount++];
+            strncpy(usage.name, status[i].pcTaskName, sizeof(usage.name) - 1);
+            usage.name[sizeof(usage.name) - 1] = '\0';
+            usage.taskNumber = (uint8_t)status[i].xTaskNumber;
+            usage.size_words = (budget != nullptr) ? budget->size_words : 0;
+            usage.minFree_words = status[i].usStackHighWaterMark;
+        }
+        else if (status[i].usStackHighWaterMark < stacks.tasks[t].minFree_words) {
+            stacks.tasks[t].minFree_words = status[i].usStackHighWaterMark;
+        }
+    }
+}
+
+/**
+ * @brief Consistent copy of the lifetime minimums, safe from any task
+ */
+StackSnapshot StackMonitor::GetSnapshot()
+{
+    vTaskSuspendAll();
+    const StackSnapshot copy = stacks;
+    xTaskResumeAll();
+    return copy;
+}
+
+/**
+ * @brief Recommended depth for a stack
+ * @param size_words Configured depth
+ * @param minFree_words Lowest free space seen
+ * @return Words used plus the margin, rounded up, never below configMINIMAL_STACK_SIZE
+ */
+uint16_t StackMonitor::Recommend(uint16_t size_words, uint16_t minFree_words)
+{
+    const uint32_t used = (minFree_words < size_words) ? (size_words - minFree_words) : 0;
+    uint32_t margin = (used * STACK_MONITOR_MARGIN_PERCENT) / 100;
+    margin = (margin < STACK_MONITOR_MIN_HEADROOM_WORDS) ? STACK_MONITOR_MIN_HEADROOM_WORDS : margin;
+
+    uint32_t words = used + margin;
+    words = ((words + STACK_MONITOR_ROUND_WORDS - 1) / STACK_MONITOR_ROUND_WORDS) * STACK_MONITOR_ROUND_WORDS;
+    return (uint16_t)((words < configMINIMAL_STACK_SIZE) ? configMINIMAL_STACK_SIZE : words);
+}
+
+/**
+ * @brief Prints the stack use of every task on the debug console
+ */
+void StackMonitor::PrintSummary()
+{
+    const StackSnapshot s = GetSnapshot();
+    if (s.taskCount == 0) {
+        SOAR_PRINT("Stack use not sampled yet\n");
+        return;
+    }
+
+    uint32_t total = 0;
+    uint32_t reclaimable = 0;
+    SOAR_PRINT("Task            Stack   Used  (words, deepest seen)\n");
+    for (uint8_t i = 0; i < s.taskCount; i++) {
+        const TaskStackUsage& t = s.tasks[i];
+        if (t.size_words == 0) {
+            SOAR_PRINT("%-16s    ?      ?  %u free\n", t.name, t.minFree_words);
+            continue;
+        }
+
+        const uint16_t recommended = Recommend(t.size_words, t.minFree_words);
+        SOAR_PRINT("%-16s %4u   %4u\n", t.name, t.size_words, t.size_words - t.minFree_words);
+        total += t.size_words;
+        reclaimable += (recommended < t.size_words) ? (t.size_words - recommended) : 0;
+    }
+    SOAR_PRINT("Stacks %lu B, %lu B reclaimable at a %u%% margin (\"stackhdr\")\n",
+        (unsigned long)(total * sizeof(StackType_t)), (unsigned long)(reclaimable * sizeof(StackType_t)), STACK_MONITOR_MARGIN_PERCENT);
+}
+
+/**
+ * @brief Prints a header of recommended stack depths on the debug console, to paste over the ones in SystemDefines.hpp
+ */
+void StackMonitor::PrintRecommendations()
+{
+    const StackSnapshot s = GetSnapshot();
+
+    SOAR_PRINT("\n/* Generated by 'stackhdr' after %lu s uptime, %u%% margin (min %u words) over the deepest use seen */\n",
+        (unsigned long)(TICKS_TO_MS(xTaskGetTickCount()) / 1000), STACK_MONITOR_MARGIN_PERCENT, STACK_MONITOR_MIN_HEADROOM_WORDS);
+    SOAR_PRINT("#ifndef SOAR_STACK_RECOMMENDATIONS_HPP_\n#define SOAR_STACK_RECOMMENDATIONS_HPP_\n");
+    for (uint8_t i = 0; i < s.taskCount; i++) {
+        const TaskStackUsage& t = s.tasks[i];
+        const StackBudget* budget = FindBudget(t.name);
+        if (budget == nullptr) {
+            SOAR_PRINT("// %s: not in the budget table, %u words free at the deepest\n", t.name, t.minFree_words);
+            continue;
+        }
+
+        const uint16_t recommended = Recommend(t.size_words, t.minFree_words);
+        if (budget->isConfigDefine)
+            SOAR_PRINT("#define %s ((uint16_t)%u)    // %s, used %u of %u, FreeRTOSConfig.h\n", budget->constantName,
+                recommended, t.name, t.size_words - t.minFree_words, t.size_words);
+        else
+            SOAR_PRINT("constexpr uint16_t %s = %u;    // %s, used %u of %u\n", budget->constantName,
+                recommended, t.name, t.size_words - t.minFree_words, t.size_words);
+    }
+    SOAR_PRINT("#endif    // SOAR_STACK_RECOMMENDATIONS_HPP_\n\n");
+}
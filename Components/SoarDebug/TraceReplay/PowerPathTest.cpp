@@ -0,0 +1,287 @@
+/**
+ ******************************************************************************
+ * File Name          : PowerPathTest.cpp
+ * Description        : Host tests for the PowerPath verify and rollback.
+ *
+ *    Drives the real PowerPath and BatterySM with a scripted rail sense on
+ *    the simulated clock, each rail read and each poll moves time on. Checks:
+ *      - Every pre-check refuses without touching the select
+ *      - A rail that settles keeps the switch, with the switchover and dip
+ *      - A rail that doesn't settle in the window is rolled back, both ways
+ *      - Failed reads never count towards settling
+ *      - A fast protection trip during the baseline read, while verifying or
+ *        on the last settling read leaves the pack on umbilical
+ *      - No rail sense refuses, unless the unverified mode is on
+ *
+ *    Host only. Build and run from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ISoarDebug/TraceReplay/Shim
+ *          -ICore/Inc -IBatteryManagement/Inc -ISensors/Inc -IFlightControl/Inc
+ *          SoarDebug/TraceReplay/PowerPathTest.cpp FlightControl/PowerPath.cpp
+ *          BatteryManagement/[A-Z]*.cpp FlightControl/BatterySM.cpp
+ *          FlightControl/FastProtection.cpp -o PowerPathTest
+ *      ./PowerPathTest
+ *    Exits non-zero if anything fails.
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <cstdio>
+#include <initializer_list>
+#include "SystemDefines.hpp"
+#include "Clock.hpp"
+#include "GPIO.hpp"
+#include "PowerPath.hpp"
+#include "FastProtection.hpp"
+#include "Shim/HostTest.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint32_t RAIL_READ_US = 300;                  // Simulated I2C read time
+constexpr uint16_t RAIL_SCRIPT_LENGTH = 64;
+constexpr int32_t RAIL_READ_FAILS = -1;                 // Script entry for a failed read
+constexpr uint32_t SAMPLE_PERIOD_US = 250000;
+
+bool Shim::verbose = false;
+bool Shim::internalPower = false;
+
+/* Rail Script ------------------------------------------------------------------*/
+/**
+ * @brief Rail readings handed out in order, the last one repeats
+ */
+static struct {
+    int32_t mV[RAIL_SCRIPT_LENGTH];
+    uint16_t length;
+    uint16_t reads;
+    uint16_t tripAtRead;    // Fast protection trips on this read, 0 for never
+} rail;
+
+static void Script(std::initializer_list<int32_t> readings, uint16_t tripAtRead = 0)
+{
+    rail.length = 0;
+    for (int32_t mV : readings)
+        rail.mV[rail.length++] = mV;
+    rail.reads = 0;
+    rail.tripAtRead = tripAtRead;
+}
+
+static bool RailSense(Millivolts& value)
+{
+    Clock::SetMicros(Clock::Micros() + RAIL_READ_US);
+    const int32_t mV = rail.mV[(rail.reads < rail.length) ? rail.reads : rail.length - 1];
+    rail.reads++;
+
+    // Off the CC_READY grid, so the edge trips
+    if (rail.reads == rail.tripAtRead)
+        FastProtection::OnAlert();
+
+    if (mV == RAIL_READ_FAILS)
+        return false;
+    value = Millivolts(mV);
+    return true;
+}
+
+/* Helpers ------------------------------------------------------------------*/
+/**
+ * @brief Feeds BatterySM one BMS sample at the next CC_READY, with its ALERT edge so the fast protection grid stays set
+ */
+static void Sample(BatterySM& bsm, uint16_t cell_mV)
+{
+    Clock::SetMicros((Clock::Micros() / SAMPLE_PERIOD_US + 1) * SAMPLE_PERIOD_US);
+    FastProtection::OnAlert();
+
+    BMSData bms = {};
+    for (uint16_t& c : bms.cellVoltage_mV)
+        c = cell_mV;
+    bms.packVoltage_mV = (uint16_t)(cell_mV * BATTERY_NUM_CELLS);
+    bms.temperature_dC = 250;
+
+    Command cm(DATA_COMMAND, (uint16_t)BMS_UPDATE);
+    cm.CopyDataToCommand((uint8_t*)&bms, sizeof(bms));
+    bsm.HandleCommand(cm);
+}
+
+/**
+ * @brief Puts the select back to umbilical and the path in the given mode without counting anything
+ */
+static void Reset(PowerPath& path, bool withRailSense, bool allowUnverified)
+{
+    GPIO::PowerSelect::UmbilicalPower();
+    path.SetRailSense(withRailSense ? RailSense : nullptr);
+    path.AllowUnverified(allowUnverified);
+}
+
+/* Tests ------------------------------------------------------------------*/
+/**
+ * @brief Pre-checks refuse before anything moves
+ */
+static void TestRefusals(PowerPath& path)
+{
+    Reset(path, true, false);
+    BatterySM stale(BS_IDLE, true);
+    Script({ 14800 });
+    CHECK(path.SelectInternal(stale) == PP_BATTERY_STALE, "No sample yet wasn't refused as stale");
+    CHECK(!GPIO::PowerSelect::IsInternal() && rail.reads == 0, "Stale refusal moved the select or read the rail");
+
+    BatterySM low(BS_IDLE, true);
+    Sample(low, 3250);
+    CHECK(path.SelectInternal(low) == PP_BATTERY_LOW, "A 3.25V cell wasn't refused as low");
+
+    BatterySM old(BS_IDLE, true);
+    Sample(old, 3700);
+    Clock::SetMicros(Clock::Micros() + POWER_PATH_SAMPLE_MAX_AGE_US + 1);
+    CHECK(path.SelectInternal(old) == PP_BATTERY_STALE, "A sample older than the limit wasn't refused");
+
+    BatterySM fault(BS_IDLE, true);
+    Sample(fault, 3700);
+    fault.Dispatch(BE_PROTECTION_FAULT);
+    CHECK(fault.GetState() == BS_FAULT, "BatterySM didn't reach Fault for the test");
+    CHECK(path.SelectInternal(fault) == PP_BATTERY_FAULT, "Fault state wasn't refused");
+
+    BatterySM ok(BS_IDLE, true);
+    Sample(ok, 3700);
+    Script({ RAIL_READ_FAILS });
+    CHECK(path.SelectInternal(ok) == PP_RAIL_READ_FAILED, "A failed baseline read wasn't refused");
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Refusals moved the select");
+    CHECK(path.GetStats().refusals == 5, "%u refusals counted, expected 5", path.GetStats().refusals);
+}
+
+/**
+ * @brief A rail that dips and then holds keeps the switch
+ */
+static void TestSettles(PowerPath& path, BatterySM& bsm)
+{
+    Reset(path, true, false);
+    const PowerPathStats before = path.GetStats();
+    Sample(bsm, 3700);
+
+    // Baseline 12.0V on umbilical, dips under the minimum to 10.8V, then holds
+    Script({ 12000, 10800, 11200, 11600, 14600, 14800 });
+    const uint64_t start_us = Clock::Micros();
+    CHECK(path.SelectInternal(bsm) == PP_OK, "Settling rail gave %s", PowerPath::ResultToString(path.GetStats().lastResult));
+    CHECK(GPIO::PowerSelect::IsInternal(), "Settled switch isn't on internal");
+
+    const PowerPathStats& stats = path.GetStats();
+    CHECK(stats.switches == before.switches + 1 && stats.rollbacks == before.rollbacks, "Settled switch miscounted");
+    CHECK(stats.lastDip_mV == 1200, "Dip %u mV, expected 1200", stats.lastDip_mV);
+    CHECK(stats.lastSwitchover_us > 0 && stats.lastSwitchover_us <= Clock::Micros() - start_us, "Switchover %lu us out of range",
+        (unsigned long)stats.lastSwitchover_us);
+    CHECK(rail.reads == 1 + 1 + POWER_PATH_SETTLE_SAMPLES, "Settled after %u reads", rail.reads);
+}
+
+/**
+ * @brief A rail that never holds is rolled back at the end of the window
+ */
+static void TestRollback(PowerPath& path, BatterySM& bsm)
+{
+    Reset(path, true, false);
+    Sample(bsm, 3700);
+    const uint16_t rollbacks = path.GetStats().rollbacks;
+
+    Script({ 12000, 10500 });
+    const uint64_t start_us = Clock::Micros();
+    CHECK(path.SelectInternal(bsm) == PP_RAIL_LOW, "Sagging rail wasn't rolled back");
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Rollback left the select on internal");
+    CHECK(path.GetStats().rollbacks == rollbacks + 1, "Rollback not counted");
+    CHECK(Clock::Micros() - start_us >= (uint64_t)POWER_PATH_VERIFY_WINDOW_MS * 1000, "Rolled back before the window ran out");
+    CHECK(path.GetStats().lastDip_mV == 1500, "Rollback dip %u mV, expected 1500", path.GetStats().lastDip_mV);
+
+    // Good readings split by failed ones never add up to settled
+    Script({ 12000, 14000, 14000, RAIL_READ_FAILS, 14000, 14000, RAIL_READ_FAILS });
+    rail.length = RAIL_SCRIPT_LENGTH;
+    for (uint16_t i = 7; i < RAIL_SCRIPT_LENGTH; i++)
+        rail.mV[i] = rail.mV[4 + (i - 4) % 3];
+    CHECK(path.SelectInternal(bsm) == PP_RAIL_LOW, "Failed reads counted towards settling");
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Failed reads left the select on internal");
+
+    // Going back to umbilical is verified the same way, an umbilical that can't hold the rail goes back to the battery
+    Script({ 14800 });
+    CHECK(path.SelectInternal(bsm) == PP_OK, "Couldn't get onto internal for the umbilical test");
+    Script({ 14800, 9000 });
+    CHECK(path.SelectUmbilical() == PP_RAIL_LOW, "Dead umbilical wasn't rolled back");
+    CHECK(GPIO::PowerSelect::IsInternal(), "Dead umbilical rollback didn't return to the battery");
+}
+
+/**
+ * @brief A trip while verifying ends the attempt on umbilical, nothing moves it back
+ */
+static void TestTripWhileVerifying(PowerPath& path, BatterySM& bsm)
+{
+    Reset(path, true, false);
+    Sample(bsm, 3700);
+
+    // Verifying a move to umbilical, the trip forces umbilical anyway and the rail never holds
+    Script({ 14800 });
+    CHECK(path.SelectInternal(bsm) == PP_OK, "Couldn't get onto internal for the trip test");
+    Script({ 14800, 9000 }, 3);
+    CHECK(path.SelectUmbilical() == PP_BATTERY_FAULT, "Trip while verifying gave %s", PowerPath::ResultToString(path.GetStats().lastResult));
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Trip while verifying went back to the battery");
+
+    // Latched, so a new attempt is refused
+    CHECK(path.SelectInternal(bsm) == PP_BATTERY_FAULT, "Latched trip wasn't refused");
+    FastProtection::Acknowledge();
+
+    // A trip during the baseline read, after the pre-check, must not be overwritten by the select
+    Sample(bsm, 3700);
+    const uint16_t refusals = path.GetStats().refusals;
+    Script({ 12000, 14800 }, 1);
+    CHECK(path.SelectInternal(bsm) == PP_BATTERY_FAULT, "Trip during the baseline read gave %s", PowerPath::ResultToString(path.GetStats().lastResult));
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Select overwrote a trip during the baseline read");
+    CHECK(rail.reads == 1 && path.GetStats().refusals == refusals + 1, "Trip during the baseline read went on verifying");
+    FastProtection::Acknowledge();
+
+    // A trip on the read that completes the settle still fails the switch
+    Sample(bsm, 3700);
+    const uint16_t switches = path.GetStats().switches;
+    Script({ 12000, 14800 }, 1 + POWER_PATH_SETTLE_SAMPLES);
+    CHECK(path.SelectInternal(bsm) == PP_BATTERY_FAULT, "Trip on the settling read gave %s", PowerPath::ResultToString(path.GetStats().lastResult));
+    CHECK(!GPIO::PowerSelect::IsInternal(), "Trip on the settling read left the select on internal");
+    CHECK(path.GetStats().switches == switches, "Trip on the settling read counted as a switch");
+    FastProtection::Acknowledge();
+}
+
+/**
+ * @brief With no rail sense, refused unless the unverified mode is on
+ */
+static void TestNoRailSense(PowerPath& path, BatterySM& bsm)
+{
+    Reset(path, false, false);
+    Sample(bsm, 3700);
+    CHECK(path.SelectInternal(bsm) == PP_NO_RAIL_SENSE, "No rail sense wasn't refused");
+    CHECK(!GPIO::PowerSelect::IsInternal(), "No rail sense moved the select");
+
+    Reset(path, false, true);
+    const uint16_t unverified = path.GetStats().unverified;
+    const uint16_t switches = path.GetStats().switches;
+    CHECK(path.SelectInternal(bsm) == PP_UNVERIFIED, "Unverified mode gave %s", PowerPath::ResultToString(path.GetStats().lastResult));
+    CHECK(GPIO::PowerSelect::IsInternal(), "Unverified switch didn't move the select");
+    CHECK(path.SelectUmbilical() == PP_UNVERIFIED && !GPIO::PowerSelect::IsInternal(), "Unverified switch back failed");
+    CHECK(path.GetStats().unverified == unverified + 2 && path.GetStats().switches == switches, "Unverified switches miscounted");
+
+    // Pre-checks still apply
+    Clock::SetMicros(Clock::Micros() + POWER_PATH_SAMPLE_MAX_AGE_US + 1);
+    CHECK(path.SelectInternal(bsm) == PP_BATTERY_STALE, "Unverified mode skipped the pre-checks");
+
+    // A rail sense takes over from the unverified mode
+    Sample(bsm, 3700);
+    path.SetRailSense(RailSense);
+    Script({ 12000, 10500 });
+    CHECK(path.SelectInternal(bsm) == PP_RAIL_LOW, "Rail sense didn't take precedence over the unverified mode");
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main()
+{
+    FastProtection::Init([]() { return true; });
+    Clock::SetMicros(1000000);
+
+    PowerPath& path = PowerPath::Inst();
+    BatterySM bsm(BS_IDLE, true);
+
+    TestRefusals(path);
+    TestSettles(path, bsm);
+    TestRollback(path, bsm);
+    TestTripWhileVerifying(path, bsm);
+    TestNoRailSense(path, bsm);
+
+    return HostTest::Summary("PowerPath");
+}
+
+#endif // COMPUTER_ENVIRONMENT
@@ -0,0 +1,246 @@
+/**
+ ******************************************************************************
+ * File Name          : ProtectionTest.cpp
+ * Description        : Host tests for the ProtectionEngine limit table.
+ *
+ *    Walks LIMIT_TABLE as the firmware has it, so retuning a limit retunes
+ *    its test. For every limit, in every state:
+ *      - A value sitting exactly on the threshold never trips
+ *      - Just past the threshold it trips on exactly the debounce'th
+ *        consecutive sample, and only in the states it's enabled in
+ *      - One clear sample releases it and restarts the debounce count
+ *      - A trip stays latched after the value recovers, until cleared
+ *    Also checks that a fault outranks a charge inhibit on the same sample,
+ *    that a count built up in a disabled state trips on entering an enabled
+ *    one, and that a long violation doesn't wrap the debounce counter.
+ *
+ *    Host only. Build and run from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ICore/Inc -IBatteryManagement/Inc -ISensors/Inc
+ *          SoarDebug/TraceReplay/ProtectionTest.cpp BatteryManagement/ProtectionEngine.cpp -o ProtectionTest
+ *      ./ProtectionTest
+ *    Exits non-zero if anything fails.
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <cstdio>
+#include "ProtectionEngine.hpp"
+#include "Shim/HostTest.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint16_t LONG_VIOLATION_SAMPLES = 600;    // Well past the uint8_t debounce counter
+
+static const char* const LIMIT_NAMES[] = {
+    "CellOvervoltage", "CellUndervoltage", "CellImbalance", "ChargeOvercurrent", "DischargeOvercurrent",
+    "ChargeOvertemp", "ChargeUndertemp", "PackOvertemp", "GaugeOvertemp", "ChargerInputOvervoltage", "BmsHardwareFault",
+};
+static_assert(sizeof(LIMIT_NAMES) / sizeof(LIMIT_NAMES[0]) == PROT_LIMIT_COUNT, "LIMIT_NAMES must name every ProtectionLimit");
+
+static const char* const STATE_NAMES[BS_NONE] = { "Idle", "Charging", "Discharging", "Fault" };
+
+/* Helpers ------------------------------------------------------------------*/
+/**
+ * @brief Every engine input, nominal values trip nothing
+ */
+struct Inputs {
+    int32_t values[PROT_SRC_COUNT];
+
+    Inputs()
+    {
+        values[PROT_SRC_MAX_CELL_MV] = 3700;
+        values[PROT_SRC_MIN_CELL_MV] = 3700;
+        values[PROT_SRC_CELL_SPREAD_MV] = 0;
+        values[PROT_SRC_CURRENT_MA] = 0;
+        values[PROT_SRC_TEMPERATURE_DC] = 250;
+        values[PROT_SRC_GAUGE_TEMPERATURE_DC] = 250;
+        values[PROT_SRC_CHARGER_INPUT_MV] = 20000;
+        values[PROT_SRC_BMS_SYS_STAT] = 0;
+    }
+};
+
+/**
+ * @brief Feeds one set of inputs the way BatterySM does, charger and gauge first, then the BMS sample
+ */
+static ProtectionResult Sample(ProtectionEngine& engine, const Inputs& in, BatteryState state)
+{
+    ChargerData charger = {};
+    charger.inputVoltage_mV = (uint16_t)in.values[PROT_SRC_CHARGER_INPUT_MV];
+    engine.UpdateCharger(charger);
+
+    FuelGaugeData gauge = {};
+    gauge.temperature_dC = (int16_t)in.values[PROT_SRC_GAUGE_TEMPERATURE_DC];
+    engine.UpdateFuelGauge(gauge);
+
+    // The cell reduction is given directly, so each cell source can be moved on its own
+    CellStats cells = {};
+    cells.max_mV = (uint16_t)in.values[PROT_SRC_MAX_CELL_MV];
+    cells.min_mV = (uint16_t)in.values[PROT_SRC_MIN_CELL_MV];
+    cells.spread_mV = (uint16_t)in.values[PROT_SRC_CELL_SPREAD_MV];
+
+    BMSData bms = {};
+    bms.temperature_dC = (int16_t)in.values[PROT_SRC_TEMPERATURE_DC];
+    bms.sysStat = (uint8_t)in.values[PROT_SRC_BMS_SYS_STAT];
+    return engine.Evaluate(bms, cells, Milliamps(in.values[PROT_SRC_CURRENT_MA]), state);
+}
+
+/**
+ * @brief Inputs with one limit's source exactly on its threshold, or for a bit mask every other bit set
+ */
+static Inputs OnThreshold(const ProtectionLimitEntry& limit)
+{
+    Inputs in;
+    in.values[limit.source] = (limit.compare == PROT_ANY_BITS) ? (~limit.threshold & 0xFF) : limit.threshold;
+    return in;
+}
+
+/**
+ * @brief Inputs with one limit's source just past its threshold
+ * @param bit For a bit mask, which of its bits to set
+ */
+static Inputs PastThreshold(const ProtectionLimitEntry& limit, uint8_t bit = 0)
+{
+    Inputs in;
+    switch (limit.compare) {
+    case PROT_ABOVE:
+        in.values[limit.source] = limit.threshold + 1;
+        break;
+    case PROT_BELOW:
+        in.values[limit.source] = limit.threshold - 1;
+        break;
+    default:
+        in.values[limit.source] = limit.threshold & (1 << bit);
+        break;
+    }
+    return in;
+}
+
+/* Tests ------------------------------------------------------------------*/
+/**
+ * @brief Threshold, debounce, release and latching of one limit in one state
+ */
+static void TestLimit(uint8_t i, const Inputs& past, BatteryState state)
+{
+    const ProtectionLimitEntry& limit = ProtectionEngine::GetLimitTable()[i];
+    const uint32_t bit = 1UL << i;
+    const bool enabled = (limit.stateMask & StateBit(state)) != 0;
+    const char* name = LIMIT_NAMES[i];
+    const char* stateName = STATE_NAMES[state];
+    ProtectionEngine engine;
+
+    // On the threshold is not a violation however long it lasts
+    const Inputs on = OnThreshold(limit);
+    for (uint16_t n = 0; n < 3 * limit.debounceSamples + 3; n++)
+        CHECK(!(Sample(engine, on, state).faultMask & bit), "%s in %s tripped on the threshold", name, stateName);
+
+    // Short of the debounce count, then one clear sample releases it
+    for (uint8_t n = 1; n < limit.debounceSamples; n++)
+        CHECK(!(Sample(engine, past, state).faultMask & bit), "%s in %s tripped after %u of %u samples", name, stateName, n, limit.debounceSamples);
+    CHECK(!(Sample(engine, Inputs(), state).faultMask & bit), "%s in %s tripped on a clear sample", name, stateName);
+
+    // The count starts over, trips on exactly the debounce'th sample
+    for (uint8_t n = 1; n < limit.debounceSamples; n++)
+        CHECK(!(Sample(engine, past, state).faultMask & bit), "%s in %s didn't restart its debounce", name, stateName);
+    const ProtectionResult trip = Sample(engine, past, state);
+    CHECK(((trip.faultMask & bit) != 0) == enabled, "%s in %s %s on the debounce'th sample", name, stateName, enabled ? "didn't trip" : "tripped while disabled");
+    if (enabled) {
+        CHECK(trip.event != BE_NONE, "%s in %s tripped with no event", name, stateName);
+        CHECK(limit.action != BE_PROTECTION_FAULT || trip.event == BE_PROTECTION_FAULT, "%s in %s raised %u, not the fault", name, stateName, trip.event);
+    }
+    else {
+        CHECK(!(engine.GetLatchedFaults() & bit), "%s in %s latched while disabled", name, stateName);
+    }
+
+    // Recovered values stop reporting it, the latch keeps it until cleared
+    CHECK(!(Sample(engine, Inputs(), state).faultMask & bit), "%s in %s still reported after recovering", name, stateName);
+    CHECK(((engine.GetLatchedFaults() & bit) != 0) == enabled, "%s in %s latch is wrong after recovering", name, stateName);
+    engine.ClearLatchedFaults();
+    CHECK(engine.GetLatchedFaults() == 0, "%s in %s didn't clear", name, stateName);
+}
+
+/**
+ * @brief Debounce counts keep running in disabled states, so entering an enabled state with a standing violation trips at once
+ */
+static void TestStateChange(uint8_t i)
+{
+    const ProtectionLimitEntry& limit = ProtectionEngine::GetLimitTable()[i];
+    const uint32_t bit = 1UL << i;
+
+    BatteryState disabled = BS_NONE;
+    BatteryState enabled = BS_NONE;
+    for (uint8_t s = 0; s < BS_NONE; s++) {
+        if ((limit.stateMask & StateBit((BatteryState)s)) == 0)
+            disabled = (disabled == BS_NONE) ? (BatteryState)s : disabled;
+        else
+            enabled = (enabled == BS_NONE) ? (BatteryState)s : enabled;
+    }
+    if (disabled == BS_NONE || enabled == BS_NONE)
+        return;
+
+    ProtectionEngine engine;
+    const Inputs past = PastThreshold(limit);
+    for (uint8_t n = 0; n < limit.debounceSamples; n++)
+        Sample(engine, past, disabled);
+    CHECK(Sample(engine, past, enabled).faultMask & bit, "%s didn't trip on entering %s with a standing violation", LIMIT_NAMES[i], STATE_NAMES[enabled]);
+}
+
+/**
+ * @brief A violation longer than the counter's range stays tripped
+ */
+static void TestLongViolation(uint8_t i)
+{
+    const ProtectionLimitEntry& limit = ProtectionEngine::GetLimitTable()[i];
+    const BatteryState state = (limit.stateMask & StateBit(BS_CHARGING)) ? BS_CHARGING : BS_IDLE;
+    ProtectionEngine engine;
+    const Inputs past = PastThreshold(limit);
+
+    uint16_t tripped = 0;
+    for (uint16_t n = 1; n <= LONG_VIOLATION_SAMPLES; n++) {
+        if (Sample(engine, past, state).faultMask & (1UL << i))
+            tripped++;
+    }
+    CHECK(tripped == LONG_VIOLATION_SAMPLES - limit.debounceSamples + 1, "%s tripped on %u of %u samples", LIMIT_NAMES[i],
+        tripped, LONG_VIOLATION_SAMPLES - limit.debounceSamples + 1);
+}
+
+/**
+ * @brief A fault and a charge inhibit on the same sample raise the fault
+ */
+static void TestSeverity()
+{
+    ProtectionEngine engine;
+    Inputs in;
+    in.values[PROT_SRC_TEMPERATURE_DC] = 700;    // Past the charge overtemp and the pack overtemp
+    ProtectionResult result = {};
+    for (uint8_t n = 0; n < 16; n++)
+        result = Sample(engine, in, BS_CHARGING);
+
+    CHECK(result.faultMask & (1UL << PROT_CHARGE_OVERTEMP), "Charge overtemp didn't trip at 70C");
+    CHECK(result.faultMask & (1UL << PROT_PACK_OVERTEMP), "Pack overtemp didn't trip at 70C");
+    CHECK(result.event == BE_PROTECTION_FAULT, "Charge inhibit outranked the fault");
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main()
+{
+    const ProtectionLimitEntry* table = ProtectionEngine::GetLimitTable();
+    for (uint8_t i = 0; i < PROT_LIMIT_COUNT; i++) {
+        const ProtectionLimitEntry& limit = table[i];
+        for (uint8_t s = 0; s < BS_NONE; s++) {
+            if (limit.compare == PROT_ANY_BITS) {
+                for (uint8_t b = 0; b < 8; b++) {
+                    if (limit.threshold & (1 << b))
+                        TestLimit(i, PastThreshold(limit, b), (BatteryState)s);
+                }
+            }
+            else {
+                TestLimit(i, PastThreshold(limit), (BatteryState)s);
+            }
+        }
+        TestStateChange(i);
+        TestLongViolation(i);
+    }
+    TestSeverity();
+
+    return HostTest::Summary("ProtectionEngine");
+}
+
+#endif // COMPUTER_ENVIRONMENT
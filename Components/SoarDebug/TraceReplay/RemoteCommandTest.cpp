@@ -0,0 +1,116 @@
+/**
+ ******************************************************************************
+ * File Name          : RemoteCommandTest.cpp
+ * Description        : Host tests for the operator commands BatterySM takes.
+ *
+ *    Sends BATTERY_ABORT_COMMAND, what PMBProtocolTask turns an RCU abort
+ *    into, to the real BatterySM in every state. Checks:
+ *      - An abort lands in Fault from every state, and is acked as such
+ *      - The rate limit never holds an abort back
+ *      - A pending fast protection trip doesn't hold an abort back
+ *      - A value past BRC_COUNT is refused and moves nothing
+ *
+ *    Host only. Build and run from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ISoarDebug/TraceReplay/Shim
+ *          -ICore/Inc -IBatteryManagement/Inc -ISensors/Inc -IFlightControl/Inc
+ *          SoarDebug/TraceReplay/RemoteCommandTest.cpp BatteryManagement/[A-Z]*.cpp
+ *          FlightControl/BatterySM.cpp FlightControl/FastProtection.cpp -o RemoteCommandTest
+ *      ./RemoteCommandTest
+ *    Exits non-zero if anything fails.
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <cstdio>
+#include "SystemDefines.hpp"
+#include "Clock.hpp"
+#include "GPIO.hpp"
+#include "BatterySM.hpp"
+#include "FastProtection.hpp"
+#include "Shim/HostTest.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint32_t SAMPLE_PERIOD_US = 250000;
+
+bool Shim::verbose = false;
+bool Shim::internalPower = false;
+
+static const char* const STATE_NAMES[BS_NONE] = { "Idle", "Charging", "Discharging", "Fault" };
+
+/* Tests ------------------------------------------------------------------*/
+/**
+ * @brief An abort from each state, straight after the state was entered so nothing else can be sent yet
+ */
+static void TestAbortFromEveryState()
+{
+    for (uint8_t s = 0; s < BS_NONE; s++) {
+        BatterySM bsm((BatteryState)s, true);
+        const BatteryRemoteAck ack = bsm.HandleRemoteCommand(BATTERY_ABORT_COMMAND);
+        const BatteryRemoteResult expected = (s == BS_FAULT) ? BRR_ALREADY_IN_STATE : BRR_ACCEPTED;
+        CHECK(bsm.GetState() == BS_FAULT, "Abort from %s left it in %s", STATE_NAMES[s], STATE_NAMES[bsm.GetState()]);
+        CHECK(ack.command == BRC_FORCE_SAFE && ack.result == expected && ack.state == BS_FAULT,
+            "Abort from %s acked as command %u, result %u, state %u", STATE_NAMES[s], ack.command, ack.result, ack.state);
+    }
+}
+
+/**
+ * @brief An abort right after an accepted command isn't rate limited
+ */
+static void TestAbortNotRateLimited()
+{
+    BatterySM bsm(BS_IDLE, true);
+    const BatteryRemoteAck discharge = bsm.HandleRemoteCommand(BRC_DISCHARGE);
+    CHECK(discharge.result == BRR_ACCEPTED && bsm.GetState() == BS_DISCHARGING, "Discharge for the rate limit test gave result %u", discharge.result);
+
+    const BatteryRemoteAck stop = bsm.HandleRemoteCommand(BRC_IDLE);
+    CHECK(stop.result == BRR_RATE_LIMITED, "A second command within the interval wasn't rate limited");
+
+    const BatteryRemoteAck abort = bsm.HandleRemoteCommand(BATTERY_ABORT_COMMAND);
+    CHECK(abort.result == BRR_ACCEPTED && bsm.GetState() == BS_FAULT, "Abort within the interval gave result %u", abort.result);
+}
+
+/**
+ * @brief A trip BatterySM hasn't caught up with yet refuses a charge, never an abort
+ */
+static void TestAbortWhileLatched()
+{
+    BatterySM bsm(BS_DISCHARGING, true);
+
+    // Off the CC_READY grid, so the second edge trips
+    Clock::SetMicros((Clock::Micros() / SAMPLE_PERIOD_US + 1) * SAMPLE_PERIOD_US);
+    FastProtection::OnAlert();
+    Clock::SetMicros(Clock::Micros() + SAMPLE_PERIOD_US / 2);
+    FastProtection::OnAlert();
+    CHECK(FastProtection::IsLatched(), "The ALERT edge didn't latch for the test");
+
+    CHECK(bsm.HandleRemoteCommand(BRC_CHARGE).result == BRR_PROTECTION_LATCHED, "Charge wasn't refused while latched");
+    const BatteryRemoteAck abort = bsm.HandleRemoteCommand(BATTERY_ABORT_COMMAND);
+    CHECK(abort.result == BRR_ACCEPTED && bsm.GetState() == BS_FAULT, "Abort while latched gave result %u", abort.result);
+    FastProtection::Acknowledge();
+}
+
+/**
+ * @brief Anything past the command table is refused
+ */
+static void TestUnknownCommand()
+{
+    BatterySM bsm(BS_IDLE, true);
+    const BatteryRemoteAck ack = bsm.HandleRemoteCommand(BRC_COUNT);
+    CHECK(ack.result == BRR_UNKNOWN_COMMAND && bsm.GetState() == BS_IDLE, "Command %u gave result %u in %s",
+        BRC_COUNT, ack.result, STATE_NAMES[bsm.GetState()]);
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main()
+{
+    FastProtection::Init([]() { return true; });
+    Clock::SetMicros(1000000);
+
+    TestAbortFromEveryState();
+    TestAbortNotRateLimited();
+    TestAbortWhileLatched();
+    TestUnknownCommand();
+
+    return HostTest::Summary("RemoteCommand");
+}
+
+#endif // COMPUTER_ENVIRONMENT
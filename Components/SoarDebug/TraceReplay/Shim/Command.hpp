@@ -0,0 +1,61 @@
+/**
+ ******************************************************************************
+ * File Name          : Command.hpp (TraceReplay host shim)
+ * Description        : Host stand-in for Command, same interface as far as
+ *                      BatterySM uses it, data lives in the object.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_COMMAND_HPP_
+#define TRACE_REPLAY_SHIM_COMMAND_HPP_
+#include <cstdint>
+#include <cstring>
+
+enum GLOBAL_COMMANDS : uint8_t
+{
+    COMMAND_NONE = 0,
+    TASK_SPECIFIC_COMMAND,
+    DATA_COMMAND,
+    CONTROL_ACTION,
+    REQUEST_COMMAND,
+    HEARTBEAT_COMMAND,
+    RADIOHB_CHANGE_PERIOD,
+    PROTOCOL_COMMAND,
+    TELEMETRY_CHANGE_PERIOD,
+};
+
+class Command
+{
+public:
+    Command(GLOBAL_COMMANDS command, uint16_t taskCommand) : command(command), taskCommand(taskCommand), dataSize(0) {}
+
+    bool CopyDataToCommand(const uint8_t* dataSrc, uint16_t size)
+    {
+        if (size > sizeof(data))
+            return false;
+        memcpy(data, dataSrc, size);
+        dataSize = size;
+        return true;
+    }
+
+    bool CopyDataFromCommand(uint8_t* dataDst, uint16_t size) const
+    {
+        if (size > dataSize)
+            return false;
+        memcpy(dataDst, data, size);
+        return true;
+    }
+
+    void Reset() { dataSize = 0; }
+
+    GLOBAL_COMMANDS GetCommand() const { return command; }
+    uint16_t GetTaskCommand() const { return taskCommand; }
+    uint16_t GetDataSize() const { return dataSize; }
+
+protected:
+    GLOBAL_COMMANDS command;
+    uint16_t taskCommand;
+    uint8_t data[64];    // Large enough for any sensor sample
+    uint16_t dataSize;
+};
+
+#endif // TRACE_REPLAY_SHIM_COMMAND_HPP_
@@ -0,0 +1,9 @@
+/**
+ ******************************************************************************
+ * File Name          : CommandMessage.hpp (TraceReplay host shim)
+ * Description        : Included by BatterySM.cpp, nothing in it is used on the host.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_COMMANDMESSAGE_HPP_
+#define TRACE_REPLAY_SHIM_COMMANDMESSAGE_HPP_
+#endif // TRACE_REPLAY_SHIM_COMMANDMESSAGE_HPP_
@@ -0,0 +1,15 @@
+/**
+ ******************************************************************************
+ * File Name          : CoreProto.h (TraceReplay host shim)
+ * Description        : The one generated proto type BatterySM needs.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_CORE_PROTO_H_
+#define TRACE_REPLAY_SHIM_CORE_PROTO_H_
+
+namespace Proto
+{
+    enum class BatteryState { BS_IDLE, BS_CHARGING, BS_DISCHHARGING, BS_FAULT, BS_NONE };
+}
+
+#endif // TRACE_REPLAY_SHIM_CORE_PROTO_H_
@@ -0,0 +1,29 @@
+/**
+ ******************************************************************************
+ * File Name          : GPIO.hpp (TraceReplay host shim)
+ * Description        : Only the power select exists on the host, as a flag the
+ *                      replay can check.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_GPIO_HPP_
+#define TRACE_REPLAY_SHIM_GPIO_HPP_
+
+namespace Shim
+{
+    extern bool internalPower;    // BATTERY_EN
+}
+
+namespace GPIO
+{
+    namespace PowerSelect
+    {
+        inline void InternalPower() { Shim::internalPower = true; }
+        inline void UmbilicalPower() { Shim::internalPower = false; }
+        inline void ForceUmbilicalPower() { Shim::internalPower = false; }
+        inline void Toggle() { Shim::internalPower = !Shim::internalPower; }
+
+        inline bool IsInternal() { return Shim::internalPower; }
+    }
+}
+
+#endif // TRACE_REPLAY_SHIM_GPIO_HPP_
@@ -0,0 +1,33 @@
+/**
+ ******************************************************************************
+ * File Name          : HostTest.hpp (TraceReplay host shim)
+ * Description        : Check counting shared by the host tests. CHECK counts
+ *                      every check and prints the failing ones with their
+ *                      line, HostTest::Summary prints the totals and gives
+ *                      main its exit code.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_HOST_TEST_HPP_
+#define TRACE_REPLAY_SHIM_HOST_TEST_HPP_
+#include <cstdint>
+#include <cstdio>
+
+namespace HostTest
+{
+    inline uint32_t checks = 0;
+    inline uint32_t failures = 0;
+
+    /**
+     * @brief Prints "<name>: N checks, M failed"
+     * @return Exit code for main, non-zero if anything failed
+     */
+    inline int Summary(const char* name)
+    {
+        printf("%s: %lu checks, %lu failed\n", name, (unsigned long)checks, (unsigned long)failures);
+        return (failures == 0) ? 0 : 1;
+    }
+}
+
+#define CHECK(expr, ...) do { HostTest::checks++; if (!(expr)) { HostTest::failures++; printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+#endif // TRACE_REPLAY_SHIM_HOST_TEST_HPP_
@@ -0,0 +1,61 @@
+/**
+ ******************************************************************************
+ * File Name          : StaticTask.hpp (TraceReplay host shim)
+ * Description        : Host stand-in for the task base and the kernel calls
+ *                      a task makes. Nothing is scheduled, the host calls
+ *                      RunTask itself and defines xTaskNotifyGive and
+ *                      ulTaskNotifyTake, which move the simulated Clock.
+ *
+ *    A header in Core/Inc finds Core/Inc/StaticTask.hpp next to it before
+ *    the shim directory, so this one takes its include guard and has to be
+ *    force included with -include.
+ ******************************************************************************
+*/
+#ifndef AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H
+#define AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H
+#include <cstdint>
+#include "SystemDefines.hpp"
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef void* TaskHandle_t;
+#define pdTRUE 1
+
+constexpr uint32_t WATCHDOG_CHECKIN_PERIOD_MS = 500;
+constexpr uint8_t TIMER_WHEEL_TASK_RTOS_PRIORITY = 3;
+constexpr uint8_t TIMER_WHEEL_TASK_QUEUE_DEPTH_OBJS = 1;
+constexpr uint16_t TIMER_WHEEL_TASK_STACK_DEPTH_WORDS = 256;
+
+namespace Watchdog
+{
+    inline void CheckIn(uint8_t) {}
+}
+
+// A single simulated core, the scheduler never runs anything else
+inline void vTaskSuspendAll() {}
+inline BaseType_t xTaskResumeAll() { return 0; }
+
+// Defined by the host program
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait_ticks);
+
+template <class Derived, uint8_t Priority, uint16_t StackWords, uint16_t QueueDepth>
+class StaticTask
+{
+public:
+    static Derived& Inst() {
+        static Derived inst;
+        return inst;
+    }
+
+    void InitTask() { rtTaskHandle = this; }    // Notifications are sent from here on, nothing is created
+    static void RunTask(void* pvParams) { Derived::Inst().Run(pvParams); }    // Called by the host in place of the scheduler
+
+protected:
+    explicit StaticTask(const char* name) : rtTaskHandle(nullptr), watchdogId_(0) { (void)name; }
+
+    TaskHandle_t rtTaskHandle;
+    uint8_t watchdogId_;
+};
+
+#endif // AVIONICS_INCLUDE_SOAR_CORE_STATIC_TASK_H
@@ -0,0 +1,30 @@
+/**
+ ******************************************************************************
+ * File Name          : SystemDefines.hpp (TraceReplay host shim)
+ * Description        : Host stand-in for the system defines, prints go to
+ *                      stdout only when the replay is verbose and the RTOS
+ *                      tick follows the simulated Clock.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_SYSTEM_DEFINES_HPP_
+#define TRACE_REPLAY_SHIM_SYSTEM_DEFINES_HPP_
+#include <cstdint>
+#include <cstdio>
+#include "Clock.hpp"
+
+namespace Shim
+{
+    extern bool verbose;    // Set by the replay, firmware prints are dropped otherwise
+}
+
+#define SOAR_PRINT(str, ...) (Shim::verbose ? (void)printf(str, ##__VA_ARGS__) : (void)0)
+#define SOAR_ASSERT(expr, ...) ((expr) ? (void)0 : (void)fprintf(stderr, "ASSERT %s:%d\n", __FILE__, __LINE__))
+
+#define TICKS_TO_MS(time_ticks) (time_ticks)    // 1kHz tick
+#define MS_TO_TICKS(time_ms) (time_ms)
+
+inline uint32_t xTaskGetTickCount() { return (uint32_t)(Clock::Micros() / 1000); }
+inline uint32_t xTaskGetTickCountFromISR() { return xTaskGetTickCount(); }
+inline void osDelay(uint32_t ms) { Clock::SetMicros(Clock::Micros() + (uint64_t)ms * 1000); }    // Simulated time moves on, nothing else runs
+
+#endif // TRACE_REPLAY_SHIM_SYSTEM_DEFINES_HPP_
@@ -0,0 +1,9 @@
+/**
+ ******************************************************************************
+ * File Name          : WriteBufferFixedSize.h (TraceReplay host shim)
+ * Description        : Included by BatterySM.cpp, nothing in it is used on the host.
+ ******************************************************************************
+*/
+#ifndef TRACE_REPLAY_SHIM_WRITEBUFFERFIXEDSIZE_H_
+#define TRACE_REPLAY_SHIM_WRITEBUFFERFIXEDSIZE_H_
+#endif // TRACE_REPLAY_SHIM_WRITEBUFFERFIXEDSIZE_H_
@@ -0,0 +1,322 @@
+/**
+ ******************************************************************************
+ * File Name          : SocReplay.cpp
+ * Description        : Host replay for the fixed-point SoC EKF against a
+ *                      double precision reference filter.
+ *
+ *    Runs the firmware SocEstimator and a double precision EKF over the same
+ *    cell model side by side, sample by sample, and reports the SoC error of
+ *    each against the true SoC, how far the fixed-point filter strays from
+ *    the reference, and host nanoseconds per step. Target cycles per step come
+ *    from "bench" on the debug console, the host times are only meaningful
+ *    relative to each other.
+ *
+ *    With no arguments the simulated profiles below are run: a double
+ *    precision 1RC cell with the filter's own parameters, 2 mV of cell
+ *    voltage noise and a 20 mA current offset, both filters seeded 10% high.
+ *
+ *    A recorded curve is replayed with a CSV path, one BMS sample per line
+ *    at BMS_CC_SAMPLE_PERIOD_MS, '#' starts a comment:
+ *      current_mA,cell_mV[,soc_pct]
+ *    soc_pct is the reference SoC (e.g. from a lab coulomb count), when it's
+ *    missing only the fixed-point vs reference deviation is reported.
+ *
+ *    Host only. Build from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ICore/Inc -IBatteryManagement/Inc
+ *          SoarDebug/TraceReplay/SocReplay.cpp BatteryManagement/SocEstimator.cpp
+ *          BatteryManagement/OCVCurve.cpp -o SocReplay
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "SocEstimator.hpp"
+#include "OCVCurve.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr double SAMPLE_S = BMS_CC_SAMPLE_PERIOD_MS / 1000.0;
+constexpr double CAPACITY_AS = BATTERY_NOMINAL_CAPACITY_MAH * 3.6;    // Ampere seconds
+constexpr double Q15_LSB = 1.0 / 32768;
+constexpr double VOLTAGE_UNIT_V = (1 << EKF_VOLTAGE_UNIT_SHIFT) * 1e-6;
+
+// The reference uses the same model and tuning as the fixed-point filter, in SI units
+constexpr double MODEL_R0_OHM = EKF_R0_MOHM * 1e-3;
+constexpr double MODEL_DECAY = EKF_RC_DECAY_Q16 / 65536.0;
+constexpr double MODEL_RC_GAIN_OHM = EKF_RC_GAIN_Q16 / 65536.0 * 1e-3;
+
+constexpr double SIM_NOISE_V = 0.002;            // Cell voltage noise, 1 sigma
+constexpr double SIM_CURRENT_OFFSET_A = 0.020;    // Current sensor offset the filter doesn't know about
+constexpr double SIM_SEED_ERROR = 0.10;            // Both filters start this far above the true SoC
+constexpr uint16_t SOC_MAX_LINE = 128;
+
+/* Helpers ------------------------------------------------------------------*/
+/**
+ * @brief OCV at a fractional SoC, on the firmware's own curve
+ * @param slope_V Optional output, dOCV/dSoC in V per unit SoC
+ */
+static double OcvVolts(double soc, double* slope_V = nullptr)
+{
+    soc = (soc < 0) ? 0 : ((soc > 1) ? 1 : soc);
+    const double socQ15 = soc * 32768;
+    const uint16_t whole = (uint16_t)socQ15;
+
+    int32_t slope;
+    const int32_t ocv_uV = OCVCurve::ToVoltage(whole, &slope).Value();
+    const double slope_uVPerLsb = slope / 32768.0;
+    if (slope_V != nullptr)
+        *slope_V = slope_uVPerLsb * 32768 * 1e-6;
+    return (ocv_uV + slope_uVPerLsb * (socQ15 - whole)) * 1e-6;
+}
+
+/**
+ * @brief Deterministic normal noise, so runs can be compared
+ */
+static double Gaussian()
+{
+    static uint64_t state = 0x2545F4914F6CDD1DULL;
+    auto uniform = []() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return ((state >> 11) + 0.5) / 9007199254740992.0;
+    };
+    return std::sqrt(-2.0 * std::log(uniform())) * std::cos(2.0 * M_PI * uniform());
+}
+
+/* Reference Filter ------------------------------------------------------------------*/
+/**
+ * @brief The SocEstimator EKF in double precision, same model and noise tuning
+ */
+class ReferenceEkf
+{
+public:
+    void Reset(double cell_V)
+    {
+        soc_ = OCVCurve::ToStateOfChargeQ15(Millivolts((int32_t)std::lround(cell_V * 1000))) * Q15_LSB;
+        vrc_ = 0;
+        p11_ = EKF_INITIAL_VAR_SOC * Q15_LSB * Q15_LSB;
+        p12_ = 0;
+        p22_ = EKF_INITIAL_VAR_VRC * VOLTAGE_UNIT_V * VOLTAGE_UNIT_V;
+    }
+
+    void Update(double current_A, double cell_V)
+    {
+        // Predict, F = diag(1, decay)
+        soc_ = Clamp(soc_ + current_A * SAMPLE_S / CAPACITY_AS);
+        vrc_ = vrc_ * MODEL_DECAY + current_A * MODEL_RC_GAIN_OHM;
+        p11_ += EKF_PROCESS_NOISE_SOC * Q15_LSB * Q15_LSB;
+        p12_ *= MODEL_DECAY;
+        p22_ = p22_ * MODEL_DECAY * MODEL_DECAY + EKF_PROCESS_NOISE_VRC * VOLTAGE_UNIT_V * VOLTAGE_UNIT_V;
+
+        // Correct, H = [dOCV/dSoC, 1]
+        double h1;
+        const double innovation = cell_V - (OcvVolts(soc_, &h1) + vrc_ + MODEL_R0_OHM * current_A);
+        const double n1 = p11_ * h1 + p12_;
+        const double n2 = p12_ * h1 + p22_;
+        const double s = n1 * h1 + n2 + EKF_MEASUREMENT_NOISE * VOLTAGE_UNIT_V * VOLTAGE_UNIT_V;
+        const double k1 = n1 / s;
+        const double k2 = n2 / s;
+
+        soc_ = Clamp(soc_ + k1 * innovation);
+        vrc_ += k2 * innovation;
+        p11_ -= k1 * n1;
+        p12_ -= k1 * n2;
+        p22_ -= k2 * n2;
+    }
+
+    double GetSoc() const { return soc_; }
+
+protected:
+    static double Clamp(double soc) { return (soc < 0) ? 0 : ((soc > 1) ? 1 : soc); }
+
+    double soc_;
+    double vrc_;    // V
+    double p11_;
+    double p12_;
+    double p22_;
+};
+
+/* Error Stats ------------------------------------------------------------------*/
+struct ErrorStats {
+    uint64_t count;
+    double sumSquares;
+    double max;
+
+    void Add(double error)
+    {
+        count++;
+        sumSquares += error * error;
+        max = (std::fabs(error) > max) ? std::fabs(error) : max;
+    }
+
+    double Rms() const { return (count == 0) ? 0 : std::sqrt(sumSquares / count); }
+};
+
+/**
+ * @brief Runs both filters over one curve and prints the errors
+ */
+class SocReplay
+{
+public:
+    SocReplay() : fixed_(), reference_(), vsTruth_(), refVsTruth_(), vsReference_(), fixed_ns_(0), reference_ns_(0), seeded_(false) {}
+
+    void Seed(double cell_V)
+    {
+        fixed_.Reset(Millivolts((int32_t)std::lround(cell_V * 1000)));
+        reference_.Reset(cell_V);
+        seeded_ = true;
+    }
+
+    /**
+     * @param trueSoc Reference SoC, negative if unknown
+     */
+    void Step(int32_t current_mA, uint16_t cell_mV, double trueSoc)
+    {
+        if (!seeded_)
+            Seed(cell_mV / 1000.0);
+
+        const auto start = std::chrono::steady_clock::now();
+        fixed_.Update(Milliamps(current_mA), Millivolts(cell_mV));
+        const auto mid = std::chrono::steady_clock::now();
+        reference_.Update(current_mA / 1000.0, cell_mV / 1000.0);
+        const auto end = std::chrono::steady_clock::now();
+        fixed_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count();
+        reference_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count();
+
+        const double fixedSoc = fixed_.GetStateOfChargeQ15() * Q15_LSB;
+        vsReference_.Add(fixedSoc - reference_.GetSoc());
+        if (trueSoc >= 0) {
+            vsTruth_.Add(fixedSoc - trueSoc);
+            refVsTruth_.Add(reference_.GetSoc() - trueSoc);
+        }
+    }
+
+    void Print(const char* name) const
+    {
+        printf("%-22s %7llu steps", name, (unsigned long long)vsReference_.count);
+        if (vsTruth_.count != 0) {
+            printf("  fixed rms %5.2f%% max %5.2f%%  reference rms %5.2f%% max %5.2f%%", 100 * vsTruth_.Rms(), 100 * vsTruth_.max,
+                100 * refVsTruth_.Rms(), 100 * refVsTruth_.max);
+        }
+        printf("  fixed-reference rms %5.3f%% max %5.3f%%", 100 * vsReference_.Rms(), 100 * vsReference_.max);
+        if (vsReference_.count != 0) {
+            printf("  ns/step fixed %.0f reference %.0f", (double)fixed_ns_ / vsReference_.count, (double)reference_ns_ / vsReference_.count);
+        }
+        printf("\n");
+    }
+
+protected:
+    SocEstimator fixed_;
+    ReferenceEkf reference_;
+    ErrorStats vsTruth_;
+    ErrorStats refVsTruth_;
+    ErrorStats vsReference_;
+    uint64_t fixed_ns_;
+    uint64_t reference_ns_;
+    bool seeded_;
+};
+
+/* Simulated Curves ------------------------------------------------------------------*/
+/**
+ * @brief Pack current for a profile at a sample, positive is charging
+ */
+typedef double (*CurrentProfile)(uint32_t sample);
+
+static double ConstantDischarge(uint32_t) { return -3.0; }                                    // 1C
+static double PulsedDischarge(uint32_t i) { return (i & 0x20) ? -1.5 : -0.3; }                // Same load as "bench"
+static double ConstantCharge(uint32_t) { return 1.5; }                                        // 0.5C CC phase
+static double FlightProfile(uint32_t i)
+{
+    const uint32_t s = i % 2400;                                                            // 10 min cycles
+    return (s < 2000) ? -0.4 : ((s < 2040) ? -12.0 : -2.0);                                    // Pad idle, 10 s burst, recovery
+}
+static double ShortPulses(uint32_t i) { return ((i % 240) < 2) ? -100.0 : -0.4; }            // 0.5 s at 100 A every minute, past the int32 range of the SoC predict
+
+/**
+ * @brief Simulates a cell from a start SoC until it's empty, full, or steps run out
+ */
+static void RunSimulated(const char* name, CurrentProfile profile, double startSoc, uint32_t steps)
+{
+    SocReplay replay;
+    double soc = startSoc;
+    double vrc = 0;
+    replay.Seed(OcvVolts(startSoc + SIM_SEED_ERROR));
+
+    for (uint32_t i = 0; i < steps; i++) {
+        const double current_A = profile(i);
+        soc += current_A * SAMPLE_S / CAPACITY_AS;
+        if (soc <= 0.02 || soc >= 0.99)
+            break;
+        vrc = vrc * MODEL_DECAY + current_A * MODEL_RC_GAIN_OHM;
+        const double cell_V = OcvVolts(soc) + vrc + MODEL_R0_OHM * current_A + SIM_NOISE_V * Gaussian();
+
+        const int32_t measured_mA = (int32_t)std::lround((current_A + SIM_CURRENT_OFFSET_A) * 1000);
+        replay.Step(measured_mA, (uint16_t)std::lround(cell_V * 1000), soc);
+    }
+    replay.Print(name);
+}
+
+/**
+ * @brief Replays a recorded current_mA,cell_mV[,soc_pct] CSV
+ * @return False if the file can't be opened
+ */
+static bool RunRecorded(const char* path)
+{
+    FILE* file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    SocReplay replay;
+    char line[SOC_MAX_LINE];
+    uint64_t skipped = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+
+        long current_mA;
+        unsigned cell_mV;
+        double soc_pct;
+        const int fields = sscanf(line, "%ld,%u,%lf", &current_mA, &cell_mV, &soc_pct);
+        if (fields < 2 || cell_mV > UINT16_MAX) {
+            skipped++;
+            continue;
+        }
+        replay.Step((int32_t)current_mA, (uint16_t)cell_mV, (fields == 3) ? soc_pct / 100 : -1);
+    }
+    if (file != stdin)
+        fclose(file);
+
+    replay.Print(path);
+    if (skipped != 0)
+        printf("  %llu malformed lines skipped\n", (unsigned long long)skipped);
+    return true;
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [recorded.csv | -]\n"
+            "  no argument runs the simulated curves\n", argv[0]);
+        return 2;
+    }
+
+    printf("SoC error, fixed-point EKF and double reference (SoC %%, absolute)\n");
+    if (argc == 2) {
+        if (!RunRecorded(argv[1])) {
+            fprintf(stderr, "Can't open %s\n", argv[1]);
+            return 1;
+        }
+        return 0;
+    }
+
+    RunSimulated("1C discharge", ConstantDischarge, 0.95, 20000);
+    RunSimulated("Pulsed 1.5A/0.3A", PulsedDischarge, 0.80, 40000);
+    RunSimulated("0.5C charge", ConstantCharge, 0.10, 40000);
+    RunSimulated("Flight cycles", FlightProfile, 0.90, 60000);
+    RunSimulated("100 A pulses", ShortPulses, 0.90, 20000);
+    return 0;
+}
+
+#endif // COMPUTER_ENVIRONMENT
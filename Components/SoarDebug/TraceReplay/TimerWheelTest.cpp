@@ -0,0 +1,265 @@
+/**
+ ******************************************************************************
+ * File Name          : TimerWheelTest.cpp
+ * Description        : Host tests for the TimerWheel, run through its own task
+ *                      loop on simulated ticks.
+ *
+ *    Starts just short of the 32 bit tick wrap and runs the real Run() loop,
+ *    with ulTaskNotifyTake standing in for the scheduler: it sleeps the task
+ *    by moving the simulated Clock, unless another task arms or cancels in
+ *    the meantime, which is replayed at its tick and wakes it early.
+ *
+ *    TIMER_TEST_ENTRIES entries, one shot and periodic, with delays from 0
+ *    to past the 2^20 tick wheel span. Some are cancelled, some rearmed
+ *    from outside the task, some rearmed from their own callback, and some
+ *    have their period changed while armed. Over TIMER_TEST_SPAN_TICKS,
+ *    across the wrap, it checks:
+ *      - Every callback runs on exactly the tick it's due, never early or late,
+ *        except a delay of 0 on a tick the wheel has already run, which runs
+ *        on the next one and keeps its period's phase
+ *      - Nothing cancelled, disarmed or made a last expiry by SetPeriod runs
+ *      - Nothing armed is left overdue when the run ends
+ *      - Remaining() and the armed count agree with what's still to come
+ *
+ *    Host only. Build and run from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ISoarDebug/TraceReplay/Shim -ICore/Inc
+ *          -include SoarDebug/TraceReplay/Shim/StaticTask.hpp
+ *          SoarDebug/TraceReplay/TimerWheelTest.cpp Core/TimerWheel.cpp -o TimerWheelTest
+ *      ./TimerWheelTest
+ *    Exits non-zero if anything fails.
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <cstdio>
+#include <random>
+#include "TimerWheel.hpp"
+#include "Shim/HostTest.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr TickType_t TIMER_TEST_START_TICK = 0xFFFF0000;        // 65536 ticks short of the wrap
+constexpr TickType_t TIMER_TEST_SPAN_TICKS = 3100000;           // Three times round the 2^20 wheel span
+constexpr uint16_t TIMER_TEST_ENTRIES = 600;
+constexpr uint16_t TIMER_TEST_OUTSIDE_OPS = 400;                // Arms, cancels and period changes from other tasks
+constexpr uint8_t TIMER_TEST_SELF_REARMS = 3;                   // Times a one shot rearms itself from its callback
+
+bool Shim::verbose = false;
+
+/**
+ * @brief What an entry should do, kept alongside the wheel's copy
+ */
+struct Expected {
+    TimerWheelEntry entry;
+    bool armed;
+    TickType_t due;                 // Expiry, periods follow on from it
+    TickType_t earliest;            // First tick the wheel hadn't run when it was armed
+    TickType_t period;
+    uint8_t selfRearms;             // Left to do, one shots only
+    uint32_t fired;
+};
+
+/**
+ * @brief Something another task does while the wheel sleeps
+ */
+struct OutsideOp {
+    TickType_t at;
+    uint16_t index;
+    uint8_t kind;                   // 0 arm, 1 cancel, 2 period change
+    TickType_t delay;
+    TickType_t period;
+};
+
+static Expected timers[TIMER_TEST_ENTRIES];
+static OutsideOp ops[TIMER_TEST_OUTSIDE_OPS];
+static uint16_t nextOp = 0;
+static std::mt19937 rng(1);
+
+static bool notified = false;
+static TickType_t advancedTo = 0;   // Every slot up to here has been run, arming for it waits a tick
+
+struct RunEnd {};                   // Thrown out of the task loop once the span is covered
+
+/* Helpers ------------------------------------------------------------------*/
+static TickType_t Now()
+{
+    return xTaskGetTickCount();
+}
+
+static void SetTick(TickType_t tick)
+{
+    // The tick is the low 32 bits of simulated milliseconds, so it wraps as on the target
+    const uint64_t ms = Clock::Micros() / 1000;
+    const uint64_t base = ms & ~0xFFFFFFFFULL;
+    const uint64_t next = base + tick + ((tick < (uint32_t)ms) ? (1ULL << 32) : 0);
+    Clock::SetMicros(next * 1000);
+}
+
+static TickType_t RandomDelay(uint16_t i)
+{
+    if (i % 50 == 0)
+        return rng() % (TIMER_TEST_SPAN_TICKS - 100000);    // Past the wheel span, goes round the top level
+    if (i % 17 == 0)
+        return 0;
+    return rng() % 200000;
+}
+
+/**
+ * @brief Arms an entry and its expectation
+ */
+static void Arm(Expected& t, TickType_t delay, TickType_t period)
+{
+    TimerWheel::Inst().Arm(t.entry, delay, period);
+    t.armed = true;
+    t.due = Now() + delay;
+    t.earliest = advancedTo + 1;
+    t.period = period;
+}
+
+/**
+ * @brief Tick an entry runs on, an expiry the wheel has already run past waits for the next one
+ */
+static TickType_t RunsAt(const Expected& t)
+{
+    return ((int32_t)(t.due - t.earliest) >= 0) ? t.due : t.earliest;
+}
+
+/**
+ * @brief Entry callback, checks it's due now and moves the expectation on
+ */
+static void OnExpire(void* arg)
+{
+    Expected& t = *(Expected*)arg;
+    const uint16_t index = (uint16_t)(&t - timers);
+    advancedTo = Now();
+    CHECK(t.armed, "Entry %u ran while disarmed at %lu", index, (unsigned long)Now());
+    CHECK(Now() == RunsAt(t), "Entry %u due at %lu ran at %lu", index, (unsigned long)RunsAt(t), (unsigned long)Now());
+    t.fired++;
+
+    if (t.period != 0) {
+        t.due += t.period;
+        t.earliest = Now() + 1;
+    }
+    else if (t.selfRearms > 0) {
+        t.selfRearms--;
+        Arm(t, rng() % 100000, 0);
+    }
+    else {
+        t.armed = false;
+    }
+}
+
+/**
+ * @brief Replays the next outside operation, at its tick
+ */
+static void RunOutsideOp()
+{
+    const OutsideOp& op = ops[nextOp++];
+    Expected& t = timers[op.index];
+    SetTick(op.at);
+
+    switch (op.kind) {
+    case 0:
+        Arm(t, op.delay, op.period);
+        break;
+    case 1:
+        CHECK(TimerWheel::Inst().Cancel(t.entry) == t.armed, "Cancel of entry %u disagreed on whether it was armed", op.index);
+        t.armed = false;
+        break;
+    default:
+        TimerWheel::Inst().SetPeriod(t.entry, op.period);
+        t.period = op.period;
+        break;
+    }
+}
+
+/* Kernel stand-ins ----------------------------------------------------------*/
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    notified = true;
+}
+
+/**
+ * @brief The wheel task blocks here, time moves on to its timeout or the next outside operation that notifies it
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait_ticks)
+{
+    (void)clearOnExit;
+    advancedTo = Now();
+    if (advancedTo - TIMER_TEST_START_TICK >= TIMER_TEST_SPAN_TICKS)
+        throw RunEnd();
+
+    const TickType_t wakeAt = Now() + wait_ticks;
+    while (!notified && nextOp < TIMER_TEST_OUTSIDE_OPS && (int32_t)(ops[nextOp].at - wakeAt) < 0)
+        RunOutsideOp();
+
+    if (notified) {
+        notified = false;
+        return 1;
+    }
+    SetTick(wakeAt);
+    return 0;
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main()
+{
+    SetTick(TIMER_TEST_START_TICK);
+    advancedTo = TIMER_TEST_START_TICK;
+    TimerWheel& wheel = TimerWheel::Inst();
+    wheel.InitTask();
+
+    for (uint16_t i = 0; i < TIMER_TEST_ENTRIES; i++) {
+        Expected& t = timers[i];
+        t = {};
+        TimerWheel::Init(t.entry, OnExpire, &t);
+        t.selfRearms = (i % 11 == 0) ? TIMER_TEST_SELF_REARMS : 0;
+        Arm(t, RandomDelay(i), (i % 7 == 0) ? 1 + rng() % 5000 : 0);
+    }
+    for (uint16_t i = 0; i < TIMER_TEST_ENTRIES; i += 13) {
+        wheel.Cancel(timers[i].entry);
+        timers[i].armed = false;
+    }
+
+    // Outside operations spread over the span in tick order
+    for (uint16_t n = 0; n < TIMER_TEST_OUTSIDE_OPS; n++) {
+        OutsideOp& op = ops[n];
+        op.at = TIMER_TEST_START_TICK + 1 + (TickType_t)(((uint64_t)n * TIMER_TEST_SPAN_TICKS) / TIMER_TEST_OUTSIDE_OPS) + rng() % 1000;
+        op.index = (uint16_t)(rng() % TIMER_TEST_ENTRIES);
+        op.kind = (uint8_t)(rng() % 3);
+        op.delay = RandomDelay(op.index);
+        op.period = (rng() % 2) ? 1 + rng() % 5000 : 0;
+    }
+
+    try {
+        TimerWheel::RunTask(nullptr);
+    }
+    catch (RunEnd&) {
+    }
+
+    CHECK(nextOp == TIMER_TEST_OUTSIDE_OPS, "Only %u of %u outside operations ran", nextOp, TIMER_TEST_OUTSIDE_OPS);
+
+    uint16_t armed = 0;
+    uint32_t fired = 0;
+    for (uint16_t i = 0; i < TIMER_TEST_ENTRIES; i++) {
+        const Expected& t = timers[i];
+        fired += t.fired;
+        CHECK(t.entry.armed == t.armed, "Entry %u armed is %u, expected %u", i, t.entry.armed, t.armed);
+        if (!t.armed)
+            continue;
+
+        armed++;
+        const TickType_t remaining = ((int32_t)(t.due - Now()) > 0) ? t.due - Now() : 0;
+        CHECK((int32_t)(RunsAt(t) - advancedTo) > 0, "Entry %u due at %lu was still waiting at %lu", i, (unsigned long)RunsAt(t), (unsigned long)advancedTo);
+        CHECK(wheel.Remaining(t.entry) == remaining, "Entry %u has %lu remaining, expected %lu", i,
+            (unsigned long)wheel.Remaining(t.entry), (unsigned long)remaining);
+    }
+    const TimerWheelStats stats = wheel.GetStats();
+    CHECK(stats.armed == armed, "Wheel counts %u armed, expected %u", stats.armed, armed);
+    CHECK(stats.expired == fired, "Wheel counts %lu expired, callbacks counted %lu", (unsigned long)stats.expired, (unsigned long)fired);
+    CHECK(stats.maxLate_ticks <= 1, "An entry ran %lu ticks late", (unsigned long)stats.maxLate_ticks);    // Only a delay of 0 on a tick already run
+
+    printf("TimerWheel: %lu callbacks, %lu cascaded, ended at tick %lu\n", (unsigned long)fired, (unsigned long)stats.cascaded, (unsigned long)advancedTo);
+    return HostTest::Summary("TimerWheel");
+}
+
+#endif // COMPUTER_ENVIRONMENT
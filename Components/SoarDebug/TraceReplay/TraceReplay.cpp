@@ -0,0 +1,724 @@
+/**
+ ******************************************************************************
+ * File Name          : TraceReplay.cpp
+ * Description        : Host trace replay for BatterySM, runs recorded sensor
+ *                      traces through the real state machine as fast as the
+ *                      host allows.
+ *
+ *    Every record is turned into the same DATA_COMMAND the sensor tasks send
+ *    and handed to BatterySM::HandleCommand, with the simulated clock set to
+ *    the record's time, so protection, SoC, charging and the journal run
+ *    exactly as on the target. Reports every transition and every limit that
+ *    trips, the time spent in each substate and how long each sample took to
+ *    decide on (host nanoseconds, only meaningful relative to each other).
+ *
+ *    The ALERT pin is simulated too: every BMS record is the CC_READY edge
+ *    that announced it and every A record a fault edge, both go through the
+ *    real FastProtection interrupt path. For each trip the replay checks the
+ *    power select went to umbilical and the FETs were held open before
+ *    BatterySM saw anything, then delivers the queued BMS_ALERT and checks
+ *    BatterySM ended up in Fault.
+ *
+ *    Traces are read one record at a time through a large stdio buffer, so
+ *    memory use doesn't depend on the trace length. "-" reads stdin, which
+ *    lets compressed traces be piped in.
+ *
+ *    CSV, one record per line, '#' starts a comment:
+ *      B,time_ms,cell1_mV,...,cellN_mV,pack_mV,cc_raw,temperature_dC,sys_stat
+ *      C,time_ms,input_mV,battery_mV,charge_mA,die_dC,charger_state,charge_status
+ *      F,time_ms,soc_pct,remaining_mAh,full_mAh,voltage_mV,avg_current_mA,temperature_dC
+ *      E,time_ms,event               (BatteryEvent number or name, e.g. StartCharge)
+ *      A,time_ms[,queued]            (ALERT fault edge, queued=0 plays a full FlightTask queue)
+ *
+ *    Binary, for the big traces: an 8 byte header "BRTR", version, cell
+ *    count, 2 reserved, then per record a uint64_t time_ms, a uint8_t type
+ *    (the CSV letter), a uint8_t length and the Data.h struct (or the event
+ *    byte, the queued byte) as laid out by a little endian GCC build.
+ *
+ *    Host only. Build from Components with:
+ *      g++ -std=c++17 -O2 -DCOMPUTER_ENVIRONMENT -ISoarDebug/TraceReplay/Shim
+ *          -ICore/Inc -IBatteryManagement/Inc -ISensors/Inc -IFlightControl/Inc
+ *          SoarDebug/TraceReplay/TraceReplay.cpp BatteryManagement/[A-Z]*.cpp
+ *          FlightControl/BatterySM.cpp FlightControl/FastProtection.cpp -o TraceReplay
+ *
+ *    Limits are tuned by editing LIMIT_TABLE in ProtectionEngine.cpp and
+ *    rebuilding, the replay uses whatever the firmware would.
+ ******************************************************************************
+*/
+#ifdef COMPUTER_ENVIRONMENT
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "SystemDefines.hpp"
+#include "BatterySM.hpp"
+#include "Clock.hpp"
+#include "FastProtection.hpp"
+#include "GPIO.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr size_t TRACE_IO_BUFFER_BYTES = 1 << 20;    // stdio buffer, large sequential reads
+constexpr uint16_t TRACE_MAX_LINE = 256;
+constexpr uint8_t TRACE_BINARY_VERSION = 1;
+constexpr uint8_t LATENCY_BUCKETS = 32;                // log2 nanoseconds
+constexpr uint8_t TRACE_KINDS = 5;                     // BMS, charger, fuel gauge, event, alert
+
+enum TraceRecordType : uint8_t
+{
+    TRACE_BMS = 'B',
+    TRACE_CHARGER = 'C',
+    TRACE_FUEL_GAUGE = 'F',
+    TRACE_EVENT = 'E',
+    TRACE_ALERT = 'A',
+};
+
+// Indexed by ProtectionLimit
+static const char* const LIMIT_NAMES[] = {
+    "CellOvervoltage", "CellUndervoltage", "CellImbalance", "ChargeOvercurrent", "DischargeOvercurrent",
+    "ChargeOvertemp", "ChargeUndertemp", "PackOvertemp", "GaugeOvertemp", "ChargerInputOvervoltage", "BmsHardwareFault",
+};
+static_assert(sizeof(LIMIT_NAMES) / sizeof(LIMIT_NAMES[0]) == PROT_LIMIT_COUNT, "LIMIT_NAMES must name every ProtectionLimit");
+
+bool Shim::verbose = false;
+bool Shim::internalPower = true;    // Running on the pack until something trips
+
+// The FlightTask queue as far as BMS_ALERT goes
+static bool alertQueueFull = false;
+static uint32_t queuedAlerts = 0;
+
+/* Structs ------------------------------------------------------------------*/
+struct TraceRecord {
+    uint64_t time_ms;
+    TraceRecordType type;
+    union {
+        BMSData bms;
+        ChargerData charger;
+        FuelGaugeData fuelGauge;
+        uint8_t event;
+        uint8_t queued;        // TRACE_ALERT, 0 if the notify doesn't fit in the queue
+    };
+};
+
+/**
+ * @brief Nanosecond latency distribution, log2 buckets so it's constant size however long the trace is
+ */
+struct LatencyStats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];    // Bucket n is [2^(n-1), 2^n) ns
+
+    void Add(uint64_t ns)
+    {
+        uint8_t bucket = 0;
+        for (uint64_t v = ns; v != 0 && bucket < LATENCY_BUCKETS - 1; v >>= 1)
+            bucket++;
+        buckets[bucket]++;
+        count++;
+        total_ns += ns;
+        max_ns = (ns > max_ns) ? ns : max_ns;
+    }
+
+    // Upper bound of the bucket holding the given fraction of samples
+    uint64_t Percentile(uint32_t perMille) const
+    {
+        const uint64_t target = (count * perMille + 999) / 1000;
+        uint64_t seen = 0;
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen >= target)
+                return (b == 0) ? 0 : (1ULL << b);
+        }
+        return max_ns;
+    }
+};
+
+/* Trace Reader ------------------------------------------------------------------*/
+/**
+ * @brief Streams records out of a CSV or binary trace
+ */
+class TraceReader
+{
+public:
+    TraceReader() : file_(nullptr), binary_(false), prefixLength_(0), line_(0), skipped_(0) {}
+    ~TraceReader() { if (file_ != nullptr && file_ != stdin) fclose(file_); }
+
+    bool Open(const char* path);
+    bool Next(TraceRecord& record);
+
+    uint64_t GetLine() const { return line_; }
+    uint64_t GetSkipped() const { return skipped_; }
+
+protected:
+    bool NextBinary(TraceRecord& record);
+    bool NextCsv(TraceRecord& record);
+    bool ReadLine(char* line, uint16_t size);
+    bool ParseCsv(char* line, TraceRecord& record);
+
+    FILE* file_;
+    bool binary_;
+    char prefix_[4];        // Read while checking for the binary magic, not yet consumed
+    uint8_t prefixLength_;
+    uint64_t line_;        // CSV line or binary record number, for error messages
+    uint64_t skipped_;    // Malformed records
+};
+
+/**
+ * @brief Opens a trace and works out its format from the first bytes
+ * @param path File to read, "-" for stdin
+ * @return False if the file can't be opened or has an unsupported binary header
+ */
+bool TraceReader::Open(const char* path)
+{
+    file_ = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+    if (file_ == nullptr)
+        return false;
+    setvbuf(file_, nullptr, _IOFBF, TRACE_IO_BUFFER_BYTES);
+
+    // Binary traces start with the magic, anything else is CSV and the bytes read are the start of its first line
+    prefixLength_ = (uint8_t)fread(prefix_, 1, sizeof(prefix_), file_);
+    if (prefixLength_ < sizeof(prefix_) || memcmp(prefix_, "BRTR", 4) != 0)
+        return true;
+    prefixLength_ = 0;
+
+    uint8_t header[4];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) || header[0] != TRACE_BINARY_VERSION || header[1] != BATTERY_NUM_CELLS) {
+        fprintf(stderr, "Unsupported binary trace, version %u with %u cells\n", header[0], header[1]);
+        return false;
+    }
+    binary_ = true;
+    return true;
+}
+
+/**
+ * @brief Reads the next record, malformed ones are counted and skipped
+ * @return False at the end of the trace
+ */
+bool TraceReader::Next(TraceRecord& record)
+{
+    return binary_ ? NextBinary(record) : NextCsv(record);
+}
+
+/**
+ * @brief Reads the next binary record, records of an unknown type or the wrong length are skipped
+ */
+bool TraceReader::NextBinary(TraceRecord& record)
+{
+    while (true) {
+        uint8_t header[10];
+        if (fread(header, 1, sizeof(header), file_) != sizeof(header))
+            return false;
+        line_++;
+
+        memcpy(&record.time_ms, header, sizeof(uint64_t));
+        record.type = (TraceRecordType)header[8];
+        const uint8_t length = header[9];
+
+        uint8_t payload[UINT8_MAX];
+        if (fread(payload, 1, length, file_) != length)
+            return false;
+
+        size_t expected = 0;
+        switch (record.type) {
+        case TRACE_BMS: expected = sizeof(BMSData); break;
+        case TRACE_CHARGER: expected = sizeof(ChargerData); break;
+        case TRACE_FUEL_GAUGE: expected = sizeof(FuelGaugeData); break;
+        case TRACE_EVENT: expected = sizeof(uint8_t); break;
+        case TRACE_ALERT: expected = sizeof(uint8_t); break;
+        default: break;
+        }
+        if (expected == 0 || length != expected) {
+            skipped_++;
+            continue;
+        }
+
+        memcpy(&record.bms, payload, length);
+        return true;
+    }
+}
+
+/**
+ * @brief Reads the next CSV record, blank and comment lines are skipped
+ */
+bool TraceReader::NextCsv(TraceRecord& record)
+{
+    char line[TRACE_MAX_LINE];
+    while (ReadLine(line, sizeof(line))) {
+        line_++;
+
+        // A line longer than the buffer is malformed, drop the rest of it
+        if (strchr(line, '\n') == nullptr && !feof(file_)) {
+            int c;
+            while ((c = fgetc(file_)) != '\n' && c != EOF) {}
+            skipped_++;
+            continue;
+        }
+
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r' || line[0] == '\0')
+            continue;
+
+        if (ParseCsv(line, record))
+            return true;
+
+        skipped_++;
+        if (skipped_ <= 10)
+            fprintf(stderr, "Line %llu malformed, skipped\n", (unsigned long long)line_);
+    }
+    return false;
+}
+
+/**
+ * @brief fgets that first hands out whatever Open() read ahead
+ */
+bool TraceReader::ReadLine(char* line, uint16_t size)
+{
+    uint16_t n = 0;
+    uint8_t used = 0;
+    while (used < prefixLength_ && n + 1 < size) {
+        line[n++] = prefix_[used++];
+        if (line[n - 1] == '\n')
+            break;
+    }
+    memmove(prefix_, prefix_ + used, prefixLength_ - used);
+    prefixLength_ -= used;
+
+    if (n > 0 && line[n - 1] == '\n') {
+        line[n] = '\0';
+        return true;
+    }
+    if (fgets(line + n, size - n, file_) == nullptr) {
+        line[n] = '\0';
+        return n > 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses one CSV record, strtol instead of sscanf since this runs for every line of a huge file
+ */
+bool TraceReader::ParseCsv(char* line, TraceRecord& record)
+{
+    char* p = line;
+    record.type = (TraceRecordType)*p++;
+    if (*p++ != ',')
+        return false;
+
+    char* end;
+    record.time_ms = strtoull(p, &end, 10);
+    if (end == p)
+        return false;
+    p = end;
+
+    // Reads count integer fields, each preceded by a comma
+    int32_t fields[BATTERY_NUM_CELLS + 4];
+    auto readFields = [&p, &fields](uint8_t count) {
+        for (uint8_t i = 0; i < count; i++) {
+            if (*p != ',')
+                return false;
+            char* fieldEnd;
+            fields[i] = (int32_t)strtol(p + 1, &fieldEnd, 0);
+            if (fieldEnd == p + 1)
+                return false;
+            p = fieldEnd;
+        }
+        return true;
+    };
+
+    switch (record.type) {
+    case TRACE_BMS: {
+        if (!readFields(BATTERY_NUM_CELLS + 4))
+            return false;
+        BMSData& bms = record.bms;
+        for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++)
+            bms.cellVoltage_mV[i] = (uint16_t)fields[i];
+        bms.packVoltage_mV = (uint16_t)fields[BATTERY_NUM_CELLS];
+        bms.ccReading = (int16_t)fields[BATTERY_NUM_CELLS + 1];
+        bms.temperature_dC = (int16_t)fields[BATTERY_NUM_CELLS + 2];
+        bms.sysStat = (uint8_t)fields[BATTERY_NUM_CELLS + 3];
+        return true;
+    }
+    case TRACE_CHARGER: {
+        if (!readFields(6))
+            return false;
+        ChargerData& charger = record.charger;
+        charger.inputVoltage_mV = (uint16_t)fields[0];
+        charger.batteryVoltage_mV = (uint16_t)fields[1];
+        charger.chargeCurrent_mA = (int16_t)fields[2];
+        charger.dieTemperature_dC = (int16_t)fields[3];
+        charger.chargerState = (uint16_t)fields[4];
+        charger.chargeStatus = (uint16_t)fields[5];
+        return true;
+    }
+    case TRACE_FUEL_GAUGE: {
+        if (!readFields(6))
+            return false;
+        FuelGaugeData& fuelGauge = record.fuelGauge;
+        fuelGauge.stateOfCharge_pct = (uint8_t)fields[0];
+        fuelGauge.remainingCapacity_mAh = (uint16_t)fields[1];
+        fuelGauge.fullChargeCapacity_mAh = (uint16_t)fields[2];
+        fuelGauge.voltage_mV = (uint16_t)fields[3];
+        fuelGauge.averageCurrent_mA = (int16_t)fields[4];
+        fuelGauge.temperature_dC = (int16_t)fields[5];
+        return true;
+    }
+    case TRACE_EVENT: {
+        if (*p++ != ',')
+            return false;
+        p[strcspn(p, "\r\n")] = '\0';
+
+        // Either the number or the name BatterySM prints
+        if (*p >= '0' && *p <= '9') {
+            record.event = (uint8_t)strtoul(p, nullptr, 10);
+            return record.event < BE_COUNT;
+        }
+        for (uint8_t e = 0; e < BE_COUNT; e++) {
+            if (strcmp(p, BatterySM::EventToString((BatteryEvent)e)) == 0) {
+                record.event = e;
+                return true;
+            }
+        }
+        return false;
+    }
+    case TRACE_ALERT: {
+        record.queued = 1;
+        if (*p == ',')
+            record.queued = (uint8_t)(strtoul(p + 1, nullptr, 10) != 0);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/* Replay ------------------------------------------------------------------*/
+/**
+ * @brief Feeds records to a BatterySM and collects what it did
+ */
+class TraceReplay
+{
+public:
+    TraceReplay(bool printTransitions);
+
+    void Apply(const TraceRecord& record);
+    void PrintSummary(double wall_s, uint64_t skipped) const;
+
+protected:
+    bool PulseAlert(uint64_t time_ms);
+    void ReportTransitions(uint64_t time_ms);
+    void ReportFaults(uint64_t time_ms);
+    static void PrintTime(uint64_t time_ms);
+
+    BatterySM bsm_;
+    bool printTransitions_;
+
+    uint64_t firstTime_ms_;
+    uint64_t lastTime_ms_;
+    uint64_t records_[TRACE_KINDS];     // BMS, charger, fuel gauge, event, alert
+    uint64_t outOfOrder_;
+
+    uint16_t lastSequence_;
+    uint64_t transitions_;
+    uint64_t lostTransitions_;          // More transitions in one record than the journal keeps
+    uint64_t enteredState_[BS_NONE];
+    uint32_t lastFaultMask_;
+    uint64_t trips_[PROT_LIMIT_COUNT];
+    uint64_t substateTime_ms_[BSS_COUNT];
+
+    // Fast protection trips, each check counts the trips it held for
+    uint64_t alertTrips_;
+    uint64_t safeBeforeStateMachine_;   // Umbilical power and FETs open before BatterySM ran
+    uint64_t faultAfterNotify_;         // BatterySM in Fault once the notify was delivered
+    uint64_t lateNotifies_;             // Notify didn't fit, left to the next BMS sample
+    uint64_t awaitingFault_;            // Trips BatterySM hasn't acknowledged yet
+    uint64_t alertsOnGrid_;             // A records taken for a CC_READY edge
+
+    LatencyStats latency_[TRACE_KINDS];
+};
+
+/**
+ * @brief Starts in Idle with the FETs open, as after a reset with no stored state
+ */
+TraceReplay::TraceReplay(bool printTransitions) : bsm_(BS_IDLE, true)
+{
+    printTransitions_ = printTransitions;
+    firstTime_ms_ = UINT64_MAX;
+    lastTime_ms_ = 0;
+    memset(records_, 0, sizeof(records_));
+    outOfOrder_ = 0;
+    lastSequence_ = bsm_.GetJournal().GetSequence();
+    transitions_ = 0;
+    lostTransitions_ = 0;
+    memset(enteredState_, 0, sizeof(enteredState_));
+    lastFaultMask_ = 0;
+    memset(trips_, 0, sizeof(trips_));
+    memset(substateTime_ms_, 0, sizeof(substateTime_ms_));
+    alertTrips_ = 0;
+    safeBeforeStateMachine_ = 0;
+    faultAfterNotify_ = 0;
+    lateNotifies_ = 0;
+    awaitingFault_ = 0;
+    alertsOnGrid_ = 0;
+    memset(latency_, 0, sizeof(latency_));
+
+    FastProtection::Init([]() {
+        if (alertQueueFull)
+            return false;
+        queuedAlerts++;
+        return true;
+    });
+}
+
+/**
+ * @brief Runs one record through the state machine
+ */
+void TraceReplay::Apply(const TraceRecord& record)
+{
+    // Time only moves forward, a record from the past runs at the last time seen
+    uint64_t time_ms = record.time_ms;
+    if (firstTime_ms_ == UINT64_MAX)
+        firstTime_ms_ = lastTime_ms_ = time_ms;
+    if (time_ms < lastTime_ms_) {
+        outOfOrder_++;
+        time_ms = lastTime_ms_;
+    }
+    substateTime_ms_[bsm_.GetSubstate()] += time_ms - lastTime_ms_;
+    lastTime_ms_ = time_ms;
+    Clock::SetMicros(time_ms * 1000);
+
+    uint8_t kind;
+    uint16_t taskCommand;
+    const void* data;
+    uint16_t size;
+    switch (record.type) {
+    case TRACE_BMS:         kind = 0; taskCommand = BMS_UPDATE; data = &record.bms; size = sizeof(BMSData); break;
+    case TRACE_CHARGER:     kind = 1; taskCommand = CHARGER_UPDATE; data = &record.charger; size = sizeof(ChargerData); break;
+    case TRACE_FUEL_GAUGE:  kind = 2; taskCommand = FUEL_GAUGE_UPDATE; data = &record.fuelGauge; size = sizeof(FuelGaugeData); break;
+    case TRACE_ALERT:       kind = 4; taskCommand = BMS_ALERT; data = nullptr; size = 0; break;
+    default:                kind = 3; taskCommand = 0; data = nullptr; size = 0; break;
+    }
+    records_[kind]++;
+
+    // Every sample was announced by a CC_READY edge on ALERT, an A record is an edge and nothing else
+    if (record.type == TRACE_BMS || record.type == TRACE_ALERT) {
+        alertQueueFull = (record.type == TRACE_ALERT && record.queued == 0);
+        if (!PulseAlert(time_ms) && record.type == TRACE_ALERT)
+            alertsOnGrid_++;
+        alertQueueFull = false;
+    }
+
+    // Build the command outside the timed section, the sensor task does that on the target
+    Command cm(DATA_COMMAND, taskCommand);
+    if (data != nullptr)
+        cm.CopyDataToCommand((const uint8_t*)data, size);
+
+    // An alert edge only reaches BatterySM if it tripped and the notify was queued
+    if (kind != 4 || queuedAlerts != 0) {
+        const auto start = std::chrono::steady_clock::now();
+        if (kind == 3)
+            bsm_.Dispatch((BatteryEvent)record.event);
+        else
+            bsm_.HandleCommand(cm);
+        const auto end = std::chrono::steady_clock::now();
+        latency_[kind].Add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    queuedAlerts = 0;
+
+    // A late notify is picked up by whichever BMS sample comes next
+    if (awaitingFault_ != 0 && !FastProtection::IsLatched()) {
+        faultAfterNotify_ += (bsm_.GetState() == BS_FAULT) ? awaitingFault_ : 0;
+        awaitingFault_ = 0;
+    }
+
+    ReportFaults(time_ms);
+    ReportTransitions(time_ms);
+}
+
+/**
+ * @brief Runs one ALERT edge through the interrupt path and checks a trip left the pack safe on its own
+ * @return True if the edge tripped
+ */
+bool TraceReplay::PulseAlert(uint64_t time_ms)
+{
+    const uint16_t tripsBefore = FastProtection::GetStats().trips;
+    const BatteryState stateBefore = bsm_.GetState();
+    FastProtection::OnAlert();
+
+    const FastProtectionStats stats = FastProtection::GetStats();
+    if (stats.trips == tripsBefore)
+        return false;
+
+    alertTrips_++;
+    awaitingFault_++;
+    lateNotifies_ += (queuedAlerts == 0);
+    const bool safe = !GPIO::PowerSelect::IsInternal() && bsm_.GetFetRegister() == 0 && bsm_.GetState() == stateBefore;
+    safeBeforeStateMachine_ += safe;
+
+    if (printTransitions_) {
+        PrintTime(time_ms);
+        printf(" alert      trip in %s, %s%s, isr %lu ns\n", BatterySM::StateToString(stateBefore),
+            safe ? "safe before BatterySM" : "NOT SAFE", (queuedAlerts == 0) ? ", notify late" : "", (unsigned long)stats.lastResponseCycles);
+    }
+    return true;
+}
+
+/**
+ * @brief Prints the journal entries added by the last record
+ */
+void TraceReplay::ReportTransitions(uint64_t time_ms)
+{
+    const BatteryJournal& journal = bsm_.GetJournal();
+    const uint16_t added = (uint16_t)(journal.GetSequence() - lastSequence_);
+    if (added == 0)
+        return;
+    lastSequence_ = journal.GetSequence();
+
+    const uint8_t kept = (added < journal.GetCount()) ? (uint8_t)added : journal.GetCount();
+    transitions_ += added;
+    lostTransitions_ += added - kept;
+
+    for (uint8_t age = kept; age > 0; age--) {
+        BatteryJournalEntry e;
+        journal.GetEntry(age - 1, e);
+        if (e.toState != e.fromState && e.toState < BS_NONE)
+            enteredState_[e.toState]++;
+
+        if (printTransitions_) {
+            PrintTime(time_ms);
+            printf(" transition %-16s %s.%s --> %s.%s", BatterySM::EventToString((BatteryEvent)e.event),
+                BatterySM::StateToString((BatteryState)e.fromState), BatterySM::SubstateToString((BatterySubstate)e.fromSubstate),
+                BatterySM::StateToString((BatteryState)e.toState), BatterySM::SubstateToString((BatterySubstate)e.toSubstate));
+            if (e.faultMask != 0)
+                printf(" faults 0x%08lx", (unsigned long)e.faultMask);
+            printf("\n");
+        }
+    }
+}
+
+/**
+ * @brief Prints each limit that trips, once per trip rather than on every sample it stays tripped
+ */
+void TraceReplay::ReportFaults(uint64_t time_ms)
+{
+    const uint32_t mask = bsm_.GetLastFaultMask();
+    const uint32_t tripped = mask & ~lastFaultMask_;
+    lastFaultMask_ = mask;
+
+    for (uint8_t limit = 0; limit < PROT_LIMIT_COUNT; limit++) {
+        if ((tripped & (1UL << limit)) == 0)
+            continue;
+        trips_[limit]++;
+        if (printTransitions_) {
+            PrintTime(time_ms);
+            printf(" fault      %s\n", LIMIT_NAMES[limit]);
+        }
+    }
+}
+
+/**
+ * @brief Trace time as d hh:mm:ss.mmm
+ */
+void TraceReplay::PrintTime(uint64_t time_ms)
+{
+    const uint64_t s = time_ms / 1000;
+    printf("%3llud %02llu:%02llu:%02llu.%03llu", (unsigned long long)(s / 86400), (unsigned long long)(s / 3600 % 24),
+        (unsigned long long)(s / 60 % 60), (unsigned long long)(s % 60), (unsigned long long)(time_ms % 1000));
+}
+
+/**
+ * @brief Prints totals for the whole trace
+ */
+void TraceReplay::PrintSummary(double wall_s, uint64_t skipped) const
+{
+    static const char* const KIND_NAMES[TRACE_KINDS] = { "BMS", "Charger", "FuelGauge", "Event", "Alert" };
+
+    const uint64_t span_ms = (firstTime_ms_ == UINT64_MAX) ? 0 : lastTime_ms_ - firstTime_ms_;
+    const uint64_t total = records_[0] + records_[1] + records_[2] + records_[3] + records_[4];
+
+    printf("\n-- Trace Replay Summary --\n");
+    printf("Records     : %llu (%llu BMS, %llu charger, %llu fuel gauge, %llu events, %llu alerts), %llu skipped, %llu out of order\n",
+        (unsigned long long)total, (unsigned long long)records_[0], (unsigned long long)records_[1], (unsigned long long)records_[2],
+        (unsigned long long)records_[3], (unsigned long long)records_[4], (unsigned long long)skipped, (unsigned long long)outOfOrder_);
+    printf("Trace span  : %.2f h replayed in %.2f s (%.0fx real time, %.0f records/s)\n",
+        span_ms / 3600000.0, wall_s, (wall_s > 0) ? span_ms / 1000.0 / wall_s : 0.0, (wall_s > 0) ? total / wall_s : 0.0);
+    printf("Final state : %s.%s\n", BatterySM::StateToString(bsm_.GetState()), BatterySM::SubstateToString(bsm_.GetSubstate()));
+
+    printf("Transitions : %llu", (unsigned long long)transitions_);
+    for (uint8_t s = 0; s < BS_NONE; s++)
+        printf(", %llu into %s", (unsigned long long)enteredState_[s], BatterySM::StateToString((BatteryState)s));
+    if (lostTransitions_ != 0)
+        printf(" (%llu not shown, burst longer than the journal)", (unsigned long long)lostTransitions_);
+    printf("\n");
+
+    printf("Limit trips :\n");
+    for (uint8_t limit = 0; limit < PROT_LIMIT_COUNT; limit++) {
+        if (trips_[limit] != 0)
+            printf("  %-24s %llu\n", LIMIT_NAMES[limit], (unsigned long long)trips_[limit]);
+    }
+
+    const FastProtectionStats fast = FastProtection::GetStats();
+    printf("Fast protection : %lu sample edges, %llu trips (%llu A records on the sample grid, %u slow path faults)\n", (unsigned long)fast.sampleEdges,
+        (unsigned long long)alertTrips_, (unsigned long long)alertsOnGrid_, fast.slowPathFaults);
+    if (alertTrips_ != 0) {
+        printf("  safe before BatterySM %llu/%llu, Fault reached %llu/%llu, %llu notifies late, isr worst %lu ns, handled worst %lu ms\n",
+            (unsigned long long)safeBeforeStateMachine_, (unsigned long long)alertTrips_, (unsigned long long)faultAfterNotify_,
+            (unsigned long long)alertTrips_, (unsigned long long)lateNotifies_, (unsigned long)fast.maxResponseCycles, (unsigned long)fast.maxHandled_ms);
+    }
+
+    printf("Substate time :\n");
+    for (uint8_t s = 0; s < BSS_COUNT; s++) {
+        if (substateTime_ms_[s] != 0) {
+            printf("  %-10s %10.2f h %6.2f%%\n", BatterySM::SubstateToString((BatterySubstate)s),
+                substateTime_ms_[s] / 3600000.0, (span_ms > 0) ? 100.0 * substateTime_ms_[s] / span_ms : 0.0);
+        }
+    }
+
+    printf("Decision latency (host ns) :\n");
+    for (uint8_t k = 0; k < TRACE_KINDS; k++) {
+        const LatencyStats& l = latency_[k];
+        if (l.count != 0) {
+            printf("  %-10s avg %6llu  p50 <%6llu  p99 <%6llu  max %8llu\n", KIND_NAMES[k], (unsigned long long)(l.total_ns / l.count),
+                (unsigned long long)l.Percentile(500), (unsigned long long)l.Percentile(990), (unsigned long long)l.max_ns);
+        }
+    }
+}
+
+/* Functions ------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    bool quiet = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else if (strcmp(argv[i], "-v") == 0)
+            Shim::verbose = true;
+        else
+            path = argv[i];
+    }
+
+    if (path == nullptr) {
+        fprintf(stderr, "Usage: %s [-q] [-v] <trace.csv | trace.bin | ->\n"
+            "  -q  summary only, no per transition lines\n"
+            "  -v  also show the firmware's own prints\n", argv[0]);
+        return 2;
+    }
+
+    TraceReader reader;
+    if (!reader.Open(path)) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+
+    static TraceReplay replay(!quiet);
+    const auto start = std::chrono::steady_clock::now();
+
+    TraceRecord record;
+    while (reader.Next(record))
+        replay.Apply(record);
+
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    replay.PrintSummary(wall_s, reader.GetSkipped());
+    return 0;
+}
+
+#endif // COMPUTER_ENVIRONMENT
@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ * File Name          : SystemStorage.hpp
+ * Description        : Power fail safe system state storage on internal flash.
+ *
+ *    The last two 2KB flash pages are banks A and B. Records are appended to
+ *    the active bank, each one version tagged, sequence numbered and CRC'd
+ *    with the CRC in the last double word so it's programmed last. A record
+ *    torn by a reset fails its CRC and the one before it is used instead.
+ *    When the active bank fills up the other one is erased and becomes the
+ *    active bank, the full bank keeps the newest good record until then.
+ *
+ *    Slots fill in order so the boot lookup is a binary search for the last
+ *    programmed slot in each bank and one CRC, no scan. Writes are queued to
+ *    the storage task and only programmed once the state has been quiet for
+ *    STORAGE_COALESCE_MS (or STORAGE_MAX_LATENCY_MS has passed), so a burst
+ *    of changes costs one flash program. Unchanged state is never written.
+ *    A failed program leaves the state pending and is retried, the wait
+ *    doubling from STORAGE_RETRY_MIN_MS up to STORAGE_RETRY_MAX_MS.
+ *
+ *    A reset in the middle of programming a double word can leave it with a
+ *    broken ECC, and reading it raises a double ECC error NMI. Slots are only
+ *    read through ReadSlot, and the NMI handler hands storage bank errors to
+ *    OnEccNmi, which clears the error and returns. The read then fails and
+ *    the slot is treated as torn.
+ ******************************************************************************
+*/
+#ifndef SOAR_SYSTEM_STORAGE_HPP_
+#define SOAR_SYSTEM_STORAGE_HPP_
+#include "StaticTask.hpp"
+#include "SystemDefines.hpp"
+#include "BatteryState.hpp"
+#include "ResistanceEstimator.hpp"
+
+/* Macros/Enums ------------------------------------------------------------*/
+constexpr uint32_t STORAGE_BANK_A_ADDRESS = 0x0800F000;    // Second to last page, see STORAGE in the linker script
+constexpr uint32_t STORAGE_BANK_B_ADDRESS = 0x0800F800;    // Last page
+constexpr uint32_t STORAGE_BANK_SIZE = 2048;               // One flash page per bank
+constexpr uint16_t STORAGE_RECORD_MAGIC = 0x5353;          // 'SS'
+constexpr uint8_t STORAGE_RECORD_VERSION = 1;              // Bump when SystemState changes, old records are ignored
+constexpr uint32_t STORAGE_COALESCE_MS = 500;              // Program once the state has been quiet this long
+constexpr uint32_t STORAGE_MAX_LATENCY_MS = 5000;          // Program at the latest this long after the first change
+constexpr uint32_t STORAGE_RETRY_MIN_MS = 100;             // Wait before retrying a failed program, doubles on each failure
+constexpr uint32_t STORAGE_RETRY_MAX_MS = 30000;           // Longest wait between retries
+
+enum SystemStorageCommands
+{
+    STORAGE_WRITE_STATE = 0,    // DATA_COMMAND carrying a SystemState, coalesced
+    STORAGE_FLUSH,              // TASK_SPECIFIC_COMMAND, program any pending state now
+};
+
+/* Structs ------------------------------------------------------------------*/
+/**
+ * @brief Everything restored on boot
+ */
+struct SystemState {
+    BatteryState batteryState;
+    ResistanceRecord resistance;
+};
+
+/**
+ * @brief One record slot, a multiple of the 8 byte flash program size
+ */
+struct alignas(8) SystemStorageRecord {
+    uint16_t magic;         // STORAGE_RECORD_MAGIC, an erased slot reads 0xFFFF
+    uint8_t version;        // STORAGE_RECORD_VERSION
+    uint8_t length;         // sizeof(SystemState)
+    uint32_t sequence;      // Increments on every write, across both banks
+    SystemState state;
+    uint16_t crc;           // CRC16 of everything above, in the last double word
+};
+
+/**
+ * @brief Program outcomes since boot
+ */
+struct SystemStorageStats {
+    uint32_t commits;               // Records programmed and read back valid
+    uint32_t failures;              // Failed erases and programs, each one retried
+    uint32_t retryDelay_ms;         // Wait before the next retry, 0 when the last attempt succeeded
+};
+
+constexpr uint16_t STORAGE_SLOTS_PER_BANK = STORAGE_BANK_SIZE / sizeof(SystemStorageRecord);
+
+/* Class ------------------------------------------------------------------*/
+class SystemStorage : public StaticTask<SystemStorage, STORAGE_TASK_RTOS_PRIORITY, STORAGE_TASK_STACK_DEPTH_WORDS, STORAGE_TASK_QUEUE_DEPTH_OBJS>
+{
+    friend StaticTask;
+
+public:
+    void InitTask();
+
+    bool Read(SystemState& state) const;
+    void Write(const SystemState& state);
+    void Flush() { SendCommand(Command(TASK_SPECIFIC_COMMAND, (uint16_t)STORAGE_FLUSH)); }
+
+    SystemStorageStats GetStats();
+    void PrintStats();
+
+    static bool OnEccNmi();
+
+protected:
+    void Run(void* pvParams); // Main run code
+
+    void HandleCommand(Command& cm);
+
+    // Flash layout
+    void Load();
+    uint16_t CountProgrammedSlots(uint8_t bank) const;
+    bool FindNewestInBank(uint8_t bank, uint16_t programmed, SystemStorageRecord& record) const;
+    void CommitPending();
+    bool Commit(const SystemState& state);
+    bool ProgramRecord(uint8_t bank, uint16_t slot, const SystemStorageRecord& record);
+    bool EraseBank(uint8_t bank);
+    const SystemStorageRecord* Slot(uint8_t bank, uint16_t slot) const { return &((const SystemStorageRecord*)bankAddress_[bank])[slot]; }
+    bool ReadSlot(uint8_t bank, uint16_t slot, SystemStorageRecord& record, uint16_t size = sizeof(SystemStorageRecord)) const;
+
+    static uint16_t RecordCrc(const SystemStorageRecord& record);
+    static bool IsValid(const SystemStorageRecord& record);
+
+    // Variables
+    uintptr_t bankAddress_[2];
+
+    bool hasState_;                 // A valid record was found or written
+    SystemState state_;             // Newest state in flash
+    uint32_t sequence_;             // Of state_
+    uint8_t activeBank_;
+    uint16_t nextSlot_;             // In the active bank, STORAGE_SLOTS_PER_BANK when full
+
+    bool pending_;                  // Waiting to be programmed
+    SystemState pendingState_;
+    uint32_t firstPendingTick_;
+    uint32_t lastPendingTick_;
+    uint32_t retryTick_;            // Not programmed again before this after a failure
+
+    SystemStorageStats stats_;
+
+private:
+    // Private Functions
+    SystemStorage();        // Private constructor
+};
+
+#endif    // SOAR_SYSTEM_STORAGE_HPP_
@@ -0,0 +1,427 @@
+/**
+ ******************************************************************************
+ * File Name          : SystemStorage.cpp
+ * Description        : Power fail safe system state storage on internal flash.
+ ******************************************************************************
+*/
+#include "SystemStorage.hpp"
+#include "Utils.hpp"
+#include <cstddef>
+#include <cstring>
+#include "stm32g0xx_hal.h"
+
+static_assert(sizeof(SystemStorageRecord) % 8 == 0, "Records must be whole flash double words");
+static_assert(offsetof(SystemStorageRecord, crc) >= sizeof(SystemStorageRecord) - 8, "The CRC must be in the last double word so it's programmed last");
+static_assert(sizeof(SystemState) <= UINT8_MAX, "SystemState too large for the record length field");
+static_assert(STORAGE_SLOTS_PER_BANK >= 2, "A bank must hold at least two records");
+
+/* Variables -----------------------------------------------------------------*/
+static volatile bool eccFailed = false;    // Set by the NMI, a storage bank read hit a double ECC error
+
+/* Functions ------------------------------------------------------------------*/
+/**
+ * @brief Compares two states field by field, so struct padding doesn't cause writes
+ */
+static bool IsSameState(const SystemState& a, const SystemState& b)
+{
+    if (a.batteryState != b.batteryState || a.resistance.stepCount != b.resistance.stepCount)
+        return false;
+    for (uint8_t i = 0; i < BATTERY_NUM_CELLS; i++) {
+        if (a.resistance.cellResistance_uOhm[i] != b.resistance.cellResistance_uOhm[i])
+            return false;
+    }
+    return true;
+}
+
+/* System Storage ------------------------------------------------------------------*/
+/**
+ * @brief Constructor for SystemStorage
+ */
+SystemStorage::SystemStorage() : StaticTask("StorageTask")
+{
+    bankAddress_[0] = STORAGE_BANK_A_ADDRESS;
+    bankAddress_[1] = STORAGE_BANK_B_ADDRESS;
+
+    hasState_ = false;
+    memset(&state_, 0, sizeof(state_));
+    sequence_ = 0;
+    activeBank_ = 0;
+    nextSlot_ = 0;
+
+    pending_ = false;
+    memset(&pendingState_, 0, sizeof(pendingState_));
+    firstPendingTick_ = 0;
+    lastPendingTick_ = 0;
+    retryTick_ = 0;
+
+    stats_ = {};
+}
+
+/**
+ * @brief Initialize the SystemStorage task, the stored state is looked up here so it's ready before any task runs
+ */
+void SystemStorage::InitTask()
+{
+    Load();
+
+    StaticTask::InitTask();
+}
+
+/**
+ * @brief Instance Run loop for the storage task, sleeps until a write is pending and then until it's due
+ * @param pvParams RTOS Passed void parameters, contains a pointer to the object instance, should not be used
+ */
+void SystemStorage::Run(void* pvParams)
+{
+    while (1) {
+        Watchdog::CheckIn(watchdogId_);
+        Command cm;
+
+        // Nothing to write, sleep until something is queued or it's time to check in
+        if (!pending_) {
+            if (qEvtQueue->Receive(cm, WATCHDOG_CHECKIN_PERIOD_MS))
+                HandleCommand(cm);
+            continue;
+        }
+
+        // Due when the state has been quiet for a while, or has been pending too long
+        const uint32_t now = xTaskGetTickCount();
+        const uint32_t quietAt = lastPendingTick_ + MS_TO_TICKS(STORAGE_COALESCE_MS);
+        const uint32_t latestAt = firstPendingTick_ + MS_TO_TICKS(STORAGE_MAX_LATENCY_MS);
+        uint32_t dueAt = ((int32_t)(quietAt - latestAt) < 0) ? quietAt : latestAt;
+        if (stats_.retryDelay_ms != 0 && (int32_t)(retryTick_ - dueAt) > 0)
+            dueAt = retryTick_;    // A program failed, back off before trying again
+        const uint32_t wait_ms = ((int32_t)(dueAt - now) > 0) ? TICKS_TO_MS(dueAt - now) : 0;
+
+        // Waits are cut to the check-in period, a retry backoff can be longer than the watchdog deadline
+        if (wait_ms > 0) {
+            if (qEvtQueue->Receive(cm, (wait_ms < WATCHDOG_CHECKIN_PERIOD_MS) ? wait_ms : WATCHDOG_CHECKIN_PERIOD_MS))
+                HandleCommand(cm);
+            continue;
+        }
+
+        if (pending_)
+            CommitPending();
+    }
+}
+
+/**
+ * @brief Handles a command from the command queue
+ * @param cm Command to handle
+ */
+void SystemStorage::HandleCommand(Command& cm)
+{
+    switch (cm.GetCommand()) {
+    case DATA_COMMAND: {
+        if (cm.GetTaskCommand() != STORAGE_WRITE_STATE || cm.GetDataSize() != sizeof(SystemState))
+            break;
+
+        SystemState state;
+        memcpy(&state, cm.GetDataPointer(), sizeof(SystemState));
+
+        // Back to what's already in flash, nothing to write
+        if (hasState_ && IsSameState(state, state_)) {
+            pending_ = false;
+            break;
+        }
+
+        const uint32_t now = xTaskGetTickCount();
+        if (!pending_)
+            firstPendingTick_ = now;
+        lastPendingTick_ = now;
+        pendingState_ = state;
+        pending_ = true;
+        break;
+    }
+    case TASK_SPECIFIC_COMMAND: {
+        if (cm.GetTaskCommand() == STORAGE_FLUSH && pending_)
+            CommitPending();    // Now, even while backing off
+        break;
+    }
+    default:
+        SOAR_PRINT("SystemStorage - Received Unsupported Command {%d}\n", cm.GetCommand());
+        break;
+    }
+
+    //No matter what we happens, we must reset allocated data
+    cm.Reset();
+}
+
+/**
+ * @brief Gets the newest stored state
+ * @param state Filled with the state
+ * @return False if there is no valid record in either bank
+ */
+bool SystemStorage::Read(SystemState& state) const
+{
+    if (!hasState_)
+        return false;
+
+    state = state_;
+    return true;
+}
+
+/**
+ * @brief Queues a state to be stored, repeated calls are coalesced into one flash program
+ * @param state The state to store
+ */
+void SystemStorage::Write(const SystemState& state)
+{
+    Command cm(DATA_COMMAND, (uint16_t)STORAGE_WRITE_STATE);
+    cm.CopyDataToCommand((uint8_t*)&state, sizeof(SystemState));
+    SendCommand(cm);
+}
+
+/**
+ * @brief Boot lookup, finds the newest valid record and where the next one goes
+ */
+void SystemStorage::Load()
+{
+    uint16_t programmed[2];
+    SystemStorageRecord newest[2];
+    bool found[2];
+
+    for (uint8_t bank = 0; bank < 2; bank++) {
+        programmed[bank] = CountProgrammedSlots(bank);
+        found[bank] = FindNewestInBank(bank, programmed[bank], newest[bank]);
+    }
+
+    // The bank with the newest record is the one being appended to
+    uint8_t bank = 0;
+    if (found[1] && (!found[0] || (int32_t)(newest[1].sequence - newest[0].sequence) > 0))
+        bank = 1;
+    else if (!found[0] && programmed[1] > programmed[0])
+        bank = 1;    // Nothing valid anywhere, continue where the most was written
+
+    activeBank_ = bank;
+    nextSlot_ = programmed[bank];
+    hasState_ = found[bank];
+    if (hasState_) {
+        state_ = newest[bank].state;
+        sequence_ = newest[bank].sequence;
+        SOAR_PRINT("SystemStorage: restored record %lu from bank %c\n", (unsigned long)sequence_, 'A' + bank);
+    }
+    else {
+        SOAR_PRINT("SystemStorage: no stored state\n");
+    }
+}
+
+/**
+ * @brief Counts the programmed slots in a bank, slots are only ever programmed in order so this is a binary search
+ * @param bank Bank to count
+ * @return Number of programmed slots, the next free slot
+ */
+uint16_t SystemStorage::CountProgrammedSlots(uint8_t bank) const
+{
+    uint16_t lo = 0;
+    uint16_t hi = STORAGE_SLOTS_PER_BANK;
+    while (lo < hi) {
+        const uint16_t mid = (lo + hi) / 2;
+        // A double word that fails ECC was being programmed, so the slot counts as programmed
+        SystemStorageRecord head;
+        if (!ReadSlot(bank, mid, head, 8) || head.magic != 0xFFFF)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Finds the newest valid record in a bank, a torn last record falls back to the one before it
+ * @param bank Bank to search
+ * @param programmed Programmed slots in the bank
+ * @param record Filled with the record
+ * @return False if the bank has no valid record
+ */
+bool SystemStorage::FindNewestInBank(uint8_t bank, uint16_t programmed, SystemStorageRecord& record) const
+{
+    // Only the last write can be torn, so this almost always stops on the first slot it checks
+    for (uint16_t slot = programmed; slot > 0; slot--) {
+        if (ReadSlot(bank, slot - 1, record) && IsValid(record))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Programs the pending state, on failure it stays pending and the retry wait doubles
+ */
+void SystemStorage::CommitPending()
+{
+    const bool ok = Commit(pendingState_);
+
+    taskENTER_CRITICAL();
+    if (ok) {
+        stats_.commits++;
+        stats_.retryDelay_ms = 0;
+    }
+    else {
+        stats_.failures++;
+        stats_.retryDelay_ms = (stats_.retryDelay_ms == 0) ? STORAGE_RETRY_MIN_MS : stats_.retryDelay_ms * 2;
+        if (stats_.retryDelay_ms > STORAGE_RETRY_MAX_MS)
+            stats_.retryDelay_ms = STORAGE_RETRY_MAX_MS;
+    }
+    taskEXIT_CRITICAL();
+
+    if (ok) {
+        pending_ = false;
+        return;
+    }
+    retryTick_ = xTaskGetTickCount() + MS_TO_TICKS(stats_.retryDelay_ms);
+    SOAR_PRINT("SystemStorage: retrying in %lu ms\n", (unsigned long)stats_.retryDelay_ms);
+}
+
+/**
+ * @brief Consistent copy of the counters, safe from any task
+ */
+SystemStorageStats SystemStorage::GetStats()
+{
+    taskENTER_CRITICAL();
+    const SystemStorageStats copy = stats_;
+    taskEXIT_CRITICAL();
+    return copy;
+}
+
+/**
+ * @brief Prints the program counters on the debug console
+ */
+void SystemStorage::PrintStats()
+{
+    const SystemStorageStats s = GetStats();
+    SOAR_PRINT("Storage Records    \t: %lu written, %lu failed", (unsigned long)s.commits, (unsigned long)s.failures);
+    if (s.retryDelay_ms != 0)
+        SOAR_PRINT(", retrying every %lu ms", (unsigned long)s.retryDelay_ms);
+    SOAR_PRINT("\n\n");
+}
+
+/**
+ * @brief Programs a state into the next free slot, switching banks if the active one is full
+ * @param state The state to store
+ * @return True if the record was programmed and reads back valid
+ */
+bool SystemStorage::Commit(const SystemState& state)
+{
+    SystemStorageRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = STORAGE_RECORD_MAGIC;
+    record.version = STORAGE_RECORD_VERSION;
+    record.length = sizeof(SystemState);
+    record.sequence = sequence_ + 1;
+    record.state = state;
+    record.crc = RecordCrc(record);
+
+    // The full bank keeps the newest record until the other one has a newer one
+    if (nextSlot_ >= STORAGE_SLOTS_PER_BANK) {
+        const uint8_t other = activeBank_ ^ 1;
+        if (!EraseBank(other)) {
+            SOAR_PRINT("SystemStorage: bank %c erase failed\n", 'A' + other);
+            return false;
+        }
+        activeBank_ = other;
+        nextSlot_ = 0;
+    }
+
+    const uint16_t slot = nextSlot_++;
+    SystemStorageRecord readBack;
+    if (!ProgramRecord(activeBank_, slot, record) || !ReadSlot(activeBank_, slot, readBack) || !IsValid(readBack)) {
+        SOAR_PRINT("SystemStorage: bank %c slot %u program failed\n", 'A' + activeBank_, slot);
+        return false;
+    }
+
+    state_ = state;
+    sequence_ = record.sequence;
+    hasState_ = true;
+    return true;
+}
+
+/**
+ * @brief Copies a slot out of flash, a double ECC error fails the read instead of hanging in the NMI
+ * @param size Bytes from the start of the slot, whole double words
+ * @return False if a double word failed ECC, its program was cut short
+ */
+bool SystemStorage::ReadSlot(uint8_t bank, uint16_t slot, SystemStorageRecord& record, uint16_t size) const
+{
+    const volatile uint32_t* from = (const volatile uint32_t*)Slot(bank, slot);
+    uint32_t* to = (uint32_t*)&record;
+
+    eccFailed = false;
+    for (uint16_t i = 0; i < size / 4; i++)
+        to[i] = from[i];
+
+    // The NMI is taken once the failing read completes, make sure that's happened before looking at the flag
+    __DSB();
+    __ISB();
+    return !eccFailed;
+}
+
+/**
+ * @brief Called from the NMI, clears a double ECC error in the storage banks so the read that hit it can fail
+ * @return False if the NMI wasn't a storage bank ECC error, the handler then stops as before
+ */
+bool SystemStorage::OnEccNmi()
+{
+    const uint32_t eccr = FLASH->ECCR;
+    if ((eccr & FLASH_ECCR_ECCD) == 0 || (eccr & FLASH_ECCR_SYSF_ECC) != 0)
+        return false;
+
+    const uint32_t address = FLASH_BASE + ((eccr & FLASH_ECCR_ADDR_ECC) >> FLASH_ECCR_ADDR_ECC_Pos) * 8;
+    if (address < STORAGE_BANK_A_ADDRESS || address >= STORAGE_BANK_B_ADDRESS + STORAGE_BANK_SIZE)
+        return false;
+
+    FLASH->ECCR = (eccr & FLASH_ECCR_ECCCIE) | FLASH_ECCR_ECCD;    // Write one to clear, leaves a pending ECCC alone
+    eccFailed = true;
+    return true;
+}
+
+/**
+ * @brief Programs one record, a double word at a time from the start so the CRC goes in last
+ */
+bool SystemStorage::ProgramRecord(uint8_t bank, uint16_t slot, const SystemStorageRecord& record)
+{
+    const uint32_t address = (uint32_t)(uintptr_t)Slot(bank, slot);
+    const uint64_t* words = (const uint64_t*)&record;
+    bool ok = true;
+
+    HAL_FLASH_Unlock();
+    for (uint16_t i = 0; i < sizeof(SystemStorageRecord) / 8 && ok; i++)
+        ok = (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + i * 8, words[i]) == HAL_OK);
+    HAL_FLASH_Lock();
+
+    return ok;
+}
+
+/**
+ * @brief Erases one bank
+ */
+bool SystemStorage::EraseBank(uint8_t bank)
+{
+    FLASH_EraseInitTypeDef erase;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Page = (bankAddress_[bank] - FLASH_BASE) / FLASH_PAGE_SIZE;
+    erase.NbPages = STORAGE_BANK_SIZE / FLASH_PAGE_SIZE;
+    uint32_t pageError = 0;
+
+    HAL_FLASH_Unlock();
+    const bool ok = (HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK);
+    HAL_FLASH_Lock();
+
+    return ok;
+}
+
+/**
+ * @brief CRC16 of a record up to, not including, the CRC
+ */
+uint16_t SystemStorage::RecordCrc(const SystemStorageRecord& record)
+{
+    return Utils::getCRC16((uint8_t*)&record, offsetof(SystemStorageRecord, crc));
+}
+
+/**
+ * @brief Checks a record is whole and written by this version of the firmware
+ */
+bool SystemStorage::IsValid(const SystemStorageRecord& record)
+{
+    return record.magic == STORAGE_RECORD_MAGIC && record.version == STORAGE_RECORD_VERSION
+        && record.length == sizeof(SystemState) && record.crc == RecordCrc(record);
+}
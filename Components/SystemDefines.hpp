@@ -80,6 +80,21 @@ constexpr uint8_t CHARGER_TASK_RTOS_PRIORITY = 2;            // Priority of the
 constexpr uint8_t CHARGER_TASK_QUEUE_DEPTH_OBJS = 10;        // Size of the charger task queue
 constexpr uint16_t CHARGER_TASK_STACK_DEPTH_WORDS = 512;        // Size of the charger task stack
 
+// System Storage Task
+constexpr uint8_t STORAGE_TASK_RTOS_PRIORITY = 1;            // Priority of the storage task, flash programming stalls the CPU anyway
+constexpr uint8_t STORAGE_TASK_QUEUE_DEPTH_OBJS = 10;        // Size of the storage task queue
+constexpr uint16_t STORAGE_TASK_STACK_DEPTH_WORDS = 256;        // Size of the storage task stack
+
+// Watchdog Task
+constexpr uint8_t WATCHDOG_TASK_RTOS_PRIORITY = 5;            // Priority of the watchdog supervisor, above every task it supervises
+constexpr uint8_t WATCHDOG_TASK_QUEUE_DEPTH_OBJS = 5;        // Size of the watchdog task queue
+constexpr uint16_t WATCHDOG_TASK_STACK_DEPTH_WORDS = 256;        // Size of the watchdog task stack
+
+// Timer Wheel Task
+constexpr uint8_t TIMER_WHEEL_TASK_RTOS_PRIORITY = 3;            // Priority of the timer wheel, every Timer callback runs at this priority
+constexpr uint8_t TIMER_WHEEL_TASK_QUEUE_DEPTH_OBJS = 1;        // Size of the timer wheel queue, unused, it's woken by task notification
+constexpr uint16_t TIMER_WHEEL_TASK_STACK_DEPTH_WORDS = 256;        // Size of the timer wheel stack, Timer callbacks run on it
+
 // TODO: Turn state machine into a task perhaps
 
 /* System Defines ------------------------------------------------------------------*/
@@ -24,14 +24,14 @@
  */
 uint16_t Utils::averageArray(uint16_t array[], int size)
 {
-    uint16_t sum = 0;
+    uint32_t sum = 0;    // A uint16_t overflows after ~17 cell voltages
 
     for (int i = 0; i < size; i++)
     {
         sum += array[i];
     }
 
-    return (sum / size);
+    return (uint16_t)(sum / size);
 }
 
 /**
@@ -10,17 +10,12 @@
 #ifndef AVIONICS_INCLUDE_SOAR_UTILS_HPP_
 #define AVIONICS_INCLUDE_SOAR_UTILS_HPP_
 #include "cmsis_os.h"    // CMSIS RTOS definitions
+#include "Units.hpp"    // Integer unit conversions (Units::MilliDegToMicroRad etc.), there's no FPU so no float conversions here
 
 // Programmer Macros
 constexpr uint16_t ERRVAL = 0xDEAD;    // Error value for debugging
 
 // Math macros and conversions
-constexpr double MATH_PI = 3.14159265358979323846;
-#define DEG_TO_RAD(degrees) ((degrees) * 0.01745329251994329576923690768489f)    // Degrees to radians (PI/180)
-#define RAD_TO_DEG(radians) ((radians) * 57.295779513082320876798154814105f)    // Radians to degrees (180/PI)
-#define MILLIG_TO_MPS2(millig) ((millig) * 9.80665f)    // Milli-g to m/s^2
-#define MILLIDPS_TO_RADPS(millidps) ((millidps) * 0.00017453292519943295769236907684886f)    // Milli-degrees per second to radians per second (PI/180/1000)
-#define LBS_TO_GRAMS(lbs) ((lbs) * 453.59237f)    // Pounds to grams
 #define GET_COBS_MAX_LEN(len) (((len) + ((len) / 254) + 1) + 1)    // Get the max length of a COBS encoded string, we add 1 for the 0x00 delimiter
 
 // Conversion macros (SYSTEM)
@@ -14,6 +14,10 @@
 #include "Mutex.hpp"
 #include "Command.hpp"
 #include "UARTDriver.hpp"
+#include "LowPower.hpp"
+#include "Watchdog.hpp"
+#include "TimerWheel.hpp"
+#include "HighResTimer.hpp"
 
 // Tasks
 #include "UARTTask.hpp"
@@ -21,6 +25,8 @@
 #include "DebugTask.hpp"
 #include "PMBProtocolTask.hpp"
 #include "TelemetryTask.hpp"
+#include "SystemStorage.hpp"
+#include "WatchdogTask.hpp"
 
 /* Global Variables ------------------------------------------------------------------*/
 Mutex Global::vaListMutex;
@@ -30,8 +36,14 @@ Mutex Global::vaListMutex;
  * @brief Main function interface, called inside main.cpp before os initialization takes place.
 */
 void run_main() {
+    Watchdog::CheckResetCause();    // Before anything can overwrite the retained record
+    LowPower::Init();    // Polls the SysTick to calibrate the LSI, before anything can mask it
+    HighResTimer::Init();
+
     // Init Tasks
     WatchdogTask::Inst().InitTask();
+    TimerWheel::Inst().InitTask();
+    SystemStorage::Inst().InitTask();    // Before any task that reads the stored state
     FlightTask::Inst().InitTask();
     UARTTask::Inst().InitTask();
     DebugTask::Inst().InitTask();
@@ -40,7 +52,10 @@ void run_main() {
 
     // Print System Boot Info : Warning, don't queue more than 10 prints before scheduler starts
     SOAR_PRINT("\n-- SOAR AVIONICS --\n");
-    SOAR_PRINT("System Reset Reason: [TODO]\n"); //TODO: If we want a system reset reason we need to save it on flash
+    SOAR_PRINT("System Reset Reason: %s\n", Watchdog::GetResetCause());
+    const WatchdogStatus watchdog = Watchdog::GetStatus();
+    if (watchdog.hasRecord)
+        SOAR_PRINT("%s missed its deadline, %lu watchdog resets in a row\n", watchdog.record.name, (unsigned long)watchdog.record.resetCount);
     SOAR_PRINT("Current System Heap Use: %d Bytes\n", xPortGetFreeHeapSize());
     SOAR_PRINT("Lowest Ever Heap Size: %d Bytes\n\n", xPortGetMinimumEverFreeHeapSize());
     
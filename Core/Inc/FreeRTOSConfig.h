@@ -144,6 +144,25 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Per task run time on TIM2, see RuntimeStats.hpp */
+#define configGENERATE_RUN_TIME_STATS            1
+#define INCLUDE_xTaskGetIdleTaskHandle           1
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  void RuntimeStats_ConfigureTimer(void);
+  uint32_t RuntimeStats_GetCounter(void);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() RuntimeStats_ConfigureTimer()
+#define portGET_RUN_TIME_COUNTER_VALUE()         RuntimeStats_GetCounter()
+/* Tickless idle with STOP1 on LPTIM1, see LowPower.hpp */
+#define configUSE_TICKLESS_IDLE                  2
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP    2
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  void LowPower_SuppressTicksAndSleep(uint32_t expectedIdleTicks);
+#endif
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) LowPower_SuppressTicksAndSleep(xExpectedIdleTime)
+/* Kernel task names, the kernel's own defaults, defined here so the stack monitor can match them */
+#define configIDLE_TASK_NAME                     "IDLE"
+#define configTIMER_SERVICE_TASK_NAME            "Tmr Svc"
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -57,6 +57,8 @@ void Error_Handler(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
+#define BMS_ALERT_Pin GPIO_PIN_5
+#define BMS_ALERT_GPIO_Port GPIOB
 
 /* USER CODE BEGIN Private defines */
 
@@ -24,6 +24,7 @@
 #include "task.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include <stdbool.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -48,6 +49,9 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+bool cpp_NMI_Handler(void);
+void cpp_EXTI4_15_IRQHandler(void);
+void cpp_TIM2_IRQHandler(void);
 
 /* USER CODE END PFP */
 
@@ -71,7 +75,10 @@
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
-
+  if (cpp_NMI_Handler())
+  {
+    return;
+  }
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
   while (1)
@@ -125,5 +132,20 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles EXTI line 4 to 15 interrupts, the BMS ALERT pin.
+  */
+void EXTI4_15_IRQHandler(void)
+{
+  cpp_EXTI4_15_IRQHandler();
+}
+
+/**
+  * @brief This function handles TIM2 global interrupt, the high resolution timer compare.
+  */
+void TIM2_IRQHandler(void)
+{
+  cpp_TIM2_IRQHandler();
+}
 
 /* USER CODE END 1 */